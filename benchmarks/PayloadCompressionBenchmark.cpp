@@ -0,0 +1,85 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "core/protocol/wolkabout/WolkaboutDataProtocol.h"
+#include "core/utilities/Logger.h"
+#include "wolk/protocol/CompressedWolkaboutDataProtocol.h"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+using namespace wolkabout;
+using namespace wolkabout::connect;
+
+namespace
+{
+const std::vector<std::string> FEED_REFERENCES = {"T", "H", "P", "ACL", "SW", "LOC", "BAT", "RSSI"};
+const std::string DEVICE_KEY = "BenchmarkDevice";
+const std::size_t ITERATIONS = 1000;
+
+FeedValuesMessage makeFeedValues(std::size_t count)
+{
+    auto readings = std::vector<Reading>{};
+    for (auto i = std::size_t{0}; i < count; ++i)
+    {
+        const auto value = 20.0 + static_cast<double>(i % 13) * 0.25;
+        readings.emplace_back(FEED_REFERENCES[i % FEED_REFERENCES.size()], std::to_string(value),
+                              1650000000000 + (i / FEED_REFERENCES.size()) * 1000);
+    }
+    return FeedValuesMessage{readings};
+}
+
+// Makes the message ITERATIONS times, and returns the payload size and the average time per message.
+std::pair<std::size_t, double> measure(DataProtocol& protocol, std::size_t readings)
+{
+    auto size = std::size_t{0};
+    const auto start = std::chrono::steady_clock::now();
+    for (auto i = std::size_t{0}; i < ITERATIONS; ++i)
+        size = protocol.makeOutboundMessage(DEVICE_KEY, makeFeedValues(readings))->getContent().size();
+    const auto elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start);
+    return {size, elapsed.count() / ITERATIONS};
+}
+}    // namespace
+
+int main(int /* argc */, char** /* argv */)
+{
+    Logger::init(LogLevel::INFO, Logger::Type::CONSOLE);
+
+    auto plainProtocol = WolkaboutDataProtocol{};
+    CompressedWolkaboutDataProtocol fastProtocol{0, FEED_REFERENCES, 1};
+    CompressedWolkaboutDataProtocol defaultProtocol{0, FEED_REFERENCES, 6};
+    CompressedWolkaboutDataProtocol noDictionaryProtocol{0, {}, 6};
+    for (auto protocol : {&fastProtocol, &defaultProtocol, &noDictionaryProtocol})
+        protocol->setCompressionAccepted(DEVICE_KEY, true);
+
+    std::cout << std::setw(10) << "readings" << std::setw(14) << "json [B]" << std::setw(14) << "json [us]"
+              << std::setw(14) << "lvl1 [B]" << std::setw(14) << "lvl1 [us]" << std::setw(14) << "lvl6 [B]"
+              << std::setw(14) << "lvl6 [us]" << std::setw(16) << "no dict [B]" << std::endl;
+    for (const auto readings : {1, 10, 50, 200, 1000})
+    {
+        const auto count = static_cast<std::size_t>(readings);
+        const auto plain = measure(plainProtocol, count);
+        const auto fast = measure(fastProtocol, count);
+        const auto regular = measure(defaultProtocol, count);
+        const auto noDictionary = measure(noDictionaryProtocol, count);
+        std::cout << std::fixed << std::setprecision(2) << std::setw(10) << count << std::setw(14) << plain.first
+                  << std::setw(14) << plain.second << std::setw(14) << fast.first << std::setw(14) << fast.second
+                  << std::setw(14) << regular.first << std::setw(14) << regular.second << std::setw(16)
+                  << noDictionary.first << std::endl;
+    }
+    return 0;
+}
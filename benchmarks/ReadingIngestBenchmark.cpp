@@ -0,0 +1,157 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "core/connectivity/ConnectivityService.h"
+#include "core/connectivity/OutboundMessageHandler.h"
+#include "core/connectivity/OutboundRetryMessageHandler.h"
+#include "core/persistence/inmemory/InMemoryPersistence.h"
+#include "core/protocol/wolkabout/WolkaboutDataProtocol.h"
+#include "core/utilities/Logger.h"
+#include "wolk/service/data/DataService.h"
+#include "wolk/service/data/ReadingIngestQueue.h"
+
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+using namespace wolkabout;
+using namespace wolkabout::connect;
+
+namespace
+{
+const std::string DEVICE_KEY = "BenchmarkDevice";
+const std::size_t READINGS_PER_THREAD = 100000;
+const std::size_t QUEUE_CAPACITY = 65536;
+const std::size_t BATCH_SIZE = 256;
+
+// The way the readings get into the persistence
+enum class Path
+{
+    Direct,
+    Queue,
+    Service
+};
+
+// The readings are only stored, so nothing is ever sent out
+class NullConnectivityService : public ConnectivityService
+{
+public:
+    bool connect() override { return true; }
+    void disconnect() override {}
+    bool reconnect() override { return true; }
+    bool isConnected() override { return true; }
+    bool publish(std::shared_ptr<Message>) override { return true; }
+};
+
+class NullOutboundMessageHandler : public OutboundMessageHandler
+{
+public:
+    void addMessage(std::shared_ptr<Message>) override {}
+};
+
+// Runs the producers, and returns the count of readings stored per second.
+double measure(std::size_t producers, Path path)
+{
+    InMemoryPersistence persistence;
+    ReadingIngestQueue queue{QUEUE_CAPACITY};
+    std::atomic<std::size_t> producing{producers};
+
+    // Through the service, the readings take the same way as the ones added by an application
+    WolkaboutDataProtocol protocol;
+    NullConnectivityService connectivityService;
+    NullOutboundMessageHandler outboundMessageHandler;
+    OutboundRetryMessageHandler outboundRetryMessageHandler{outboundMessageHandler};
+    DataService service{protocol, persistence, connectivityService, outboundRetryMessageHandler, {}, {}, {}};
+    if (path == Path::Service)
+        service.startIngestQueue(QUEUE_CAPACITY, IngestOverflowPolicy::Block);
+
+    // With the raw queue, a single consumer is the only thread that touches the persistence
+    auto consumer = std::thread{[&] {
+        if (path != Path::Queue)
+            return;
+        auto batch = std::vector<IngestedReading>{};
+        batch.reserve(BATCH_SIZE);
+        while (true)
+        {
+            const auto finished = producing.load() == 0;
+            batch.clear();
+            if (queue.drain(batch, BATCH_SIZE) == 0)
+            {
+                if (finished)
+                    return;
+                std::this_thread::yield();
+                continue;
+            }
+            for (const auto& ingested : batch)
+                persistence.putReading(ingested.deviceKey + "+" + ingested.reading.getReference(), ingested.reading);
+        }
+    }};
+
+    const auto start = std::chrono::steady_clock::now();
+    auto threads = std::vector<std::thread>{};
+    for (auto i = std::size_t{0}; i < producers; ++i)
+    {
+        threads.emplace_back([&, i] {
+            const auto reference = "T" + std::to_string(i % 8);
+            for (auto j = std::size_t{0}; j < READINGS_PER_THREAD; ++j)
+            {
+                const auto reading = Reading{reference, std::to_string(j), static_cast<std::uint64_t>(j)};
+                switch (path)
+                {
+                case Path::Direct:
+                    persistence.putReading(DEVICE_KEY + "+" + reference, reading);
+                    break;
+                case Path::Queue:
+                    while (!queue.tryPush(DEVICE_KEY, reading))
+                        std::this_thread::yield();
+                    break;
+                case Path::Service:
+                    service.addReading(DEVICE_KEY, reading);
+                    break;
+                }
+            }
+            --producing;
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+    consumer.join();
+    service.stopIngestQueue();
+    const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start);
+    return static_cast<double>(producers * READINGS_PER_THREAD) / elapsed.count();
+}
+}    // namespace
+
+int main(int /* argc */, char** /* argv */)
+{
+    Logger::init(LogLevel::INFO, Logger::Type::CONSOLE);
+
+    std::cout << std::setw(10) << "threads" << std::setw(18) << "direct [1/s]" << std::setw(18) << "queue [1/s]"
+              << std::setw(18) << "service [1/s]" << std::setw(10) << "ratio" << std::endl;
+    for (const auto producers : {1, 2, 4, 8, 16, 32, 64})
+    {
+        const auto count = static_cast<std::size_t>(producers);
+        const auto direct = measure(count, Path::Direct);
+        const auto queued = measure(count, Path::Queue);
+        const auto service = measure(count, Path::Service);
+        std::cout << std::fixed << std::setprecision(0) << std::setw(10) << count << std::setw(18) << direct
+                  << std::setw(18) << queued << std::setw(18) << service << std::setprecision(2) << std::setw(10)
+                  << service / direct << std::endl;
+    }
+    return 0;
+}
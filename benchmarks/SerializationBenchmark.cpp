@@ -0,0 +1,89 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "core/protocol/wolkabout/WolkaboutDataProtocol.h"
+#include "core/utilities/Logger.h"
+#include "wolk/protocol/BinaryWolkaboutDataProtocol.h"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+using namespace wolkabout;
+using namespace wolkabout::connect;
+
+namespace
+{
+const std::vector<std::string> FEED_REFERENCES = {"T", "H", "P", "ACL", "SW", "LOC", "BAT", "RSSI"};
+const std::string DEVICE_KEY = "BenchmarkDevice";
+const std::size_t ITERATIONS = 1000;
+
+// Makes readings of mixed types, the way a device with a handful of sensors would report them.
+FeedValuesMessage makeFeedValues(std::size_t count)
+{
+    auto readings = std::vector<Reading>{};
+    for (auto i = std::size_t{0}; i < count; ++i)
+    {
+        const auto& reference = FEED_REFERENCES[i % FEED_REFERENCES.size()];
+        const auto timestamp = 1650000000000 + (i / FEED_REFERENCES.size()) * 1000;
+        if (reference == "SW")
+            readings.emplace_back(reference, std::string{i % 2 ? "true" : "false"}, timestamp);
+        else if (reference == "ACL" || reference == "LOC")
+            readings.emplace_back(reference, std::vector<std::string>{"45.2671", "19.8335", std::to_string(i % 7)},
+                                  timestamp);
+        else
+            readings.emplace_back(reference, std::to_string(20.0 + static_cast<double>(i % 13) * 0.25), timestamp);
+    }
+    return FeedValuesMessage{readings};
+}
+
+// Makes the message ITERATIONS times, and returns the payload size and the average time per message.
+std::pair<std::size_t, double> measure(DataProtocol& protocol, std::size_t readings)
+{
+    const auto message = makeFeedValues(readings);
+    auto size = std::size_t{0};
+    const auto start = std::chrono::steady_clock::now();
+    for (auto i = std::size_t{0}; i < ITERATIONS; ++i)
+        size = protocol.makeOutboundMessage(DEVICE_KEY, message)->getContent().size();
+    const auto elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start);
+    return {size, elapsed.count() / ITERATIONS};
+}
+}    // namespace
+
+int main(int /* argc */, char** /* argv */)
+{
+    Logger::init(LogLevel::INFO, Logger::Type::CONSOLE);
+
+    auto jsonProtocol = WolkaboutDataProtocol{};
+    BinaryWolkaboutDataProtocol binaryProtocol{FEED_REFERENCES};
+    BinaryWolkaboutDataProtocol noDictionaryProtocol{};
+
+    std::cout << std::setw(10) << "readings" << std::setw(14) << "json [B]" << std::setw(14) << "json [us]"
+              << std::setw(14) << "cbor [B]" << std::setw(14) << "cbor [us]" << std::setw(16) << "no dict [B]"
+              << std::setw(10) << "ratio" << std::endl;
+    for (const auto readings : {1, 10, 50, 200, 1000})
+    {
+        const auto count = static_cast<std::size_t>(readings);
+        const auto json = measure(jsonProtocol, count);
+        const auto binary = measure(binaryProtocol, count);
+        const auto noDictionary = measure(noDictionaryProtocol, count);
+        const auto ratio = static_cast<double>(binary.first) / static_cast<double>(json.first);
+        std::cout << std::fixed << std::setprecision(2) << std::setw(10) << count << std::setw(14) << json.first
+                  << std::setw(14) << json.second << std::setw(14) << binary.first << std::setw(14) << binary.second
+                  << std::setw(16) << noDictionary.first << std::setw(10) << ratio << std::endl;
+    }
+    return 0;
+}
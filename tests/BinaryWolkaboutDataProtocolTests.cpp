@@ -0,0 +1,242 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define private public
+#define protected public
+#include "wolk/protocol/BinaryWolkaboutDataProtocol.h"
+#include "wolk/protocol/CborWriter.h"
+#undef private
+#undef protected
+
+#include "core/utilities/Logger.h"
+#include "tests/utilities/CborReader.h"
+
+#include <gtest/gtest.h>
+
+using namespace ::testing;
+using namespace wolkabout;
+using namespace wolkabout::connect;
+
+class BinaryWolkaboutDataProtocolTests : public ::testing::Test
+{
+public:
+    static void SetUpTestCase() { Logger::init(LogLevel::TRACE, Logger::Type::CONSOLE); }
+
+    void SetUp() override
+    {
+        protocol = std::unique_ptr<BinaryWolkaboutDataProtocol>{new BinaryWolkaboutDataProtocol{{"T", "H"}}};
+    }
+
+    // Decodes the payload, checks the header and returns the body
+    std::unique_ptr<CborValue> decodeBody(const std::string& payload, BinaryPayloadKind kind)
+    {
+        auto reader = CborReader{payload};
+        auto value = reader.read();
+        EXPECT_TRUE(reader.isAtEnd());
+        if (value == nullptr || value->type != CborValue::Type::TAG || value->items.size() != 1)
+            return nullptr;
+        EXPECT_EQ(value->unsignedValue, CborWriter::SELF_DESCRIBE_TAG);
+
+        const auto& envelope = value->items.front();
+        if (envelope.type != CborValue::Type::ARRAY || envelope.items.size() != 4)
+            return nullptr;
+        EXPECT_EQ(envelope.items[0].unsignedValue, BinaryWolkaboutDataProtocol::FORMAT_VERSION);
+        EXPECT_EQ(envelope.items[1].unsignedValue, protocol->getDictionaryId());
+        EXPECT_EQ(envelope.items[2].unsignedValue, static_cast<std::uint64_t>(kind));
+        return std::unique_ptr<CborValue>{new CborValue{envelope.items[3]}};
+    }
+
+    static CborValue encodeTypedValue(const std::string& value)
+    {
+        auto writer = CborWriter{};
+        BinaryWolkaboutDataProtocol::writeTypedValue(writer, value);
+        return *CborReader{writer.release()}.read();
+    }
+
+    std::unique_ptr<BinaryWolkaboutDataProtocol> protocol;
+
+    const std::string DEVICE_KEY = "TestDevice";
+};
+
+TEST_F(BinaryWolkaboutDataProtocolTests, CborRoundTrip)
+{
+    auto writer = CborWriter{};
+    writer.writeArrayHeader(8);
+    writer.writeUnsigned(23);
+    writer.writeUnsigned(1650000000000);
+    writer.writeSigned(-500);
+    writer.writeDouble(1.5);
+    writer.writeDouble(0.1);
+    writer.writeBool(true);
+    writer.writeNull();
+    writer.writeMapHeader(1);
+    writer.writeText("key");
+    writer.writeText(std::string(300, 'a'));
+
+    auto reader = CborReader{writer.release()};
+    const auto value = reader.read();
+    ASSERT_NE(value, nullptr);
+    EXPECT_TRUE(reader.isAtEnd());
+    ASSERT_EQ(value->type, CborValue::Type::ARRAY);
+    ASSERT_EQ(value->items.size(), 8);
+    EXPECT_EQ(value->items[0].unsignedValue, 23);
+    EXPECT_EQ(value->items[1].unsignedValue, 1650000000000);
+    EXPECT_EQ(value->items[2].signedValue, -500);
+    EXPECT_DOUBLE_EQ(value->items[3].doubleValue, 1.5);
+    EXPECT_DOUBLE_EQ(value->items[4].doubleValue, 0.1);
+    EXPECT_TRUE(value->items[5].boolValue);
+    EXPECT_EQ(value->items[6].type, CborValue::Type::NULL_VALUE);
+    ASSERT_EQ(value->items[7].type, CborValue::Type::MAP);
+    EXPECT_EQ(value->items[7].items[0].text, "key");
+    EXPECT_EQ(value->items[7].items[1].text, std::string(300, 'a'));
+}
+
+TEST_F(BinaryWolkaboutDataProtocolTests, CborReaderRejectsMalformedData)
+{
+    EXPECT_EQ(CborReader{""}.read(), nullptr);
+    // Truncated text
+    EXPECT_EQ(CborReader{"\x65" "ab"}.read(), nullptr);
+    // Array that claims more items than there is data
+    EXPECT_EQ(CborReader{"\x9b\xff\xff\xff\xff\xff\xff\xff\xff"}.read(), nullptr);
+    // Map whose count of items would overflow when doubled
+    EXPECT_EQ(CborReader(std::string{"\xbb\x80\x00\x00\x00\x00\x00\x00\x00", 9}).read(), nullptr);
+    // Indefinite length
+    EXPECT_EQ(CborReader{"\x9f"}.read(), nullptr);
+}
+
+TEST_F(BinaryWolkaboutDataProtocolTests, TypedValues)
+{
+    EXPECT_EQ(encodeTypedValue("true").type, CborValue::Type::BOOL);
+    EXPECT_EQ(encodeTypedValue("42").unsignedValue, 42);
+    EXPECT_EQ(encodeTypedValue("-42").signedValue, -42);
+    EXPECT_DOUBLE_EQ(encodeTypedValue("21.5").doubleValue, 21.5);
+    EXPECT_EQ(encodeTypedValue("007").text, "007");
+    EXPECT_EQ(encodeTypedValue("0").unsignedValue, 0);
+    EXPECT_DOUBLE_EQ(encodeTypedValue("0.25").doubleValue, 0.25);
+    EXPECT_EQ(encodeTypedValue("ON").text, "ON");
+    EXPECT_EQ(encodeTypedValue("").type, CborValue::Type::TEXT);
+    EXPECT_EQ(encodeTypedValue("99999999999999999999999").type, CborValue::Type::TEXT);
+}
+
+TEST_F(BinaryWolkaboutDataProtocolTests, NumbersThatDoNotFormatBackStayText)
+{
+    for (const auto& value :
+         {"+5", "-0", "1.50", "1.0", "1e5", ".5", "-007", "0.10000000000000001", "12345678901234567890"})
+    {
+        const auto encoded = encodeTypedValue(value);
+        EXPECT_EQ(encoded.type, CborValue::Type::TEXT) << value;
+        EXPECT_EQ(encoded.text, value);
+    }
+    EXPECT_DOUBLE_EQ(encodeTypedValue("0.1").doubleValue, 0.1);
+    EXPECT_DOUBLE_EQ(encodeTypedValue("-3.75").doubleValue, -3.75);
+    EXPECT_DOUBLE_EQ(encodeTypedValue("1e+23").doubleValue, 1e23);
+}
+
+TEST_F(BinaryWolkaboutDataProtocolTests, TextFeedValuesStayText)
+{
+    protocol = std::unique_ptr<BinaryWolkaboutDataProtocol>{new BinaryWolkaboutDataProtocol{{"T", "H"}, {"SN"}}};
+    const auto message = protocol->makeOutboundMessage(
+      DEVICE_KEY,
+      FeedValuesMessage{{Reading{"SN", std::string{"1234"}, 1000}, Reading{"T", std::string{"1234"}, 1000}}});
+    ASSERT_NE(message, nullptr);
+
+    const auto body = decodeBody(message->getContent(), BinaryPayloadKind::FEED_VALUES);
+    ASSERT_NE(body, nullptr);
+    const auto& readings = body->items[1].items;
+    ASSERT_EQ(readings.size(), 4);
+    EXPECT_EQ(readings[0].text, "SN");
+    EXPECT_EQ(readings[1].type, CborValue::Type::TEXT);
+    EXPECT_EQ(readings[1].text, "1234");
+    EXPECT_EQ(readings[3].unsignedValue, 1234);
+}
+
+TEST_F(BinaryWolkaboutDataProtocolTests, FeedValues)
+{
+    const auto message = protocol->makeOutboundMessage(
+      DEVICE_KEY, FeedValuesMessage{{Reading{"T", std::string{"21"}, 1000}, Reading{"X", std::string{"ON"}, 1000},
+                                     Reading{"H", std::vector<std::string>{"1", "2"}, 2000}}});
+    ASSERT_NE(message, nullptr);
+    EXPECT_EQ(message->getContent().substr(0, 3), "\xd9\xd9\xf7");
+
+    const auto body = decodeBody(message->getContent(), BinaryPayloadKind::FEED_VALUES);
+    ASSERT_NE(body, nullptr);
+    ASSERT_EQ(body->type, CborValue::Type::MAP);
+    ASSERT_EQ(body->items.size(), 4);
+
+    // The first timestamp has a reference from the dictionary, and one that is not in it
+    EXPECT_EQ(body->items[0].unsignedValue, 1000);
+    const auto& first = body->items[1].items;
+    ASSERT_EQ(first.size(), 4);
+    EXPECT_EQ(first[0].unsignedValue, 0);
+    EXPECT_EQ(first[1].unsignedValue, 21);
+    EXPECT_EQ(first[2].text, "X");
+    EXPECT_EQ(first[3].text, "ON");
+
+    // The second timestamp has a multi-value reading
+    EXPECT_EQ(body->items[2].unsignedValue, 2000);
+    const auto& second = body->items[3].items;
+    ASSERT_EQ(second.size(), 2);
+    EXPECT_EQ(second[0].unsignedValue, 1);
+    ASSERT_EQ(second[1].type, CborValue::Type::ARRAY);
+    EXPECT_EQ(second[1].items[1].unsignedValue, 2);
+
+    // The channel is cached per device
+    EXPECT_EQ(protocol->m_channels.size(), 1);
+}
+
+TEST_F(BinaryWolkaboutDataProtocolTests, BinaryIsSmallerThanJson)
+{
+    auto readings = std::vector<Reading>{};
+    for (auto i = 0; i < 100; ++i)
+        readings.emplace_back(i % 2 ? "T" : "H", std::to_string(20 + i % 5), 1650000000000 + i * 1000);
+
+    const auto json = WolkaboutDataProtocol{}.makeOutboundMessage(DEVICE_KEY, FeedValuesMessage{readings});
+    const auto binary = protocol->makeOutboundMessage(DEVICE_KEY, FeedValuesMessage{readings});
+    ASSERT_NE(json, nullptr);
+    ASSERT_NE(binary, nullptr);
+    EXPECT_EQ(binary->getChannel(), json->getChannel());
+    EXPECT_LT(binary->getContent().size(), json->getContent().size());
+}
+
+TEST_F(BinaryWolkaboutDataProtocolTests, Parameters)
+{
+    const auto message = protocol->makeOutboundMessage(
+      DEVICE_KEY, ParametersUpdateMessage{{{ParameterName::FIRMWARE_VERSION, "1.0.0"}}});
+    ASSERT_NE(message, nullptr);
+
+    const auto body = decodeBody(message->getContent(), BinaryPayloadKind::PARAMETERS);
+    ASSERT_NE(body, nullptr);
+    ASSERT_EQ(body->type, CborValue::Type::MAP);
+    ASSERT_EQ(body->items.size(), 2);
+    EXPECT_EQ(body->items[0].text, toString(ParameterName::FIRMWARE_VERSION));
+    EXPECT_EQ(body->items[1].text, "1.0.0");
+}
+
+TEST_F(BinaryWolkaboutDataProtocolTests, Attributes)
+{
+    const auto message = protocol->makeOutboundMessage(
+      DEVICE_KEY, AttributeRegistrationMessage{{Attribute{"Location", DataType::STRING, "Novi Sad"}}});
+    ASSERT_NE(message, nullptr);
+
+    const auto body = decodeBody(message->getContent(), BinaryPayloadKind::ATTRIBUTE_REGISTRATION);
+    ASSERT_NE(body, nullptr);
+    ASSERT_EQ(body->type, CborValue::Type::ARRAY);
+    ASSERT_EQ(body->items.size(), 1);
+    ASSERT_EQ(body->items[0].items.size(), 3);
+    EXPECT_EQ(body->items[0].items[0].text, "Location");
+    EXPECT_EQ(body->items[0].items[1].unsignedValue, static_cast<std::uint64_t>(DataType::STRING));
+    EXPECT_EQ(body->items[0].items[2].text, "Novi Sad");
+}
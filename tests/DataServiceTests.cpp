@@ -20,6 +20,7 @@
 
 #define private public
 #define protected public
+#include "wolk/connectivity/OutboundScheduler.h"
 #include "wolk/service/data/DataService.h"
 #undef private
 #undef protected
@@ -35,6 +36,8 @@
 
 #include <gtest/gtest.h>
 
+#include <future>
+
 using namespace wolkabout::connect;
 using namespace ::testing;
 
@@ -159,33 +162,63 @@ TEST_F(DataServiceTests, PublishReadingsHappyFlow)
     ASSERT_NO_FATAL_FAILURE(service->publishReadingsForPersistenceKey(DEVICE_KEY + "+" + "T"));
 }
 
+TEST_F(DataServiceTests, PublishReadingsThroughSchedulerRemovesThemOnceSent)
+{
+    OutboundScheduler scheduler{*connectivityServiceMock,
+                                [](const wolkabout::Message&) { return wolkabout::MessageType::FEED_VALUES; }, 0, 0};
+    service->setOutboundScheduler(&scheduler);
+    EXPECT_CALL(*persistenceMock, getReadings)
+      .WillOnce(Return(std::vector<std::shared_ptr<Reading>>{std::make_shared<Reading>("T", "TestValue", 123456789)}));
+    EXPECT_CALL(*dataProtocolMock, makeOutboundMessage(A<const std::string&>(), A<FeedValuesMessage>()))
+      .WillOnce(Return(ByMove(std::unique_ptr<wolkabout::Message>{new wolkabout::Message{"", ""}})));
+    EXPECT_CALL(*connectivityServiceMock, isConnected).WillRepeatedly(Return(true));
+
+    // While the message waits in the queue, the readings stay in the persistence, and are not sent again
+    scheduler.m_stopped = false;
+    EXPECT_CALL(*persistenceMock, removeReadings).Times(0);
+    ASSERT_NO_FATAL_FAILURE(service->publishReadingsForPersistenceKey(DEVICE_KEY + "+" + "T"));
+    ASSERT_NO_FATAL_FAILURE(service->publishReadingsForPersistenceKey(DEVICE_KEY + "+" + "T"));
+    EXPECT_EQ(scheduler.getQueueDepth(), 1);
+    Mock::VerifyAndClearExpectations(persistenceMock.get());
+
+    // And they are removed once the dispatcher sent the message
+    auto removed = std::promise<void>{};
+    EXPECT_CALL(*persistenceMock, getReadings).WillOnce(Return(std::vector<std::shared_ptr<Reading>>{}));
+    EXPECT_CALL(*persistenceMock, removeReadings(DEVICE_KEY + "+T", 1))
+      .WillOnce(InvokeWithoutArgs([&] { removed.set_value(); }));
+    EXPECT_CALL(*connectivityServiceMock, publish).WillOnce(Return(true));
+    scheduler.start();
+    EXPECT_EQ(removed.get_future().wait_for(std::chrono::seconds{1}), std::future_status::ready);
+    scheduler.stop();
+}
+
 TEST_F(DataServiceTests, CheckIfSubscriptionExistButItsEmpty)
 {
-    ASSERT_FALSE(service->checkIfSubscriptionIsWaiting(ParametersUpdateMessage{{}}));
+    ASSERT_FALSE(service->checkIfSubscriptionIsWaiting(DEVICE_KEY, ParametersUpdateMessage{{}}));
 }
 
 TEST_F(DataServiceTests, CheckIfSubscriptionExistTwoSubscription)
 {
     // Add the two subscriptions
-    service->m_parameterSubscriptions.emplace(
-      0, DataService::ParameterSubscription{
-           {ParameterName::FIRMWARE_UPDATE_REPOSITORY, ParameterName::FIRMWARE_UPDATE_CHECK_TIME},
-           [](const std::vector<Parameter>&) {}});
-    service->m_parameterSubscriptions.emplace(
-      1, DataService::ParameterSubscription{{ParameterName::FILE_TRANSFER_PLATFORM_ENABLED},
-                                            [](const std::vector<Parameter>&) {}});
+    service->addSubscription(DEVICE_KEY,
+                             {ParameterName::FIRMWARE_UPDATE_REPOSITORY, ParameterName::FIRMWARE_UPDATE_CHECK_TIME},
+                             [](const std::vector<Parameter>&) {}, std::chrono::minutes{1});
+    service->addSubscription(DEVICE_KEY, {ParameterName::FILE_TRANSFER_PLATFORM_ENABLED},
+                             [](const std::vector<Parameter>&) {}, std::chrono::minutes{1});
     std::atomic_bool callbackCalled{false};
     std::mutex mutex;
     std::condition_variable conditionVariable;
-    service->m_parameterSubscriptions.emplace(
-      2, DataService::ParameterSubscription{{ParameterName::EXTERNAL_ID}, [&](const std::vector<Parameter>&) {
-                                                callbackCalled = true;
-                                                conditionVariable.notify_one();
-                                            }});
+    service->addSubscription(
+      DEVICE_KEY, {ParameterName::EXTERNAL_ID},
+      [&](const std::vector<Parameter>&) {
+          callbackCalled = true;
+          conditionVariable.notify_one();
+      },
+      std::chrono::minutes{1});
 
     // Now parse the subscription
-    ASSERT_TRUE(
-      service->checkIfSubscriptionIsWaiting(ParametersUpdateMessage{{{ParameterName::EXTERNAL_ID, "TestValue"}}}));
+    ASSERT_TRUE(service->checkIfSubscriptionIsWaiting(
+      DEVICE_KEY, ParametersUpdateMessage{{{ParameterName::EXTERNAL_ID, "TestValue"}}}));
     if (!callbackCalled)
     {
         std::unique_lock<std::mutex> lock{mutex};
@@ -194,10 +227,68 @@ TEST_F(DataServiceTests, CheckIfSubscriptionExistTwoSubscription)
     EXPECT_TRUE(callbackCalled);
 }
 
+TEST_F(DataServiceTests, CheckIfSubscriptionMatchesDeviceAndParameterSet)
+{
+    service->addSubscription(DEVICE_KEY,
+                             {ParameterName::FIRMWARE_UPDATE_REPOSITORY, ParameterName::FIRMWARE_UPDATE_CHECK_TIME},
+                             [](const std::vector<Parameter>&) {}, std::chrono::minutes{1});
+    const auto message = ParametersUpdateMessage{
+      {{ParameterName::FIRMWARE_UPDATE_CHECK_TIME, "10:00"}, {ParameterName::FIRMWARE_UPDATE_REPOSITORY, "repo"}}};
+
+    // Another device and another parameter set do not answer the subscription
+    EXPECT_FALSE(service->checkIfSubscriptionIsWaiting("OtherDevice", message));
+    EXPECT_FALSE(service->checkIfSubscriptionIsWaiting(
+      DEVICE_KEY, ParametersUpdateMessage{{{ParameterName::FIRMWARE_UPDATE_REPOSITORY, "repo"}}}));
+
+    // The order in which the parameters are received does not matter, and the subscription is answered only once
+    EXPECT_TRUE(service->checkIfSubscriptionIsWaiting(DEVICE_KEY, message));
+    EXPECT_FALSE(service->checkIfSubscriptionIsWaiting(DEVICE_KEY, message));
+    EXPECT_TRUE(service->m_parameterSubscriptions.empty());
+}
+
+TEST_F(DataServiceTests, CheckIfSubscriptionExpired)
+{
+    service->addSubscription(
+      DEVICE_KEY, {ParameterName::EXTERNAL_ID}, [](const std::vector<Parameter>&) { FAIL(); },
+      std::chrono::milliseconds{0});
+    service->addSubscription(DEVICE_KEY, {ParameterName::EXTERNAL_ID}, [](const std::vector<Parameter>&) {},
+                             std::chrono::minutes{1});
+
+    // The expired subscription is dropped, and the next one answers the message
+    EXPECT_TRUE(service->checkIfSubscriptionIsWaiting(
+      DEVICE_KEY, ParametersUpdateMessage{{{ParameterName::EXTERNAL_ID, "TestValue"}}}));
+    EXPECT_TRUE(service->m_parameterSubscriptions.empty());
+    EXPECT_EQ(service->m_subscriptionDeadlines.size(), 1u);
+}
+
 TEST_F(DataServiceTests, CheckIfCallbackNoCallbacks)
 {
     ASSERT_TRUE(service->m_detailsCallbacks.empty());
-    ASSERT_FALSE(service->checkIfCallbackIsWaiting({{}, {}}));
+    ASSERT_FALSE(service->checkIfCallbackIsWaiting(DEVICE_KEY, {{}, {}}));
+}
+
+TEST_F(DataServiceTests, CheckIfCallbackMatchesTheDevice)
+{
+    for (const auto& deviceKey : {"FirstDevice", "SecondDevice"})
+        service->addDetailsCallback(
+          deviceKey, [](const std::vector<std::string>&, const std::vector<std::string>&) {}, std::chrono::minutes{1});
+
+    // The response of the second device does not answer the request of the first one
+    EXPECT_TRUE(service->checkIfCallbackIsWaiting("SecondDevice", {{}, {}}));
+    EXPECT_FALSE(service->checkIfCallbackIsWaiting("SecondDevice", {{}, {}}));
+    ASSERT_EQ(service->m_detailsCallbacks.size(), 1u);
+    EXPECT_EQ(service->m_detailsCallbacks.cbegin()->first, "FirstDevice");
+}
+
+TEST_F(DataServiceTests, CheckIfCallbackExpired)
+{
+    service->addDetailsCallback(
+      DEVICE_KEY, [](const std::vector<std::string>&, const std::vector<std::string>&) { FAIL(); },
+      std::chrono::milliseconds{0});
+
+    EXPECT_FALSE(service->checkIfCallbackIsWaiting(DEVICE_KEY, {{}, {}}));
+    EXPECT_TRUE(service->m_detailsCallbacks.empty());
+    EXPECT_TRUE(service->m_detailsDeadlines.empty());
 }
 
 TEST_F(DataServiceTests, CheckIfCallbackFinallyACallback)
@@ -205,12 +296,14 @@ TEST_F(DataServiceTests, CheckIfCallbackFinallyACallback)
     std::atomic_bool called{false};
     std::mutex mutex;
     std::condition_variable conditionVariable;
-    ASSERT_NO_FATAL_FAILURE(
-      service->m_detailsCallbacks.push([&](const std::vector<std::string>&, const std::vector<std::string>&) {
+    ASSERT_NO_FATAL_FAILURE(service->addDetailsCallback(
+      DEVICE_KEY,
+      [&](const std::vector<std::string>&, const std::vector<std::string>&) {
           called = true;
           conditionVariable.notify_one();
-      }));
-    ASSERT_TRUE(service->checkIfCallbackIsWaiting({{}, {}}));
+      },
+      std::chrono::minutes{1}));
+    ASSERT_TRUE(service->checkIfCallbackIsWaiting(DEVICE_KEY, {{}, {}}));
     if (!called)
     {
         std::unique_lock<std::mutex> lock{mutex};
@@ -246,6 +339,151 @@ TEST_F(DataServiceTests, AddReadings)
                                                             {"T", std::uint64_t{789}, 1234567892}}));
 }
 
+TEST_F(DataServiceTests, AddReadingsThroughIngestQueue)
+{
+    // The readings are stored by the thread of the queue, at the latest when it is stopped
+    EXPECT_CALL(*persistenceMock, putReading).Times(100);
+    service->startIngestQueue(16, IngestOverflowPolicy::Block);
+    for (auto i = 0; i < 100; ++i)
+        ASSERT_NO_FATAL_FAILURE(service->addReading(DEVICE_KEY, "T", std::to_string(i), 1234567890));
+    service->stopIngestQueue();
+    EXPECT_EQ(service->getDroppedReadingCount(), 0u);
+
+    // And once it is stopped, the readings are stored right away
+    EXPECT_CALL(*persistenceMock, putReading).Times(1);
+    ASSERT_NO_FATAL_FAILURE(service->addReading(DEVICE_KEY, "T", "Value", 1234567890));
+}
+
+TEST_F(DataServiceTests, IngestQueueOverflowPolicies)
+{
+    // The queue is not drained while the thread is held in the persistence
+    auto release = std::make_shared<std::promise<void>>();
+    auto released = release->get_future().share();
+    EXPECT_CALL(*persistenceMock, putReading).WillRepeatedly([released](const std::string&, const Reading&) {
+        released.wait();
+        return true;
+    });
+    service->startIngestQueue(2, IngestOverflowPolicy::Reject);
+    for (auto i = 0; i < 10; ++i)
+        service->addReading(DEVICE_KEY, "T", std::to_string(i), 1234567890);
+    EXPECT_GE(service->getDroppedReadingCount(), 6u);
+
+    // With the synchronous policy, the readings that do not fit are stored by the thread adding them
+    service->m_ingestOverflowPolicy = IngestOverflowPolicy::Synchronous;
+    release->set_value();
+    service->addReading(DEVICE_KEY, "T", "Value", 1234567890);
+    service->stopIngestQueue();
+}
+
+TEST_F(DataServiceTests, SynchronousOverflowKeepsTheOrder)
+{
+    // The queue is set up without its thread, so the readings only leave it when they are stored by the producer
+    service->m_ingestQueue = std::unique_ptr<ReadingIngestQueue>{new ReadingIngestQueue{2}};
+    service->m_ingestOverflowPolicy = IngestOverflowPolicy::Synchronous;
+
+    auto values = std::vector<std::string>{};
+    EXPECT_CALL(*persistenceMock, putReading).WillRepeatedly([&](const std::string&, const Reading& reading) {
+        values.emplace_back(reading.getStringValue());
+        return true;
+    });
+    for (auto i = 0; i < 5; ++i)
+        service->addReading(DEVICE_KEY, "T", std::to_string(i), 1234567890);
+    EXPECT_EQ(values, (std::vector<std::string>{"0", "1", "2"}));
+    service->stopIngestQueue();
+    EXPECT_EQ(values, (std::vector<std::string>{"0", "1", "2", "3", "4"}));
+}
+
+TEST_F(DataServiceTests, PublishReadingsStoresTheQueuedReadingsFirst)
+{
+    service->m_ingestQueue = std::unique_ptr<ReadingIngestQueue>{new ReadingIngestQueue{16}};
+    service->addReading(DEVICE_KEY, "T", "1", 1234567890);
+    service->addReading(DEVICE_KEY, "T", "2", 1234567891);
+
+    InSequence sequence;
+    EXPECT_CALL(*persistenceMock, putReading).Times(2).WillRepeatedly(Return(true));
+    EXPECT_CALL(*persistenceMock, getReadingsKeys).WillOnce(Return(std::vector<std::string>{}));
+    ASSERT_NO_FATAL_FAILURE(service->publishReadings());
+    service->stopIngestQueue();
+}
+
+TEST_F(DataServiceTests, AddReadingsWithFilter)
+{
+    auto filter = ReadingFilterConfiguration{};
+    filter.absoluteDeadband = 1.0;
+    ASSERT_NO_FATAL_FAILURE(service->setFeedFilter(DEVICE_KEY, "T", filter));
+
+    // Only the first reading and the one out of the deadband are stored, and the other feed is not filtered
+    EXPECT_CALL(*persistenceMock, putReading(service->makePersistenceKey(DEVICE_KEY, "T"), _)).Times(2);
+    EXPECT_CALL(*persistenceMock, putReading(service->makePersistenceKey(DEVICE_KEY, "H"), _)).Times(2);
+    ASSERT_NO_FATAL_FAILURE(service->addReadings(
+      DEVICE_KEY, std::vector<Reading>{{"T", std::string{"20.0"}, 1234567890}, {"T", std::string{"20.5"}, 1234567891},
+                                       {"T", std::string{"21.5"}, 1234567892}, {"H", std::string{"50"}, 1234567890},
+                                       {"H", std::string{"50"}, 1234567891}}));
+}
+
+TEST_F(DataServiceTests, RemoveFeedRemovesFilter)
+{
+    auto filter = ReadingFilterConfiguration{};
+    filter.publishOnChange = true;
+    ASSERT_NO_FATAL_FAILURE(service->setFeedFilter(DEVICE_KEY, "T", filter));
+    EXPECT_EQ(service->m_filters.size(), 1);
+
+    EXPECT_CALL(*dataProtocolMock, makeOutboundMessage(_, A<FeedRemovalMessage>())).WillOnce(Return(ByMove(nullptr)));
+    ASSERT_NO_FATAL_FAILURE(service->removeFeed(DEVICE_KEY, "T"));
+    EXPECT_TRUE(service->m_filters.empty());
+
+    // A configuration with nothing enabled does not create a filter
+    ASSERT_NO_FATAL_FAILURE(service->setFeedFilter(DEVICE_KEY, "T", ReadingFilterConfiguration{}));
+    EXPECT_TRUE(service->m_filters.empty());
+}
+
+TEST_F(DataServiceTests, AddReadingsWithAggregation)
+{
+    auto aggregation = AggregationConfiguration{};
+    aggregation.window = std::chrono::milliseconds{1000};
+    ASSERT_NO_FATAL_FAILURE(service->setFeedAggregation(DEVICE_KEY, "V", aggregation));
+
+    // Nothing is stored until the window is closed, and then the five aggregates are stored
+    EXPECT_CALL(*persistenceMock, putReading(_, _)).Times(4);
+    EXPECT_CALL(*persistenceMock, putReading(service->makePersistenceKey(DEVICE_KEY, "V_mean"), _)).Times(1);
+    EXPECT_CALL(*persistenceMock, putReading(service->makePersistenceKey(DEVICE_KEY, "V"), _)).Times(0);
+    ASSERT_NO_FATAL_FAILURE(service->addReadings(
+      DEVICE_KEY, std::vector<Reading>{{"V", std::string{"1"}, 1000}, {"V", std::string{"2"}, 1100},
+                                       {"V", std::string{"3"}, 1200}}));
+    ASSERT_NO_FATAL_FAILURE(service->addReading(DEVICE_KEY, "V", "4", 2000));
+}
+
+TEST_F(DataServiceTests, RemoveFeedRemovesAggregation)
+{
+    auto aggregation = AggregationConfiguration{};
+    aggregation.window = std::chrono::milliseconds{1000};
+    ASSERT_NO_FATAL_FAILURE(service->setFeedAggregation(DEVICE_KEY, "V", aggregation));
+    ASSERT_NO_FATAL_FAILURE(service->setFeedAggregation(DEVICE_KEY, "W", aggregation));
+    EXPECT_EQ(service->m_aggregators[DEVICE_KEY].size(), 2u);
+
+    EXPECT_CALL(*dataProtocolMock, makeOutboundMessage(_, A<FeedRemovalMessage>())).WillOnce(Return(ByMove(nullptr)));
+    ASSERT_NO_FATAL_FAILURE(service->removeFeeds(DEVICE_KEY, {"V", "W"}));
+    EXPECT_TRUE(service->m_aggregators.empty());
+
+    // The samples of the feed are stored as they are again
+    EXPECT_CALL(*persistenceMock, putReading(service->makePersistenceKey(DEVICE_KEY, "V"), _)).Times(1);
+    ASSERT_NO_FATAL_FAILURE(service->addReading(DEVICE_KEY, "V", "4", 2000));
+}
+
+TEST_F(DataServiceTests, FlushAggregations)
+{
+    auto aggregation = AggregationConfiguration{};
+    aggregation.window = std::chrono::milliseconds{1000};
+    aggregation.minimum = aggregation.maximum = aggregation.last = aggregation.count = false;
+    ASSERT_NO_FATAL_FAILURE(service->setFeedAggregation(DEVICE_KEY, "V", aggregation));
+    ASSERT_NO_FATAL_FAILURE(service->addReading(DEVICE_KEY, "V", "4", 2000));
+
+    // The window is long over, so publishing the readings stores the aggregate first
+    EXPECT_CALL(*persistenceMock, putReading(service->makePersistenceKey(DEVICE_KEY, "V_mean"), _)).Times(1);
+    EXPECT_CALL(*persistenceMock, getReadingsKeys).WillOnce(Return(std::vector<std::string>{}));
+    ASSERT_NO_FATAL_FAILURE(service->publishReadings());
+}
+
 TEST_F(DataServiceTests, AddAttribute)
 {
     EXPECT_CALL(*persistenceMock, putAttribute).Times(1);
@@ -688,15 +926,16 @@ TEST_F(DataServiceTests, MessageReceivedMessageParameterHappyFlowAnswersSubscrip
     std::atomic_bool callbackCalled{false};
     std::mutex mutex;
     std::condition_variable conditionVariable;
-    service->m_parameterSubscriptions.emplace(
-      0,
-      DataService::ParameterSubscription{{ParameterName::EXTERNAL_ID}, [&](const std::vector<Parameter>& parameters) {
-                                             if (!parameters.empty())
-                                             {
-                                                 callbackCalled = true;
-                                                 conditionVariable.notify_one();
-                                             }
-                                         }});
+    service->addSubscription(
+      DEVICE_KEY, {ParameterName::EXTERNAL_ID},
+      [&](const std::vector<Parameter>& parameters) {
+          if (!parameters.empty())
+          {
+              callbackCalled = true;
+              conditionVariable.notify_one();
+          }
+      },
+      std::chrono::minutes{1});
 
     ASSERT_NO_FATAL_FAILURE(service->messageReceived(std::make_shared<wolkabout::Message>("", "")));
     if (!callbackCalled)
@@ -726,10 +965,13 @@ TEST_F(DataServiceTests, MessageReceivedMessageCallbackIsAwaiting)
       .WillOnce(Return(ByMove(
         std::unique_ptr<DetailsSynchronizationResponseMessage>{new DetailsSynchronizationResponseMessage{{}, {}}})));
 
-    service->m_detailsCallbacks.push([&](const std::vector<std::string>&, const std::vector<std::string>&) {
-        callbackCalled = true;
-        conditionVariable.notify_one();
-    });
+    service->addDetailsCallback(
+      DEVICE_KEY,
+      [&](const std::vector<std::string>&, const std::vector<std::string>&) {
+          callbackCalled = true;
+          conditionVariable.notify_one();
+      },
+      std::chrono::minutes{1});
 
     ASSERT_NO_FATAL_FAILURE(service->messageReceived(std::make_shared<wolkabout::Message>("", "")));
     if (!callbackCalled)
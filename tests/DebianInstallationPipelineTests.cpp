@@ -0,0 +1,207 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define private public
+#define protected public
+#include "wolk/service/firmware_update/debian/DebianInstallationPipeline.h"
+#undef private
+#undef protected
+
+#include "core/utilities/FileSystemUtils.h"
+#include "core/utilities/Logger.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <future>
+#include <map>
+
+using namespace wolkabout;
+using namespace wolkabout::connect;
+using namespace ::testing;
+
+class DebianInstallationPipelineTests : public ::testing::Test
+{
+public:
+    static void SetUpTestCase() { Logger::init(LogLevel::TRACE, Logger::Type::CONSOLE); }
+
+    void SetUp() override
+    {
+        for (const auto& package : {FIRST_PACKAGE, SECOND_PACKAGE, OTHER_PACKAGE})
+            ASSERT_TRUE(FileSystemUtils::createFileWithContent(package, PACKAGE_CONTENT));
+        ASSERT_TRUE(FileSystemUtils::createFileWithContent(INVALID_PACKAGE, "this is not a package"));
+    }
+
+    void TearDown() override
+    {
+        for (const auto& package : {FIRST_PACKAGE, SECOND_PACKAGE, OTHER_PACKAGE, INVALID_PACKAGE})
+            FileSystemUtils::deleteFile(package);
+    }
+
+    // Makes an `ar` member, with the header padded to its fixed widths and the content padded to an even size
+    static std::string member(const std::string& name, const std::string& content)
+    {
+        auto header = std::string(60, ' ');
+        header.replace(0, name.size(), name);
+        header.replace(16, 10, "1342943816");
+        header.replace(28, 1, "0");
+        header.replace(34, 1, "0");
+        header.replace(40, 6, "100644");
+        const auto size = std::to_string(content.size());
+        header.replace(48, size.size(), size);
+        header.replace(58, 2, "`\n");
+        return header + content + (content.size() % 2 != 0 ? "\n" : "");
+    }
+
+    const std::string FIRST_PACKAGE = "./service_1.0.0_amd64.deb";
+    const std::string SECOND_PACKAGE = "./service_1.0.1_amd64.deb";
+    const std::string OTHER_PACKAGE = "./other_2.0.0_amd64.deb";
+    const std::string INVALID_PACKAGE = "./invalid_1.0.0_amd64.deb";
+    const std::string PACKAGE_CONTENT = "!<arch>\n" + member("debian-binary", "2.0\n") +
+                                        member("control.tar.xz", "control") + member("data.tar.xz", "data");
+};
+
+TEST_F(DebianInstallationPipelineTests, VerifyPackage)
+{
+    EXPECT_TRUE(DebianInstallationPipeline::verifyPackage(FIRST_PACKAGE));
+    EXPECT_FALSE(DebianInstallationPipeline::verifyPackage(INVALID_PACKAGE));
+    EXPECT_FALSE(DebianInstallationPipeline::verifyPackage("./non-existing.deb"));
+}
+
+TEST_F(DebianInstallationPipelineTests, VerifyPackageMembers)
+{
+    const auto check = [&](const std::string& content) {
+        EXPECT_TRUE(FileSystemUtils::createFileWithContent(INVALID_PACKAGE, content));
+        return DebianInstallationPipeline::verifyPackage(INVALID_PACKAGE);
+    };
+    const auto version = member("debian-binary", "2.0\n");
+    const auto control = member("control.tar.gz", "control");
+    const auto data = member("data.tar.gz", "data");
+
+    // The members that start with an underscore are allowed in between
+    EXPECT_TRUE(check("!<arch>\n" + version + member("_gpgorigin", "signature") + control + data));
+
+    // But the version has to be the supported one, and both tarballs have to be there, in order, and whole
+    EXPECT_FALSE(check("!<arch>\n" + member("debian-binary", "3.0\n") + control + data));
+    EXPECT_FALSE(check("!<arch>\n" + version + control));
+    EXPECT_FALSE(check("!<arch>\n" + version + data + control));
+    EXPECT_FALSE(check("!<arch>\n" + version + control + data.substr(0, data.size() - 2)));
+    EXPECT_FALSE(check("!<arch>\n" + version + control + member("manifest", "") + data));
+}
+
+TEST_F(DebianInstallationPipelineTests, ServiceNameOf)
+{
+    EXPECT_EQ(DebianInstallationPipeline::serviceNameOf("/var/files/service_1.0.0_amd64.deb"), "service");
+    EXPECT_EQ(DebianInstallationPipeline::serviceNameOf("service.deb"), "service.deb");
+}
+
+TEST_F(DebianInstallationPipelineTests, SubmitWhileStopped)
+{
+    DebianInstallationPipeline pipeline{[](const std::string&) { return true; },
+                                        [](const std::string&) { return true; }};
+    EXPECT_FALSE(pipeline.submit(FIRST_PACKAGE, [](const std::string&, bool, const PackageInstallationTimings&) {}));
+}
+
+TEST_F(DebianInstallationPipelineTests, InvalidPackageIsNotInstalled)
+{
+    std::atomic_int installs{0};
+    DebianInstallationPipeline pipeline{[&](const std::string&) { return ++installs > 0; },
+                                        [](const std::string&) { return true; }};
+    pipeline.start();
+
+    auto outcome = std::promise<bool>{};
+    const auto callback = [&](const std::string&, bool success, const PackageInstallationTimings&) {
+        outcome.set_value(success);
+    };
+    ASSERT_TRUE(pipeline.submit(INVALID_PACKAGE, callback));
+    auto future = outcome.get_future();
+    ASSERT_EQ(future.wait_for(std::chrono::seconds{1}), std::future_status::ready);
+    EXPECT_FALSE(future.get());
+    EXPECT_EQ(installs, 0);
+}
+
+TEST_F(DebianInstallationPipelineTests, PackagesReadyTogetherShareTheRestart)
+{
+    // The first installation is held until the next packages are verified
+    auto release = std::promise<void>{};
+    auto released = release.get_future().share();
+    std::atomic_int installs{0};
+    std::mutex restartsMutex;
+    auto restarts = std::map<std::string, int>{};
+    DebianInstallationPipeline pipeline{[&](const std::string&) {
+                                            if (installs++ == 0)
+                                                released.wait();
+                                            return true;
+                                        },
+                                        [&](const std::string& service) {
+                                            std::lock_guard<std::mutex> lock{restartsMutex};
+                                            ++restarts[service];
+                                            return true;
+                                        }};
+    pipeline.start();
+
+    std::atomic_int succeeded{0};
+    std::atomic_int reported{0};
+    const auto callback = [&](const std::string&, bool success, const PackageInstallationTimings&) {
+        if (success)
+            ++succeeded;
+        ++reported;
+    };
+    ASSERT_TRUE(pipeline.submit(FIRST_PACKAGE, callback));
+    while (installs == 0)
+        std::this_thread::sleep_for(std::chrono::milliseconds{1});
+    ASSERT_TRUE(pipeline.submit(SECOND_PACKAGE, callback));
+    ASSERT_TRUE(pipeline.submit(OTHER_PACKAGE, callback));
+    while (true)
+    {
+        {
+            std::lock_guard<std::mutex> lock{pipeline.m_mutex};
+            if (pipeline.m_verified.size() == 2)
+                break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds{1});
+    }
+    release.set_value();
+
+    for (auto i = 0; i < 1000 && reported < 3; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds{1});
+    EXPECT_EQ(succeeded, 3);
+    EXPECT_EQ(installs, 3);
+
+    // The service is restarted once for the first package, and once for the second batch
+    std::lock_guard<std::mutex> lock{restartsMutex};
+    EXPECT_EQ(restarts["service"], 2);
+    EXPECT_EQ(restarts["other"], 1);
+}
+
+TEST_F(DebianInstallationPipelineTests, FailedRestartFailsThePackages)
+{
+    DebianInstallationPipeline pipeline{[](const std::string&) { return true; },
+                                        [](const std::string&) { return false; }};
+    pipeline.start();
+
+    auto outcome = std::promise<PackageInstallationTimings>{};
+    auto succeeded = true;
+    ASSERT_TRUE(pipeline.submit(FIRST_PACKAGE,
+                                [&](const std::string&, bool success, const PackageInstallationTimings& timings) {
+                                    succeeded = success;
+                                    outcome.set_value(timings);
+                                }));
+    auto future = outcome.get_future();
+    ASSERT_EQ(future.wait_for(std::chrono::seconds{1}), std::future_status::ready);
+    future.get();
+    EXPECT_FALSE(succeeded);
+}
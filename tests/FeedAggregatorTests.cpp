@@ -0,0 +1,127 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define private public
+#define protected public
+#include "wolk/service/data/FeedAggregator.h"
+#undef private
+#undef protected
+
+#include "core/utilities/Logger.h"
+
+#include <gtest/gtest.h>
+
+using namespace wolkabout;
+using namespace wolkabout::connect;
+using namespace ::testing;
+
+class FeedAggregatorTests : public ::testing::Test
+{
+public:
+    static void SetUpTestCase() { Logger::init(LogLevel::TRACE, Logger::Type::CONSOLE); }
+
+    static AggregationConfiguration makeConfiguration(std::chrono::milliseconds window)
+    {
+        auto configuration = AggregationConfiguration{};
+        configuration.window = window;
+        return configuration;
+    }
+
+    static std::string findValue(const std::vector<Reading>& readings, const std::string& reference)
+    {
+        for (const auto& reading : readings)
+            if (reading.getReference() == reference)
+                return reading.getStringValue();
+        return {};
+    }
+};
+
+TEST_F(FeedAggregatorTests, ConfigurationIsEnabled)
+{
+    EXPECT_FALSE(AggregationConfiguration{}.isEnabled());
+    auto configuration = makeConfiguration(std::chrono::milliseconds{1000});
+    EXPECT_TRUE(configuration.isEnabled());
+    configuration.minimum = configuration.maximum = configuration.mean = configuration.last = configuration.count =
+      false;
+    EXPECT_FALSE(configuration.isEnabled());
+}
+
+TEST_F(FeedAggregatorTests, ParseSample)
+{
+    auto value = double{0};
+    EXPECT_TRUE(FeedAggregator::parseSample(Reading{"V", std::string{"1.5"}, 0}, value));
+    EXPECT_DOUBLE_EQ(value, 1.5);
+    EXPECT_TRUE(FeedAggregator::parseSample(Reading{"V", std::string{"-3"}, 0}, value));
+    EXPECT_DOUBLE_EQ(value, -3);
+    EXPECT_FALSE(FeedAggregator::parseSample(Reading{"V", std::string{"ON"}, 0}, value));
+    EXPECT_FALSE(FeedAggregator::parseSample(Reading{"V", std::string{""}, 0}, value));
+    EXPECT_FALSE(FeedAggregator::parseSample(Reading{"V", std::vector<std::string>{"1", "2"}, 0}, value));
+}
+
+TEST_F(FeedAggregatorTests, WindowIsClosedByTheNextWindowSample)
+{
+    auto aggregator = FeedAggregator{"V", makeConfiguration(std::chrono::milliseconds{1000})};
+    auto output = std::vector<Reading>{};
+
+    // A hundred samples in the first window
+    for (auto i = 0; i < 100; ++i)
+        EXPECT_FALSE(aggregator.addSample(static_cast<double>(i % 10), 5000 + static_cast<std::uint64_t>(i) * 10,
+                                          output));
+    EXPECT_TRUE(output.empty());
+    EXPECT_EQ(aggregator.getSampleCount(), 100);
+
+    // The first sample in the next window closes it
+    EXPECT_TRUE(aggregator.addSample(42, 6000, output));
+    ASSERT_EQ(output.size(), 5);
+    EXPECT_EQ(findValue(output, "V_min"), "0");
+    EXPECT_EQ(findValue(output, "V_max"), "9");
+    EXPECT_EQ(findValue(output, "V_mean"), "4.5");
+    EXPECT_EQ(findValue(output, "V_last"), "9");
+    EXPECT_EQ(findValue(output, "V_count"), "100");
+    EXPECT_EQ(output.front().getTimestamp(), 5990);
+    EXPECT_EQ(aggregator.getSampleCount(), 1);
+}
+
+TEST_F(FeedAggregatorTests, FlushOnlyClosesFinishedWindows)
+{
+    auto configuration = makeConfiguration(std::chrono::milliseconds{1000});
+    configuration.minimum = configuration.maximum = configuration.last = false;
+    auto aggregator = FeedAggregator{"V", configuration};
+    auto output = std::vector<Reading>{};
+
+    EXPECT_FALSE(aggregator.flush(10000, output));
+    aggregator.addSample(1, 10100, output);
+    aggregator.addSample(2, 10200, output);
+    EXPECT_FALSE(aggregator.flush(10999, output));
+    EXPECT_TRUE(aggregator.flush(11000, output));
+    ASSERT_EQ(output.size(), 2);
+    EXPECT_EQ(findValue(output, "V_mean"), "1.5");
+    EXPECT_EQ(findValue(output, "V_count"), "2");
+    EXPECT_FALSE(aggregator.flush(20000, output));
+}
+
+TEST_F(FeedAggregatorTests, LateSamplesCountInTheCurrentWindow)
+{
+    auto aggregator = FeedAggregator{"V", makeConfiguration(std::chrono::milliseconds{1000})};
+    auto output = std::vector<Reading>{};
+
+    aggregator.addSample(1, 2500, output);
+    EXPECT_FALSE(aggregator.addSample(5, 1500, output));
+    EXPECT_EQ(aggregator.getSampleCount(), 2);
+    EXPECT_TRUE(aggregator.flush(3000, output));
+    EXPECT_EQ(findValue(output, "V_max"), "5");
+    EXPECT_EQ(output.front().getTimestamp(), 2500);
+}
@@ -0,0 +1,151 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define private public
+#define protected public
+#include "wolk/service/file_management/FileBlobStore.h"
+#undef private
+#undef protected
+
+#include "core/utilities/FileSystemUtils.h"
+#include "core/utilities/Logger.h"
+
+#include <gtest/gtest.h>
+
+#include <sys/stat.h>
+
+using namespace wolkabout;
+using namespace wolkabout::connect;
+using namespace ::testing;
+
+class FileBlobStoreTests : public ::testing::Test
+{
+public:
+    static void SetUpTestCase() { Logger::init(LogLevel::TRACE, Logger::Type::CONSOLE); }
+
+    void TearDown() override
+    {
+        for (const auto& folder : {BLOB_FOLDER, DEVICE_FOLDER})
+        {
+            for (const auto& file : FileSystemUtils::listFiles(folder))
+                FileSystemUtils::deleteFile(FileSystemUtils::composePath(file, folder));
+            FileSystemUtils::deleteFile(folder);
+        }
+    }
+
+    static std::uint64_t linkCount(const std::string& path)
+    {
+        struct stat status = {};
+        return stat(path.c_str(), &status) == 0 ? static_cast<std::uint64_t>(status.st_nlink) : 0;
+    }
+
+    const std::string BLOB_FOLDER = "./blob-store-test";
+    const std::string DEVICE_FOLDER = "./blob-store-test-device";
+    const std::string ALIAS = "0123456789abcdef";
+    const ByteArray CONTENT = ByteArray{'a', 'b', 'c'};
+    const std::string CONTENT_HASH = "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad";
+};
+
+TEST_F(FileBlobStoreTests, StoreAndFindByAlias)
+{
+    FileBlobStore store{BLOB_FOLDER};
+    EXPECT_TRUE(store.findByAlias(ALIAS).empty());
+
+    auto hash = std::string{};
+    ASSERT_TRUE(store.store(CONTENT, ALIAS, hash));
+    EXPECT_EQ(hash, CONTENT_HASH);
+    EXPECT_EQ(store.findByAlias(ALIAS), CONTENT_HASH);
+    EXPECT_EQ(store.getSize(CONTENT_HASH), CONTENT.size());
+
+    // Storing the same content again keeps the one blob
+    ASSERT_TRUE(store.store(CONTENT, "", hash));
+    EXPECT_EQ(FileSystemUtils::listFiles(BLOB_FOLDER).size(), 2);
+}
+
+TEST_F(FileBlobStoreTests, AliasesThatAreNotHashesAreRejected)
+{
+    FileBlobStore store{BLOB_FOLDER};
+    auto hash = std::string{};
+    ASSERT_TRUE(store.store(CONTENT, "../escape", hash));
+    EXPECT_EQ(FileSystemUtils::listFiles(BLOB_FOLDER).size(), 1);
+    EXPECT_TRUE(store.findByAlias("../escape").empty());
+    EXPECT_FALSE(store.place("../escape", DEVICE_FOLDER + "/file"));
+}
+
+TEST_F(FileBlobStoreTests, PlacedFilesAreReadOnlyLinks)
+{
+    FileBlobStore store{BLOB_FOLDER};
+    ASSERT_TRUE(FileSystemUtils::createDirectory(DEVICE_FOLDER));
+    auto hash = std::string{};
+    ASSERT_TRUE(store.store(CONTENT, ALIAS, hash));
+
+    const auto first = FileSystemUtils::composePath("first", DEVICE_FOLDER);
+    const auto second = FileSystemUtils::composePath("second", DEVICE_FOLDER);
+    ASSERT_TRUE(store.place(hash, first));
+    ASSERT_TRUE(store.place(hash, second));
+    EXPECT_EQ(linkCount(store.getBlobPath(hash)), 3);
+
+    // No one can write into the shared content
+    struct stat status = {};
+    ASSERT_EQ(stat(first.c_str(), &status), 0);
+    EXPECT_EQ(status.st_mode & (S_IWUSR | S_IWGRP | S_IWOTH), 0);
+
+    // But the file of a device can still be replaced
+    ASSERT_TRUE(FileSystemUtils::createFileWithContent(DEVICE_FOLDER + "/other", "xbc"));
+    ASSERT_TRUE(store.place(hash, DEVICE_FOLDER + "/other"));
+    EXPECT_EQ(linkCount(store.getBlobPath(hash)), 4);
+}
+
+TEST_F(FileBlobStoreTests, BlobThatDoesNotMatchItsHashIsReplacedOnStore)
+{
+    FileBlobStore store{BLOB_FOLDER};
+    ASSERT_TRUE(FileSystemUtils::createDirectory(DEVICE_FOLDER));
+    auto hash = std::string{};
+    ASSERT_TRUE(store.store(CONTENT, ALIAS, hash));
+    const auto file = FileSystemUtils::composePath("file", DEVICE_FOLDER);
+    ASSERT_TRUE(store.place(hash, file));
+    ASSERT_TRUE(FileSystemUtils::deleteFile(store.getBlobPath(hash)));
+    ASSERT_TRUE(FileSystemUtils::createFileWithContent(store.getBlobPath(hash), "xbc"));
+
+    ASSERT_TRUE(store.store(CONTENT, ALIAS, hash));
+    auto content = std::string{};
+    ASSERT_TRUE(FileSystemUtils::readFileContent(store.getBlobPath(hash), content));
+    EXPECT_EQ(content, "abc");
+    ASSERT_TRUE(FileSystemUtils::readFileContent(file, content));
+    EXPECT_EQ(content, "abc");
+}
+
+TEST_F(FileBlobStoreTests, GarbageIsCollectedOnceLinksAreGone)
+{
+    FileBlobStore store{BLOB_FOLDER};
+    ASSERT_TRUE(FileSystemUtils::createDirectory(DEVICE_FOLDER));
+    auto hash = std::string{};
+    ASSERT_TRUE(store.store(CONTENT, ALIAS, hash));
+    const auto first = FileSystemUtils::composePath("first", DEVICE_FOLDER);
+    const auto second = FileSystemUtils::composePath("second", DEVICE_FOLDER);
+    ASSERT_TRUE(store.place(hash, first));
+    ASSERT_TRUE(store.place(hash, second));
+
+    EXPECT_EQ(store.collectGarbage(), 0);
+    ASSERT_TRUE(FileSystemUtils::deleteFile(first));
+    EXPECT_EQ(store.collectGarbage(), 0);
+    EXPECT_EQ(store.findByAlias(ALIAS), hash);
+
+    ASSERT_TRUE(FileSystemUtils::deleteFile(second));
+    EXPECT_EQ(store.collectGarbage(), 1);
+    EXPECT_TRUE(store.findByAlias(ALIAS).empty());
+    EXPECT_TRUE(FileSystemUtils::listFiles(BLOB_FOLDER).empty());
+}
@@ -77,9 +77,11 @@ public:
 
     void DeleteEverything()
     {
-        const auto subFolderPath = FileSystemUtils::composePath(DEVICE_KEY, fileLocation);
-        if (FileSystemUtils::isDirectoryPresent(subFolderPath))
+        for (const auto& subFolder : {DEVICE_KEY, BLOB_FOLDER})
         {
+            const auto subFolderPath = FileSystemUtils::composePath(subFolder, fileLocation);
+            if (!FileSystemUtils::isDirectoryPresent(subFolderPath))
+                continue;
             const auto files = FileSystemUtils::listFiles(subFolderPath);
             for (const auto& file : files)
             {
@@ -129,6 +131,8 @@ public:
 
     const std::string DEVICE_KEY = "TestDevice";
 
+    const std::string BLOB_FOLDER = ".blobs";
+
     const std::string TEST_FILE = "test.file";
     const std::uint64_t TEST_FILE_SIZE = 256;
     const std::string TEST_FILE_HASH = "test.hash";
@@ -566,6 +570,40 @@ TEST_F(FileManagementServiceTests, TransferInit)
     conditionVariable.wait_for(lock, std::chrono::milliseconds{100});
 }
 
+TEST_F(FileManagementServiceTests, TransferInitSkipsStoredContent)
+{
+    // Store the content for one file
+    const auto bytes = ByteArray{65, 65, 65, 65, 65};
+    const auto deviceFolder = FileSystemUtils::composePath(DEVICE_KEY, fileLocation);
+    ASSERT_TRUE(FileSystemUtils::createDirectory(deviceFolder));
+    ASSERT_TRUE(service->storeFile(bytes, FileSystemUtils::composePath(TEST_FILE, deviceFolder)));
+
+    // And upload the same content as another file, which should not need a transfer
+    const auto copyFile = std::string{"copy.file"};
+    EXPECT_CALL(fileManagementProtocolMock,
+                makeOutboundMessage(A<const std::string&>(), A<const FileUploadStatusMessage&>()))
+      .WillOnce([&](const std::string&, const FileUploadStatusMessage& message) {
+          EXPECT_EQ(message.getStatus(), FileTransferStatus::FILE_READY);
+          return nullptr;
+      });
+    EXPECT_CALL(fileManagementProtocolMock,
+                makeOutboundMessage(A<const std::string&>(), A<const FileBinaryRequestMessage&>()))
+      .Times(0);
+    const auto hash = ByteUtils::toHexString(ByteUtils::hashMDA5(bytes));
+    ASSERT_NO_FATAL_FAILURE(
+      service->onFileUploadInit(DEVICE_KEY, FileUploadInitiateMessage{copyFile, bytes.size(), hash}));
+    EXPECT_EQ(service->m_sessions[DEVICE_KEY], nullptr);
+    auto fileContent = std::string{};
+    ASSERT_TRUE(FileSystemUtils::readFileContent(FileSystemUtils::composePath(copyFile, deviceFolder), fileContent));
+    EXPECT_EQ(fileContent, "AAAAA");
+
+    // The content is only removed once both files are gone
+    ASSERT_TRUE(FileSystemUtils::deleteFile(FileSystemUtils::composePath(TEST_FILE, deviceFolder)));
+    EXPECT_EQ(service->m_blobStore.collectGarbage(), 0);
+    ASSERT_TRUE(FileSystemUtils::deleteFile(FileSystemUtils::composePath(copyFile, deviceFolder)));
+    EXPECT_EQ(service->m_blobStore.collectGarbage(), 1);
+}
+
 TEST_F(FileManagementServiceTests, TransferBinaryResponse)
 {
     // Inject a session
@@ -0,0 +1,172 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define private public
+#define protected public
+#include "wolk/service/firmware_update/FirmwareDeltaPatcher.h"
+#undef private
+#undef protected
+
+#include "core/utilities/FileSystemUtils.h"
+#include "core/utilities/Logger.h"
+#include "wolk/utilities/Sha256.h"
+
+#include <gtest/gtest.h>
+
+using namespace wolkabout;
+using namespace wolkabout::connect;
+using namespace ::testing;
+
+class FirmwareDeltaPatcherTests : public ::testing::Test
+{
+public:
+    static void SetUpTestCase() { Logger::init(LogLevel::TRACE, Logger::Type::CONSOLE); }
+
+    void TearDown() override
+    {
+        FileSystemUtils::deleteFile(BASE_PATH);
+        FileSystemUtils::deleteFile(PATCH_PATH);
+        FileSystemUtils::deleteFile(TARGET_PATH);
+        FileSystemUtils::deleteFile(TARGET_PATH + ".part");
+    }
+
+    static std::string number(std::uint64_t value, std::size_t size)
+    {
+        auto bytes = std::string(size, '\0');
+        for (auto i = size; i > 0; --i, value >>= 8)
+            bytes[i - 1] = static_cast<char>(value & 0xFF);
+        return bytes;
+    }
+
+    static std::string digest(const std::string& content)
+    {
+        auto hash = Sha256{};
+        hash.update(content);
+        const auto result = hash.digest();
+        return {result.cbegin(), result.cend()};
+    }
+
+    static std::string header(const std::string& base, const std::string& target)
+    {
+        return "WDLT" + std::string(1, '\x01') + number(BASE_NAME.size(), 2) + BASE_NAME + digest(base) +
+               digest(target) + number(target.size(), 8);
+    }
+
+    static std::string copy(std::uint64_t offset, std::uint64_t length)
+    {
+        return std::string(1, '\x01') + number(offset, 8) + number(length, 8);
+    }
+
+    static std::string insert(const std::string& bytes)
+    {
+        return std::string(1, '\x02') + number(bytes.size(), 8) + bytes;
+    }
+
+    static std::string end() { return std::string(1, '\0'); }
+
+    static const std::string BASE_NAME;
+    static const std::string BASE_PATH;
+    static const std::string PATCH_PATH;
+    static const std::string TARGET_PATH;
+
+    const std::string BASE = "firmware version one, with a long common part";
+    const std::string TARGET = "firmware version two, with a long common part!";
+};
+
+const std::string FirmwareDeltaPatcherTests::BASE_NAME = "delta_test_base.bin";
+const std::string FirmwareDeltaPatcherTests::BASE_PATH = "./delta_test_base.bin";
+const std::string FirmwareDeltaPatcherTests::PATCH_PATH = "./delta_test_target.bin.wdelta";
+const std::string FirmwareDeltaPatcherTests::TARGET_PATH = "./delta_test_target.bin";
+
+TEST_F(FirmwareDeltaPatcherTests, IsPatch)
+{
+    EXPECT_FALSE(FirmwareDeltaPatcher::isPatch(PATCH_PATH));
+
+    ASSERT_TRUE(FileSystemUtils::createFileWithContent(PATCH_PATH, "WDLT"));
+    EXPECT_TRUE(FirmwareDeltaPatcher::isPatch(PATCH_PATH));
+
+    ASSERT_TRUE(FileSystemUtils::createFileWithContent(BASE_PATH, "WDLT"));
+    EXPECT_FALSE(FirmwareDeltaPatcher::isPatch(BASE_PATH));
+}
+
+TEST_F(FirmwareDeltaPatcherTests, AppliesCopiesAndInserts)
+{
+    ASSERT_TRUE(FileSystemUtils::createFileWithContent(BASE_PATH, BASE));
+    ASSERT_TRUE(FileSystemUtils::createFileWithContent(PATCH_PATH, header(BASE, TARGET) + copy(0, 17) + insert("two") +
+                                                                     copy(20, BASE.size() - 20) + insert("!") + end()));
+
+    // A small buffer makes the copies go through it in several pieces
+    const auto patcher = FirmwareDeltaPatcher{4};
+    auto output = std::string{};
+    EXPECT_EQ(patcher.apply(PATCH_PATH, output), DeltaPatchResult::APPLIED);
+    EXPECT_EQ(output, TARGET_PATH);
+    auto content = std::string{};
+    ASSERT_TRUE(FileSystemUtils::readFileContent(TARGET_PATH, content));
+    EXPECT_EQ(content, TARGET);
+    EXPECT_FALSE(FileSystemUtils::isFilePresent(TARGET_PATH + ".part"));
+}
+
+TEST_F(FirmwareDeltaPatcherTests, MissingBase)
+{
+    ASSERT_TRUE(FileSystemUtils::createFileWithContent(PATCH_PATH, header(BASE, TARGET) + insert(TARGET) + end()));
+
+    auto output = std::string{};
+    EXPECT_EQ(FirmwareDeltaPatcher{}.apply(PATCH_PATH, output), DeltaPatchResult::MISSING_BASE);
+    EXPECT_TRUE(output.empty());
+}
+
+TEST_F(FirmwareDeltaPatcherTests, BaseMismatch)
+{
+    ASSERT_TRUE(FileSystemUtils::createFileWithContent(BASE_PATH, BASE + "modified"));
+    ASSERT_TRUE(FileSystemUtils::createFileWithContent(PATCH_PATH, header(BASE, TARGET) + insert(TARGET) + end()));
+
+    auto output = std::string{};
+    EXPECT_EQ(FirmwareDeltaPatcher{}.apply(PATCH_PATH, output), DeltaPatchResult::BASE_MISMATCH);
+}
+
+TEST_F(FirmwareDeltaPatcherTests, TargetMismatchLeavesNoFile)
+{
+    ASSERT_TRUE(FileSystemUtils::createFileWithContent(BASE_PATH, BASE));
+    auto wrongTarget = TARGET;
+    wrongTarget[0] = 'F';
+    ASSERT_TRUE(FileSystemUtils::createFileWithContent(PATCH_PATH, header(BASE, TARGET) + insert(wrongTarget) + end()));
+
+    auto output = std::string{};
+    EXPECT_EQ(FirmwareDeltaPatcher{}.apply(PATCH_PATH, output), DeltaPatchResult::TARGET_MISMATCH);
+    EXPECT_FALSE(FileSystemUtils::isFilePresent(TARGET_PATH));
+    EXPECT_FALSE(FileSystemUtils::isFilePresent(TARGET_PATH + ".part"));
+}
+
+TEST_F(FirmwareDeltaPatcherTests, InvalidPatches)
+{
+    ASSERT_TRUE(FileSystemUtils::createFileWithContent(BASE_PATH, BASE));
+    auto output = std::string{};
+
+    // The copy goes past the end of the base
+    ASSERT_TRUE(
+      FileSystemUtils::createFileWithContent(PATCH_PATH, header(BASE, TARGET) + copy(10, BASE.size()) + end()));
+    EXPECT_EQ(FirmwareDeltaPatcher{}.apply(PATCH_PATH, output), DeltaPatchResult::INVALID_PATCH);
+
+    // The package is cut off before the end
+    ASSERT_TRUE(FileSystemUtils::createFileWithContent(PATCH_PATH, header(BASE, TARGET) + copy(0, 17)));
+    EXPECT_EQ(FirmwareDeltaPatcher{}.apply(PATCH_PATH, output), DeltaPatchResult::INVALID_PATCH);
+
+    // The base is outside of the folder of the package
+    ASSERT_TRUE(FileSystemUtils::createFileWithContent(
+      PATCH_PATH, "WDLT" + std::string(1, '\x01') + number(2, 2) + ".." + std::string(72, '\0')));
+    EXPECT_EQ(FirmwareDeltaPatcher{}.apply(PATCH_PATH, output), DeltaPatchResult::INVALID_PATCH);
+    EXPECT_FALSE(FileSystemUtils::isFilePresent(TARGET_PATH));
+}
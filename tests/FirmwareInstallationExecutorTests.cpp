@@ -0,0 +1,195 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define private public
+#define protected public
+#include "wolk/service/firmware_update/FirmwareInstallationExecutor.h"
+#undef private
+#undef protected
+
+#include "core/utilities/Logger.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <stdexcept>
+
+using namespace wolkabout;
+using namespace wolkabout::connect;
+using namespace ::testing;
+
+class FirmwareInstallationExecutorTests : public ::testing::Test
+{
+public:
+    static void SetUpTestCase() { Logger::init(LogLevel::TRACE, Logger::Type::CONSOLE); }
+
+    // Waits until the executor has nothing waiting or running for the devices
+    static bool waitForIdle(FirmwareInstallationExecutor& executor, const std::vector<std::string>& deviceKeys)
+    {
+        for (auto i = 0; i < 200; ++i)
+        {
+            auto busy = false;
+            for (const auto& deviceKey : deviceKeys)
+                busy = busy || executor.isBusy(deviceKey);
+            if (!busy)
+                return true;
+            std::this_thread::sleep_for(std::chrono::milliseconds{10});
+        }
+        return false;
+    }
+};
+
+TEST_F(FirmwareInstallationExecutorTests, JobsOfOneDeviceRunInOrderOneAtATime)
+{
+    FirmwareInstallationExecutor executor{4, 100};
+    std::atomic_int running{0};
+    std::atomic_bool overlapped{false};
+    auto order = std::vector<int>{};
+    std::mutex orderMutex;
+
+    for (auto i = 0; i < 5; ++i)
+        ASSERT_TRUE(executor.submit("Device", [&, i] {
+            if (++running > 1)
+                overlapped = true;
+            std::this_thread::sleep_for(std::chrono::milliseconds{5});
+            {
+                std::lock_guard<std::mutex> lock{orderMutex};
+                order.emplace_back(i);
+            }
+            --running;
+        }));
+    EXPECT_TRUE(executor.isBusy("Device"));
+    ASSERT_TRUE(waitForIdle(executor, {"Device"}));
+    EXPECT_FALSE(overlapped);
+    EXPECT_EQ(order, (std::vector<int>{0, 1, 2, 3, 4}));
+}
+
+TEST_F(FirmwareInstallationExecutorTests, DevicesRunInParallel)
+{
+    FirmwareInstallationExecutor executor{2, 100};
+    auto release = std::promise<void>{};
+    auto released = release.get_future().share();
+    auto secondRan = std::promise<void>{};
+
+    // The first device blocks until the second device has run its job
+    ASSERT_TRUE(executor.submit("DeviceOne", [released] { released.wait(); }));
+    ASSERT_TRUE(executor.submit("DeviceTwo", [&] { secondRan.set_value(); }));
+    EXPECT_EQ(secondRan.get_future().wait_for(std::chrono::seconds{1}), std::future_status::ready);
+    release.set_value();
+    EXPECT_TRUE(waitForIdle(executor, {"DeviceOne", "DeviceTwo"}));
+}
+
+TEST_F(FirmwareInstallationExecutorTests, QueueIsBounded)
+{
+    FirmwareInstallationExecutor executor{1, 2};
+    auto release = std::promise<void>{};
+    auto released = release.get_future().share();
+    auto started = std::promise<void>{};
+
+    // Once the first job is running, two more can wait, and the fourth one is rejected
+    ASSERT_TRUE(executor.submit("DeviceOne", [&, released] {
+        started.set_value();
+        released.wait();
+    }));
+    ASSERT_EQ(started.get_future().wait_for(std::chrono::seconds{1}), std::future_status::ready);
+    EXPECT_TRUE(executor.submit("DeviceTwo", [] {}));
+    EXPECT_TRUE(executor.submit("DeviceThree", [] {}));
+    EXPECT_EQ(executor.getPendingCount(), 2);
+    EXPECT_FALSE(executor.submit("DeviceFour", [] {}));
+    EXPECT_FALSE(executor.submit("DeviceFive", nullptr));
+
+    release.set_value();
+    EXPECT_TRUE(waitForIdle(executor, {"DeviceOne", "DeviceTwo", "DeviceThree"}));
+    EXPECT_EQ(executor.getPendingCount(), 0);
+}
+
+TEST_F(FirmwareInstallationExecutorTests, ThrowingJobDoesNotStopTheWorker)
+{
+    FirmwareInstallationExecutor executor{1, 10};
+    auto ran = std::promise<void>{};
+    ASSERT_TRUE(executor.submit("Device", [] { throw std::runtime_error{"Installation failed"}; }));
+    ASSERT_TRUE(executor.submit("Device", [&] { ran.set_value(); }));
+    EXPECT_EQ(ran.get_future().wait_for(std::chrono::seconds{1}), std::future_status::ready);
+}
+
+TEST_F(FirmwareInstallationExecutorTests, StopDropsWaitingJobs)
+{
+    FirmwareInstallationExecutor executor{1, 10};
+    auto release = std::promise<void>{};
+    auto released = release.get_future().share();
+    auto started = std::promise<void>{};
+    std::atomic_bool dropped{false};
+
+    ASSERT_TRUE(executor.submit("Device", [&, released] {
+        started.set_value();
+        released.wait();
+    }));
+    ASSERT_EQ(started.get_future().wait_for(std::chrono::seconds{1}), std::future_status::ready);
+    ASSERT_TRUE(executor.submit("Device", [&] { dropped = true; }));
+
+    auto stopped = std::async(std::launch::async, [&] { executor.stop(); });
+    std::this_thread::sleep_for(std::chrono::milliseconds{20});
+    release.set_value();
+    stopped.wait();
+    EXPECT_FALSE(dropped);
+    EXPECT_FALSE(executor.submit("Device", [] {}));
+}
+
+TEST_F(FirmwareInstallationExecutorTests, CancelDropsOnlyTheWaitingJobsOfTheDevice)
+{
+    FirmwareInstallationExecutor executor{1, 10};
+    auto release = std::promise<void>{};
+    auto released = release.get_future().share();
+    auto started = std::promise<void>{};
+    std::atomic_bool dropped{false};
+    auto otherRan = std::promise<void>{};
+
+    ASSERT_TRUE(executor.submit("DeviceOne", [&, released] {
+        started.set_value();
+        released.wait();
+    }));
+    ASSERT_EQ(started.get_future().wait_for(std::chrono::seconds{1}), std::future_status::ready);
+    ASSERT_TRUE(executor.submit("DeviceTwo", [&] { dropped = true; }));
+    ASSERT_TRUE(executor.submit("DeviceTwo", [&] { dropped = true; }));
+    ASSERT_TRUE(executor.submit("DeviceThree", [&] { otherRan.set_value(); }));
+
+    EXPECT_EQ(executor.cancel("DeviceTwo"), 2);
+    EXPECT_EQ(executor.cancel("DeviceOne"), 0);
+    EXPECT_FALSE(executor.isBusy("DeviceTwo"));
+    EXPECT_EQ(executor.getPendingCount(), 1);
+
+    release.set_value();
+    EXPECT_EQ(otherRan.get_future().wait_for(std::chrono::seconds{1}), std::future_status::ready);
+    EXPECT_TRUE(waitForIdle(executor, {"DeviceOne", "DeviceThree"}));
+    EXPECT_FALSE(dropped);
+}
+
+TEST_F(FirmwareInstallationExecutorTests, JobCanDestroyTheExecutor)
+{
+    auto executor = std::unique_ptr<FirmwareInstallationExecutor>{new FirmwareInstallationExecutor{2, 10}};
+    auto destroyed = std::promise<void>{};
+    ASSERT_TRUE(executor->submit("Device", [&] {
+        executor.reset();
+        destroyed.set_value();
+    }));
+    EXPECT_EQ(destroyed.get_future().wait_for(std::chrono::seconds{1}), std::future_status::ready);
+
+    // Give the detached worker the time to return from the job
+    std::this_thread::sleep_for(std::chrono::milliseconds{20});
+}
@@ -0,0 +1,282 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define private public
+#define protected public
+#include "wolk/service/firmware_update/FirmwareRolloutScheduler.h"
+#undef private
+#undef protected
+
+#include "core/utilities/FileSystemUtils.h"
+#include "core/utilities/Logger.h"
+
+#include <gtest/gtest.h>
+
+using namespace wolkabout;
+using namespace wolkabout::connect;
+using namespace ::testing;
+
+class FirmwareRolloutSchedulerTests : public ::testing::Test
+{
+public:
+    static void SetUpTestCase() { Logger::init(LogLevel::TRACE, Logger::Type::CONSOLE); }
+
+    void TearDown() override { FileSystemUtils::deleteFile(STATE_FILE); }
+
+    static RolloutConfiguration makeConfiguration(std::size_t concurrencyLimit)
+    {
+        auto configuration = RolloutConfiguration{};
+        configuration.concurrencyLimit = concurrencyLimit;
+        return configuration;
+    }
+
+    static std::vector<std::string> keys(const std::vector<RolloutEntry>& entries)
+    {
+        auto deviceKeys = std::vector<std::string>{};
+        for (const auto& entry : entries)
+            deviceKeys.emplace_back(entry.deviceKey);
+        return deviceKeys;
+    }
+
+    const std::string STATE_FILE = "./.fw-rollout-test";
+};
+
+TEST_F(FirmwareRolloutSchedulerTests, ConcurrencyIsLimited)
+{
+    FirmwareRolloutScheduler scheduler{makeConfiguration(2), STATE_FILE};
+    for (const auto& deviceKey : {"D1", "D2", "D3", "D4"})
+        ASSERT_TRUE(scheduler.enqueue(deviceKey, "firmware.bin"));
+    EXPECT_FALSE(scheduler.enqueue("D1", "firmware.bin"));
+
+    EXPECT_EQ(keys(scheduler.takeReady()), (std::vector<std::string>{"D1", "D2"}));
+    EXPECT_TRUE(scheduler.takeReady().empty());
+    EXPECT_EQ(scheduler.getRunningCount(), 2);
+    EXPECT_EQ(scheduler.getQueuedCount(), 2);
+
+    EXPECT_TRUE(scheduler.finish("D2", true));
+    EXPECT_FALSE(scheduler.finish("D2", true));
+    EXPECT_EQ(keys(scheduler.takeReady()), (std::vector<std::string>{"D3"}));
+    EXPECT_TRUE(scheduler.isRunning("D3"));
+    EXPECT_TRUE(scheduler.contains("D4"));
+    EXPECT_FALSE(scheduler.isRunning("D4"));
+}
+
+TEST_F(FirmwareRolloutSchedulerTests, CanariesGoFirst)
+{
+    auto configuration = makeConfiguration(3);
+    configuration.canaryDevices = {"C1", "C2"};
+    FirmwareRolloutScheduler scheduler{configuration, STATE_FILE};
+    scheduler.enqueue("D1", "firmware.bin");
+    scheduler.enqueue("C1", "firmware.bin");
+    scheduler.enqueue("D2", "firmware.bin");
+    scheduler.enqueue("C2", "firmware.bin");
+
+    // The others wait for the canaries even though there is room for them
+    EXPECT_EQ(keys(scheduler.takeReady()), (std::vector<std::string>{"C1", "C2"}));
+    scheduler.finish("C1", true);
+    EXPECT_TRUE(scheduler.takeReady().empty());
+    scheduler.finish("C2", true);
+    EXPECT_EQ(keys(scheduler.takeReady()), (std::vector<std::string>{"D1", "D2"}));
+}
+
+TEST_F(FirmwareRolloutSchedulerTests, FailedCanaryPausesTheRollout)
+{
+    auto configuration = makeConfiguration(1);
+    configuration.canaryDevices = {"C1"};
+    FirmwareRolloutScheduler scheduler{configuration, STATE_FILE};
+    scheduler.enqueue("C1", "firmware.bin");
+    scheduler.enqueue("D1", "firmware.bin");
+
+    EXPECT_EQ(keys(scheduler.takeReady()), (std::vector<std::string>{"C1"}));
+    scheduler.finish("C1", false);
+    EXPECT_TRUE(scheduler.isPaused());
+    EXPECT_TRUE(scheduler.takeReady().empty());
+
+    scheduler.resume();
+    EXPECT_EQ(keys(scheduler.takeReady()), (std::vector<std::string>{"D1"}));
+}
+
+TEST_F(FirmwareRolloutSchedulerTests, ErrorRatePausesTheRollout)
+{
+    auto configuration = makeConfiguration(10);
+    configuration.maximumErrorRate = 0.25;
+    configuration.errorRateSampleSize = 4;
+    FirmwareRolloutScheduler scheduler{configuration, STATE_FILE};
+    for (const auto& deviceKey : {"D1", "D2", "D3", "D4", "D5"})
+        scheduler.enqueue(deviceKey, "firmware.bin");
+    ASSERT_EQ(scheduler.takeReady().size(), 5);
+
+    // Two failures out of three are not enough of a sample, but two out of four are over the limit
+    scheduler.finish("D1", false);
+    scheduler.finish("D2", false);
+    scheduler.finish("D3", true);
+    EXPECT_FALSE(scheduler.isPaused());
+    scheduler.finish("D4", true);
+    EXPECT_TRUE(scheduler.isPaused());
+}
+
+TEST_F(FirmwareRolloutSchedulerTests, RemoveOnlyRemovesWaitingInstallations)
+{
+    FirmwareRolloutScheduler scheduler{makeConfiguration(1), STATE_FILE};
+    scheduler.enqueue("D1", "firmware.bin");
+    scheduler.enqueue("D2", "firmware.bin");
+    scheduler.takeReady();
+
+    EXPECT_FALSE(scheduler.remove("D1"));
+    EXPECT_TRUE(scheduler.remove("D2"));
+    EXPECT_FALSE(scheduler.contains("D2"));
+}
+
+TEST_F(FirmwareRolloutSchedulerTests, ReleaseFreesTheSlotWithoutCounting)
+{
+    FirmwareRolloutScheduler scheduler{makeConfiguration(1), STATE_FILE};
+    scheduler.enqueue("D1", "firmware.bin");
+    scheduler.enqueue("D2", "firmware.bin");
+    scheduler.takeReady();
+
+    EXPECT_FALSE(scheduler.release("D2"));
+    EXPECT_TRUE(scheduler.release("D1"));
+    EXPECT_FALSE(scheduler.contains("D1"));
+    EXPECT_EQ(scheduler.m_failed, 0);
+    EXPECT_EQ(scheduler.takeReady().size(), 1);
+}
+
+TEST_F(FirmwareRolloutSchedulerTests, RequeuePutsTheInstallationBackInFront)
+{
+    auto configuration = makeConfiguration(2);
+    configuration.canaryDevices = {"C1", "C2"};
+    FirmwareRolloutScheduler scheduler{configuration, STATE_FILE};
+    for (const auto& deviceKey : {"D1", "D2", "D3"})
+        scheduler.enqueue(deviceKey, "firmware.bin");
+    EXPECT_EQ(keys(scheduler.takeReady()), (std::vector<std::string>{"D1", "D2"}));
+    scheduler.enqueue("C1", "canary.bin");
+
+    // A requeued installation still waits behind the canaries
+    EXPECT_FALSE(scheduler.requeue("D3"));
+    EXPECT_TRUE(scheduler.requeue("D2"));
+    EXPECT_EQ(scheduler.m_failed, 0);
+    EXPECT_EQ(keys({scheduler.m_queue.cbegin(), scheduler.m_queue.cend()}),
+              (std::vector<std::string>{"C1", "D2", "D3"}));
+    EXPECT_EQ(keys(scheduler.takeReady()), (std::vector<std::string>{"C1"}));
+    EXPECT_TRUE(scheduler.requeue("C1"));
+    EXPECT_EQ(scheduler.m_queue.front().deviceKey, "C1");
+}
+
+TEST_F(FirmwareRolloutSchedulerTests, ChangesAreAppendedAndReplayed)
+{
+    auto configuration = makeConfiguration(2);
+    configuration.canaryDevices = {"C1"};
+    auto content = std::string{};
+    {
+        FirmwareRolloutScheduler scheduler{configuration, STATE_FILE};
+        for (const auto& deviceKey : {"D1", "D2", "D3", "D4"})
+            scheduler.enqueue(deviceKey, "firmware.bin");
+        scheduler.takeReady();
+        scheduler.enqueue("C1", "canary.bin");
+        scheduler.requeue("D1");
+        scheduler.finish("D2", false);
+        scheduler.remove("D3");
+        scheduler.pause();
+
+        // The changes are added to the end of the file, which starts with the state it was created with
+        ASSERT_TRUE(FileSystemUtils::readFileContent(STATE_FILE, content));
+        EXPECT_EQ(content.find("paused\t0\ncounts\t0\t0\nqueued\t0\tD1\tfirmware.bin\nqueued\t0\tD2"), 0);
+        EXPECT_NE(content.find("requeued\tD1\n"), std::string::npos);
+    }
+
+    // A line that was not written to the end is left out
+    ASSERT_TRUE(FileSystemUtils::createFileWithContent(STATE_FILE, content + "removed\tD"));
+    FirmwareRolloutScheduler scheduler{configuration, STATE_FILE};
+    ASSERT_TRUE(scheduler.load());
+    EXPECT_TRUE(scheduler.isPaused());
+    EXPECT_EQ(scheduler.m_failed, 1);
+    EXPECT_EQ(scheduler.getRunningCount(), 0);
+    EXPECT_EQ(keys({scheduler.m_queue.cbegin(), scheduler.m_queue.cend()}),
+              (std::vector<std::string>{"C1", "D1", "D4"}));
+
+    // And loading leaves just the state behind
+    ASSERT_TRUE(FileSystemUtils::readFileContent(STATE_FILE, content));
+    EXPECT_EQ(content, "paused\t1\ncounts\t0\t1\nqueued\t1\tC1\tcanary.bin\nqueued\t0\tD1\tfirmware.bin\n"
+                       "queued\t0\tD4\tfirmware.bin\n");
+}
+
+TEST_F(FirmwareRolloutSchedulerTests, ChangesAreCompacted)
+{
+    FirmwareRolloutScheduler scheduler{makeConfiguration(1), STATE_FILE};
+    scheduler.enqueue("D1", "firmware.bin");
+    for (auto i = 0; i < 100; ++i)
+    {
+        scheduler.pause();
+        scheduler.resume();
+    }
+    EXPECT_LT(scheduler.m_recordCount, 64);
+
+    FirmwareRolloutScheduler loaded{makeConfiguration(1), STATE_FILE};
+    ASSERT_TRUE(loaded.load());
+    EXPECT_FALSE(loaded.isPaused());
+    EXPECT_EQ(loaded.getQueuedCount(), 1);
+}
+
+TEST_F(FirmwareRolloutSchedulerTests, StateSurvivesARestart)
+{
+    auto configuration = makeConfiguration(1);
+    configuration.canaryDevices = {"C1"};
+    {
+        FirmwareRolloutScheduler scheduler{configuration, STATE_FILE};
+        scheduler.enqueue("C1", "canary.bin");
+        scheduler.enqueue("D1", "firmware.bin");
+        scheduler.enqueue("D2", "firmware.bin");
+        scheduler.takeReady();
+        scheduler.pause();
+    }
+
+    FirmwareRolloutScheduler scheduler{configuration, STATE_FILE};
+    ASSERT_TRUE(scheduler.load());
+    EXPECT_TRUE(scheduler.isPaused());
+    EXPECT_TRUE(scheduler.isRunning("C1"));
+    EXPECT_EQ(scheduler.getQueuedCount(), 2);
+    EXPECT_EQ(scheduler.m_running["C1"].file, "canary.bin");
+    EXPECT_TRUE(scheduler.m_running["C1"].canary);
+
+    scheduler.resume();
+    scheduler.finish("C1", true);
+    EXPECT_EQ(keys(scheduler.takeReady()), (std::vector<std::string>{"D1"}));
+    scheduler.finish("D1", true);
+    scheduler.remove("D2");
+
+    // Once the rollout is done, the file is gone
+    EXPECT_FALSE(FileSystemUtils::isFilePresent(STATE_FILE));
+    EXPECT_FALSE(FirmwareRolloutScheduler(configuration, STATE_FILE).load());
+}
+
+TEST_F(FirmwareRolloutSchedulerTests, SeparatorsInEntriesSurviveARestart)
+{
+    const auto configuration = makeConfiguration(1);
+    const auto deviceKey = std::string{"Device\twith\nseparators\\"};
+    const auto file = std::string{"firmware\n\tqueued\t1\tD\tF.bin"};
+    {
+        FirmwareRolloutScheduler scheduler{configuration, STATE_FILE};
+        scheduler.pause();
+        scheduler.enqueue(deviceKey, file);
+    }
+    EXPECT_FALSE(FileSystemUtils::isFilePresent(STATE_FILE + ".tmp"));
+
+    FirmwareRolloutScheduler scheduler{configuration, STATE_FILE};
+    ASSERT_TRUE(scheduler.load());
+    ASSERT_EQ(scheduler.getQueuedCount(), 1);
+    EXPECT_EQ(scheduler.m_queue.front().deviceKey, deviceKey);
+    EXPECT_EQ(scheduler.m_queue.front().file, file);
+}
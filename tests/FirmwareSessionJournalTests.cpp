@@ -0,0 +1,161 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define private public
+#define protected public
+#include "wolk/service/firmware_update/FirmwareSessionJournal.h"
+#undef private
+#undef protected
+
+#include "core/utilities/FileSystemUtils.h"
+#include "core/utilities/Logger.h"
+
+#include <gtest/gtest.h>
+
+using namespace wolkabout;
+using namespace wolkabout::connect;
+using namespace ::testing;
+
+class FirmwareSessionJournalTests : public ::testing::Test
+{
+public:
+    static void SetUpTestCase() { Logger::init(LogLevel::TRACE, Logger::Type::CONSOLE); }
+
+    void TearDown() override
+    {
+        FileSystemUtils::deleteFile(JOURNAL_FILE);
+        FileSystemUtils::deleteFile(JOURNAL_FILE + ".tmp");
+    }
+
+    static std::string findVersion(const FirmwareSessionJournal& journal, const std::string& deviceKey)
+    {
+        auto version = std::string{};
+        return journal.find(deviceKey, version) ? version : "<none>";
+    }
+
+    const std::string JOURNAL_FILE = "./.fw-sessions-test";
+};
+
+TEST_F(FirmwareSessionJournalTests, MissingJournalLoadsEmpty)
+{
+    FirmwareSessionJournal journal{JOURNAL_FILE};
+    EXPECT_TRUE(journal.load());
+    EXPECT_EQ(journal.size(), 0);
+    EXPECT_EQ(findVersion(journal, "Device"), "<none>");
+}
+
+TEST_F(FirmwareSessionJournalTests, SessionsSurviveAReload)
+{
+    {
+        FirmwareSessionJournal journal{JOURNAL_FILE};
+        ASSERT_TRUE(journal.load());
+        ASSERT_TRUE(journal.store("D1", "1.0.0"));
+        ASSERT_TRUE(journal.store("D2", "2.0.0"));
+        ASSERT_TRUE(journal.store("D1", "1.0.1"));
+        EXPECT_TRUE(journal.remove("D2"));
+        EXPECT_FALSE(journal.remove("D2"));
+        ASSERT_TRUE(journal.store("Tab\tand\nnewline\\", "3.0.0\n"));
+    }
+
+    FirmwareSessionJournal journal{JOURNAL_FILE};
+    ASSERT_TRUE(journal.load());
+    EXPECT_EQ(journal.size(), 2);
+    EXPECT_EQ(findVersion(journal, "D1"), "1.0.1");
+    EXPECT_EQ(findVersion(journal, "D2"), "<none>");
+    EXPECT_EQ(findVersion(journal, "Tab\tand\nnewline\\"), "3.0.0\n");
+
+    // The stale records were dropped while loading
+    EXPECT_EQ(journal.m_recordCount, 2);
+}
+
+TEST_F(FirmwareSessionJournalTests, FileOfTheSessionSurvivesAReload)
+{
+    {
+        FirmwareSessionJournal journal{JOURNAL_FILE};
+        ASSERT_TRUE(journal.load());
+        ASSERT_TRUE(journal.store("D1", "1.0.0", "/files/D1/app_1.0.1_amd64.deb"));
+        ASSERT_TRUE(journal.store("D2", "2.0.0"));
+        ASSERT_TRUE(journal.store("D3", "3.0.0", "file\twith\ttabs"));
+    }
+
+    FirmwareSessionJournal journal{JOURNAL_FILE};
+    ASSERT_TRUE(journal.load());
+    auto version = std::string{};
+    auto file = std::string{};
+    ASSERT_TRUE(journal.find("D1", version, file));
+    EXPECT_EQ(version, "1.0.0");
+    EXPECT_EQ(file, "/files/D1/app_1.0.1_amd64.deb");
+    ASSERT_TRUE(journal.find("D2", version, file));
+    EXPECT_EQ(version, "2.0.0");
+    EXPECT_TRUE(file.empty());
+    ASSERT_TRUE(journal.find("D3", version, file));
+    EXPECT_EQ(file, "file\twith\ttabs");
+}
+
+TEST_F(FirmwareSessionJournalTests, IncompleteLastRecordIsIgnored)
+{
+    ASSERT_TRUE(FileSystemUtils::createFileWithContent(JOURNAL_FILE, "+\tD1\t1.0.0\n+\tD2\t2.0"));
+
+    FirmwareSessionJournal journal{JOURNAL_FILE};
+    ASSERT_TRUE(journal.load());
+    EXPECT_EQ(findVersion(journal, "D1"), "1.0.0");
+    EXPECT_EQ(findVersion(journal, "D2"), "<none>");
+
+    auto content = std::string{};
+    ASSERT_TRUE(FileSystemUtils::readFileContent(JOURNAL_FILE, content));
+    EXPECT_EQ(content, "+\tD1\t1.0.0\n");
+}
+
+TEST_F(FirmwareSessionJournalTests, JournalIsCompacted)
+{
+    FirmwareSessionJournal journal{JOURNAL_FILE};
+    ASSERT_TRUE(journal.load());
+    for (auto i = 0; i < 100; ++i)
+    {
+        ASSERT_TRUE(journal.store("D1", std::to_string(i)));
+        ASSERT_TRUE(journal.remove("D1"));
+    }
+    ASSERT_TRUE(journal.store("D1", "final"));
+    EXPECT_LT(journal.m_recordCount, 64);
+    EXPECT_FALSE(FileSystemUtils::isFilePresent(JOURNAL_FILE + ".tmp"));
+
+    FirmwareSessionJournal reloaded{JOURNAL_FILE};
+    ASSERT_TRUE(reloaded.load());
+    EXPECT_EQ(findVersion(reloaded, "D1"), "final");
+}
+
+TEST_F(FirmwareSessionJournalTests, LegacyFilesAreMigrated)
+{
+    ASSERT_TRUE(FileSystemUtils::createFileWithContent("./.fw-session-test_D1", "1.0.0"));
+    ASSERT_TRUE(FileSystemUtils::createFileWithContent("./.fw-session-test_D2", "2.0.0"));
+
+    FirmwareSessionJournal journal{JOURNAL_FILE};
+    ASSERT_TRUE(journal.load());
+    EXPECT_EQ(journal.migrateLegacyFiles("./", ".fw-session-test_"), 2);
+    EXPECT_EQ(findVersion(journal, "D1"), "1.0.0");
+    EXPECT_EQ(findVersion(journal, "D2"), "2.0.0");
+    EXPECT_FALSE(FileSystemUtils::isFilePresent("./.fw-session-test_D1"));
+    EXPECT_FALSE(FileSystemUtils::isFilePresent("./.fw-session-test_D2"));
+    EXPECT_EQ(journal.migrateLegacyFiles("./", ".fw-session-test_"), 0);
+}
+
+TEST_F(FirmwareSessionJournalTests, StoreFailsWithoutTheDirectory)
+{
+    FirmwareSessionJournal journal{"./non-existing-dir/.fw-sessions"};
+    ASSERT_TRUE(journal.load());
+    EXPECT_FALSE(journal.store("D1", "1.0.0"));
+    EXPECT_EQ(findVersion(journal, "D1"), "<none>");
+}
@@ -0,0 +1,91 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define private public
+#define protected public
+#include "wolk/service/firmware_update/FirmwareStateTable.h"
+#undef private
+#undef protected
+
+#include "core/utilities/Logger.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace wolkabout;
+using namespace wolkabout::connect;
+using namespace ::testing;
+
+class FirmwareStateTableTests : public ::testing::Test
+{
+public:
+    static void SetUpTestCase() { Logger::init(LogLevel::TRACE, Logger::Type::CONSOLE); }
+};
+
+TEST_F(FirmwareStateTableTests, UnknownDevicesAreIdle)
+{
+    FirmwareStateTable table;
+    EXPECT_EQ(table.get("Device"), FirmwareInstallationState::IDLE);
+    EXPECT_EQ(table.size(), 0);
+}
+
+TEST_F(FirmwareStateTableTests, SetAndGet)
+{
+    FirmwareStateTable table;
+    table.set("Device", FirmwareInstallationState::INSTALLING);
+    EXPECT_EQ(table.get("Device"), FirmwareInstallationState::INSTALLING);
+    EXPECT_EQ(table.size(), 1);
+
+    // Idle devices are not kept
+    table.set("Device", FirmwareInstallationState::IDLE);
+    EXPECT_EQ(table.get("Device"), FirmwareInstallationState::IDLE);
+    EXPECT_EQ(table.size(), 0);
+}
+
+TEST_F(FirmwareStateTableTests, TransitionOnlyFromTheExpectedState)
+{
+    FirmwareStateTable table;
+    EXPECT_TRUE(table.transition("Device", FirmwareInstallationState::IDLE, FirmwareInstallationState::INSTALLING));
+    EXPECT_FALSE(table.transition("Device", FirmwareInstallationState::IDLE, FirmwareInstallationState::INSTALLING));
+    EXPECT_TRUE(
+      table.transition("Device", FirmwareInstallationState::INSTALLING, FirmwareInstallationState::AWAITING_RESULT));
+    EXPECT_EQ(table.get("Device"), FirmwareInstallationState::AWAITING_RESULT);
+    EXPECT_TRUE(
+      table.transition("Device", FirmwareInstallationState::AWAITING_RESULT, FirmwareInstallationState::IDLE));
+    EXPECT_EQ(table.size(), 0);
+}
+
+TEST_F(FirmwareStateTableTests, OnlyOneThreadWinsTheTransition)
+{
+    FirmwareStateTable table;
+    std::atomic_int winners{0};
+    auto threads = std::vector<std::thread>{};
+    for (auto i = 0; i < 8; ++i)
+        threads.emplace_back([&] {
+            for (auto device = 0; device < 500; ++device)
+                if (table.transition("Device" + std::to_string(device), FirmwareInstallationState::IDLE,
+                                     FirmwareInstallationState::INSTALLING))
+                    ++winners;
+        });
+    for (auto& thread : threads)
+        thread.join();
+
+    EXPECT_EQ(winners, 500);
+    EXPECT_EQ(table.size(), 500);
+}
@@ -39,6 +39,8 @@
 
 #include <gtest/gtest.h>
 
+#include <future>
+#include <thread>
 #include <vector>
 
 using namespace wolkabout;
@@ -62,6 +64,12 @@ public:
     {
         if (service)
             service->deleteSessionFile(DEVICE_KEY);
+
+        // Stop the installation workers while the mocks they could be using are still alive
+        service.reset();
+        FileSystemUtils::deleteFile(FileSystemUtils::composePath(".fw-rollout", "./"));
+        FileSystemUtils::deleteFile(FileSystemUtils::composePath(".fw-sessions", "./"));
+        FileSystemUtils::deleteFile(FileSystemUtils::composePath(".fw-session_" + DEVICE_KEY, "./"));
     }
 
     void CreateServiceWithInstaller(const std::string& destination = "./")
@@ -159,16 +167,52 @@ TEST_F(FirmwareUpdateServiceTests, SessionFileCheck)
     CreateServiceWithInstaller();
 
     // Check that it does not exist
-    const auto filePath = "./.fw-session_" + DEVICE_KEY;
-    ASSERT_FALSE(FileSystemUtils::isFilePresent(filePath));
+    auto version = std::string{};
+    ASSERT_FALSE(service->m_sessionJournal.find(DEVICE_KEY, version));
 
-    // Create the session file
+    // Create the session
     ASSERT_TRUE(service->storeSessionFile(DEVICE_KEY, FIRMWARE_VERSION_1));
-    ASSERT_TRUE(FileSystemUtils::isFilePresent(filePath));
+    ASSERT_TRUE(FileSystemUtils::isFilePresent("./.fw-sessions"));
+    ASSERT_TRUE(service->m_sessionJournal.find(DEVICE_KEY, version));
+    EXPECT_EQ(version, FIRMWARE_VERSION_1);
 
     // And now delete it
     ASSERT_NO_FATAL_FAILURE(service->deleteSessionFile(DEVICE_KEY));
-    ASSERT_FALSE(FileSystemUtils::isFilePresent(filePath));
+    ASSERT_FALSE(service->m_sessionJournal.find(DEVICE_KEY, version));
+}
+
+TEST_F(FirmwareUpdateServiceTests, LegacySessionFileIsMigrated)
+{
+    ASSERT_TRUE(CreateSessionFile(DEVICE_KEY, FIRMWARE_VERSION_1));
+    CreateServiceWithInstaller();
+
+    auto version = std::string{};
+    ASSERT_TRUE(service->m_sessionJournal.find(DEVICE_KEY, version));
+    EXPECT_EQ(version, FIRMWARE_VERSION_1);
+    EXPECT_FALSE(FileSystemUtils::isFilePresent("./.fw-session_" + DEVICE_KEY));
+}
+
+TEST_F(FirmwareUpdateServiceTests, LoadStateWithoutSessionReportsNothing)
+{
+    CreateServiceWithInstaller();
+    EXPECT_CALL(GetFirmwareInstallReference(), wasFirmwareInstallSuccessful).Times(0);
+    EXPECT_CALL(firmwareUpdateProtocolMock, makeOutboundMessage).Times(0);
+    ASSERT_NO_FATAL_FAILURE(service->loadState(DEVICE_KEY));
+    EXPECT_TRUE(service->getQueue().empty());
+}
+
+TEST_F(FirmwareUpdateServiceTests, LoadStateChecksTheInstalledFile)
+{
+    CreateServiceWithInstaller();
+    const auto file = std::string{"/files/TestDevice/service_1.0.1_amd64.deb"};
+    ASSERT_TRUE(service->storeSessionFile(DEVICE_KEY, FIRMWARE_VERSION_1, file));
+    service->m_installationStates.set(DEVICE_KEY, FirmwareInstallationState::AWAITING_RESULT);
+    EXPECT_CALL(GetFirmwareInstallReference(), wasFileInstallSuccessful(DEVICE_KEY, FIRMWARE_VERSION_1, file))
+      .WillOnce(Return(true));
+    EXPECT_CALL(GetFirmwareInstallReference(), wasFirmwareInstallSuccessful).Times(0);
+    EXPECT_CALL(firmwareUpdateProtocolMock, makeOutboundMessage).WillOnce(Return(ByMove(nullptr)));
+    ASSERT_NO_FATAL_FAILURE(service->loadState(DEVICE_KEY));
+    EXPECT_EQ(service->m_installationStates.get(DEVICE_KEY), FirmwareInstallationState::IDLE);
 }
 
 TEST_F(FirmwareUpdateServiceTests, QueueStatusMessageFailsToParse)
@@ -204,26 +248,63 @@ TEST_F(FirmwareUpdateServiceTests, PublishStatusMessageHappyFlow)
     ASSERT_NO_FATAL_FAILURE(service->sendStatusMessage(DEVICE_KEY, FirmwareUpdateStatus::INSTALLING));
 }
 
+TEST_F(FirmwareUpdateServiceTests, PublishStatusMessageQueuedWhenPublishFails)
+{
+    CreateServiceWithInstaller();
+    EXPECT_CALL(firmwareUpdateProtocolMock, makeOutboundMessage)
+      .WillOnce(Return(ByMove(std::unique_ptr<wolkabout::Message>{new wolkabout::Message{"", ""}})));
+    EXPECT_CALL(connectivityServiceMock, publish).WillOnce(Return(false));
+    ASSERT_NO_FATAL_FAILURE(service->sendStatusMessage(DEVICE_KEY, FirmwareUpdateStatus::INSTALLING));
+    EXPECT_EQ(service->getQueue().size(), 1);
+
+    // And it is sent out once the connection is back
+    EXPECT_CALL(connectivityServiceMock, publish).WillOnce(Return(true));
+    ASSERT_NO_FATAL_FAILURE(service->publishQueuedMessages());
+    EXPECT_TRUE(service->getQueue().empty());
+}
+
 TEST_F(FirmwareUpdateServiceTests, AbortAFirmwareInstallation)
 {
     CreateServiceWithInstaller();
-    service->m_installation.emplace(DEVICE_KEY, true);
+    service->m_installationStates.set(DEVICE_KEY, FirmwareInstallationState::AWAITING_RESULT);
     EXPECT_CALL(GetFirmwareInstallReference(), abortFirmwareInstall(DEVICE_KEY)).Times(1);
     ASSERT_NO_FATAL_FAILURE(service->onFirmwareAbort(DEVICE_KEY, FirmwareUpdateAbortMessage{}));
 }
 
+TEST_F(FirmwareUpdateServiceTests, AbortAnInstallationWaitingForAWorker)
+{
+    CreateServiceWithInstaller();
+    service->m_executor.reset(new FirmwareInstallationExecutor{1, 10});
+    auto release = std::promise<void>{};
+    auto released = release.get_future().share();
+    auto started = std::promise<void>{};
+    ASSERT_TRUE(service->m_executor->submit("OtherDevice", [&, released] {
+        started.set_value();
+        released.wait();
+    }));
+    ASSERT_EQ(started.get_future().wait_for(std::chrono::seconds{1}), std::future_status::ready);
+    ASSERT_TRUE(service->m_executor->submit(DEVICE_KEY, [] { FAIL() << "The aborted installation ran."; }));
+
+    // The installation never reaches the installer, and the platform is told it is aborted
+    EXPECT_CALL(GetFirmwareInstallReference(), abortFirmwareInstall).Times(0);
+    EXPECT_CALL(firmwareUpdateProtocolMock, makeOutboundMessage).WillOnce(Return(ByMove(nullptr)));
+    ASSERT_NO_FATAL_FAILURE(service->onFirmwareAbort(DEVICE_KEY, FirmwareUpdateAbortMessage{}));
+    EXPECT_FALSE(service->m_executor->isBusy(DEVICE_KEY));
+    release.set_value();
+}
+
 TEST_F(FirmwareUpdateServiceTests, LoadStateNoFirmwareInstaller)
 {
-    CreateServiceWithParameterListener();
     ASSERT_TRUE(CreateSessionFile(DEVICE_KEY, FIRMWARE_VERSION_1));
+    CreateServiceWithParameterListener();
     EXPECT_CALL(firmwareUpdateProtocolMock, makeOutboundMessage).WillOnce(Return(ByMove(nullptr)));
     ASSERT_NO_FATAL_FAILURE(service->loadState(DEVICE_KEY));
 }
 
 TEST_F(FirmwareUpdateServiceTests, LoadStateHappyFlowSameVersion)
 {
-    CreateServiceWithInstaller();
     ASSERT_TRUE(CreateSessionFile(DEVICE_KEY, FIRMWARE_VERSION_1));
+    CreateServiceWithInstaller();
     EXPECT_CALL(GetFirmwareInstallReference(), getFirmwareVersion).WillOnce(Return(FIRMWARE_VERSION_1));
     EXPECT_CALL(GetFirmwareInstallReference(), wasFirmwareInstallSuccessful)
       .WillOnce([&](const std::string& deviceKey, const std::string& oldContent) {
@@ -235,8 +316,8 @@ TEST_F(FirmwareUpdateServiceTests, LoadStateHappyFlowSameVersion)
 
 TEST_F(FirmwareUpdateServiceTests, LoadStateHappyFlowNewVersion)
 {
-    CreateServiceWithInstaller();
     ASSERT_TRUE(CreateSessionFile(DEVICE_KEY, FIRMWARE_VERSION_1));
+    CreateServiceWithInstaller();
     EXPECT_CALL(GetFirmwareInstallReference(), getFirmwareVersion).WillOnce(Return(FIRMWARE_VERSION_2));
     EXPECT_CALL(GetFirmwareInstallReference(), wasFirmwareInstallSuccessful)
       .WillOnce([&](const std::string& deviceKey, const std::string& oldContent) {
@@ -246,6 +327,35 @@ TEST_F(FirmwareUpdateServiceTests, LoadStateHappyFlowNewVersion)
     ASSERT_NO_FATAL_FAILURE(service->loadState(DEVICE_KEY));
 }
 
+TEST_F(FirmwareUpdateServiceTests, LoadStateSkipsAnOngoingInstallation)
+{
+    ASSERT_TRUE(CreateSessionFile(DEVICE_KEY, FIRMWARE_VERSION_1));
+    CreateServiceWithInstaller();
+    service->m_installationStates.set(DEVICE_KEY, FirmwareInstallationState::INSTALLING);
+    EXPECT_CALL(GetFirmwareInstallReference(), wasFirmwareInstallSuccessful).Times(0);
+    EXPECT_CALL(firmwareUpdateProtocolMock, makeOutboundMessage).Times(0);
+    ASSERT_NO_FATAL_FAILURE(service->loadState(DEVICE_KEY));
+
+    // The session and the state are left to the installation
+    auto version = std::string{};
+    EXPECT_TRUE(service->m_sessionJournal.find(DEVICE_KEY, version));
+    EXPECT_EQ(service->m_installationStates.get(DEVICE_KEY), FirmwareInstallationState::INSTALLING);
+}
+
+TEST_F(FirmwareUpdateServiceTests, LoadStateFinalizesAwaitedResult)
+{
+    ASSERT_TRUE(CreateSessionFile(DEVICE_KEY, FIRMWARE_VERSION_1));
+    CreateServiceWithInstaller();
+    service->m_installationStates.set(DEVICE_KEY, FirmwareInstallationState::AWAITING_RESULT);
+    EXPECT_CALL(GetFirmwareInstallReference(), wasFirmwareInstallSuccessful).WillOnce(Return(true));
+    EXPECT_CALL(firmwareUpdateProtocolMock, makeOutboundMessage).WillOnce(Return(ByMove(nullptr)));
+    ASSERT_NO_FATAL_FAILURE(service->loadState(DEVICE_KEY));
+
+    auto version = std::string{};
+    EXPECT_FALSE(service->m_sessionJournal.find(DEVICE_KEY, version));
+    EXPECT_EQ(service->m_installationStates.get(DEVICE_KEY), FirmwareInstallationState::IDLE);
+}
+
 TEST_F(FirmwareUpdateServiceTests, ObtainParametersNoListener)
 {
     CreateServiceWithInstaller();
@@ -269,7 +379,7 @@ TEST_F(FirmwareUpdateServiceTests, ObtainParametersHappyFlow)
 TEST_F(FirmwareUpdateServiceTests, OnFirmwareInstallAlreadyOngoing)
 {
     CreateServiceWithInstaller();
-    service->m_installation.emplace(DEVICE_KEY, true);
+    service->m_installationStates.set(DEVICE_KEY, FirmwareInstallationState::AWAITING_RESULT);
     ASSERT_NO_FATAL_FAILURE(service->onFirmwareInstall(DEVICE_KEY, FirmwareUpdateInstallMessage{TEST_FILE}));
 }
 
@@ -287,6 +397,27 @@ TEST_F(FirmwareUpdateServiceTests, OnFirmwareInstallOtherStatuses)
     }
 }
 
+TEST_F(FirmwareUpdateServiceTests, OnFirmwareInstallInvalidDeltaPackageIsNotInstalled)
+{
+    CreateServiceWithInstaller();
+
+    // The package is looked up in the file folder of the device
+    const auto deviceFolder = fileManagementServiceMock->getDeviceFileFolder(DEVICE_KEY);
+    const auto patchName = std::string{"firmware_update_test.bin"} + FirmwareDeltaPatcher::EXTENSION;
+    const auto patchPath = FileSystemUtils::composePath(patchName, deviceFolder);
+    if (!FileSystemUtils::isDirectoryPresent(deviceFolder))
+        ASSERT_TRUE(FileSystemUtils::createDirectory(deviceFolder));
+    ASSERT_TRUE(FileSystemUtils::createFileWithContent(patchPath, "WDLT"));
+    EXPECT_CALL(GetFirmwareInstallReference(), installFirmware).Times(0);
+    EXPECT_CALL(firmwareUpdateProtocolMock, makeOutboundMessage)
+      .WillOnce(Return(ByMove(nullptr)))
+      .WillOnce(Return(ByMove(nullptr)));
+    ASSERT_NO_FATAL_FAILURE(service->onFirmwareInstall(DEVICE_KEY, FirmwareUpdateInstallMessage{patchName}));
+    EXPECT_EQ(service->m_installationStates.get(DEVICE_KEY), FirmwareInstallationState::IDLE);
+    FileSystemUtils::deleteFile(patchPath);
+    FileSystemUtils::deleteFile(deviceFolder);
+}
+
 TEST_F(FirmwareUpdateServiceTests, OnFirmwareInstallWillInstallFailsToStoreSessionFile)
 {
     CreateServiceWithInstaller("./non-existing-dir/");
@@ -297,16 +428,43 @@ TEST_F(FirmwareUpdateServiceTests, OnFirmwareInstallWillInstallFailsToStoreSessi
     ASSERT_NO_FATAL_FAILURE(service->onFirmwareInstall(DEVICE_KEY, FirmwareUpdateInstallMessage{TEST_FILE}));
 }
 
+TEST_F(FirmwareUpdateServiceTests, OnFirmwareInstallReportedLater)
+{
+    CreateServiceWithInstaller();
+    auto callback = InstallResponseCallback{};
+    EXPECT_CALL(GetFirmwareInstallReference(), installFirmwareAsync)
+      .WillOnce([&](const std::string&, const std::string&, InstallResponseCallback installCallback) {
+          callback = std::move(installCallback);
+      });
+    EXPECT_CALL(GetFirmwareInstallReference(), wasFirmwareInstallSuccessful).Times(0);
+    EXPECT_CALL(firmwareUpdateProtocolMock, makeOutboundMessage)
+      .WillOnce(Return(ByMove(nullptr)))
+      .WillOnce(Return(ByMove(nullptr)));
+
+    // The installation is still going once the installer returns, so the state is not loaded meanwhile
+    ASSERT_NO_FATAL_FAILURE(service->onFirmwareInstall(DEVICE_KEY, FirmwareUpdateInstallMessage{TEST_FILE}));
+    ASSERT_TRUE(callback != nullptr);
+    EXPECT_EQ(service->m_installationStates.get(DEVICE_KEY), FirmwareInstallationState::INSTALLING);
+    service->loadState(DEVICE_KEY);
+    EXPECT_EQ(service->m_installationStates.get(DEVICE_KEY), FirmwareInstallationState::INSTALLING);
+
+    callback(InstallResponse::INSTALLED);
+    EXPECT_EQ(service->m_installationStates.get(DEVICE_KEY), FirmwareInstallationState::IDLE);
+    auto version = std::string{};
+    EXPECT_FALSE(service->m_sessionJournal.find(DEVICE_KEY, version));
+}
+
 TEST_F(FirmwareUpdateServiceTests, OnFirmwareInstallWillInstallStoresSessionFile)
 {
     CreateServiceWithInstaller();
-    ASSERT_FALSE(FileSystemUtils::isFilePresent("./.fw-session_" + DEVICE_KEY));
+    auto version = std::string{};
+    ASSERT_FALSE(service->m_sessionJournal.find(DEVICE_KEY, version));
     EXPECT_CALL(GetFirmwareInstallReference(), installFirmware).WillOnce(Return(InstallResponse::WILL_INSTALL));
     EXPECT_CALL(firmwareUpdateProtocolMock, makeOutboundMessage)
       .WillOnce(Return(ByMove(nullptr)))
       .WillOnce(Return(ByMove(nullptr)));
     ASSERT_NO_FATAL_FAILURE(service->onFirmwareInstall(DEVICE_KEY, FirmwareUpdateInstallMessage{TEST_FILE}));
-    ASSERT_TRUE(FileSystemUtils::isFilePresent("./.fw-session_" + DEVICE_KEY));
+    ASSERT_TRUE(service->m_sessionJournal.find(DEVICE_KEY, version));
 }
 
 TEST_F(FirmwareUpdateServiceTests, MessageReceivedNullMessage)
@@ -346,8 +504,131 @@ TEST_F(FirmwareUpdateServiceTests, MessageReceivedInstallationHappyFlow)
     EXPECT_CALL(firmwareUpdateProtocolMock, parseFirmwareUpdateInstall)
       .WillOnce(
         Return(ByMove(std::unique_ptr<FirmwareUpdateInstallMessage>{new FirmwareUpdateInstallMessage{TEST_FILE}})));
-    service->m_installation[DEVICE_KEY] = true;
+    service->m_installationStates.set(DEVICE_KEY, FirmwareInstallationState::AWAITING_RESULT);
+    ASSERT_NO_FATAL_FAILURE(service->messageReceived(std::make_shared<wolkabout::Message>("", "")));
+}
+
+TEST_F(FirmwareUpdateServiceTests, MessageReceivedInstallationRunsOnExecutor)
+{
+    CreateServiceWithInstaller();
+    const auto receivingThread = std::this_thread::get_id();
+    auto installed = std::promise<std::thread::id>{};
+    EXPECT_CALL(firmwareUpdateProtocolMock, getMessageType).WillOnce(Return(MessageType::FIRMWARE_UPDATE_INSTALL));
+    EXPECT_CALL(firmwareUpdateProtocolMock, getDeviceKey).WillOnce(Return(DEVICE_KEY));
+    EXPECT_CALL(firmwareUpdateProtocolMock, parseFirmwareUpdateInstall)
+      .WillOnce(
+        Return(ByMove(std::unique_ptr<FirmwareUpdateInstallMessage>{new FirmwareUpdateInstallMessage{TEST_FILE}})));
+    EXPECT_CALL(firmwareUpdateProtocolMock, makeOutboundMessage)
+      .WillOnce(Return(ByMove(nullptr)))
+      .WillOnce(Return(ByMove(nullptr)));
+    EXPECT_CALL(GetFirmwareInstallReference(), installFirmware).WillOnce([&](const std::string&, const std::string&) {
+        installed.set_value(std::this_thread::get_id());
+        return InstallResponse::INSTALLED;
+    });
+
+    ASSERT_NO_FATAL_FAILURE(service->messageReceived(std::make_shared<wolkabout::Message>("", "")));
+    auto future = installed.get_future();
+    ASSERT_EQ(future.wait_for(std::chrono::seconds{1}), std::future_status::ready);
+    EXPECT_NE(future.get(), receivingThread);
+}
+
+TEST_F(FirmwareUpdateServiceTests, RolloutWaitsToBeStarted)
+{
+    CreateServiceWithInstaller();
+    auto configuration = RolloutConfiguration{};
+    configuration.concurrencyLimit = 1;
+    service->setRolloutConfiguration(configuration);
+    ASSERT_NE(service->m_rolloutScheduler, nullptr);
+
+    // Until the rollout is started, the installation only waits in the rollout
+    EXPECT_CALL(firmwareUpdateProtocolMock, getMessageType).WillOnce(Return(MessageType::FIRMWARE_UPDATE_INSTALL));
+    EXPECT_CALL(firmwareUpdateProtocolMock, getDeviceKey).WillOnce(Return(DEVICE_KEY));
+    EXPECT_CALL(firmwareUpdateProtocolMock, parseFirmwareUpdateInstall)
+      .WillOnce(
+        Return(ByMove(std::unique_ptr<FirmwareUpdateInstallMessage>{new FirmwareUpdateInstallMessage{TEST_FILE}})));
+    ASSERT_NO_FATAL_FAILURE(service->messageReceived(std::make_shared<wolkabout::Message>("", "")));
+    EXPECT_EQ(service->m_rolloutScheduler->getQueuedCount(), 1);
+    EXPECT_EQ(service->m_rolloutScheduler->getRunningCount(), 0);
+
+    auto installed = std::promise<void>{};
+    EXPECT_CALL(GetFirmwareInstallReference(), installFirmware).WillOnce([&](const std::string&, const std::string&) {
+        installed.set_value();
+        return InstallResponse::WILL_INSTALL;
+    });
+    service->startRollout();
+    EXPECT_EQ(installed.get_future().wait_for(std::chrono::seconds{1}), std::future_status::ready);
+}
+
+TEST_F(FirmwareUpdateServiceTests, MessageReceivedInstallationWaitsForRollout)
+{
+    CreateServiceWithInstaller();
+    auto configuration = RolloutConfiguration{};
+    configuration.concurrencyLimit = 1;
+    service->setRolloutConfiguration(configuration);
+    ASSERT_NE(service->m_rolloutScheduler, nullptr);
+    service->startRollout();
+
+    // The first device reboots to install, so it holds the only slot until its state is loaded
+    auto installed = std::promise<std::string>{};
+    EXPECT_CALL(firmwareUpdateProtocolMock, getMessageType)
+      .Times(2)
+      .WillRepeatedly(Return(MessageType::FIRMWARE_UPDATE_INSTALL));
+    EXPECT_CALL(firmwareUpdateProtocolMock, getDeviceKey).WillOnce(Return(DEVICE_KEY)).WillOnce(Return("OtherDevice"));
+    EXPECT_CALL(firmwareUpdateProtocolMock, parseFirmwareUpdateInstall)
+      .WillOnce(
+        Return(ByMove(std::unique_ptr<FirmwareUpdateInstallMessage>{new FirmwareUpdateInstallMessage{TEST_FILE}})))
+      .WillOnce(
+        Return(ByMove(std::unique_ptr<FirmwareUpdateInstallMessage>{new FirmwareUpdateInstallMessage{TEST_FILE}})));
+    EXPECT_CALL(GetFirmwareInstallReference(), installFirmware)
+      .WillOnce([&](const std::string& deviceKey, const std::string&) {
+          installed.set_value(deviceKey);
+          return InstallResponse::WILL_INSTALL;
+      });
+
     ASSERT_NO_FATAL_FAILURE(service->messageReceived(std::make_shared<wolkabout::Message>("", "")));
+    ASSERT_NO_FATAL_FAILURE(service->messageReceived(std::make_shared<wolkabout::Message>("", "")));
+    auto future = installed.get_future();
+    ASSERT_EQ(future.wait_for(std::chrono::seconds{1}), std::future_status::ready);
+    EXPECT_EQ(future.get(), DEVICE_KEY);
+    EXPECT_TRUE(service->m_rolloutScheduler->isRunning(DEVICE_KEY));
+    EXPECT_EQ(service->m_rolloutScheduler->getQueuedCount(), 1);
+
+    // Pausing keeps the other device waiting even once the slot is free
+    service->pauseRollout();
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{1};
+    while (service->m_executor->isBusy(DEVICE_KEY) && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds{1});
+    EXPECT_CALL(GetFirmwareInstallReference(), wasFirmwareInstallSuccessful).WillOnce(Return(true));
+    service->loadState(DEVICE_KEY);
+    EXPECT_EQ(service->m_rolloutScheduler->getRunningCount(), 0);
+    EXPECT_EQ(service->m_rolloutScheduler->getQueuedCount(), 1);
+}
+
+TEST_F(FirmwareUpdateServiceTests, LoadStateRequeuesARolloutInstallationThatNeverStarted)
+{
+    CreateServiceWithInstaller();
+    auto configuration = RolloutConfiguration{};
+    configuration.concurrencyLimit = 1;
+    service->setRolloutConfiguration(configuration);
+    ASSERT_NE(service->m_rolloutScheduler, nullptr);
+
+    // The installation was taken from the rollout before a restart, but never got to start a session
+    service->m_rolloutScheduler->enqueue(DEVICE_KEY, TEST_FILE);
+    service->m_rolloutScheduler->takeReady();
+    service->pauseRollout();
+    service->startRollout();
+    service->loadState(DEVICE_KEY);
+    EXPECT_EQ(service->m_rolloutScheduler->getRunningCount(), 0);
+    EXPECT_EQ(service->m_rolloutScheduler->getQueuedCount(), 1);
+    EXPECT_EQ(service->m_rolloutScheduler->m_failed, 0);
+
+    auto installed = std::promise<void>{};
+    EXPECT_CALL(GetFirmwareInstallReference(), installFirmware).WillOnce([&](const std::string&, const std::string&) {
+        installed.set_value();
+        return InstallResponse::WILL_INSTALL;
+    });
+    service->resumeRollout();
+    EXPECT_EQ(installed.get_future().wait_for(std::chrono::seconds{1}), std::future_status::ready);
 }
 
 TEST_F(FirmwareUpdateServiceTests, MessageReceivedAbortFailsToParse)
@@ -366,6 +647,6 @@ TEST_F(FirmwareUpdateServiceTests, MessageReceivedAbortHappyFlow)
     EXPECT_CALL(firmwareUpdateProtocolMock, getDeviceKey).WillOnce(Return(""));
     EXPECT_CALL(firmwareUpdateProtocolMock, parseFirmwareUpdateAbort)
       .WillOnce(Return(ByMove(std::unique_ptr<FirmwareUpdateAbortMessage>{new FirmwareUpdateAbortMessage})));
-    service->m_installation[DEVICE_KEY] = false;
+    service->m_installationStates.set(DEVICE_KEY, FirmwareInstallationState::IDLE);
     ASSERT_NO_FATAL_FAILURE(service->messageReceived(std::make_shared<wolkabout::Message>("", "")));
 }
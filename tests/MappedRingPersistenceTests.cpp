@@ -0,0 +1,195 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define private public
+#define protected public
+#include "wolk/persistence/MappedRingPersistence.h"
+#undef private
+#undef protected
+
+#include "core/utilities/FileSystemUtils.h"
+#include "core/utilities/Logger.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdio>
+
+using namespace wolkabout;
+using namespace wolkabout::connect;
+using namespace ::testing;
+
+class MappedRingPersistenceTests : public ::testing::Test
+{
+public:
+    static void SetUpTestCase() { Logger::init(LogLevel::TRACE, Logger::Type::CONSOLE); }
+
+    void TearDown() override
+    {
+        for (const auto& file : FileSystemUtils::listFiles(DIRECTORY))
+            FileSystemUtils::deleteFile(FileSystemUtils::composePath(file, DIRECTORY));
+        std::remove(DIRECTORY.c_str());
+    }
+
+    static void putReadings(MappedRingPersistence& persistence, const std::string& key, int from, int count)
+    {
+        for (auto i = from; i < from + count; ++i)
+            persistence.putReading(key, Reading{"T", std::to_string(i), 1650000000000 + static_cast<std::uint64_t>(i)});
+    }
+
+    const std::string DIRECTORY = "./.mapped-ring-persistence-test";
+    const std::string KEY = "Device+T";
+};
+
+TEST_F(MappedRingPersistenceTests, NumericFeedsGoIntoRings)
+{
+    MappedRingPersistence persistence{DIRECTORY, 64};
+    putReadings(persistence, KEY, 0, 10);
+
+    EXPECT_EQ(persistence.m_rings.size(), 1u);
+    EXPECT_EQ(FileSystemUtils::listFiles(DIRECTORY).size(), 1u);
+    EXPECT_EQ(persistence.getReadingsKeys(), std::vector<std::string>{KEY});
+
+    const auto readings = persistence.getReadings(KEY, 4);
+    ASSERT_EQ(readings.size(), 4u);
+    for (auto i = std::size_t{0}; i < readings.size(); ++i)
+    {
+        EXPECT_EQ(readings[i]->getReference(), "T");
+        EXPECT_EQ(readings[i]->getStringValue(), std::to_string(i));
+        EXPECT_EQ(readings[i]->getTimestamp(), 1650000000000 + i);
+    }
+
+    persistence.removeReadings(KEY, 4);
+    EXPECT_EQ(persistence.getReadings(KEY, 100).front()->getStringValue(), "4");
+    persistence.removeReadings(KEY, 100);
+    EXPECT_TRUE(persistence.getReadingsKeys().empty());
+    EXPECT_TRUE(persistence.isEmpty());
+}
+
+TEST_F(MappedRingPersistenceTests, ValuesComeBackUnchanged)
+{
+    MappedRingPersistence persistence{DIRECTORY, 64};
+    const auto values =
+      std::vector<std::string>{"20.500000", "-3", "0.1", "1650000000000", "-0", "+7", "1e3", "0x10", "1.", " 5"};
+    for (auto i = std::size_t{0}; i < values.size(); ++i)
+        persistence.putReading("Device+T" + std::to_string(i), Reading{"T", values[i], 1});
+
+    // Only the texts that are written back exactly as they came are kept as numbers
+    EXPECT_EQ(persistence.m_rings.size(), 5u);
+    for (auto i = std::size_t{0}; i < values.size(); ++i)
+    {
+        const auto readings = persistence.getReadings("Device+T" + std::to_string(i), 10);
+        ASSERT_EQ(readings.size(), 1u);
+        EXPECT_EQ(readings.front()->getStringValue(), values[i]);
+    }
+}
+
+TEST_F(MappedRingPersistenceTests, FeedWithMixedDecimalsStaysInTheRing)
+{
+    const auto texts = std::vector<std::string>{"20.5", "21", "20.25", "-0.125000", "1650000000000"};
+    MappedRingPersistence persistence{DIRECTORY, 64};
+    for (auto i = std::size_t{0}; i < texts.size(); ++i)
+        persistence.putReading(KEY, Reading{"T", texts[i], 1650000000000 + i});
+
+    EXPECT_EQ(persistence.m_rings.size(), 1u);
+    auto values = std::vector<std::string>{};
+    auto timestamps = std::vector<std::uint64_t>{};
+    for (const auto& reading : persistence.getReadings(KEY, 10))
+    {
+        values.emplace_back(reading->getStringValue());
+        timestamps.emplace_back(reading->getTimestamp());
+    }
+    EXPECT_EQ(values, texts);
+    EXPECT_EQ(timestamps.back(), 1650000000004u);
+}
+
+TEST_F(MappedRingPersistenceTests, RingsSurviveARestart)
+{
+    {
+        MappedRingPersistence persistence{DIRECTORY, 64};
+        putReadings(persistence, KEY, 0, 10);
+        persistence.removeReadings(KEY, 3);
+    }
+
+    MappedRingPersistence persistence{DIRECTORY, 64};
+    const auto readings = persistence.getReadings(KEY, 100);
+    ASSERT_EQ(readings.size(), 7u);
+    EXPECT_EQ(readings.front()->getStringValue(), "3");
+    EXPECT_EQ(readings.front()->getReference(), "T");
+
+    // New rings do not take over the files of the old ones
+    putReadings(persistence, "Other+T", 0, 1);
+    EXPECT_EQ(FileSystemUtils::listFiles(DIRECTORY).size(), 2u);
+    EXPECT_EQ(persistence.getReadings(KEY, 100).size(), 7u);
+}
+
+TEST_F(MappedRingPersistenceTests, FullRingOverwritesTheOldest)
+{
+    MappedRingPersistence persistence{DIRECTORY, 8};
+    putReadings(persistence, KEY, 0, 20);
+
+    EXPECT_EQ(persistence.getOverwrittenReadingCount(), 12u);
+    const auto readings = persistence.getReadings(KEY, 100);
+    ASSERT_EQ(readings.size(), 8u);
+    EXPECT_EQ(readings.front()->getStringValue(), "12");
+    EXPECT_EQ(readings.back()->getStringValue(), "19");
+}
+
+TEST_F(MappedRingPersistenceTests, OverwriteDuringAReadDoesNotRemoveNewerReadings)
+{
+    MappedRingPersistence persistence{DIRECTORY, 8};
+    putReadings(persistence, KEY, 0, 8);
+    ASSERT_EQ(persistence.getReadings(KEY, 4).size(), 4u);
+
+    // Three of the four readings given out are overwritten before they are removed
+    putReadings(persistence, KEY, 8, 3);
+    persistence.removeReadings(KEY, 4);
+
+    const auto readings = persistence.getReadings(KEY, 100);
+    ASSERT_EQ(readings.size(), 7u);
+    EXPECT_EQ(readings.front()->getStringValue(), "4");
+    EXPECT_EQ(readings.back()->getStringValue(), "10");
+}
+
+TEST_F(MappedRingPersistenceTests, OtherFeedsUseTheFallback)
+{
+    MappedRingPersistence persistence{DIRECTORY, 64};
+    persistence.putReading("Device+SW", Reading{"SW", std::string{"true"}, 1});
+    persistence.putReading("Device+LOC", Reading{"LOC", std::vector<std::string>{"45.2", "19.8"}, 1});
+    putReadings(persistence, KEY, 0, 2);
+
+    EXPECT_EQ(persistence.m_rings.size(), 1u);
+    auto keys = persistence.getReadingsKeys();
+    std::sort(keys.begin(), keys.end());
+    EXPECT_EQ(keys, (std::vector<std::string>{"Device+LOC", "Device+SW", KEY}));
+    EXPECT_EQ(persistence.getReadings("Device+SW", 10).front()->getStringValue(), "true");
+    EXPECT_EQ(persistence.getReadings("Device+LOC", 10).front()->getStringValues().size(), 2u);
+}
+
+TEST_F(MappedRingPersistenceTests, FeedThatStopsFittingMovesToTheFallback)
+{
+    MappedRingPersistence persistence{DIRECTORY, 64};
+    putReadings(persistence, KEY, 0, 5);
+    persistence.putReading(KEY, Reading{"T", std::string{"unknown"}, 1650000000005});
+    putReadings(persistence, KEY, 6, 2);
+
+    EXPECT_TRUE(persistence.m_rings.empty());
+    EXPECT_TRUE(FileSystemUtils::listFiles(DIRECTORY).empty());
+    auto values = std::vector<std::string>{};
+    for (const auto& reading : persistence.getReadings(KEY, 100))
+        values.emplace_back(reading->getStringValue());
+    EXPECT_EQ(values, (std::vector<std::string>{"0", "1", "2", "3", "4", "unknown", "6", "7"}));
+}
@@ -0,0 +1,309 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define private public
+#define protected public
+#include "wolk/connectivity/OutboundScheduler.h"
+#undef private
+#undef protected
+
+#include "core/utilities/Logger.h"
+#include "tests/mocks/ConnectivityServiceMock.h"
+#include "tests/mocks/ProtocolMock.h"
+
+#include <gtest/gtest.h>
+
+#include <future>
+#include <memory>
+#include <thread>
+
+using namespace ::testing;
+using namespace wolkabout;
+using namespace wolkabout::connect;
+
+class OutboundSchedulerTests : public ::testing::Test
+{
+public:
+    static void SetUpTestCase() { Logger::init(LogLevel::TRACE, Logger::Type::CONSOLE); }
+
+    void SetUp() override
+    {
+        connectivityServiceMock = std::unique_ptr<ConnectivityServiceMock>{new NiceMock<ConnectivityServiceMock>};
+        protocolMock = std::unique_ptr<ProtocolMock>{new NiceMock<ProtocolMock>};
+    }
+
+    void TearDown() override { service.reset(); }
+
+    void createService(std::uint64_t messagesPerSecond, std::uint64_t bytesPerSecond, std::size_t queueCapacity)
+    {
+        service = std::unique_ptr<OutboundScheduler>{new OutboundScheduler{
+          *connectivityServiceMock,
+          [this](const wolkabout::Message& message) { return protocolMock->getMessageType(message); },
+          messagesPerSecond, bytesPerSecond, queueCapacity}};
+    }
+
+    // Publishes the message with a callback, and returns what the callback is told
+    std::future<bool> publishWithCallback(const std::string& channel)
+    {
+        auto result = std::make_shared<std::promise<bool>>();
+        if (!service->publish(makeMessage(channel), [result](bool published) { result->set_value(published); }))
+            result->set_value(false);
+        return result->get_future();
+    }
+
+    // Waits until the queues hold the expected count of messages
+    bool waitForQueueDepth(std::size_t depth)
+    {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{1};
+        while (service->getQueueDepth() != depth)
+        {
+            if (std::chrono::steady_clock::now() > deadline)
+                return false;
+            std::this_thread::sleep_for(std::chrono::milliseconds{1});
+        }
+        return true;
+    }
+
+    static std::shared_ptr<wolkabout::Message> makeMessage(const std::string& channel, std::size_t size = 1)
+    {
+        return std::make_shared<wolkabout::Message>(std::string(size, 'a'), channel);
+    }
+
+    std::unique_ptr<ConnectivityServiceMock> connectivityServiceMock;
+
+    std::unique_ptr<ProtocolMock> protocolMock;
+
+    std::unique_ptr<OutboundScheduler> service;
+
+    std::mutex mutex;
+
+    std::condition_variable conditionVariable;
+};
+
+TEST(TokenBucketTests, UnlimitedBucket)
+{
+    auto bucket = TokenBucket{};
+    EXPECT_TRUE(bucket.isUnlimited());
+    EXPECT_TRUE(bucket.tryConsume(1000000));
+    EXPECT_EQ(bucket.timeUntilAvailable(1000000).count(), 0);
+}
+
+TEST(TokenBucketTests, ConsumeAndRefill)
+{
+    auto bucket = TokenBucket{10};
+    const auto start = TokenBucket::Clock::now();
+    EXPECT_FALSE(bucket.isUnlimited());
+
+    // The bucket starts out full
+    EXPECT_TRUE(bucket.tryConsume(10, start));
+    EXPECT_FALSE(bucket.tryConsume(1, start));
+    EXPECT_EQ(bucket.timeUntilAvailable(1, start), std::chrono::microseconds{100000});
+
+    // After a tenth of a second, there should be a single token
+    EXPECT_TRUE(bucket.tryConsume(1, start + std::chrono::milliseconds{100}));
+    EXPECT_FALSE(bucket.tryConsume(1, start + std::chrono::milliseconds{100}));
+
+    // The bucket never overflows
+    EXPECT_LE(bucket.getAvailableTokens(start + std::chrono::seconds{10}), 10.0);
+}
+
+TEST(TokenBucketTests, RequestLargerThanCapacity)
+{
+    auto bucket = TokenBucket{10, 20};
+    const auto start = TokenBucket::Clock::now();
+    EXPECT_TRUE(bucket.tryConsume(100, start));
+    EXPECT_FALSE(bucket.tryConsume(100, start));
+    EXPECT_EQ(bucket.timeUntilAvailable(100, start), std::chrono::microseconds{2000000});
+}
+
+TEST_F(OutboundSchedulerTests, DelegatesConnectionManagement)
+{
+    createService(0, 0, 10);
+    EXPECT_CALL(*connectivityServiceMock, connect).WillOnce(Return(true));
+    EXPECT_CALL(*connectivityServiceMock, reconnect).WillOnce(Return(false));
+    EXPECT_CALL(*connectivityServiceMock, disconnect).Times(1);
+    EXPECT_CALL(*connectivityServiceMock, isConnected).WillOnce(Return(true));
+    EXPECT_TRUE(service->connect());
+    EXPECT_FALSE(service->reconnect());
+    service->disconnect();
+    EXPECT_TRUE(service->isConnected());
+}
+
+TEST_F(OutboundSchedulerTests, PublishNullptr)
+{
+    createService(0, 0, 10);
+    EXPECT_FALSE(service->publish(nullptr));
+}
+
+TEST_F(OutboundSchedulerTests, PublishNotConnected)
+{
+    createService(0, 0, 10);
+    EXPECT_CALL(*connectivityServiceMock, isConnected).WillOnce(Return(false));
+    EXPECT_FALSE(service->publish(makeMessage("d2p/test/feed_values")));
+    EXPECT_EQ(service->getQueueDepth(), 0);
+}
+
+TEST_F(OutboundSchedulerTests, DefaultPriorities)
+{
+    createService(0, 0, 10);
+    EXPECT_EQ(service->getPriority(MessageType::FILE_BINARY_REQUEST), OutboundPriority::HIGH);
+    EXPECT_EQ(service->getPriority(MessageType::FIRMWARE_UPDATE_STATUS), OutboundPriority::HIGH);
+    EXPECT_EQ(service->getPriority(MessageType::FEED_VALUES), OutboundPriority::LOW);
+    EXPECT_EQ(service->getPriority(MessageType::PARAMETER_SYNC), OutboundPriority::NORMAL);
+
+    service->setPriority(MessageType::PARAMETER_SYNC, OutboundPriority::LOW);
+    EXPECT_EQ(service->getPriority(MessageType::PARAMETER_SYNC), OutboundPriority::LOW);
+}
+
+TEST_F(OutboundSchedulerTests, PublishWhenNotRunning)
+{
+    createService(0, 0, 10);
+    EXPECT_CALL(*connectivityServiceMock, isConnected).WillRepeatedly(Return(true));
+    EXPECT_CALL(*connectivityServiceMock, publish).Times(0);
+    EXPECT_FALSE(service->publish(makeMessage("d2p/test/feed_values")));
+    EXPECT_EQ(service->getQueueDepth(), 0);
+}
+
+TEST_F(OutboundSchedulerTests, HigherPriorityGoesOutFirst)
+{
+    createService(0, 0, 10);
+    EXPECT_CALL(*connectivityServiceMock, isConnected).WillRepeatedly(Return(true));
+    EXPECT_CALL(*protocolMock, getMessageType)
+      .WillOnce(Return(MessageType::FEED_VALUES))
+      .WillOnce(Return(MessageType::PARAMETER_SYNC))
+      .WillOnce(Return(MessageType::FILE_BINARY_REQUEST));
+
+    // Queue up the messages before the dispatcher is started
+    service->m_stopped = false;
+    auto low = publishWithCallback("low");
+    ASSERT_TRUE(waitForQueueDepth(1));
+    auto normal = publishWithCallback("normal");
+    ASSERT_TRUE(waitForQueueDepth(2));
+    auto high = publishWithCallback("high");
+    ASSERT_TRUE(waitForQueueDepth(3));
+    EXPECT_EQ(service->getQueueDepth(OutboundPriority::HIGH), 1);
+    EXPECT_EQ(service->getPeakQueueDepth(), 3);
+
+    auto order = std::vector<std::string>{};
+    EXPECT_CALL(*connectivityServiceMock, publish)
+      .Times(3)
+      .WillRepeatedly([&](const std::shared_ptr<wolkabout::Message>& message) {
+          std::lock_guard<std::mutex> lock{mutex};
+          order.emplace_back(message->getChannel());
+          return true;
+      });
+    service->start();
+
+    // The callbacks are told once the messages are out
+    EXPECT_TRUE(high.get());
+    EXPECT_TRUE(normal.get());
+    EXPECT_TRUE(low.get());
+    EXPECT_EQ(order, (std::vector<std::string>{"high", "normal", "low"}));
+    service->stop();
+    EXPECT_EQ(service->getPublishedCount(), 3);
+    EXPECT_EQ(service->getQueueDepth(), 0);
+}
+
+TEST_F(OutboundSchedulerTests, FullQueueDropsLowerPriority)
+{
+    createService(0, 0, 2);
+    EXPECT_CALL(*connectivityServiceMock, isConnected).WillRepeatedly(Return(true));
+    EXPECT_CALL(*connectivityServiceMock, publish).Times(0);
+    EXPECT_CALL(*protocolMock, getMessageType)
+      .WillOnce(Return(MessageType::FEED_VALUES))
+      .WillOnce(Return(MessageType::FEED_VALUES))
+      .WillOnce(Return(MessageType::FEED_VALUES))
+      .WillOnce(Return(MessageType::FIRMWARE_UPDATE_STATUS));
+
+    service->m_stopped = false;
+    auto first = publishWithCallback("first");
+    ASSERT_TRUE(waitForQueueDepth(1));
+    auto second = publishWithCallback("second");
+    ASSERT_TRUE(waitForQueueDepth(2));
+
+    // Another message of the same priority can not fit
+    EXPECT_FALSE(service->publish(makeMessage("third")));
+    EXPECT_EQ(service->getDroppedCount(), 1);
+
+    // But a message of a higher priority will replace the newest lower priority message, whose publisher is told that
+    // it was not sent
+    auto status = publishWithCallback("status");
+    EXPECT_FALSE(second.get());
+    EXPECT_EQ(service->getDroppedCount(), 2);
+    ASSERT_TRUE(waitForQueueDepth(2));
+    EXPECT_EQ(service->getQueueDepth(OutboundPriority::HIGH), 1);
+    EXPECT_EQ(service->m_queues[static_cast<std::size_t>(OutboundPriority::LOW)].front().message->getChannel(),
+              "first");
+
+    // Stopping gives up the messages that are still queued
+    service->stop();
+    EXPECT_FALSE(first.get());
+    EXPECT_FALSE(status.get());
+    EXPECT_EQ(service->getDroppedCount(), 4);
+    EXPECT_EQ(service->getQueueDepth(), 0);
+}
+
+TEST_F(OutboundSchedulerTests, MessageRateIsLimited)
+{
+    createService(10, 0, 100);
+    EXPECT_CALL(*connectivityServiceMock, isConnected).WillRepeatedly(Return(true));
+    EXPECT_CALL(*protocolMock, getMessageType).WillRepeatedly(Return(MessageType::FEED_VALUES));
+    EXPECT_CALL(*connectivityServiceMock, publish).Times(3).WillRepeatedly(Return(true));
+
+    // Drain the bucket so the rate becomes visible
+    service->m_messageBucket.tryConsume(10);
+    const auto start = std::chrono::steady_clock::now();
+    service->start();
+
+    auto results = std::vector<std::future<bool>>{};
+    for (auto i = 0; i < 3; ++i)
+        results.emplace_back(publishWithCallback("message"));
+    for (auto& result : results)
+        EXPECT_TRUE(result.get());
+    EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds{250});
+}
+
+TEST_F(OutboundSchedulerTests, FailedPublishIsReported)
+{
+    createService(0, 0, 10);
+    EXPECT_CALL(*connectivityServiceMock, isConnected).WillRepeatedly(Return(true));
+    EXPECT_CALL(*protocolMock, getMessageType).WillOnce(Return(MessageType::FIRMWARE_UPDATE_STATUS));
+
+    // The failure is handed back to the publisher, which keeps the data, instead of being retried in the queue
+    EXPECT_CALL(*connectivityServiceMock, publish).WillOnce(Return(false));
+    service->start();
+    EXPECT_FALSE(publishWithCallback("status").get());
+    service->stop();
+    EXPECT_EQ(service->getPublishedCount(), 0);
+    EXPECT_EQ(service->getQueueDepth(), 0);
+}
+
+TEST_F(OutboundSchedulerTests, PublishDoesNotWaitForTheDispatcher)
+{
+    createService(1, 0, 10);
+    EXPECT_CALL(*connectivityServiceMock, isConnected).WillRepeatedly(Return(true));
+    EXPECT_CALL(*protocolMock, getMessageType).WillRepeatedly(Return(MessageType::FILE_BINARY_REQUEST));
+    EXPECT_CALL(*connectivityServiceMock, publish).Times(0);
+
+    // With the bucket empty the dispatcher holds the message, but the publisher is not held with it
+    service->m_messageBucket.tryConsume(1);
+    service->start();
+    const auto start = std::chrono::steady_clock::now();
+    EXPECT_TRUE(service->publish(makeMessage("request")));
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds{500});
+    EXPECT_EQ(service->getQueueDepth(), 1);
+    service->stop();
+}
@@ -0,0 +1,163 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define private public
+#define protected public
+#include "wolk/protocol/CompressedWolkaboutDataProtocol.h"
+#include "wolk/protocol/PayloadCompressor.h"
+#undef private
+#undef protected
+
+#include "core/utilities/Logger.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+
+using namespace ::testing;
+using namespace wolkabout;
+using namespace wolkabout::connect;
+
+class PayloadCompressionTests : public ::testing::Test
+{
+public:
+    static void SetUpTestCase() { Logger::init(LogLevel::TRACE, Logger::Type::CONSOLE); }
+
+    static FeedValuesMessage makeFeedValues(std::size_t count)
+    {
+        auto readings = std::vector<Reading>{};
+        for (auto i = std::size_t{0}; i < count; ++i)
+            readings.emplace_back(FEED_REFERENCES[i % FEED_REFERENCES.size()], std::to_string(20 + i % 7),
+                                  1650000000000 + i * 1000);
+        return FeedValuesMessage{readings};
+    }
+
+    const std::string DEVICE_KEY = "TestDevice";
+
+    static const std::vector<std::string> FEED_REFERENCES;
+};
+
+const std::vector<std::string> PayloadCompressionTests::FEED_REFERENCES = {"T", "H", "P", "ACL", "SW"};
+
+TEST_F(PayloadCompressionTests, IsCompressed)
+{
+    auto compressed = std::string{};
+    ASSERT_TRUE(PayloadCompressor{}.compress("[{\"T\":20}]", compressed));
+    EXPECT_TRUE(PayloadCompressor::isCompressed(compressed));
+    EXPECT_FALSE(PayloadCompressor::isCompressed("[{\"T\":20}]"));
+    EXPECT_FALSE(PayloadCompressor::isCompressed("{}"));
+    EXPECT_FALSE(PayloadCompressor::isCompressed(""));
+}
+
+TEST_F(PayloadCompressionTests, RoundTripWithoutDictionary)
+{
+    const auto compressor = PayloadCompressor{};
+    EXPECT_EQ(compressor.getDictionaryId(), 0);
+
+    const auto payload = std::string(1000, 'a');
+    auto compressed = std::string{};
+    ASSERT_TRUE(compressor.compress(payload, compressed));
+    EXPECT_LT(compressed.size(), payload.size());
+
+    auto decompressed = std::string{};
+    ASSERT_TRUE(compressor.decompress(compressed, decompressed));
+    EXPECT_EQ(decompressed, payload);
+}
+
+TEST_F(PayloadCompressionTests, RoundTripWithDictionary)
+{
+    const auto compressor = PayloadCompressor{PayloadCompressor::makeDictionary(FEED_REFERENCES)};
+    EXPECT_NE(compressor.getDictionaryId(), 0);
+
+    // Make the payload larger than a single output chunk
+    auto payload = std::string{"["};
+    for (auto i = 0; i < 1000; ++i)
+        payload += "{\"T\":" + std::to_string(i) + ",\"timestamp\":" + std::to_string(1650000000000 + i) + "},";
+    payload += "]";
+
+    auto compressed = std::string{};
+    ASSERT_TRUE(compressor.compress(payload, compressed));
+    auto decompressed = std::string{};
+    ASSERT_TRUE(compressor.decompress(compressed, decompressed));
+    EXPECT_EQ(decompressed, payload);
+
+    // Without the dictionary, the payload can not be inflated
+    EXPECT_FALSE(PayloadCompressor{}.decompress(compressed, decompressed));
+    EXPECT_FALSE(PayloadCompressor{"other"}.decompress(compressed, decompressed));
+}
+
+TEST_F(PayloadCompressionTests, DecompressInvalidPayload)
+{
+    const auto compressor = PayloadCompressor{};
+    auto output = std::string{};
+    EXPECT_FALSE(compressor.decompress("[{\"T\":20}]", output));
+
+    auto compressed = std::string{};
+    ASSERT_TRUE(compressor.compress(std::string(1000, 'a'), compressed));
+    EXPECT_FALSE(compressor.decompress(compressed.substr(0, compressed.size() / 2), output));
+}
+
+TEST_F(PayloadCompressionTests, SmallPayloadIsNotCompressed)
+{
+    CompressedWolkaboutDataProtocol protocol{1000000, FEED_REFERENCES};
+    const auto plain = WolkaboutDataProtocol{}.makeOutboundMessage(DEVICE_KEY, makeFeedValues(10));
+    const auto message = protocol.makeOutboundMessage(DEVICE_KEY, makeFeedValues(10));
+    ASSERT_NE(message, nullptr);
+    EXPECT_EQ(message->getContent(), plain->getContent());
+    EXPECT_EQ(protocol.getCompressedBytes(), protocol.getUncompressedBytes());
+}
+
+TEST_F(PayloadCompressionTests, PayloadIsNotCompressedUntilThePlatformAcceptsIt)
+{
+    CompressedWolkaboutDataProtocol protocol{64, FEED_REFERENCES};
+    const auto channel = "p2d/" + DEVICE_KEY + "/payload_compression";
+    EXPECT_NE(std::find(protocol.getInboundChannelsForDevice(DEVICE_KEY).cbegin(),
+                        protocol.getInboundChannelsForDevice(DEVICE_KEY).cend(), channel),
+              protocol.getInboundChannelsForDevice(DEVICE_KEY).cend());
+    EXPECT_FALSE(PayloadCompressor::isCompressed(
+      protocol.makeOutboundMessage(DEVICE_KEY, makeFeedValues(200))->getContent()));
+
+    // A platform that holds a different dictionary can not inflate the payloads
+    const auto dictionaryId = std::to_string(protocol.getCompressor().getDictionaryId());
+    EXPECT_EQ(protocol.getMessageType(wolkabout::Message{"12345", channel}), MessageType::UNKNOWN);
+    EXPECT_FALSE(protocol.isCompressionAccepted(DEVICE_KEY));
+    EXPECT_EQ(protocol.getMessageType(wolkabout::Message{dictionaryId, channel}), MessageType::UNKNOWN);
+    EXPECT_TRUE(protocol.isCompressionAccepted(DEVICE_KEY));
+    EXPECT_TRUE(PayloadCompressor::isCompressed(
+      protocol.makeOutboundMessage(DEVICE_KEY, makeFeedValues(200))->getContent()));
+    EXPECT_FALSE(PayloadCompressor::isCompressed(
+      protocol.makeOutboundMessage("OtherDevice", makeFeedValues(200))->getContent()));
+
+    protocol.getMessageType(wolkabout::Message{"", channel});
+    EXPECT_FALSE(PayloadCompressor::isCompressed(
+      protocol.makeOutboundMessage(DEVICE_KEY, makeFeedValues(200))->getContent()));
+}
+
+TEST_F(PayloadCompressionTests, LargePayloadIsCompressed)
+{
+    CompressedWolkaboutDataProtocol protocol{64, FEED_REFERENCES};
+    protocol.setCompressionAccepted(DEVICE_KEY, true);
+    const auto plain = WolkaboutDataProtocol{}.makeOutboundMessage(DEVICE_KEY, makeFeedValues(200));
+    const auto message = protocol.makeOutboundMessage(DEVICE_KEY, makeFeedValues(200));
+    ASSERT_NE(message, nullptr);
+    EXPECT_EQ(message->getChannel(), plain->getChannel());
+    EXPECT_TRUE(PayloadCompressor::isCompressed(message->getContent()));
+    EXPECT_LT(protocol.getCompressedBytes(), protocol.getUncompressedBytes());
+
+    auto decompressed = std::string{};
+    ASSERT_TRUE(protocol.getCompressor().decompress(message->getContent(), decompressed));
+    EXPECT_EQ(decompressed, plain->getContent());
+}
@@ -0,0 +1,141 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define private public
+#define protected public
+#include "wolk/service/data/ReadingFilter.h"
+#undef private
+#undef protected
+
+#include "core/utilities/Logger.h"
+
+#include <gtest/gtest.h>
+
+using namespace wolkabout;
+using namespace wolkabout::connect;
+using namespace ::testing;
+
+class ReadingFilterTests : public ::testing::Test
+{
+public:
+    static void SetUpTestCase() { Logger::init(LogLevel::TRACE, Logger::Type::CONSOLE); }
+
+    static Reading makeReading(const std::string& value, std::uint64_t timestamp)
+    {
+        return Reading{"T", value, timestamp};
+    }
+};
+
+TEST_F(ReadingFilterTests, DefaultConfigurationKeepsEverything)
+{
+    auto filter = ReadingFilter{};
+    EXPECT_FALSE(filter.getConfiguration().isEnabled());
+    for (auto i = std::uint64_t{1}; i <= 10; ++i)
+        EXPECT_TRUE(filter.accept(makeReading("1", i), 0));
+    EXPECT_EQ(filter.getDroppedCount(), 0);
+}
+
+TEST_F(ReadingFilterTests, AbsoluteDeadband)
+{
+    auto configuration = ReadingFilterConfiguration{};
+    configuration.absoluteDeadband = 0.5;
+    auto filter = ReadingFilter{configuration};
+
+    EXPECT_TRUE(filter.accept(makeReading("20.0", 1), 0));
+    EXPECT_FALSE(filter.accept(makeReading("20.3", 2), 0));
+    // The drift is measured from the last kept reading, not from the last seen one
+    EXPECT_FALSE(filter.accept(makeReading("20.5", 3), 0));
+    EXPECT_TRUE(filter.accept(makeReading("20.6", 4), 0));
+    EXPECT_FALSE(filter.accept(makeReading("20.2", 5), 0));
+    EXPECT_TRUE(filter.accept(makeReading("19.9", 6), 0));
+    EXPECT_EQ(filter.getDroppedCount(), 3);
+}
+
+TEST_F(ReadingFilterTests, PercentDeadband)
+{
+    auto configuration = ReadingFilterConfiguration{};
+    configuration.percentDeadband = 10;
+    auto filter = ReadingFilter{configuration};
+
+    EXPECT_TRUE(filter.accept(makeReading("100", 1), 0));
+    EXPECT_FALSE(filter.accept(makeReading("109", 2), 0));
+    EXPECT_TRUE(filter.accept(makeReading("111", 3), 0));
+    EXPECT_FALSE(filter.accept(makeReading("101", 4), 0));
+}
+
+TEST_F(ReadingFilterTests, DeadbandOnMultiValueAndText)
+{
+    auto configuration = ReadingFilterConfiguration{};
+    configuration.absoluteDeadband = 1;
+    auto filter = ReadingFilter{configuration};
+
+    EXPECT_TRUE(filter.accept(Reading{"ACL", std::vector<std::string>{"1", "2", "3"}, 1}, 0));
+    EXPECT_FALSE(filter.accept(Reading{"ACL", std::vector<std::string>{"1.5", "2", "3.5"}, 2}, 0));
+    EXPECT_TRUE(filter.accept(Reading{"ACL", std::vector<std::string>{"1", "2", "4.5"}, 3}, 0));
+    EXPECT_TRUE(filter.accept(Reading{"ACL", std::vector<std::string>{"1", "2"}, 4}, 0));
+
+    // Text is compared as is
+    EXPECT_TRUE(filter.accept(makeReading("192.168.0.1", 5), 0));
+    EXPECT_FALSE(filter.accept(makeReading("192.168.0.1", 6), 0));
+    EXPECT_TRUE(filter.accept(makeReading("192.168.0.2", 7), 0));
+}
+
+TEST_F(ReadingFilterTests, PublishOnChange)
+{
+    auto configuration = ReadingFilterConfiguration{};
+    configuration.publishOnChange = true;
+    auto filter = ReadingFilter{configuration};
+
+    EXPECT_TRUE(filter.accept(makeReading("ON", 1), 0));
+    EXPECT_FALSE(filter.accept(makeReading("ON", 2), 0));
+    EXPECT_TRUE(filter.accept(makeReading("OFF", 3), 0));
+    // Without a deadband, numbers are compared exactly
+    EXPECT_TRUE(filter.accept(makeReading("1.0", 4), 0));
+    EXPECT_TRUE(filter.accept(makeReading("1.00001", 5), 0));
+}
+
+TEST_F(ReadingFilterTests, MinimumIntervalAndMaximumSilence)
+{
+    auto configuration = ReadingFilterConfiguration{};
+    configuration.publishOnChange = true;
+    configuration.minimumInterval = std::chrono::milliseconds{100};
+    configuration.maximumSilence = std::chrono::milliseconds{1000};
+    auto filter = ReadingFilter{configuration};
+
+    EXPECT_TRUE(filter.accept(makeReading("1", 1000), 0));
+    // Changed, but too soon
+    EXPECT_FALSE(filter.accept(makeReading("2", 1050), 0));
+    EXPECT_TRUE(filter.accept(makeReading("2", 1100), 0));
+    // Not changed, until the silence runs out
+    EXPECT_FALSE(filter.accept(makeReading("2", 1500), 0));
+    EXPECT_FALSE(filter.accept(makeReading("2", 2099), 0));
+    EXPECT_TRUE(filter.accept(makeReading("2", 2100), 0));
+}
+
+TEST_F(ReadingFilterTests, TimestampsAndOutOfOrderReadings)
+{
+    auto configuration = ReadingFilterConfiguration{};
+    configuration.minimumInterval = std::chrono::milliseconds{100};
+    auto filter = ReadingFilter{configuration};
+
+    // Readings without a timestamp use the time that is passed in
+    EXPECT_TRUE(filter.accept(makeReading("1", 0), 5000));
+    EXPECT_FALSE(filter.accept(makeReading("1", 0), 5010));
+    // Older readings are kept, but do not move the last kept reading
+    EXPECT_TRUE(filter.accept(makeReading("1", 4000), 0));
+    EXPECT_EQ(filter.m_lastTimestamp, 5000);
+    EXPECT_TRUE(filter.accept(makeReading("1", 5100), 0));
+}
@@ -0,0 +1,131 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define private public
+#define protected public
+#include "wolk/service/data/ReadingIngestQueue.h"
+#undef private
+#undef protected
+
+#include "core/utilities/Logger.h"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+
+using namespace wolkabout;
+using namespace wolkabout::connect;
+using namespace ::testing;
+
+class ReadingIngestQueueTests : public ::testing::Test
+{
+public:
+    static void SetUpTestCase() { Logger::init(LogLevel::TRACE, Logger::Type::CONSOLE); }
+};
+
+TEST_F(ReadingIngestQueueTests, CapacityIsRoundedUp)
+{
+    EXPECT_EQ(ReadingIngestQueue{0}.capacity(), 2u);
+    EXPECT_EQ(ReadingIngestQueue{5}.capacity(), 8u);
+    EXPECT_EQ(ReadingIngestQueue{1024}.capacity(), 1024u);
+}
+
+TEST_F(ReadingIngestQueueTests, ReadingsAreTakenInOrder)
+{
+    ReadingIngestQueue queue{4};
+    ASSERT_TRUE(queue.tryPush("D1", Reading{"T", std::string{"1"}, 1}));
+    ASSERT_TRUE(queue.tryPush("D2", Reading{"T", std::string{"2"}, 2}));
+
+    auto output = std::vector<IngestedReading>{};
+    EXPECT_EQ(queue.drain(output, 1), 1u);
+    EXPECT_EQ(queue.drain(output, 10), 1u);
+    EXPECT_EQ(queue.drain(output, 10), 0u);
+    ASSERT_EQ(output.size(), 2u);
+    EXPECT_EQ(output[0].deviceKey, "D1");
+    EXPECT_EQ(output[1].deviceKey, "D2");
+    EXPECT_EQ(output[1].reading.getStringValue(), "2");
+}
+
+TEST_F(ReadingIngestQueueTests, FullQueueRejectsUntilDrained)
+{
+    ReadingIngestQueue queue{2};
+    ASSERT_TRUE(queue.tryPush("D", Reading{"T", std::string{"1"}}));
+    ASSERT_TRUE(queue.tryPush("D", Reading{"T", std::string{"2"}}));
+    EXPECT_FALSE(queue.tryPush("D", Reading{"T", std::string{"3"}}));
+
+    // The slots are reused for the next laps
+    auto output = std::vector<IngestedReading>{};
+    for (auto lap = 0; lap < 3; ++lap)
+    {
+        EXPECT_EQ(queue.drain(output, 1), 1u);
+        EXPECT_TRUE(queue.tryPush("D", Reading{"T", std::to_string(4 + lap)}));
+    }
+    EXPECT_EQ(queue.drain(output, 10), 2u);
+    ASSERT_EQ(output.size(), 5u);
+    EXPECT_EQ(output.back().reading.getStringValue(), "6");
+}
+
+TEST_F(ReadingIngestQueueTests, ManyProducersLoseNothing)
+{
+    const auto producers = 8;
+    const auto readingsPerProducer = 20000;
+    ReadingIngestQueue queue{256};
+
+    auto threads = std::vector<std::thread>{};
+    for (auto producer = 0; producer < producers; ++producer)
+        threads.emplace_back([&queue, producer] {
+            for (auto i = 0; i < readingsPerProducer; ++i)
+                while (!queue.tryPush(std::to_string(producer), Reading{"T", std::to_string(i)}))
+                    std::this_thread::yield();
+        });
+
+    // Every producer's readings arrive, in the order that producer added them
+    auto next = std::vector<int>(producers, 0);
+    auto output = std::vector<IngestedReading>{};
+    auto received = 0;
+    while (received < producers * readingsPerProducer)
+    {
+        output.clear();
+        queue.drain(output, 64);
+        for (const auto& ingested : output)
+        {
+            auto& expected = next[static_cast<std::size_t>(std::stoi(ingested.deviceKey))];
+            ASSERT_EQ(ingested.reading.getStringValue(), std::to_string(expected));
+            ++expected;
+        }
+        received += static_cast<int>(output.size());
+    }
+    for (auto& thread : threads)
+        thread.join();
+    EXPECT_EQ(queue.drain(output, 1), 0u);
+}
+
+TEST_F(ReadingIngestQueueTests, ClosedQueueRefusesReadings)
+{
+    ReadingIngestQueue queue{4};
+    ASSERT_TRUE(queue.tryPush("D", Reading{"T", std::string{"1"}}));
+    EXPECT_FALSE(queue.isClosed());
+    EXPECT_FALSE(queue.isEmpty());
+
+    // The readings added before the queue was closed can still be taken
+    queue.close();
+    EXPECT_TRUE(queue.isClosed());
+    EXPECT_FALSE(queue.tryPush("D", Reading{"T", std::string{"2"}}));
+    auto output = std::vector<IngestedReading>{};
+    EXPECT_EQ(queue.drain(output, 10), 1u);
+    EXPECT_TRUE(queue.isEmpty());
+    EXPECT_EQ(output.front().reading.getStringValue(), "1");
+}
@@ -0,0 +1,148 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define private public
+#define protected public
+#include "wolk/service/registration_service/RegisteredDevicesCache.h"
+#undef private
+#undef protected
+
+#include "core/utilities/FileSystemUtils.h"
+#include "core/utilities/Logger.h"
+
+#include <gtest/gtest.h>
+
+using namespace wolkabout;
+using namespace wolkabout::connect;
+using namespace ::testing;
+
+class RegisteredDevicesCacheTests : public ::testing::Test
+{
+public:
+    static void SetUpTestCase() { Logger::init(LogLevel::TRACE, Logger::Type::CONSOLE); }
+
+    void TearDown() override
+    {
+        FileSystemUtils::deleteFile(CACHE_FILE);
+        FileSystemUtils::deleteFile(CACHE_FILE + ".tmp");
+    }
+
+    static std::string findId(const RegisteredDevicesCache& cache, const std::string& deviceKey)
+    {
+        auto device = RegisteredDeviceInformation{};
+        return cache.findByKey(deviceKey, device) ? device.deviceId : "<none>";
+    }
+
+    const std::string CACHE_FILE = "./.registered-devices-test";
+    const std::chrono::system_clock::time_point CURSOR{std::chrono::milliseconds{1650000000000}};
+};
+
+TEST_F(RegisteredDevicesCacheTests, MissingCacheLoadsEmpty)
+{
+    RegisteredDevicesCache cache{CACHE_FILE};
+    EXPECT_TRUE(cache.load());
+    EXPECT_EQ(cache.size(), 0);
+    EXPECT_EQ(cache.getCursor("Sensor"), std::chrono::system_clock::time_point{});
+    EXPECT_TRUE(cache.findByType("Sensor").empty());
+}
+
+TEST_F(RegisteredDevicesCacheTests, LookupsUseAllIndexes)
+{
+    RegisteredDevicesCache cache{CACHE_FILE};
+    ASSERT_TRUE(cache.load());
+    ASSERT_TRUE(cache.update("Sensor", {{"S2", "2", "ext-2"}, {"S1", "1", ""}}, CURSOR));
+    ASSERT_TRUE(cache.update("Actuator", {{"A1", "3", "ext-3"}}, CURSOR));
+
+    EXPECT_EQ(cache.size(), 3);
+    EXPECT_EQ(findId(cache, "S1"), "1");
+    auto device = RegisteredDeviceInformation{};
+    ASSERT_TRUE(cache.findByExternalId("ext-3", device));
+    EXPECT_EQ(device.deviceKey, "A1");
+    EXPECT_FALSE(cache.findByExternalId("", device));
+
+    const auto sensors = cache.findByType("Sensor");
+    ASSERT_EQ(sensors.size(), 2);
+    EXPECT_EQ(sensors.front().deviceKey, "S1");
+    EXPECT_EQ(sensors.back().deviceKey, "S2");
+    EXPECT_EQ(cache.getCursor("Actuator"), CURSOR);
+}
+
+TEST_F(RegisteredDevicesCacheTests, IncrementalUpdatesSurviveAReload)
+{
+    {
+        RegisteredDevicesCache cache{CACHE_FILE};
+        ASSERT_TRUE(cache.load());
+        ASSERT_TRUE(cache.update("Sensor", {{"S1", "1", "ext-1"}}, CURSOR));
+        ASSERT_TRUE(cache.update("Sensor", {{"S2", "2", ""}, {"S1", "1", "ext-new"}},
+                                 CURSOR + std::chrono::seconds{10}));
+        ASSERT_TRUE(cache.update("Tab\tand\nnewline\\", {{"K\t", "\n", "\\"}}, CURSOR));
+    }
+
+    RegisteredDevicesCache cache{CACHE_FILE};
+    ASSERT_TRUE(cache.load());
+    EXPECT_EQ(cache.size(), 3);
+    EXPECT_EQ(cache.findByType("Sensor").size(), 2);
+    EXPECT_EQ(cache.getCursor("Sensor"), CURSOR + std::chrono::seconds{10});
+    auto device = RegisteredDeviceInformation{};
+    EXPECT_FALSE(cache.findByExternalId("ext-1", device));
+    ASSERT_TRUE(cache.findByExternalId("ext-new", device));
+    EXPECT_EQ(device.deviceKey, "S1");
+    EXPECT_EQ(findId(cache, "K\t"), "\n");
+    EXPECT_EQ(cache.findByType("Tab\tand\nnewline\\").size(), 1);
+
+    // The stale records were dropped while loading
+    EXPECT_EQ(cache.m_recordCount, 5);
+}
+
+TEST_F(RegisteredDevicesCacheTests, IncompleteLastRecordIsIgnored)
+{
+    ASSERT_TRUE(FileSystemUtils::createFileWithContent(CACHE_FILE, "D\tSensor\tS1\t1\t\nC\tSensor\t16500"));
+
+    RegisteredDevicesCache cache{CACHE_FILE};
+    ASSERT_TRUE(cache.load());
+    EXPECT_EQ(findId(cache, "S1"), "1");
+    EXPECT_EQ(cache.getCursor("Sensor"), std::chrono::system_clock::time_point{});
+}
+
+TEST_F(RegisteredDevicesCacheTests, ClearEmptiesTheCache)
+{
+    {
+        RegisteredDevicesCache cache{CACHE_FILE};
+        ASSERT_TRUE(cache.load());
+        ASSERT_TRUE(cache.update("Sensor", {{"S1", "1", "ext-1"}}, CURSOR));
+        ASSERT_TRUE(cache.clear());
+        EXPECT_EQ(cache.size(), 0);
+    }
+
+    RegisteredDevicesCache cache{CACHE_FILE};
+    ASSERT_TRUE(cache.load());
+    EXPECT_EQ(cache.size(), 0);
+    EXPECT_EQ(cache.getCursor("Sensor"), std::chrono::system_clock::time_point{});
+}
+
+TEST_F(RegisteredDevicesCacheTests, RepeatedRefreshesAreCompacted)
+{
+    RegisteredDevicesCache cache{CACHE_FILE};
+    ASSERT_TRUE(cache.load());
+    for (auto i = 0; i < 100; ++i)
+        ASSERT_TRUE(cache.update("Sensor", {{"S1", std::to_string(i), ""}}, CURSOR + std::chrono::seconds{i}));
+
+    EXPECT_LT(cache.m_recordCount, 64);
+    RegisteredDevicesCache reloaded{CACHE_FILE};
+    ASSERT_TRUE(reloaded.load());
+    EXPECT_EQ(findId(reloaded, "S1"), "99");
+    EXPECT_EQ(reloaded.getCursor("Sensor"), CURSOR + std::chrono::seconds{99});
+}
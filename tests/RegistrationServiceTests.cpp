@@ -23,6 +23,7 @@
 #undef private
 #undef protected
 
+#include "core/utilities/FileSystemUtils.h"
 #include "core/utilities/Logger.h"
 #include "core/utilities/Timer.h"
 #include "tests/mocks/ConnectivityServiceMock.h"
@@ -32,7 +33,11 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <thread>
+#include <tuple>
 
 using namespace wolkabout::connect;
 using namespace ::testing;
@@ -122,6 +127,86 @@ TEST_F(RegistrationServiceTests, RegisterDevicesSentSuccessfully)
       service->registerDevices(DEVICE_KEY, {DeviceRegistrationData{"DeviceName", "DeviceKey", "", {}, {}, {}}}, {}));
 }
 
+TEST_F(RegistrationServiceTests, RegisterDevicesInBatchesEmptyVector)
+{
+    ASSERT_FALSE(service->registerDevicesInBatches(DEVICE_KEY, {}, {}));
+    ASSERT_FALSE(service->registerDevicesInBatches(DEVICE_KEY, {DeviceRegistrationData{}}, {}));
+}
+
+TEST_F(RegistrationServiceTests, RegisterDevicesInBatchesSplitsAndAggregates)
+{
+    auto devices = std::vector<DeviceRegistrationData>{};
+    for (auto i = 0; i < 5; ++i)
+        devices.emplace_back(DeviceRegistrationData{"Device", "D" + std::to_string(i), "", {}, {}, {}});
+
+    // Every device makes ten bytes of the payload, so the batches of three are split down to two devices
+    auto batches = std::vector<std::size_t>{};
+    EXPECT_CALL(registrationProtocolMock,
+                makeOutboundMessage(A<const std::string&>(), A<const DeviceRegistrationMessage&>()))
+      .WillRepeatedly([&](const std::string&, const DeviceRegistrationMessage& message) {
+          return std::unique_ptr<wolkabout::Message>{
+            new wolkabout::Message{std::string(message.getDevices().size() * 10, ' '), ""}};
+      });
+    EXPECT_CALL(*connectivityServiceMock, publish).WillRepeatedly([&](const std::shared_ptr<wolkabout::Message>& m) {
+        batches.emplace_back(m->getContent().size() / 10);
+        return true;
+    });
+
+    auto progress = std::vector<std::size_t>{};
+    auto success = std::vector<std::string>{};
+    auto failed = std::vector<std::string>{};
+    auto options = BulkRegistrationOptions{};
+    options.batchSize = 3;
+    options.maximumPayloadSize = 25;
+    options.inFlightBatches = 2;
+    ASSERT_TRUE(service->registerDevicesInBatches(
+      DEVICE_KEY, devices,
+      [&](const std::vector<std::string>& s, const std::vector<std::string>& f) {
+          success = s;
+          failed = f;
+      },
+      [&](std::size_t answered, std::size_t) { progress.emplace_back(answered); }, options));
+
+    // Only two batches are sent until one of them is answered
+    EXPECT_EQ(batches, (std::vector<std::size_t>{2, 2}));
+    auto respond = [&](std::vector<std::string> s, std::vector<std::string> f) {
+        auto names = s;
+        names.insert(names.end(), f.cbegin(), f.cend());
+        const auto digest = RegistrationService::makeRegistrationDigest(names);
+        const auto callback = service->m_deviceRegistrationCallbacks.at(digest).front().callback;
+        service->m_deviceRegistrationCallbacks.erase(digest);
+        callback(s, f);
+    };
+    respond({"D0", "D1"}, {});
+    EXPECT_EQ(batches, (std::vector<std::size_t>{2, 2, 1}));
+    respond({"D2"}, {"D3"});
+    respond({"D4"}, {});
+    EXPECT_EQ(batches.size(), 3u);
+    EXPECT_EQ(progress, (std::vector<std::size_t>{2, 4, 5}));
+    EXPECT_EQ(success, (std::vector<std::string>{"D0", "D1", "D2", "D4"}));
+    EXPECT_EQ(failed, (std::vector<std::string>{"D3"}));
+}
+
+TEST_F(RegistrationServiceTests, RegisterDevicesInBatchesFailedBatches)
+{
+    EXPECT_CALL(registrationProtocolMock,
+                makeOutboundMessage(A<const std::string&>(), A<const DeviceRegistrationMessage&>()))
+      .WillRepeatedly([&](const std::string&, const DeviceRegistrationMessage&) {
+          return std::unique_ptr<wolkabout::Message>{new wolkabout::Message{"", ""}};
+      });
+    EXPECT_CALL(*connectivityServiceMock, publish).WillRepeatedly(Return(false));
+
+    auto failed = std::vector<std::string>{};
+    auto options = BulkRegistrationOptions{};
+    options.batchSize = 1;
+    ASSERT_TRUE(service->registerDevicesInBatches(
+      DEVICE_KEY,
+      {DeviceRegistrationData{"Device", "D0", "", {}, {}, {}}, DeviceRegistrationData{"Device", "D1", "", {}, {}, {}}},
+      [&](const std::vector<std::string>&, const std::vector<std::string>& f) { failed = f; }, {}, options));
+    EXPECT_EQ(failed, (std::vector<std::string>{"D0", "D1"}));
+    EXPECT_TRUE(service->m_deviceRegistrationCallbacks.empty());
+}
+
 TEST_F(RegistrationServiceTests, RemoveDevicesEmptyVector)
 {
     // Call the service
@@ -198,6 +283,31 @@ TEST_F(RegistrationServiceTests, ObtainChildrenFailedToPublish)
 
     // Call the service (async)
     ASSERT_EQ(service->obtainChildrenAsync(DEVICE_KEY, [](const std::vector<std::string>&) {}), false);
+    EXPECT_TRUE(service->m_childrenRequests.empty());
+}
+
+TEST_F(RegistrationServiceTests, ObtainChildrenPublishesWithoutTheLock)
+{
+    EXPECT_CALL(registrationProtocolMock,
+                makeOutboundMessage(A<const std::string&>(), A<const ChildrenSynchronizationRequestMessage&>()))
+      .WillOnce(Return(ByMove(std::unique_ptr<wolkabout::Message>{new wolkabout::Message{"", ""}})))
+      .WillOnce(Return(ByMove(std::unique_ptr<wolkabout::Message>{new wolkabout::Message{"", ""}})));
+
+    // The one asking while the request is being published joins it, and is taken out with it once the publish fails
+    auto joined = false;
+    EXPECT_CALL(*connectivityServiceMock, publish)
+      .WillOnce([&](const std::shared_ptr<wolkabout::Message>&) {
+          joined = service->obtainChildrenAsync(DEVICE_KEY, [](const std::vector<std::string>&) {});
+          return false;
+      })
+      .WillOnce(Return(true));
+    ASSERT_FALSE(service->obtainChildrenAsync(DEVICE_KEY, [](const std::vector<std::string>&) {}));
+    EXPECT_TRUE(joined);
+    ASSERT_EQ(service->m_childrenRequests[DEVICE_KEY].callbacks.size(), 1u);
+
+    // The request is left expired, so the next one asking sends it out again for both
+    ASSERT_TRUE(service->obtainChildrenAsync(DEVICE_KEY, [](const std::vector<std::string>&) {}));
+    EXPECT_EQ(service->m_childrenRequests[DEVICE_KEY].callbacks.size(), 2u);
 }
 
 TEST_F(RegistrationServiceTests, ObtainChildrenNotCalled)
@@ -259,6 +369,77 @@ TEST_F(RegistrationServiceTests, ObtainChildrenAsyncSuccessful)
     ASSERT_TRUE(service->obtainChildrenAsync(DEVICE_KEY, [](const std::vector<std::string>&) {}));
 }
 
+TEST_F(RegistrationServiceTests, ObtainChildrenRequestsAreCoalesced)
+{
+    // Only one request is sent out, no matter how many ask
+    EXPECT_CALL(registrationProtocolMock,
+                makeOutboundMessage(A<const std::string&>(), A<const ChildrenSynchronizationRequestMessage&>()))
+      .WillOnce(Return(ByMove(std::unique_ptr<wolkabout::Message>{new wolkabout::Message{"", ""}})));
+    EXPECT_CALL(*connectivityServiceMock, publish).WillOnce(Return(true));
+
+    auto answered = std::make_shared<std::atomic_int>(0);
+    const auto callback = [answered](const std::vector<std::string>& children) {
+        if (children.size() == 2)
+            ++(*answered);
+    };
+    ASSERT_TRUE(service->obtainChildrenAsync(DEVICE_KEY, callback));
+    ASSERT_TRUE(service->obtainChildrenAsync(DEVICE_KEY, callback));
+    ASSERT_EQ(service->m_childrenRequests[DEVICE_KEY].callbacks.size(), 2u);
+
+    // And its response serves all of them
+    service->handleChildrenSynchronizationResponse(
+      DEVICE_KEY, std::unique_ptr<ChildrenSynchronizationResponseMessage>{
+                    new ChildrenSynchronizationResponseMessage{std::vector<std::string>{"C1", "C2"}}});
+    for (auto i = 0; i < 100 && *answered < 2; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds{1});
+    EXPECT_EQ(*answered, 2);
+    EXPECT_TRUE(service->m_childrenRequests.empty());
+}
+
+TEST_F(RegistrationServiceTests, ObtainChildrenServedFromTheCache)
+{
+    // The list that arrived is given out without asking the platform
+    EXPECT_CALL(registrationProtocolMock,
+                makeOutboundMessage(A<const std::string&>(), A<const ChildrenSynchronizationRequestMessage&>()))
+      .Times(0);
+    service->handleChildrenSynchronizationResponse(
+      DEVICE_KEY, std::unique_ptr<ChildrenSynchronizationResponseMessage>{
+                    new ChildrenSynchronizationResponseMessage{std::vector<std::string>{"C1"}}});
+    const auto children = service->obtainChildren(DEVICE_KEY, HUNDRED);
+    ASSERT_NE(children, nullptr);
+    EXPECT_EQ(children->size(), 1u);
+}
+
+TEST_F(RegistrationServiceTests, ObtainChildrenCacheInvalidated)
+{
+    EXPECT_CALL(registrationProtocolMock,
+                makeOutboundMessage(A<const std::string&>(), A<const ChildrenSynchronizationRequestMessage&>()))
+      .Times(2)
+      .WillRepeatedly([](const std::string&, const ChildrenSynchronizationRequestMessage&) {
+          return std::unique_ptr<wolkabout::Message>{new wolkabout::Message{"", ""}};
+      });
+    EXPECT_CALL(registrationProtocolMock,
+                makeOutboundMessage(A<const std::string&>(), A<const DeviceRemovalMessage&>()))
+      .WillOnce(Return(ByMove(std::unique_ptr<wolkabout::Message>{new wolkabout::Message{"", ""}})));
+    EXPECT_CALL(*connectivityServiceMock, publish).WillRepeatedly(Return(true));
+
+    // An expired list is asked for again
+    service->m_childrenCacheTimeToLive = std::chrono::milliseconds{0};
+    service->handleChildrenSynchronizationResponse(
+      DEVICE_KEY, std::unique_ptr<ChildrenSynchronizationResponseMessage>{
+                    new ChildrenSynchronizationResponseMessage{std::vector<std::string>{"C1"}}});
+    ASSERT_TRUE(service->obtainChildrenAsync(DEVICE_KEY, [](const std::vector<std::string>&) {}));
+
+    // And so is a list of a device whose children were removed
+    service->m_childrenCacheTimeToLive = std::chrono::minutes{1};
+    service->m_childrenRequests.clear();
+    service->handleChildrenSynchronizationResponse(
+      DEVICE_KEY, std::unique_ptr<ChildrenSynchronizationResponseMessage>{
+                    new ChildrenSynchronizationResponseMessage{std::vector<std::string>{"C1"}}});
+    ASSERT_TRUE(service->removeDevices(DEVICE_KEY, {"C1"}));
+    ASSERT_TRUE(service->obtainChildrenAsync(DEVICE_KEY, [](const std::vector<std::string>&) {}));
+}
+
 TEST_F(RegistrationServiceTests, DeviceRegistrationResponseNull)
 {
     ASSERT_NO_FATAL_FAILURE(service->handleDeviceRegistrationResponse(nullptr));
@@ -277,18 +458,70 @@ TEST_F(RegistrationServiceTests, DeviceRegistrationResponseFoundCallback)
     std::condition_variable conditionVariable;
 
     // insert the callback
-    service->m_deviceRegistrationCallbacks.emplace(
-      std::vector<std::string>{"D1", "D2", "D3"},
+    const auto digest = RegistrationService::makeRegistrationDigest({"D3", "D2", "D1"});
+    service->m_deviceRegistrationCallbacks[digest].emplace_back(RegistrationService::PendingRegistration{
+        {"D3", "D2", "D1"},
+        [&](const std::vector<std::string>& success, const std::vector<std::string>& failed) {
+            if (success.size() == 2 && failed.size() == 1)
+            {
+                called = true;
+                conditionVariable.notify_one();
+            }
+        },
+        std::chrono::steady_clock::now() + std::chrono::minutes{1}});
+
+    ASSERT_NO_FATAL_FAILURE(service->handleDeviceRegistrationResponse(
+      std::unique_ptr<DeviceRegistrationResponseMessage>{new DeviceRegistrationResponseMessage{{"D1", "D2"}, {"D3"}}}));
+    if (!called)
+    {
+        std::unique_lock<std::mutex> lock{mutex};
+        conditionVariable.wait_for(lock, std::chrono::milliseconds{100});
+    }
+    EXPECT_TRUE(called);
+}
+
+TEST_F(RegistrationServiceTests, RegistrationDigestIgnoresOrder)
+{
+    EXPECT_EQ(RegistrationService::makeRegistrationDigest({"D1", "D2", "D3"}),
+              RegistrationService::makeRegistrationDigest({"D3", "D1", "D2"}));
+
+    // Sets whose names pair up, or that concatenate the same, are still different
+    EXPECT_NE(RegistrationService::makeRegistrationDigest({"D1", "D1"}),
+              RegistrationService::makeRegistrationDigest({"D2", "D2"}));
+    EXPECT_NE(RegistrationService::makeRegistrationDigest({"D1", "D2"}),
+              RegistrationService::makeRegistrationDigest({"D1D2"}));
+}
+
+TEST_F(RegistrationServiceTests, DeviceRegistrationResponseUnmatched)
+{
+    ASSERT_NO_FATAL_FAILURE(service->handleDeviceRegistrationResponse(
+      std::unique_ptr<DeviceRegistrationResponseMessage>{new DeviceRegistrationResponseMessage{{"D1"}, {}}}));
+    EXPECT_EQ(service->getUnmatchedRegistrationResponseCount(), 1u);
+}
+
+TEST_F(RegistrationServiceTests, DeviceRegistrationExpires)
+{
+    EXPECT_CALL(*connectivityServiceMock, publish).WillOnce(Return(true));
+    service->m_deviceRegistrationTimeout = std::chrono::milliseconds{0};
+
+    std::atomic_bool called{false};
+    std::mutex mutex;
+    std::condition_variable conditionVariable;
+    ASSERT_TRUE(service->sendRegistration(
+      std::make_shared<wolkabout::Message>("", ""), {"D1"},
       [&](const std::vector<std::string>& success, const std::vector<std::string>& failed) {
-          if (success.size() == 2 && failed.size() == 1)
+          if (success.empty() && failed == std::vector<std::string>{"D1"})
           {
               called = true;
               conditionVariable.notify_one();
           }
-      });
+      }));
 
+    // The response that arrives late does not match, and the devices were reported as not registered
     ASSERT_NO_FATAL_FAILURE(service->handleDeviceRegistrationResponse(
-      std::unique_ptr<DeviceRegistrationResponseMessage>{new DeviceRegistrationResponseMessage{{"D1", "D2"}, {"D3"}}}));
+      std::unique_ptr<DeviceRegistrationResponseMessage>{new DeviceRegistrationResponseMessage{{"D1"}, {}}}));
+    EXPECT_EQ(service->getExpiredRegistrationCount(), 1u);
+    EXPECT_EQ(service->getUnmatchedRegistrationResponseCount(), 1u);
     if (!called)
     {
         std::unique_lock<std::mutex> lock{mutex};
@@ -297,6 +530,33 @@ TEST_F(RegistrationServiceTests, DeviceRegistrationResponseFoundCallback)
     EXPECT_TRUE(called);
 }
 
+TEST_F(RegistrationServiceTests, DeviceRegistrationExpiresWithoutAResponse)
+{
+    EXPECT_CALL(*connectivityServiceMock, publish).WillOnce(Return(true));
+    service->m_deviceRegistrationTimeout = std::chrono::milliseconds{0};
+    service->start();
+
+    std::atomic_bool called{false};
+    std::mutex mutex;
+    std::condition_variable conditionVariable;
+    ASSERT_TRUE(service->sendRegistration(
+      std::make_shared<wolkabout::Message>("", ""), {"D1"},
+      [&](const std::vector<std::string>&, const std::vector<std::string>& failed) {
+          if (failed == std::vector<std::string>{"D1"})
+          {
+              called = true;
+              conditionVariable.notify_one();
+          }
+      }));
+
+    // The timer reports the devices as not registered, without anything else happening
+    std::unique_lock<std::mutex> lock{mutex};
+    conditionVariable.wait_for(lock, std::chrono::seconds{3}, [&] { return called.load(); });
+    EXPECT_TRUE(called);
+    EXPECT_EQ(service->getExpiredRegistrationCount(), 1u);
+    service->stop();
+}
+
 TEST_F(RegistrationServiceTests, ReceiveMessageUnknownType)
 {
     EXPECT_CALL(registrationProtocolMock, getMessageType).WillOnce(Return(MessageType::UNKNOWN));
@@ -325,7 +585,7 @@ TEST_F(RegistrationServiceTests, ObtainDevicesAsyncNoCallback)
     ASSERT_EQ(
       service->obtainDevicesAsync(DEVICE_KEY, std::chrono::system_clock::now() - std::chrono::seconds(60), {}, {}, {}),
       false);
-    EXPECT_TRUE(service->m_deviceRegistrationResponses.empty());
+    EXPECT_TRUE(service->m_deviceQueries.empty());
 }
 
 TEST_F(RegistrationServiceTests, ObtainDevicesFailedToFormMessage)
@@ -340,13 +600,13 @@ TEST_F(RegistrationServiceTests, ObtainDevicesFailedToFormMessage)
     ASSERT_EQ(
       service->obtainDevices(DEVICE_KEY, std::chrono::system_clock::now() - std::chrono::seconds(60), {}, {}, HUNDRED),
       nullptr);
-    EXPECT_TRUE(service->m_deviceRegistrationResponses.empty());
+    EXPECT_TRUE(service->m_deviceQueries.empty());
 
     // Call the service (async)
     ASSERT_EQ(service->obtainDevicesAsync(DEVICE_KEY, std::chrono::system_clock::now() - std::chrono::seconds(60), {},
                                           {}, [&](const std::vector<RegisteredDeviceInformation>&) {}),
               false);
-    EXPECT_TRUE(service->m_deviceRegistrationResponses.empty());
+    EXPECT_TRUE(service->m_deviceQueries.empty());
 }
 
 TEST_F(RegistrationServiceTests, ObtainDevicesFailedToPublish)
@@ -362,13 +622,13 @@ TEST_F(RegistrationServiceTests, ObtainDevicesFailedToPublish)
     ASSERT_EQ(
       service->obtainDevices(DEVICE_KEY, std::chrono::system_clock::now() - std::chrono::seconds(60), {}, {}, HUNDRED),
       nullptr);
-    EXPECT_TRUE(service->m_deviceRegistrationResponses.empty());
+    EXPECT_TRUE(service->m_deviceQueries.empty());
 
     // Call the service (async)
     ASSERT_EQ(service->obtainDevicesAsync(DEVICE_KEY, std::chrono::system_clock::now() - std::chrono::seconds(60), {},
                                           {}, [&](const std::vector<RegisteredDeviceInformation>&) {}),
               false);
-    EXPECT_TRUE(service->m_deviceRegistrationResponses.empty());
+    EXPECT_TRUE(service->m_deviceQueries.empty());
 }
 
 TEST_F(RegistrationServiceTests, ObtainDevicesNothingGotPushed)
@@ -385,7 +645,7 @@ TEST_F(RegistrationServiceTests, ObtainDevicesNothingGotPushed)
     ASSERT_EQ(
       service->obtainDevices(DEVICE_KEY, std::chrono::system_clock::now() - std::chrono::seconds(60), {}, {}, timeout),
       nullptr);
-    EXPECT_TRUE(service->m_deviceRegistrationResponses.empty());
+    EXPECT_TRUE(service->m_deviceQueries.empty());
     const auto duration = std::chrono::system_clock::now() - start;
     const auto durationMs = std::chrono::duration_cast<std::chrono::milliseconds>(duration);
     LOG(INFO) << "Execution time: " << duration.count() << "μs (" << durationMs.count()
@@ -507,6 +767,212 @@ TEST_F(RegistrationServiceTests, ObtainDevicesPushedDevicesInArrayWithCallback)
     ASSERT_LT(durationMs.count(), tolerable.count());
 }
 
+TEST_F(RegistrationServiceTests, ObtainDevicesFutureFailedToPublish)
+{
+    EXPECT_CALL(registrationProtocolMock,
+                makeOutboundMessage(A<const std::string&>(), A<const RegisteredDevicesRequestMessage&>()))
+      .WillOnce(Return(ByMove(std::unique_ptr<wolkabout::Message>{new wolkabout::Message{"", ""}})));
+    EXPECT_CALL(*connectivityServiceMock, publish).WillOnce(Return(false));
+
+    auto future = service->obtainDevicesFuture(DEVICE_KEY, std::chrono::system_clock::now(), {}, {});
+    ASSERT_EQ(future.wait_for(std::chrono::seconds{0}), std::future_status::ready);
+    EXPECT_EQ(future.get(), nullptr);
+    EXPECT_TRUE(service->m_deviceQueries.empty());
+}
+
+TEST_F(RegistrationServiceTests, ObtainDevicesFutureConcurrentQueries)
+{
+    EXPECT_CALL(registrationProtocolMock,
+                makeOutboundMessage(A<const std::string&>(), A<const RegisteredDevicesRequestMessage&>()))
+      .Times(3)
+      .WillRepeatedly([](const std::string&, const RegisteredDevicesRequestMessage&) {
+          return std::unique_ptr<wolkabout::Message>{new wolkabout::Message{"", ""}};
+      });
+    EXPECT_CALL(*connectivityServiceMock, publish).WillRepeatedly(Return(true));
+
+    const auto timeFrom =
+      std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch());
+    auto first = service->obtainDevicesFuture(DEVICE_KEY, TimePoint(timeFrom), "First", {});
+    auto second = service->obtainDevicesFuture(DEVICE_KEY, TimePoint(timeFrom), "Second", {});
+    auto third = service->obtainDevicesFuture(DEVICE_KEY, TimePoint(timeFrom), "Third", {});
+
+    // Answer the second one only, and only it is woken up
+    service->handleRegisteredDevicesResponse(
+      std::unique_ptr<RegisteredDevicesResponseMessage>{new RegisteredDevicesResponseMessage{
+        timeFrom, "Second", "", std::vector<RegisteredDeviceInformation>{{"DeviceKey", "", ""}}}});
+    ASSERT_EQ(second.wait_for(std::chrono::seconds{0}), std::future_status::ready);
+    EXPECT_EQ(first.wait_for(std::chrono::seconds{0}), std::future_status::timeout);
+    const auto devices = second.get();
+    ASSERT_NE(devices, nullptr);
+    EXPECT_EQ(devices->size(), 1u);
+
+    // And the rest are released when the service stops
+    service->stop();
+    ASSERT_EQ(first.wait_for(std::chrono::seconds{0}), std::future_status::ready);
+    EXPECT_EQ(first.get(), nullptr);
+    EXPECT_EQ(third.get(), nullptr);
+}
+
+TEST_F(RegistrationServiceTests, ObtainDevicesResponseArrivesWhilePublishing)
+{
+    EXPECT_CALL(registrationProtocolMock,
+                makeOutboundMessage(A<const std::string&>(), A<const RegisteredDevicesRequestMessage&>()))
+      .WillOnce(Return(ByMove(std::unique_ptr<wolkabout::Message>{new wolkabout::Message{"", ""}})));
+
+    // The response is handled before the publish returns, so the query has to be waiting without the lock being held
+    const auto timeFrom =
+      std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch());
+    EXPECT_CALL(*connectivityServiceMock, publish).WillOnce([&](const std::shared_ptr<wolkabout::Message>&) {
+        service->handleRegisteredDevicesResponse(
+          std::unique_ptr<RegisteredDevicesResponseMessage>{new RegisteredDevicesResponseMessage{
+            timeFrom, "", "", std::vector<RegisteredDeviceInformation>{{"DeviceKey", "", ""}}}});
+        return true;
+    });
+
+    auto future = service->obtainDevicesFuture(DEVICE_KEY, TimePoint(timeFrom), {}, {});
+    ASSERT_EQ(future.wait_for(std::chrono::seconds{0}), std::future_status::ready);
+    const auto devices = future.get();
+    ASSERT_NE(devices, nullptr);
+    EXPECT_EQ(devices->size(), 1u);
+    EXPECT_TRUE(service->m_deviceQueries.empty());
+}
+
+TEST_F(RegistrationServiceTests, ObtainDevicesPagedInvalidArguments)
+{
+    const auto timestampFrom = std::chrono::system_clock::now();
+    EXPECT_FALSE(service->obtainDevicesPaged(DEVICE_KEY, timestampFrom, {}, {}, 100, {}));
+    EXPECT_FALSE(
+      service->obtainDevicesPaged(DEVICE_KEY, timestampFrom, {}, {}, 0, [](const RegisteredDevicesPage&) {}));
+    EXPECT_TRUE(service->m_deviceQueries.empty());
+}
+
+TEST_F(RegistrationServiceTests, DeliverDevicePagesSplitsTheResponse)
+{
+    auto pending = RegistrationService::PendingDeviceQuery{};
+    auto pages = std::vector<RegisteredDevicesPage>{};
+    auto devices = std::vector<const RegisteredDeviceInformation*>{};
+    pending.pageCallback = [&](const RegisteredDevicesPage& page) {
+        pages.emplace_back(page);
+        for (const auto& device : page)
+            devices.emplace_back(&device);
+    };
+    pending.pageSize = 2;
+    pending.cursor = TimePoint{std::chrono::milliseconds{1000}};
+
+    const auto response = RegisteredDevicesResponseMessage{
+      std::chrono::milliseconds{0}, "", "",
+      std::vector<RegisteredDeviceInformation>{
+        {"D1", "", ""}, {"D2", "", ""}, {"D3", "", ""}, {"D4", "", ""}, {"D5", "", ""}}};
+    RegistrationService::deliverDevicePages(pending, response);
+    ASSERT_EQ(pages.size(), 3u);
+    for (auto i = std::size_t{0}; i < pages.size(); ++i)
+    {
+        EXPECT_EQ(pages[i].index, i);
+        EXPECT_EQ(pages[i].last, i == 2);
+        EXPECT_EQ(pages[i].cursor, pending.cursor);
+    }
+    EXPECT_EQ(pages[0].size(), 2u);
+    EXPECT_EQ(pages[1].size(), 2u);
+    EXPECT_EQ(pages[2].size(), 1u);
+
+    // The pages are not copies, they point into the devices of the response
+    ASSERT_EQ(devices.size(), 5u);
+    for (auto i = std::size_t{0}; i < devices.size(); ++i)
+        EXPECT_EQ(devices[i], &response.getMatchingDevices()[i]);
+}
+
+TEST_F(RegistrationServiceTests, DeliverDevicePagesEmptyResponse)
+{
+    auto pending = RegistrationService::PendingDeviceQuery{};
+    auto pages = std::vector<RegisteredDevicesPage>{};
+    pending.pageCallback = [&](const RegisteredDevicesPage& page) { pages.emplace_back(page); };
+    pending.pageSize = 2;
+
+    const auto response = RegisteredDevicesResponseMessage{std::chrono::milliseconds{0}, "", "",
+                                                           std::vector<RegisteredDeviceInformation>{}};
+    RegistrationService::deliverDevicePages(pending, response);
+    ASSERT_EQ(pages.size(), 1u);
+    EXPECT_TRUE(pages.front().empty());
+    EXPECT_TRUE(pages.front().last);
+}
+
+TEST_F(RegistrationServiceTests, ObtainDevicesPagedHappyFlow)
+{
+    EXPECT_CALL(registrationProtocolMock,
+                makeOutboundMessage(A<const std::string&>(), A<const RegisteredDevicesRequestMessage&>()))
+      .WillOnce(Return(ByMove(std::unique_ptr<wolkabout::Message>{new wolkabout::Message{"", ""}})));
+    EXPECT_CALL(*connectivityServiceMock, publish).WillOnce(Return(true));
+
+    // The cursor is taken when the query is sent out
+    const auto timeFrom =
+      std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch());
+    const auto sent = std::chrono::system_clock::now() - std::chrono::milliseconds{1};
+    auto lastPage = std::make_shared<std::promise<std::tuple<std::size_t, std::vector<std::string>, TimePoint>>>();
+    ASSERT_TRUE(service->obtainDevicesPaged(DEVICE_KEY, TimePoint(timeFrom), {}, {}, 1,
+                                            [lastPage](const RegisteredDevicesPage& page) {
+                                                // The page is only valid while the callback runs
+                                                auto keys = std::vector<std::string>{};
+                                                for (const auto& device : page)
+                                                    keys.emplace_back(device.deviceKey);
+                                                if (page.last)
+                                                    lastPage->set_value(std::make_tuple(page.index, keys, page.cursor));
+                                            }));
+
+    service->handleRegisteredDevicesResponse(
+      std::unique_ptr<RegisteredDevicesResponseMessage>{new RegisteredDevicesResponseMessage{
+        timeFrom, "", "", std::vector<RegisteredDeviceInformation>{{"D1", "", ""}, {"D2", "", ""}}}});
+    auto future = lastPage->get_future();
+    ASSERT_EQ(future.wait_for(std::chrono::milliseconds{100}), std::future_status::ready);
+    const auto page = future.get();
+    EXPECT_EQ(std::get<0>(page), 1u);
+    EXPECT_EQ(std::get<1>(page), std::vector<std::string>{"D2"});
+    EXPECT_GE(std::get<2>(page), sent);
+    EXPECT_TRUE(service->m_deviceQueries.empty());
+}
+
+TEST_F(RegistrationServiceTests, RefreshDevicesCacheNoCache)
+{
+    EXPECT_CALL(registrationProtocolMock,
+                makeOutboundMessage(A<const std::string&>(), A<const RegisteredDevicesRequestMessage&>()))
+      .Times(0);
+    EXPECT_FALSE(service->refreshDevicesCache(DEVICE_KEY, "Sensor"));
+    EXPECT_EQ(service->getDevicesCache(), nullptr);
+}
+
+TEST_F(RegistrationServiceTests, RefreshDevicesCacheMergesTheDevices)
+{
+    const auto cacheFile = std::string{"./.registered-devices-service-test"};
+    service->m_devicesCache = std::make_shared<RegisteredDevicesCache>(cacheFile);
+    ASSERT_TRUE(service->m_devicesCache->load());
+
+    // The first refresh obtains all the devices
+    EXPECT_CALL(registrationProtocolMock,
+                makeOutboundMessage(A<const std::string&>(), A<const RegisteredDevicesRequestMessage&>()))
+      .WillOnce([](const std::string&, const RegisteredDevicesRequestMessage& request) {
+          EXPECT_EQ(request.getTimestampFrom().count(), 0);
+          EXPECT_EQ(request.getDeviceType(), "Sensor");
+          return std::unique_ptr<wolkabout::Message>{new wolkabout::Message{"", ""}};
+      });
+    EXPECT_CALL(*connectivityServiceMock, publish).WillOnce(Return(true));
+    const auto sent = std::chrono::system_clock::now() - std::chrono::milliseconds{1};
+    auto refreshed = std::make_shared<std::promise<bool>>();
+    ASSERT_TRUE(
+      service->refreshDevicesCache(DEVICE_KEY, "Sensor", [refreshed](bool stored) { refreshed->set_value(stored); }));
+
+    service->handleRegisteredDevicesResponse(
+      std::unique_ptr<RegisteredDevicesResponseMessage>{new RegisteredDevicesResponseMessage{
+        std::chrono::milliseconds{0}, "Sensor", "",
+        std::vector<RegisteredDeviceInformation>{{"S1", "", ""}, {"S2", "", ""}}}});
+    auto future = refreshed->get_future();
+    ASSERT_EQ(future.wait_for(std::chrono::milliseconds{100}), std::future_status::ready);
+    EXPECT_TRUE(future.get());
+    EXPECT_EQ(service->getDevicesCache()->findByType("Sensor").size(), 2u);
+    EXPECT_GE(service->getDevicesCache()->getCursor("Sensor"), sent);
+
+    service.reset();
+    FileSystemUtils::deleteFile(cacheFile);
+}
+
 TEST_F(RegistrationServiceTests, ReceivedMessageFailsToParse)
 {
     // Make the protocol fail to parse the message
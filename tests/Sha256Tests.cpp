@@ -0,0 +1,70 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wolk/utilities/Sha256.h"
+
+#include "core/utilities/FileSystemUtils.h"
+#include "core/utilities/Logger.h"
+
+#include <gtest/gtest.h>
+
+using namespace wolkabout;
+using namespace wolkabout::connect;
+using namespace ::testing;
+
+class Sha256Tests : public ::testing::Test
+{
+public:
+    static void SetUpTestCase() { Logger::init(LogLevel::TRACE, Logger::Type::CONSOLE); }
+
+    const std::string FILE_NAME = "./sha256_test_file";
+
+    void TearDown() override { FileSystemUtils::deleteFile(FILE_NAME); }
+};
+
+TEST_F(Sha256Tests, KnownDigests)
+{
+    auto hash = Sha256{};
+    EXPECT_EQ(Sha256::toHex(hash.digest()), "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+
+    hash.update("abc");
+    EXPECT_EQ(Sha256::toHex(hash.digest()), "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+
+    hash.update("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq");
+    EXPECT_EQ(Sha256::toHex(hash.digest()), "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+}
+
+TEST_F(Sha256Tests, UpdatesInPiecesMatchOneUpdate)
+{
+    const auto data = std::string(1000, 'a');
+    auto whole = Sha256{};
+    whole.update(data);
+
+    auto pieces = Sha256{};
+    for (auto i = std::size_t{0}; i < data.size(); i += 7)
+        pieces.update(data.substr(i, 7));
+    EXPECT_EQ(pieces.digest(), whole.digest());
+}
+
+TEST_F(Sha256Tests, HashFile)
+{
+    auto digest = Sha256::Digest{};
+    EXPECT_FALSE(Sha256::hashFile(FILE_NAME, digest));
+
+    ASSERT_TRUE(FileSystemUtils::createFileWithContent(FILE_NAME, "abc"));
+    ASSERT_TRUE(Sha256::hashFile(FILE_NAME, digest));
+    EXPECT_EQ(Sha256::toHex(digest), "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+}
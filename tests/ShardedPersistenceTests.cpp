@@ -0,0 +1,122 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define private public
+#define protected public
+#include "wolk/persistence/ShardedPersistence.h"
+#undef private
+#undef protected
+
+#include "core/utilities/Logger.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <thread>
+
+using namespace wolkabout;
+using namespace wolkabout::connect;
+using namespace ::testing;
+
+class ShardedPersistenceTests : public ::testing::Test
+{
+public:
+    static void SetUpTestCase() { Logger::init(LogLevel::TRACE, Logger::Type::CONSOLE); }
+
+    ShardedPersistence persistence{8};
+};
+
+TEST_F(ShardedPersistenceTests, ShardCount)
+{
+    EXPECT_EQ(persistence.getShardCount(), 8u);
+    EXPECT_GE(ShardedPersistence{}.getShardCount(), 1u);
+}
+
+TEST_F(ShardedPersistenceTests, KeysOfADeviceShareAShard)
+{
+    const auto shard = &persistence.getShard("Device");
+    EXPECT_EQ(&persistence.getShard("Device+T"), shard);
+    EXPECT_EQ(&persistence.getShard("Device+H"), shard);
+    EXPECT_EQ(&persistence.getShard("Device+FIRMWARE_VERSION"), shard);
+}
+
+TEST_F(ShardedPersistenceTests, ReadingsAreRoutedAndKeysMerged)
+{
+    for (auto i = 0; i < 32; ++i)
+        EXPECT_TRUE(persistence.putReading("Device" + std::to_string(i) + "+T", Reading{"T", std::to_string(i)}));
+    EXPECT_TRUE(persistence.putReading("Device3+T", Reading{"T", std::string{"again"}}));
+
+    const auto keys = persistence.getReadingsKeys();
+    ASSERT_EQ(keys.size(), 32u);
+    EXPECT_TRUE(std::is_sorted(keys.cbegin(), keys.cend()));
+    EXPECT_EQ(persistence.getReadings("Device3+T", 10).size(), 2u);
+
+    // More than one shard is in use
+    auto usedShards = std::size_t{0};
+    for (const auto& shard : persistence.m_shards)
+        usedShards += shard->getReadingsKeys().empty() ? 0 : 1;
+    EXPECT_GT(usedShards, 1u);
+
+    persistence.removeReadings("Device3+T", 2);
+    EXPECT_TRUE(persistence.getReadings("Device3+T", 10).empty());
+}
+
+TEST_F(ShardedPersistenceTests, AttributesAndParameters)
+{
+    for (auto i = 0; i < 16; ++i)
+    {
+        const auto deviceKey = "Device" + std::to_string(i);
+        persistence.putAttribute(deviceKey + "+A", std::make_shared<Attribute>("A", DataType::STRING, deviceKey));
+        persistence.putParameter(deviceKey + "+FIRMWARE_VERSION", {ParameterName::FIRMWARE_VERSION, deviceKey});
+    }
+
+    EXPECT_EQ(persistence.getAttributes().size(), 16u);
+    EXPECT_EQ(persistence.getAttributeKeys().size(), 16u);
+    ASSERT_NE(persistence.getAttributeUnderKey("Device5+A"), nullptr);
+    EXPECT_EQ(persistence.getAttributeUnderKey("Device5+A")->getValue(), "Device5");
+    EXPECT_EQ(persistence.getParameters().size(), 16u);
+    EXPECT_EQ(persistence.getParameterKeys().size(), 16u);
+    EXPECT_EQ(persistence.getParameterForKey("Device7+FIRMWARE_VERSION").second, "Device7");
+
+    persistence.removeAttributes("Device5+A");
+    persistence.removeParameters("Device7+FIRMWARE_VERSION");
+    EXPECT_EQ(persistence.getAttributeUnderKey("Device5+A"), nullptr);
+    EXPECT_EQ(persistence.getParameters().size(), 15u);
+
+    persistence.removeAttributes();
+    persistence.removeParameters();
+    EXPECT_TRUE(persistence.isEmpty());
+}
+
+TEST_F(ShardedPersistenceTests, ConcurrentProducersLoseNothing)
+{
+    const auto threadCount = 8;
+    const auto readingCount = 2000;
+    auto threads = std::vector<std::thread>{};
+    for (auto i = 0; i < threadCount; ++i)
+        threads.emplace_back([&, i] {
+            const auto key = "Device" + std::to_string(i) + "+T";
+            for (auto j = 0; j < readingCount; ++j)
+                persistence.putReading(key, Reading{"T", std::to_string(j)});
+        });
+    for (auto& thread : threads)
+        thread.join();
+
+    EXPECT_EQ(persistence.getReadingsKeys().size(), static_cast<std::size_t>(threadCount));
+    for (auto i = 0; i < threadCount; ++i)
+        EXPECT_EQ(persistence.getReadings("Device" + std::to_string(i) + "+T", readingCount + 1).size(),
+                  static_cast<std::size_t>(readingCount));
+}
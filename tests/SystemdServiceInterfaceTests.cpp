@@ -0,0 +1,96 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define private public
+#define protected public
+#include "wolk/service/firmware_update/debian/systemd/SystemdServiceInterface.h"
+#undef private
+#undef protected
+
+#include "core/utilities/Logger.h"
+
+#include <gtest/gtest.h>
+
+#include <map>
+
+using namespace wolkabout;
+using namespace wolkabout::connect;
+using namespace ::testing;
+
+class SystemdServiceInterfaceTests : public ::testing::Test
+{
+public:
+    static void SetUpTestCase() { Logger::init(LogLevel::TRACE, Logger::Type::CONSOLE); }
+
+    // Makes the parameters of a `PropertiesChanged` signal, with every property holding a string
+    static GVariant* makeSignal(const std::string& interfaceName, const std::map<std::string, std::string>& properties)
+    {
+        GVariantBuilder changedProperties;
+        g_variant_builder_init(&changedProperties, G_VARIANT_TYPE("a{sv}"));
+        for (const auto& property : properties)
+            g_variant_builder_add(&changedProperties, "{sv}", property.first.c_str(),
+                                  g_variant_new_string(property.second.c_str()));
+        GVariantBuilder invalidatedProperties;
+        g_variant_builder_init(&invalidatedProperties, G_VARIANT_TYPE("as"));
+        g_variant_builder_add(&invalidatedProperties, "s", "Job");
+        return g_variant_ref_sink(g_variant_new("(sa{sv}as)", interfaceName.c_str(), &changedProperties,
+                                                &invalidatedProperties));
+    }
+
+    void receive(GVariant* signal)
+    {
+        service.handlePropertiesChanged(UNIT, signal);
+        g_variant_unref(signal);
+    }
+
+    SystemdServiceInterface service;
+
+    const std::string UNIT = "/org/freedesktop/systemd1/unit/wolk_2eservice";
+    const std::string UNIT_INTERFACE = "org.freedesktop.systemd1.Unit";
+};
+
+TEST_F(SystemdServiceInterfaceTests, PropertiesChangedRecordsTheActiveState)
+{
+    receive(makeSignal(UNIT_INTERFACE, {{"ActiveState", "deactivating"}, {"SubState", "stop-sigterm"}}));
+    EXPECT_EQ(service.m_serviceStates.get(UNIT), UnitActiveState::Deactivating);
+    EXPECT_EQ(service.m_serviceStates.getGeneration(UNIT), 1u);
+
+    receive(makeSignal(UNIT_INTERFACE, {{"ActiveState", "active"}}));
+    EXPECT_EQ(service.m_serviceStates.get(UNIT), UnitActiveState::Active);
+    EXPECT_EQ(service.m_serviceStates.getGeneration(UNIT), 2u);
+}
+
+TEST_F(SystemdServiceInterfaceTests, PropertiesChangedWithoutTheActiveStateAreIgnored)
+{
+    receive(makeSignal(UNIT_INTERFACE, {{"SubState", "running"}}));
+    receive(makeSignal("org.freedesktop.systemd1.Service", {{"ActiveState", "failed"}}));
+    EXPECT_EQ(service.m_serviceStates.get(UNIT), UnitActiveState::Unknown);
+    EXPECT_EQ(service.m_serviceStates.getGeneration(UNIT), 0u);
+}
+
+TEST_F(SystemdServiceInterfaceTests, PropertiesChangedFinishARestart)
+{
+    receive(makeSignal(UNIT_INTERFACE, {{"ActiveState", "active"}}));
+    const auto generation = service.m_serviceStates.getGeneration(UNIT);
+
+    auto state = UnitActiveState::Unknown;
+    receive(makeSignal(UNIT_INTERFACE, {{"ActiveState", "active"}}));
+    EXPECT_FALSE(service.m_serviceStates.waitUntilRestarted(UNIT, generation, std::chrono::milliseconds{10}, state));
+    receive(makeSignal(UNIT_INTERFACE, {{"ActiveState", "activating"}}));
+    receive(makeSignal(UNIT_INTERFACE, {{"ActiveState", "active"}}));
+    EXPECT_TRUE(service.m_serviceStates.waitUntilRestarted(UNIT, generation, std::chrono::milliseconds{10}, state));
+    EXPECT_EQ(state, UnitActiveState::Active);
+}
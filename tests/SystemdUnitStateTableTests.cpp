@@ -0,0 +1,122 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define private public
+#define protected public
+#include "wolk/service/firmware_update/debian/systemd/SystemdUnitStateTable.h"
+#undef private
+#undef protected
+
+#include "core/utilities/Logger.h"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+
+using namespace wolkabout;
+using namespace wolkabout::connect;
+using namespace ::testing;
+
+class SystemdUnitStateTableTests : public ::testing::Test
+{
+public:
+    static void SetUpTestCase() { Logger::init(LogLevel::TRACE, Logger::Type::CONSOLE); }
+
+    SystemdUnitStateTable table;
+
+    const std::string UNIT = "/org/freedesktop/systemd1/unit/wolk_2eservice";
+};
+
+TEST_F(SystemdUnitStateTableTests, StateStrings)
+{
+    for (const auto& state : {UnitActiveState::Active, UnitActiveState::Reloading, UnitActiveState::Inactive,
+                              UnitActiveState::Failed, UnitActiveState::Activating, UnitActiveState::Deactivating})
+        EXPECT_EQ(unitActiveStateFromString(toString(state)), state);
+    EXPECT_EQ(unitActiveStateFromString("maintenance"), UnitActiveState::Unknown);
+}
+
+TEST_F(SystemdUnitStateTableTests, UpdateCountsGenerations)
+{
+    EXPECT_EQ(table.get(UNIT), UnitActiveState::Unknown);
+    EXPECT_EQ(table.getGeneration(UNIT), 0u);
+
+    table.update(UNIT, UnitActiveState::Active);
+    table.update(UNIT, UnitActiveState::Deactivating);
+    EXPECT_EQ(table.get(UNIT), UnitActiveState::Deactivating);
+    EXPECT_EQ(table.getGeneration(UNIT), 2u);
+}
+
+TEST_F(SystemdUnitStateTableTests, WaitIgnoresStatesBeforeTheGeneration)
+{
+    table.update(UNIT, UnitActiveState::Active);
+    const auto generation = table.getGeneration(UNIT);
+
+    EXPECT_EQ(table.waitUntilSettled(UNIT, generation, std::chrono::milliseconds{10}), UnitActiveState::Active);
+    EXPECT_EQ(table.getGeneration(UNIT), generation);
+}
+
+TEST_F(SystemdUnitStateTableTests, WaitReturnsWhenTheUnitSettles)
+{
+    table.update(UNIT, UnitActiveState::Active);
+    const auto generation = table.getGeneration(UNIT);
+
+    auto signals = std::thread{[&] {
+        for (const auto& state : {UnitActiveState::Deactivating, UnitActiveState::Inactive,
+                                  UnitActiveState::Activating, UnitActiveState::Failed})
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds{1});
+            table.update(UNIT, state);
+        }
+    }};
+    EXPECT_EQ(table.waitUntilSettled(UNIT, generation, std::chrono::seconds{1}), UnitActiveState::Failed);
+    signals.join();
+}
+
+TEST_F(SystemdUnitStateTableTests, WaitTimesOutOnUnsettledUnit)
+{
+    table.update(UNIT, UnitActiveState::Activating);
+
+    EXPECT_EQ(table.waitUntilSettled(UNIT, 0, std::chrono::milliseconds{10}), UnitActiveState::Activating);
+    EXPECT_EQ(table.waitUntilSettled("/other", 0, std::chrono::milliseconds{10}), UnitActiveState::Unknown);
+}
+
+TEST_F(SystemdUnitStateTableTests, RestartNeedsTheUnitToLeaveTheActiveState)
+{
+    table.update(UNIT, UnitActiveState::Active);
+    const auto generation = table.getGeneration(UNIT);
+
+    // A signal that only repeats the state from before the restart does not finish it
+    auto state = UnitActiveState::Unknown;
+    table.update(UNIT, UnitActiveState::Active);
+    EXPECT_FALSE(table.waitUntilRestarted(UNIT, generation, std::chrono::milliseconds{10}, state));
+    EXPECT_EQ(state, UnitActiveState::Active);
+
+    auto signals = std::thread{[&] {
+        for (const auto& next : {UnitActiveState::Deactivating, UnitActiveState::Activating, UnitActiveState::Active})
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds{1});
+            table.update(UNIT, next);
+        }
+    }};
+    EXPECT_TRUE(table.waitUntilRestarted(UNIT, generation, std::chrono::seconds{1}, state));
+    EXPECT_EQ(state, UnitActiveState::Active);
+    signals.join();
+
+    // A failure finishes it right away
+    table.update(UNIT, UnitActiveState::Failed);
+    EXPECT_TRUE(table.waitUntilRestarted(UNIT, table.getGeneration(UNIT) - 1, std::chrono::milliseconds{10}, state));
+    EXPECT_EQ(state, UnitActiveState::Failed);
+}
@@ -0,0 +1,353 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define private public
+#define protected public
+#include "wolk/persistence/TieredPersistence.h"
+#undef private
+#undef protected
+
+#include "core/utilities/FileSystemUtils.h"
+#include "core/utilities/Logger.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <future>
+
+using namespace wolkabout;
+using namespace wolkabout::connect;
+using namespace ::testing;
+
+class TieredPersistenceTests : public ::testing::Test
+{
+public:
+    static void SetUpTestCase() { Logger::init(LogLevel::TRACE, Logger::Type::CONSOLE); }
+
+    void TearDown() override
+    {
+        for (const auto& file : FileSystemUtils::listFiles(DIRECTORY))
+            FileSystemUtils::deleteFile(FileSystemUtils::composePath(file, DIRECTORY));
+        std::remove(DIRECTORY.c_str());
+        for (const auto& file : FileSystemUtils::listFiles(TWIN_DIRECTORY))
+            FileSystemUtils::deleteFile(FileSystemUtils::composePath(file, TWIN_DIRECTORY));
+        std::remove(TWIN_DIRECTORY.c_str());
+    }
+
+    TieredPersistenceConfiguration makeConfiguration(std::uint64_t memoryBudget, std::uint64_t diskBudget,
+                                                     ReadingDropPolicy dropPolicy = ReadingDropPolicy::OldestFirst)
+    {
+        auto configuration = TieredPersistenceConfiguration{};
+        configuration.memoryBudget = memoryBudget;
+        configuration.diskBudget = diskBudget;
+        configuration.segmentDirectory = DIRECTORY;
+        configuration.dropPolicy = dropPolicy;
+        return configuration;
+    }
+
+    // Waits for every spill, so the segments are the same as if the readings were spilled right away
+    static void putReadings(TieredPersistence& persistence, const std::string& key, std::uint64_t from,
+                            std::uint64_t count)
+    {
+        for (auto i = from; i < from + count; ++i)
+        {
+            persistence.putReading(key, Reading{"T", std::to_string(i), 1650000000000 + i * 1000});
+            persistence.flush();
+        }
+    }
+
+    // Reads a batch, puts more readings so the drop policy runs meanwhile, and removes the batch. Gives back what is
+    // left, and what a twin persistence had right before the removal.
+    void removeAfterDrops(ReadingDropPolicy dropPolicy, std::vector<std::string>& left,
+                          std::vector<std::string>& beforeRemoval, std::uint64_t& lastGivenOut)
+    {
+        auto configuration = makeConfiguration(2048, 4096, dropPolicy);
+        auto twinConfiguration = configuration;
+        twinConfiguration.segmentDirectory = TWIN_DIRECTORY;
+        TieredPersistence persistence{configuration};
+        TieredPersistence twin{twinConfiguration};
+        for (auto* target : {&persistence, &twin})
+        {
+            putReadings(*target, KEY, 0, 1000);
+            lastGivenOut = std::stoull(target->getReadings(KEY, 50).back()->getStringValue());
+            putReadings(*target, KEY, 1000, 50);
+        }
+
+        persistence.removeReadings(KEY, 50);
+        for (const auto& reading : persistence.getReadings(KEY, 10000))
+            left.emplace_back(reading->getStringValue());
+        for (const auto& reading : twin.getReadings(KEY, 10000))
+            beforeRemoval.emplace_back(reading->getStringValue());
+    }
+
+    const std::string DIRECTORY = "./.tiered-persistence-test";
+    const std::string TWIN_DIRECTORY = "./.tiered-persistence-test-twin";
+    const std::string KEY = "Device+T";
+};
+
+TEST_F(TieredPersistenceTests, ReadingsUnderTheBudgetStayInMemory)
+{
+    TieredPersistence persistence{makeConfiguration(1024 * 1024, 1024 * 1024)};
+    putReadings(persistence, KEY, 0, 100);
+
+    const auto usage = persistence.getUsage();
+    EXPECT_EQ(usage.memoryReadings, 100u);
+    EXPECT_EQ(usage.segmentCount, 0u);
+    EXPECT_TRUE(FileSystemUtils::listFiles(DIRECTORY).empty());
+    EXPECT_EQ(persistence.getReadings(KEY, 1000).size(), 100u);
+
+    persistence.removeReadings(KEY, 100);
+    EXPECT_TRUE(persistence.isEmpty());
+    EXPECT_EQ(persistence.getUsage().memoryBytes, 0u);
+}
+
+TEST_F(TieredPersistenceTests, OldReadingsSpillInOrder)
+{
+    TieredPersistence persistence{makeConfiguration(4096, 1024 * 1024)};
+    putReadings(persistence, KEY, 0, 500);
+    putReadings(persistence, "Other+T", 0, 10);
+
+    const auto usage = persistence.getUsage();
+    EXPECT_LE(usage.memoryBytes, 4096u);
+    EXPECT_GT(usage.segmentCount, 0u);
+    EXPECT_EQ(usage.memoryReadings + usage.diskReadings, 510u);
+    EXPECT_EQ(usage.spilledReadings, usage.diskReadings);
+    EXPECT_EQ(usage.droppedReadings, 0u);
+
+    // The spilled readings come back first, and nothing is lost or reordered
+    const auto readings = persistence.getReadings(KEY, 1000);
+    ASSERT_EQ(readings.size(), 500u);
+    for (auto i = std::size_t{0}; i < readings.size(); ++i)
+    {
+        EXPECT_EQ(readings[i]->getStringValue(), std::to_string(i));
+        EXPECT_EQ(readings[i]->getTimestamp(), 1650000000000 + i * 1000);
+    }
+
+    persistence.removeReadings(KEY, 7);
+    const auto remaining = persistence.getReadings(KEY, 1000);
+    ASSERT_EQ(remaining.size(), 493u);
+    EXPECT_EQ(remaining.front()->getStringValue(), "7");
+    persistence.removeReadings(KEY, 493);
+    persistence.removeReadings("Other+T", 10);
+    EXPECT_TRUE(persistence.isEmpty());
+    EXPECT_EQ(persistence.getUsage().diskBytes, 0u);
+    EXPECT_TRUE(FileSystemUtils::listFiles(DIRECTORY).empty());
+}
+
+TEST_F(TieredPersistenceTests, SegmentsSurviveARestart)
+{
+    {
+        TieredPersistence persistence{makeConfiguration(2048, 1024 * 1024)};
+        putReadings(persistence, KEY, 0, 200);
+        EXPECT_GT(persistence.getUsage().diskReadings, 0u);
+    }
+
+    TieredPersistence persistence{makeConfiguration(2048, 1024 * 1024)};
+    const auto usage = persistence.getUsage();
+    EXPECT_GT(usage.diskReadings, 0u);
+    EXPECT_EQ(usage.memoryReadings, 0u);
+    ASSERT_EQ(persistence.getReadingsKeys(), std::vector<std::string>{KEY});
+    const auto readings = persistence.getReadings(KEY, 1000);
+    ASSERT_EQ(readings.size(), usage.diskReadings);
+    EXPECT_EQ(readings.front()->getStringValue(), "0");
+}
+
+TEST_F(TieredPersistenceTests, OldestFirstDropsTheOldestSegments)
+{
+    TieredPersistence persistence{makeConfiguration(2048, 4096)};
+    putReadings(persistence, KEY, 0, 2000);
+
+    const auto usage = persistence.getUsage();
+    EXPECT_LE(usage.diskBytes, 4096u);
+    EXPECT_GT(usage.droppedReadings, 0u);
+    EXPECT_EQ(usage.memoryReadings + usage.diskReadings + usage.droppedReadings, 2000u);
+
+    // What is left is the most recent stretch of readings
+    const auto readings = persistence.getReadings(KEY, 2000);
+    ASSERT_FALSE(readings.empty());
+    EXPECT_EQ(readings.front()->getStringValue(), std::to_string(usage.droppedReadings));
+    EXPECT_EQ(readings.back()->getStringValue(), "1999");
+}
+
+TEST_F(TieredPersistenceTests, PerFeedQuotaSparesTheSmallFeeds)
+{
+    TieredPersistence persistence{makeConfiguration(2048, 8192, ReadingDropPolicy::PerFeedQuota)};
+    putReadings(persistence, "Quiet+T", 0, 100);
+    putReadings(persistence, KEY, 0, 3000);
+
+    EXPECT_GT(persistence.getUsage().droppedReadings, 0u);
+    EXPECT_EQ(persistence.getReadings("Quiet+T", 1000).size(), 100u);
+    EXPECT_LT(persistence.getReadings(KEY, 3000).size(), 3000u);
+}
+
+TEST_F(TieredPersistenceTests, DownsamplingKeepsTheWholeStretch)
+{
+    TieredPersistence persistence{makeConfiguration(2048, 4096, ReadingDropPolicy::DownsampleOnPressure)};
+    putReadings(persistence, KEY, 0, 1000);
+
+    const auto usage = persistence.getUsage();
+    EXPECT_LE(usage.diskBytes, 4096u);
+    EXPECT_GT(usage.droppedReadings, 0u);
+
+    // The older readings are thinned out, so what is left spans more time than the same count of recent readings
+    const auto readings = persistence.getReadings(KEY, 1000);
+    ASSERT_GT(readings.size(), 2u);
+    EXPECT_EQ(readings.back()->getStringValue(), "999");
+    EXPECT_GT(readings[1]->getTimestamp() - readings[0]->getTimestamp(), 1000u);
+    EXPECT_GT(readings.back()->getTimestamp() - readings.front()->getTimestamp(), (readings.size() - 1) * 1000);
+}
+
+TEST_F(TieredPersistenceTests, DropsDuringAReadDoNotRemoveNewerReadings)
+{
+    for (const auto dropPolicy : {ReadingDropPolicy::OldestFirst, ReadingDropPolicy::DownsampleOnPressure})
+    {
+        auto left = std::vector<std::string>{};
+        auto beforeRemoval = std::vector<std::string>{};
+        auto lastGivenOut = std::uint64_t{0};
+        removeAfterDrops(dropPolicy, left, beforeRemoval, lastGivenOut);
+        TearDown();
+
+        // Exactly the readings that were given out, and were not dropped meanwhile, are removed
+        auto expected = std::vector<std::string>{};
+        for (const auto& value : beforeRemoval)
+        {
+            if (std::stoull(value) > lastGivenOut)
+                expected.emplace_back(value);
+        }
+        EXPECT_LT(expected.size(), beforeRemoval.size() + 50);
+        EXPECT_EQ(left, expected);
+    }
+}
+
+TEST_F(TieredPersistenceTests, CompressedSegments)
+{
+    auto configuration = makeConfiguration(2048, 1024 * 1024);
+    auto compressions = 0;
+    // The codec keeps the segments on the side, and writes only a short token into the file
+    auto stored = std::map<std::string, std::string>{};
+    configuration.compress = [&](const std::string& input, std::string& output) {
+        ++compressions;
+        output = "#" + std::to_string(stored.size());
+        stored[output] = input;
+        return true;
+    };
+    configuration.decompress = [&](const std::string& input, std::string& output) {
+        const auto it = stored.find(input);
+        if (it == stored.cend())
+            return false;
+        output = it->second;
+        return true;
+    };
+    TieredPersistence persistence{configuration};
+    putReadings(persistence, KEY, 0, 200);
+
+    EXPECT_GT(compressions, 0);
+    EXPECT_EQ(persistence.getReadings(KEY, 1000).size(), 200u);
+}
+
+TEST_F(TieredPersistenceTests, PutReadingDoesNotWaitForTheSpill)
+{
+    auto configuration = makeConfiguration(2048, 1024 * 1024);
+    auto release = std::promise<void>{};
+    auto released = release.get_future().share();
+    configuration.compress = [=](const std::string&, std::string&) {
+        released.wait();
+        return false;
+    };
+    configuration.decompress = [](const std::string&, std::string&) { return false; };
+    TieredPersistence persistence{configuration};
+
+    // The readings stay in memory, and can be read, while their segment is being written
+    for (std::uint64_t i = 0; i < 200; ++i)
+        persistence.putReading(KEY, Reading{"T", std::to_string(i), 1650000000000 + i * 1000});
+    EXPECT_EQ(persistence.getUsage().segmentCount, 0u);
+    EXPECT_EQ(persistence.getReadings(KEY, 1000).size(), 200u);
+
+    release.set_value();
+    persistence.flush();
+    const auto usage = persistence.getUsage();
+    EXPECT_GT(usage.segmentCount, 0u);
+    EXPECT_LE(usage.memoryBytes, 2048u);
+    EXPECT_EQ(usage.memoryReadings + usage.diskReadings, 200u);
+    EXPECT_EQ(persistence.getReadings(KEY, 1000).front()->getStringValue(), "0");
+}
+
+TEST_F(TieredPersistenceTests, RemovedReadingsAreNotSpilled)
+{
+    auto configuration = makeConfiguration(2048, 1024 * 1024);
+    auto writing = std::promise<void>{};
+    auto release = std::promise<void>{};
+    auto released = release.get_future().share();
+    auto first = true;
+    configuration.compress = [&, released](const std::string&, std::string&) {
+        if (first)
+        {
+            first = false;
+            writing.set_value();
+            released.wait();
+        }
+        return false;
+    };
+    TieredPersistence persistence{configuration};
+    for (std::uint64_t i = 0; i < 100; ++i)
+        persistence.putReading(KEY, Reading{"T", std::to_string(i), 1650000000000 + i * 1000});
+
+    // The readings the segment is being written for are published and removed in the meantime
+    ASSERT_EQ(writing.get_future().wait_for(std::chrono::seconds{1}), std::future_status::ready);
+    persistence.getReadings(KEY, 10);
+    persistence.removeReadings(KEY, 10);
+    release.set_value();
+    persistence.flush();
+
+    const auto readings = persistence.getReadings(KEY, 1000);
+    ASSERT_EQ(readings.size(), 90u);
+    EXPECT_EQ(readings.front()->getStringValue(), "10");
+    EXPECT_EQ(readings.back()->getStringValue(), "99");
+    EXPECT_EQ(persistence.getUsage().diskReadings + persistence.getUsage().memoryReadings, 90u);
+}
+
+TEST_F(TieredPersistenceTests, FrontSegmentIsDecodedOnce)
+{
+    auto configuration = makeConfiguration(2048, 1024 * 1024);
+    auto decompressions = 0u;
+    auto stored = std::map<std::string, std::string>{};
+    configuration.compress = [&](const std::string& input, std::string& output) {
+        output = "#" + std::to_string(stored.size());
+        stored[output] = input;
+        return true;
+    };
+    configuration.decompress = [&](const std::string& input, std::string& output) {
+        ++decompressions;
+        output = stored.at(input);
+        return true;
+    };
+    TieredPersistence persistence{configuration};
+    putReadings(persistence, KEY, 0, 500);
+    const auto segmentCount = persistence.getUsage().segmentCount;
+    ASSERT_GT(segmentCount, 0u);
+
+    // Every segment is decoded once, no matter how many batches it is read in
+    auto next = 0u;
+    while (persistence.getUsage().segmentCount > 0)
+    {
+        const auto batch = persistence.getReadings(KEY, 7);
+        ASSERT_FALSE(batch.empty());
+        EXPECT_EQ(batch.front()->getStringValue(), std::to_string(next));
+        next += static_cast<unsigned>(batch.size());
+        persistence.removeReadings(KEY, batch.size());
+    }
+    EXPECT_EQ(decompressions, segmentCount);
+}
@@ -22,6 +22,7 @@
 #include "wolk/WolkBuilder.h"
 #include "wolk/WolkMulti.h"
 #include "wolk/WolkSingle.h"
+#include "wolk/persistence/ShardedPersistence.h"
 #undef private
 #undef protected
 
@@ -134,6 +135,15 @@ TEST_F(WolkBuilderTests, BuildInvalidType)
     ASSERT_THROW(([] { WolkBuilder{{}}.build(WolkInterfaceType::Gateway); }()), std::runtime_error);
 }
 
+TEST_F(WolkBuilderTests, WithShardedPersistence)
+{
+    auto builder = WolkBuilder{};
+    builder.withShardedPersistence(4);
+    const auto persistence = dynamic_cast<ShardedPersistence*>(builder.m_persistence.get());
+    ASSERT_NE(persistence, nullptr);
+    EXPECT_EQ(persistence->getShardCount(), 4u);
+}
+
 TEST_F(WolkBuilderTests, FullSingleExample)
 {
     auto wolk = std::unique_ptr<WolkSingle>{};
@@ -471,6 +471,18 @@ TEST_F(WolkMultiTests, RegisterDevicesHappyFlow)
     ASSERT_TRUE(service->registerDevices({{}}, {}));
 }
 
+TEST_F(WolkMultiTests, RegisterDevicesInBatchesServiceIsNull)
+{
+    service->m_registrationService = nullptr;
+    ASSERT_FALSE(service->registerDevicesInBatches({{}}, {}));
+}
+
+TEST_F(WolkMultiTests, RegisterDevicesInBatchesHappyFlow)
+{
+    EXPECT_CALL(GetRegistrationServiceReference(), registerDevicesInBatches).WillOnce(Return(true));
+    ASSERT_TRUE(service->registerDevicesInBatches({{}}, {}));
+}
+
 TEST_F(WolkMultiTests, RemoveDeviceWrongDevice)
 {
     EXPECT_CALL(GetRegistrationServiceReference(), removeDevices).Times(0);
@@ -519,6 +531,24 @@ TEST_F(WolkMultiTests, ObtainDevicesHappyFlow)
     ASSERT_EQ(service->obtainDevices(devices.front().getKey(), std::chrono::system_clock::now()), nullptr);
 }
 
+TEST_F(WolkMultiTests, ObtainDevicesFutureWrongDevice)
+{
+    EXPECT_CALL(GetRegistrationServiceReference(), obtainDevicesFuture).Times(0);
+    EXPECT_EQ(service->obtainDevicesFuture("TestDevice", std::chrono::system_clock::now()).get(), nullptr);
+}
+
+TEST_F(WolkMultiTests, ObtainDevicesFutureHappyFlow)
+{
+    EXPECT_CALL(GetRegistrationServiceReference(), obtainDevicesFuture)
+      .WillOnce([](const std::string&, TimePoint, const std::string&, const std::string&) {
+          auto promise = std::promise<std::unique_ptr<std::vector<RegisteredDeviceInformation>>>{};
+          promise.set_value(std::unique_ptr<std::vector<RegisteredDeviceInformation>>{
+            new std::vector<RegisteredDeviceInformation>{}});
+          return promise.get_future();
+      });
+    EXPECT_NE(service->obtainDevicesFuture(devices.front().getKey(), std::chrono::system_clock::now()).get(), nullptr);
+}
+
 TEST_F(WolkMultiTests, ObtainDevicesAsyncWrongDevice)
 {
     EXPECT_CALL(GetRegistrationServiceReference(), obtainDevicesAsync).Times(0);
@@ -531,6 +561,66 @@ TEST_F(WolkMultiTests, ObtainDevicesAsyncHappyFlow)
     ASSERT_TRUE(service->obtainDevicesAsync(devices.front().getKey(), std::chrono::system_clock::now()));
 }
 
+TEST_F(WolkMultiTests, ObtainDevicesPagedWrongDevice)
+{
+    EXPECT_CALL(GetRegistrationServiceReference(), obtainDevicesPaged).Times(0);
+    ASSERT_FALSE(service->obtainDevicesPaged("TestDevice", std::chrono::system_clock::now(), 100,
+                                             [](const RegisteredDevicesPage&) {}));
+}
+
+TEST_F(WolkMultiTests, ObtainDevicesPagedHappyFlow)
+{
+    EXPECT_CALL(GetRegistrationServiceReference(), obtainDevicesPaged).WillOnce(Return(true));
+    ASSERT_TRUE(service->obtainDevicesPaged(devices.front().getKey(), std::chrono::system_clock::now(), 100,
+                                            [](const RegisteredDevicesPage&) {}));
+}
+
+TEST_F(WolkMultiTests, RefreshDevicesCacheWrongDevice)
+{
+    EXPECT_CALL(GetRegistrationServiceReference(), refreshDevicesCache).Times(0);
+    ASSERT_FALSE(service->refreshDevicesCache("TestDevice", "Sensor"));
+}
+
+TEST_F(WolkMultiTests, RefreshDevicesCacheHappyFlow)
+{
+    EXPECT_CALL(GetRegistrationServiceReference(), refreshDevicesCache).WillOnce(Return(true));
+    ASSERT_TRUE(service->refreshDevicesCache(devices.front().getKey(), "Sensor"));
+}
+
+TEST_F(WolkMultiTests, ObtainCachedDevicesNoCache)
+{
+    EXPECT_TRUE(service->obtainCachedDevices("Sensor").empty());
+}
+
+TEST_F(WolkMultiTests, ObtainCachedDevicesServiceIsNull)
+{
+    service->m_registrationService = nullptr;
+    EXPECT_TRUE(service->obtainCachedDevices("Sensor").empty());
+}
+
+TEST_F(WolkMultiTests, ResumeFirmwareRolloutNoService)
+{
+    ASSERT_NO_FATAL_FAILURE(service->resumeFirmwareRollout());
+}
+
+TEST_F(WolkMultiTests, ResumeFirmwareRollout)
+{
+    SetUpFirmwareUpdateInstaller();
+
+    // Set up the FirmwareUpdateService to be called
+    std::atomic_bool called{false};
+    EXPECT_CALL(GetFirmwareUpdateServiceReference(), resumeRollout).WillOnce([&]() {
+        called = true;
+        Notify();
+    });
+
+    // Call the service
+    ASSERT_NO_FATAL_FAILURE(service->resumeFirmwareRollout());
+    if (!called)
+        Await();
+    EXPECT_TRUE(called);
+}
+
 TEST_F(WolkMultiTests, PeekErrorCountWrongDevice)
 {
     EXPECT_CALL(GetErrorServiceReference(), peekMessagesForDevice).Times(0);
@@ -635,6 +725,7 @@ TEST_F(WolkMultiTests, NotifyConnected)
     SetUpFirmwareUpdateInstaller();
     EXPECT_CALL(GetFileManagementServiceReference(), reportPresentFiles).Times(2);
     EXPECT_CALL(GetFirmwareUpdateServiceReference(), loadState).Times(2);
+    EXPECT_CALL(GetFirmwareUpdateServiceReference(), startRollout).Times(1);
     ASSERT_NO_FATAL_FAILURE(service->notifyConnected());
 }
 
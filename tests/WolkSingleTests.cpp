@@ -211,6 +211,29 @@ TEST_F(WolkSingleTests, AddFeed)
     EXPECT_TRUE(called);
 }
 
+TEST_F(WolkSingleTests, AddFeedWithFilter)
+{
+    // Set up the DataService to be called
+    std::atomic_bool called{false};
+    auto filter = ReadingFilterConfiguration{};
+    filter.absoluteDeadband = 0.5;
+    EXPECT_CALL(GetDataServiceReference(), setFeedFilter(device.getKey(), "TF", _))
+      .WillOnce([&](const std::string&, const std::string&, const ReadingFilterConfiguration& configuration) {
+          EXPECT_DOUBLE_EQ(configuration.absoluteDeadband, 0.5);
+      });
+    EXPECT_CALL(GetDataServiceReference(), registerFeed(device.getKey(), _))
+      .WillOnce([&](const std::string&, const Feed&) {
+          called = true;
+          Notify();
+      });
+
+    // Call the service
+    ASSERT_NO_FATAL_FAILURE(service->registerFeed(Feed{"TestFeed", "TF", FeedType::IN_OUT, "NUMERIC"}, filter));
+    if (!called)
+        Await();
+    EXPECT_TRUE(called);
+}
+
 TEST_F(WolkSingleTests, AddFeeds)
 {
     // Set up the DataService to be called
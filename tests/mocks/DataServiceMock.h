@@ -46,6 +46,9 @@ public:
     MOCK_METHOD(void, registerFeeds, (const std::string&, std::vector<Feed>));
     MOCK_METHOD(void, removeFeed, (const std::string&, std::string));
     MOCK_METHOD(void, removeFeeds, (const std::string&, std::vector<std::string>));
+    MOCK_METHOD(void, setFeedFilter, (const std::string&, const std::string&, const ReadingFilterConfiguration&));
+    MOCK_METHOD(void, setFeedAggregation, (const std::string&, const std::string&, const AggregationConfiguration&));
+    MOCK_METHOD(void, flushAggregations, ());
     MOCK_METHOD(void, pullFeedValues, (const std::string&));
     MOCK_METHOD(void, pullParameters, (const std::string&));
     MOCK_METHOD(bool, synchronizeParameters,
@@ -26,9 +26,26 @@ using namespace wolkabout::connect;
 class FirmwareInstallerMock : public FirmwareInstaller
 {
 public:
+    FirmwareInstallerMock()
+    {
+        // By default, these go through the synchronous methods as they do in the interface
+        ON_CALL(*this, installFirmwareAsync)
+          .WillByDefault([this](const std::string& deviceKey, const std::string& fileName,
+                                InstallResponseCallback callback) {
+              FirmwareInstaller::installFirmwareAsync(deviceKey, fileName, std::move(callback));
+          });
+        ON_CALL(*this, wasFileInstallSuccessful)
+          .WillByDefault([this](const std::string& deviceKey, const std::string& oldVersion,
+                                const std::string& fileName) {
+              return FirmwareInstaller::wasFileInstallSuccessful(deviceKey, oldVersion, fileName);
+          });
+    }
+
     MOCK_METHOD(InstallResponse, installFirmware, (const std::string&, const std::string&));
+    MOCK_METHOD(void, installFirmwareAsync, (const std::string&, const std::string&, InstallResponseCallback));
     MOCK_METHOD(void, abortFirmwareInstall, (const std::string&));
     MOCK_METHOD(bool, wasFirmwareInstallSuccessful, (const std::string&, const std::string&));
+    MOCK_METHOD(bool, wasFileInstallSuccessful, (const std::string&, const std::string&, const std::string&));
     MOCK_METHOD(std::string, getFirmwareVersion, (const std::string&));
 };
 
@@ -46,6 +46,9 @@ public:
     MOCK_METHOD(void, loadState, (const std::string&));
     MOCK_METHOD(void, obtainParametersAndAnnounce, (const std::string&));
     MOCK_METHOD(std::string, getVersionForDevice, (const std::string& deviceKey));
+    MOCK_METHOD(void, startRollout, ());
+    MOCK_METHOD(void, pauseRollout, ());
+    MOCK_METHOD(void, resumeRollout, ());
 };
 
 #endif    // WOLKABOUTCONNECTOR_FIRMWAREUPDATESERVICEMOCK_H
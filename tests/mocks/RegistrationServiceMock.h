@@ -34,6 +34,10 @@ public:
     MOCK_METHOD(bool, registerDevices,
                 (const std::string&, const std::vector<DeviceRegistrationData>&,
                  std::function<void(const std::vector<std::string>&, const std::vector<std::string>&)>));
+    MOCK_METHOD(bool, registerDevicesInBatches,
+                (const std::string&, const std::vector<DeviceRegistrationData>&,
+                 std::function<void(const std::vector<std::string>&, const std::vector<std::string>&)>,
+                 std::function<void(std::size_t, std::size_t)>, BulkRegistrationOptions));
     MOCK_METHOD(bool, removeDevices, (const std::string&, std::vector<std::string>));
     MOCK_METHOD(std::shared_ptr<std::vector<std::string>>, obtainChildren,
                 (const std::string&, std::chrono::milliseconds));
@@ -43,6 +47,12 @@ public:
     MOCK_METHOD(bool, obtainDevicesAsync,
                 (const std::string&, TimePoint, std::string, std::string,
                  std::function<void(const std::vector<RegisteredDeviceInformation>&)>));
+    MOCK_METHOD(std::future<std::unique_ptr<std::vector<RegisteredDeviceInformation>>>, obtainDevicesFuture,
+                (const std::string&, TimePoint, std::string, std::string));
+    MOCK_METHOD(bool, obtainDevicesPaged,
+                (const std::string&, TimePoint, std::string, std::string, std::size_t,
+                 std::function<void(const RegisteredDevicesPage&)>));
+    MOCK_METHOD(bool, refreshDevicesCache, (const std::string&, const std::string&, std::function<void(bool)>));
 };
 
 #endif    // WOLKABOUTCONNECTOR_REGISTRATIONSERVICEMOCK_H
@@ -0,0 +1,179 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "tests/utilities/CborReader.h"
+
+#include "core/utilities/Logger.h"
+
+#include <cstring>
+
+namespace wolkabout
+{
+namespace connect
+{
+namespace
+{
+// The maximum nesting of arrays, maps and tags the reader will accept
+const std::uint32_t MAX_DEPTH = 16;
+}    // namespace
+
+CborReader::CborReader(std::string data) : m_data(std::move(data)), m_position(0) {}
+
+std::unique_ptr<CborValue> CborReader::read()
+{
+    auto value = std::unique_ptr<CborValue>{new CborValue};
+    if (isAtEnd() || !readItem(*value, 0))
+        return nullptr;
+    return value;
+}
+
+bool CborReader::isAtEnd() const
+{
+    return m_position >= m_data.size();
+}
+
+bool CborReader::readItem(CborValue& value, std::uint32_t depth)
+{
+    if (isAtEnd() || depth > MAX_DEPTH)
+        return false;
+
+    const auto initial = static_cast<std::uint8_t>(m_data[m_position++]);
+    const auto major = static_cast<std::uint8_t>(initial >> 5);
+    const auto additional = static_cast<std::uint8_t>(initial & 0x1F);
+
+    // The simple values and floats have their own meaning of the additional information
+    if (major == 7)
+    {
+        auto bits = std::uint64_t{0};
+        switch (additional)
+        {
+        case 20:
+        case 21:
+            value.type = CborValue::Type::BOOL;
+            value.boolValue = additional == 21;
+            return true;
+        case 22:
+            value.type = CborValue::Type::NULL_VALUE;
+            return true;
+        case 26:
+        {
+            if (!readBigEndian(4, bits))
+                return false;
+            const auto singleBits = static_cast<std::uint32_t>(bits);
+            auto single = float{0};
+            std::memcpy(&single, &singleBits, sizeof(single));
+            value.type = CborValue::Type::DOUBLE;
+            value.doubleValue = static_cast<double>(single);
+            return true;
+        }
+        case 27:
+        {
+            if (!readBigEndian(8, bits))
+                return false;
+            value.type = CborValue::Type::DOUBLE;
+            std::memcpy(&value.doubleValue, &bits, sizeof(bits));
+            return true;
+        }
+        default:
+            LOG(WARN) << "Failed to decode CBOR -> Unsupported simple value '" << static_cast<int>(additional) << "'.";
+            return false;
+        }
+    }
+
+    auto argument = std::uint64_t{0};
+    if (!readArgument(additional, argument))
+        return false;
+
+    switch (major)
+    {
+    case 0:
+        value.type = CborValue::Type::UNSIGNED;
+        value.unsignedValue = argument;
+        return true;
+    case 1:
+        value.type = CborValue::Type::NEGATIVE;
+        value.signedValue = -1 - static_cast<std::int64_t>(argument);
+        return true;
+    case 3:
+        if (argument > m_data.size() - m_position)
+            return false;
+        value.type = CborValue::Type::TEXT;
+        value.text = m_data.substr(m_position, static_cast<std::size_t>(argument));
+        m_position += static_cast<std::size_t>(argument);
+        return true;
+    case 4:
+    case 5:
+    {
+        // Every item takes at least a byte, which also guards from huge allocations. A map has two items for every
+        // entry, so its size is compared against half of what is left, as doubling it could overflow.
+        const auto remaining = static_cast<std::uint64_t>(m_data.size() - m_position);
+        if (argument > (major == 5 ? remaining / 2 : remaining))
+            return false;
+        const auto count = major == 5 ? argument * 2 : argument;
+        value.type = major == 5 ? CborValue::Type::MAP : CborValue::Type::ARRAY;
+        value.unsignedValue = argument;
+        value.items.resize(static_cast<std::size_t>(count));
+        for (auto& item : value.items)
+            if (!readItem(item, depth + 1))
+                return false;
+        return true;
+    }
+    case 6:
+        value.type = CborValue::Type::TAG;
+        value.unsignedValue = argument;
+        value.items.resize(1);
+        return readItem(value.items.front(), depth + 1);
+    default:
+        LOG(WARN) << "Failed to decode CBOR -> Unsupported major type '" << static_cast<int>(major) << "'.";
+        return false;
+    }
+}
+
+bool CborReader::readArgument(std::uint8_t additional, std::uint64_t& argument)
+{
+    if (additional < 24)
+    {
+        argument = additional;
+        return true;
+    }
+    switch (additional)
+    {
+    case 24:
+        return readBigEndian(1, argument);
+    case 25:
+        return readBigEndian(2, argument);
+    case 26:
+        return readBigEndian(4, argument);
+    case 27:
+        return readBigEndian(8, argument);
+    default:
+        LOG(WARN) << "Failed to decode CBOR -> Indefinite lengths are not supported.";
+        return false;
+    }
+}
+
+bool CborReader::readBigEndian(std::size_t bytes, std::uint64_t& value)
+{
+    if (bytes > m_data.size() - m_position)
+        return false;
+
+    value = 0;
+    for (auto i = std::size_t{0}; i < bytes; ++i)
+        value = value << 8 | static_cast<std::uint8_t>(m_data[m_position++]);
+    return true;
+}
+}    // namespace connect
+}    // namespace wolkabout
@@ -0,0 +1,98 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WOLKABOUTCONNECTOR_CBORREADER_H
+#define WOLKABOUTCONNECTOR_CBORREADER_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace wolkabout
+{
+namespace connect
+{
+// This is the generic representation of a decoded CBOR item.
+struct CborValue
+{
+    enum class Type
+    {
+        UNSIGNED,
+        NEGATIVE,
+        TEXT,
+        ARRAY,
+        MAP,
+        TAG,
+        BOOL,
+        NULL_VALUE,
+        DOUBLE
+    };
+
+    Type type = Type::NULL_VALUE;
+
+    // Holds the value of unsigned integers, the tag number of tags, and the size of arrays and maps.
+    std::uint64_t unsignedValue = 0;
+    std::int64_t signedValue = 0;
+    double doubleValue = 0;
+    bool boolValue = false;
+    std::string text;
+
+    // Holds the items of an array, the keys and values of a map one after another, or the tagged item.
+    std::vector<CborValue> items;
+};
+
+/**
+ * This is a minimal CBOR (RFC 8949) decoder, the counterpart of the `CborWriter`. It decodes everything the writer
+ * can produce, and is meant to be used as a stand-in for the platform side when verifying the binary protocol.
+ */
+class CborReader
+{
+public:
+    /**
+     * Default parameter constructor.
+     *
+     * @param data The encoded data.
+     */
+    explicit CborReader(std::string data);
+
+    /**
+     * This method is used to decode the next item.
+     *
+     * @return The decoded item. A nullptr if the data is malformed or there is nothing more to read.
+     */
+    std::unique_ptr<CborValue> read();
+
+    /**
+     * This method is used to check whether all the data has been read.
+     *
+     * @return Whether all the data has been read.
+     */
+    bool isAtEnd() const;
+
+private:
+    // Internal methods used to decode the data
+    bool readItem(CborValue& value, std::uint32_t depth);
+    bool readArgument(std::uint8_t additional, std::uint64_t& argument);
+    bool readBigEndian(std::size_t bytes, std::uint64_t& value);
+
+    std::string m_data;
+    std::size_t m_position;
+};
+}    // namespace connect
+}    // namespace wolkabout
+
+#endif    // WOLKABOUTCONNECTOR_CBORREADER_H
@@ -31,12 +31,16 @@
 #include "core/utilities/Logger.h"
 #include "wolk/WolkMulti.h"
 #include "wolk/WolkSingle.h"
+#include "wolk/connectivity/OutboundScheduler.h"
+#include "wolk/persistence/MappedRingPersistence.h"
+#include "wolk/persistence/ShardedPersistence.h"
 #include "wolk/service/data/DataService.h"
 #include "wolk/service/file_management/FileManagementService.h"
 #include "wolk/service/firmware_update/FirmwareUpdateService.h"
 
 #include <stdexcept>
 #include <utility>
+#include <vector>
 
 namespace wolkabout
 {
@@ -53,6 +57,12 @@ WolkBuilder::WolkBuilder(std::vector<Device> devices)
 , m_fileTransferEnabled(false)
 , m_fileTransferUrlEnabled(false)
 , m_maxPacketSize{0}
+, m_outboundRateLimitEnabled(false)
+, m_outboundMessagesPerSecond{0}
+, m_outboundBytesPerSecond{0}
+, m_outboundQueueCapacity{0}
+, m_readingIngestQueueCapacity{0}
+, m_readingIngestOverflowPolicy{IngestOverflowPolicy::Block}
 {
 }
 
@@ -67,6 +77,12 @@ WolkBuilder::WolkBuilder(Device device)
 , m_fileTransferEnabled(false)
 , m_fileTransferUrlEnabled(false)
 , m_maxPacketSize{0}
+, m_outboundRateLimitEnabled(false)
+, m_outboundMessagesPerSecond{0}
+, m_outboundBytesPerSecond{0}
+, m_outboundQueueCapacity{0}
+, m_readingIngestQueueCapacity{0}
+, m_readingIngestOverflowPolicy{IngestOverflowPolicy::Block}
 {
 }
 
@@ -123,6 +139,24 @@ WolkBuilder& WolkBuilder::withPersistence(std::unique_ptr<Persistence> persisten
     return *this;
 }
 
+WolkBuilder& WolkBuilder::withShardedPersistence(std::size_t shardCount)
+{
+    m_persistence = std::unique_ptr<Persistence>{new ShardedPersistence{shardCount}};
+    return *this;
+}
+
+WolkBuilder& WolkBuilder::withTieredPersistence(TieredPersistenceConfiguration configuration)
+{
+    m_persistence = std::unique_ptr<Persistence>{new TieredPersistence{std::move(configuration)}};
+    return *this;
+}
+
+WolkBuilder& WolkBuilder::withMappedRingPersistence(const std::string& directory, std::uint64_t recordsPerFeed)
+{
+    m_persistence = std::unique_ptr<Persistence>{new MappedRingPersistence{directory, recordsPerFeed}};
+    return *this;
+}
+
 WolkBuilder& WolkBuilder::withDataProtocol(std::unique_ptr<DataProtocol> protocol)
 {
     m_dataProtocol = std::move(protocol);
@@ -197,6 +231,12 @@ WolkBuilder& WolkBuilder::withFirmwareUpdate(std::unique_ptr<FirmwareParametersL
     return *this;
 }
 
+WolkBuilder& WolkBuilder::withFirmwareRollout(RolloutConfiguration configuration)
+{
+    m_rolloutConfiguration = std::move(configuration);
+    return *this;
+}
+
 WolkBuilder& WolkBuilder::withPlatformStatus(std::shared_ptr<PlatformStatusListener> platformStatusListener)
 {
     if (m_platformStatusProtocol == nullptr)
@@ -206,11 +246,30 @@ WolkBuilder& WolkBuilder::withPlatformStatus(std::shared_ptr<PlatformStatusListe
     return *this;
 }
 
-WolkBuilder& WolkBuilder::withRegistration(std::unique_ptr<RegistrationProtocol> protocol)
+WolkBuilder& WolkBuilder::withRegistration(std::unique_ptr<RegistrationProtocol> protocol,
+                                           std::string devicesCacheFile)
 {
     if (protocol == nullptr)
         protocol = std::unique_ptr<WolkaboutRegistrationProtocol>(new wolkabout::WolkaboutRegistrationProtocol{false});
     m_registrationProtocol = std::move(protocol);
+    m_devicesCacheFile = std::move(devicesCacheFile);
+    return *this;
+}
+
+WolkBuilder& WolkBuilder::withOutboundRateLimit(std::uint64_t messagesPerSecond, std::uint64_t bytesPerSecond,
+                                                std::size_t queueCapacity)
+{
+    m_outboundRateLimitEnabled = true;
+    m_outboundMessagesPerSecond = messagesPerSecond;
+    m_outboundBytesPerSecond = bytesPerSecond;
+    m_outboundQueueCapacity = queueCapacity;
+    return *this;
+}
+
+WolkBuilder& WolkBuilder::withReadingIngestQueue(std::size_t capacity, IngestOverflowPolicy overflowPolicy)
+{
+    m_readingIngestQueueCapacity = capacity;
+    m_readingIngestOverflowPolicy = overflowPolicy;
     return *this;
 }
 
@@ -285,8 +344,37 @@ std::unique_ptr<WolkInterface> WolkBuilder::build(WolkInterfaceType type)
     wolk->m_feedUpdateHandler = m_feedUpdateHandler;
     wolk->m_parameterLambda = m_parameterHandlerLambda;
     wolk->m_parameterHandler = m_parameterHandler;
+
+    // If the outbound traffic should be shaped, the services will publish through the scheduler
+    if (m_outboundRateLimitEnabled)
+    {
+        // Each message is classified by the protocol that created it, so the protocols are asked in turn
+        auto classifier = [wolkRaw](const Message& message) {
+            const auto protocols = std::vector<Protocol*>{
+              wolkRaw->m_dataProtocol.get(),           wolkRaw->m_fileManagementProtocol.get(),
+              wolkRaw->m_firmwareUpdateProtocol.get(), wolkRaw->m_platformStatusProtocol.get(),
+              wolkRaw->m_registrationProtocol.get(),   wolkRaw->m_errorProtocol.get()};
+            for (const auto protocol : protocols)
+            {
+                if (protocol == nullptr)
+                    continue;
+                const auto type = protocol->getMessageType(message);
+                if (type != MessageType::UNKNOWN)
+                    return type;
+            }
+            return MessageType::UNKNOWN;
+        };
+        wolk->m_outboundScheduler = std::unique_ptr<OutboundScheduler>{
+          new OutboundScheduler{*wolk->m_connectivityService, classifier, m_outboundMessagesPerSecond,
+                                m_outboundBytesPerSecond, m_outboundQueueCapacity}};
+        wolk->m_outboundScheduler->start();
+    }
+    auto& outboundConnectivityService = wolk->m_outboundScheduler != nullptr ?
+                                          static_cast<ConnectivityService&>(*wolk->m_outboundScheduler) :
+                                          *wolk->m_connectivityService;
+
     wolk->m_dataService = std::make_shared<DataService>(
-      *wolk->m_dataProtocol, *wolk->m_persistence, *wolk->m_connectivityService, *wolk->m_outboundRetryMessageHandler,
+      *wolk->m_dataProtocol, *wolk->m_persistence, outboundConnectivityService, *wolk->m_outboundRetryMessageHandler,
       [wolkRaw](const std::string& deviceKey, const std::map<std::uint64_t, std::vector<Reading>>& readings) {
           wolkRaw->handleFeedUpdateCommand(deviceKey, readings);
       },
@@ -303,6 +391,10 @@ std::unique_ptr<WolkInterface> WolkBuilder::build(WolkInterfaceType type)
           for (const auto& parameter : parameters)
               LOG(INFO) << "\t\t" << parameter;
       });
+    if (wolk->m_outboundScheduler != nullptr)
+        wolk->m_dataService->setOutboundScheduler(wolk->m_outboundScheduler.get());
+    if (m_readingIngestQueueCapacity > 0)
+        wolk->m_dataService->startIngestQueue(m_readingIngestQueueCapacity, m_readingIngestOverflowPolicy);
     wolk->m_errorService = std::make_shared<ErrorService>(*wolk->m_errorProtocol, m_errorRetainTime);
     wolk->m_inboundMessageHandler->addListener(wolk->m_dataService);
     wolk->m_inboundMessageHandler->addListener(wolk->m_errorService);
@@ -314,7 +406,7 @@ std::unique_ptr<WolkInterface> WolkBuilder::build(WolkInterfaceType type)
         // Create the File Management service
         wolk->m_fileManagementProtocol = std::move(m_fileManagementProtocol);
         wolk->m_fileManagementService = std::make_shared<FileManagementService>(
-          *wolk->m_connectivityService, *wolk->m_dataService, *wolk->m_fileManagementProtocol, m_fileDownloadDirectory,
+          outboundConnectivityService, *wolk->m_dataService, *wolk->m_fileManagementProtocol, m_fileDownloadDirectory,
           m_fileTransferEnabled, m_fileTransferUrlEnabled, std::move(m_fileDownloader), std::move(m_fileListener));
 
         // Trigger the on build and add the listener for MQTT messages
@@ -354,13 +446,15 @@ std::unique_ptr<WolkInterface> WolkBuilder::build(WolkInterfaceType type)
         if (m_firmwareInstaller != nullptr)
         {
             wolk->m_firmwareUpdateService = std::make_shared<FirmwareUpdateService>(
-              *wolk->m_connectivityService, *wolk->m_dataService, wolk->m_fileManagementService,
+              outboundConnectivityService, *wolk->m_dataService, wolk->m_fileManagementService,
               std::move(m_firmwareInstaller), *wolk->m_firmwareUpdateProtocol, m_workingDirectory);
+            if (m_rolloutConfiguration.isEnabled())
+                wolk->m_firmwareUpdateService->setRolloutConfiguration(m_rolloutConfiguration);
         }
         else if (m_firmwareParametersListener != nullptr)
         {
             wolk->m_firmwareUpdateService = std::make_shared<FirmwareUpdateService>(
-              *wolk->m_connectivityService, *wolk->m_dataService, wolk->m_fileManagementService,
+              outboundConnectivityService, *wolk->m_dataService, wolk->m_fileManagementService,
               std::move(m_firmwareParametersListener), *wolk->m_firmwareUpdateProtocol, m_workingDirectory);
         }
 
@@ -383,10 +477,19 @@ std::unique_ptr<WolkInterface> WolkBuilder::build(WolkInterfaceType type)
     // Check if the registration service needs to be introduces
     if (m_registrationProtocol != nullptr)
     {
+        // Load the cache of the devices, if one is wanted. A cache that can not be loaded starts over empty.
+        auto devicesCache = std::shared_ptr<RegisteredDevicesCache>{};
+        if (!m_devicesCacheFile.empty())
+        {
+            devicesCache = std::make_shared<RegisteredDevicesCache>(m_devicesCacheFile);
+            if (!devicesCache->load())
+                devicesCache->clear();
+        }
+
         // Create the service
         wolk->m_registrationProtocol = std::move(m_registrationProtocol);
-        wolk->m_registrationService =
-          std::make_shared<RegistrationService>(*wolk->m_registrationProtocol, *wolk->m_connectivityService);
+        wolk->m_registrationService = std::make_shared<RegistrationService>(
+          *wolk->m_registrationProtocol, outboundConnectivityService, std::move(devicesCache));
         wolk->m_inboundMessageHandler->addListener(wolk->m_registrationService);
     }
 
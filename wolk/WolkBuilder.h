@@ -32,7 +32,10 @@
 #include "wolk/api/FirmwareParametersListener.h"
 #include "wolk/api/ParameterHandler.h"
 #include "wolk/api/PlatformStatusListener.h"
+#include "wolk/persistence/TieredPersistence.h"
+#include "wolk/service/data/ReadingIngestQueue.h"
 #include "wolk/service/file_management/FileDownloader.h"
+#include "wolk/service/firmware_update/FirmwareRolloutScheduler.h"
 
 #include <cstdint>
 #include <functional>
@@ -133,6 +136,32 @@ public:
      */
     WolkBuilder& withPersistence(std::unique_ptr<Persistence> persistence);
 
+    /**
+     * @brief Sets the Wolk module to use an in-memory persistence split into shards by the device key<br>
+     *        Readings of different devices are then stored without waiting on a single lock
+     * @param shardCount The count of shards. If zero, one shard per hardware thread is made.
+     * @return Reference to current wolkabout::WolkBuilder instance (Provides fluent interface)
+     */
+    WolkBuilder& withShardedPersistence(std::size_t shardCount = 0);
+
+    /**
+     * @brief Sets the Wolk module to keep the readings within a memory and a disk budget<br>
+     *        Readings beyond the memory budget are spilled into segment files, and the drop policy decides what is
+     *        given up once the disk budget is exhausted as well
+     * @param configuration The budgets, the segment directory and the drop policy.
+     * @return Reference to current wolkabout::WolkBuilder instance (Provides fluent interface)
+     */
+    WolkBuilder& withTieredPersistence(TieredPersistenceConfiguration configuration);
+
+    /**
+     * @brief Sets the Wolk module to keep the readings of numeric feeds in memory-mapped ring files<br>
+     *        All other feeds, attributes and parameters are kept in memory
+     * @param directory The directory of the ring files.
+     * @param recordsPerFeed The count of readings a single feed can hold before the oldest ones are overwritten.
+     * @return Reference to current wolkabout::WolkBuilder instance (Provides fluent interface)
+     */
+    WolkBuilder& withMappedRingPersistence(const std::string& directory, std::uint64_t recordsPerFeed = 65536);
+
     /**
      * @brief withDataProtocol Defines which data protocol to use
      * @param Protocol unique_ptr to wolkabout::DataProtocol implementation
@@ -205,6 +234,16 @@ public:
     WolkBuilder& withFirmwareUpdate(std::unique_ptr<FirmwareParametersListener> firmwareParametersListener,
                                     const std::string& workingDirectory = "./");
 
+    /**
+     * @brief Sets the Wolk module to roll out firmware installations in stages.
+     * @details This is used with the `FirmwareInstaller` firmware update, mostly for gateways with many devices behind
+     * them. Only as many installations as the concurrency limit allows are running at once, canary devices are
+     * updated first, and the rollout pauses if too many installations fail.
+     * @param configuration The configuration of the rollout.
+     * @return Reference to current wolkabout::WolkBuilder instance (Provides fluent interface)
+     */
+    WolkBuilder& withFirmwareRollout(RolloutConfiguration configuration);
+
     /**
      * @brief Sets the Wolk module to allow listening to `p2d/platform_status` messages.
      * @param platformStatusListener The listener of the messages.
@@ -216,9 +255,35 @@ public:
      * @brief Sets the Wolk module to allow device registration.
      * @param protocol The protocol that will be used for registration. If remained as nullptr, default one will be
      * used.
+     * @param devicesCacheFile The path of the file in which the local cache of the registered devices is kept. If
+     * remained empty, there will be no cache.
+     * @return Reference to current wolkabout::WolkBuilder instance (Provides fluent interface)
+     */
+    WolkBuilder& withRegistration(std::unique_ptr<RegistrationProtocol> protocol = nullptr,
+                                  std::string devicesCacheFile = {});
+
+    /**
+     * @brief Sets the Wolk module to shape the outbound traffic.
+     * @details Outbound messages are placed into priority queues and sent out respecting the rate limits. File transfer
+     * chunk requests and status messages are sent out first, and feed values last.
+     * @param messagesPerSecond The maximum count of messages sent out per second. Zero means unlimited.
+     * @param bytesPerSecond The maximum count of payload bytes sent out per second. Zero means unlimited.
+     * @param queueCapacity The maximum count of messages that can wait to be sent out.
      * @return Reference to current wolkabout::WolkBuilder instance (Provides fluent interface)
      */
-    WolkBuilder& withRegistration(std::unique_ptr<RegistrationProtocol> protocol = nullptr);
+    WolkBuilder& withOutboundRateLimit(std::uint64_t messagesPerSecond, std::uint64_t bytesPerSecond = 0,
+                                       std::size_t queueCapacity = 1000);
+
+    /**
+     * @brief Sets the Wolk module to place a lock-free queue in front of the persistence.
+     * @details Threads adding readings only place them into the queue, and a thread of the data service stores them
+     * into the persistence in batches. Useful when readings are added from many threads at once.
+     * @param capacity The count of readings the queue can hold.
+     * @param overflowPolicy What happens to a reading that is added while the queue is full.
+     * @return Reference to current wolkabout::WolkBuilder instance (Provides fluent interface)
+     */
+    WolkBuilder& withReadingIngestQueue(std::size_t capacity = 65536,
+                                        IngestOverflowPolicy overflowPolicy = IngestOverflowPolicy::Block);
 
     /**
      * @brief Builds a WolkInterface instance.
@@ -269,6 +334,7 @@ private:
     std::unique_ptr<FirmwareUpdateProtocol> m_firmwareUpdateProtocol;
     std::unique_ptr<PlatformStatusProtocol> m_platformStatusProtocol;
     std::unique_ptr<RegistrationProtocol> m_registrationProtocol;
+    std::string m_devicesCacheFile;
 
     // Here is the place for all the file transfer related parameters
     std::shared_ptr<FileDownloader> m_fileDownloader;
@@ -282,10 +348,21 @@ private:
     std::unique_ptr<FirmwareInstaller> m_firmwareInstaller;
     std::string m_workingDirectory;
     std::unique_ptr<FirmwareParametersListener> m_firmwareParametersListener;
+    RolloutConfiguration m_rolloutConfiguration;
 
     // Here is the place for the platform status listener
     std::shared_ptr<PlatformStatusListener> m_platformStatusListener;
 
+    // Here is the place for all the outbound rate limit parameters
+    bool m_outboundRateLimitEnabled;
+    std::uint64_t m_outboundMessagesPerSecond;
+    std::uint64_t m_outboundBytesPerSecond;
+    std::size_t m_outboundQueueCapacity;
+
+    // Here is the place for the reading ingest queue parameters
+    std::size_t m_readingIngestQueueCapacity;
+    IngestOverflowPolicy m_readingIngestOverflowPolicy;
+
     // These are the default values that are going to be used for the connection parameters
     static const constexpr char* WOLK_DEMO_HOST = "ssl://INSERT_HOSTNAME:PORT";
     static const constexpr char* TRUST_STORE = "/INSERT/PATH/TO/YOUR/CA.CRT/FILE";
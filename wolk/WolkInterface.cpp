@@ -33,7 +33,12 @@ namespace wolkabout
 {
 namespace connect
 {
-WolkInterface::~WolkInterface() = default;
+WolkInterface::~WolkInterface()
+{
+    // The scheduler calls back into the services and the persistence, which are destroyed before it
+    if (m_outboundScheduler != nullptr)
+        m_outboundScheduler->stop();
+}
 
 void WolkInterface::connect()
 {
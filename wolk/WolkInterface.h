@@ -22,6 +22,7 @@
 #include "wolk/WolkInterfaceType.h"
 #include "wolk/api/FeedUpdateHandler.h"
 #include "wolk/api/ParameterHandler.h"
+#include "wolk/connectivity/OutboundScheduler.h"
 #include "wolk/service/data/DataService.h"
 #include "wolk/service/error/ErrorService.h"
 #include "wolk/service/file_management/FileManagementService.h"
@@ -151,6 +152,7 @@ protected:
 
     // Here are entities related to an MQTT connection.
     std::unique_ptr<ConnectivityService> m_connectivityService;
+    std::unique_ptr<OutboundScheduler> m_outboundScheduler;
     std::shared_ptr<InboundMessageHandler> m_inboundMessageHandler;
     OutboundMessageHandler* m_outboundMessageHandler;
     std::shared_ptr<OutboundRetryMessageHandler> m_outboundRetryMessageHandler;
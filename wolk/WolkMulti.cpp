@@ -116,6 +116,32 @@ void WolkMulti::registerFeeds(const std::string& deviceKey, const std::vector<Fe
     addToCommandBuffer([=]() -> void { m_dataService->registerFeeds(deviceKey, feeds); });
 }
 
+void WolkMulti::registerFeed(const std::string& deviceKey, const Feed& feed, const ReadingFilterConfiguration& filter)
+{
+    if (!isDeviceInList(deviceKey))
+    {
+        LOG(WARN) << "Ignoring call of 'registerFeed' - Device '" << deviceKey << "' has not been added.";
+        return;
+    }
+
+    addToCommandBuffer([=]() -> void {
+        m_dataService->setFeedFilter(deviceKey, feed.getReference(), filter);
+        m_dataService->registerFeed(deviceKey, feed);
+    });
+}
+
+void WolkMulti::setFeedAggregation(const std::string& deviceKey, const std::string& reference,
+                                   const AggregationConfiguration& aggregation)
+{
+    if (!isDeviceInList(deviceKey))
+    {
+        LOG(WARN) << "Ignoring call of 'setFeedAggregation' - Device '" << deviceKey << "' has not been added.";
+        return;
+    }
+
+    addToCommandBuffer([=]() -> void { m_dataService->setFeedAggregation(deviceKey, reference, aggregation); });
+}
+
 void WolkMulti::removeFeed(const std::string& deviceKey, const std::string& reference)
 {
     if (!isDeviceInList(deviceKey))
@@ -206,6 +232,20 @@ bool WolkMulti::registerDevices(
     return m_registrationService->registerDevices("*", devices, wrapRegisterCallback(devices, std::move(callback)));
 }
 
+bool WolkMulti::registerDevicesInBatches(
+  const std::vector<DeviceRegistrationData>& devices,
+  std::function<void(const std::vector<std::string>&, const std::vector<std::string>&)> callback,
+  std::function<void(std::size_t, std::size_t)> progress, BulkRegistrationOptions options)
+{
+    if (m_registrationService == nullptr)
+    {
+        LOG(ERROR) << "Failed to 'registerDevicesInBatches' -> No registration service was added.";
+        return false;
+    }
+    return m_registrationService->registerDevicesInBatches(
+      "*", devices, wrapRegisterCallback(devices, std::move(callback)), std::move(progress), options);
+}
+
 bool WolkMulti::removeDevice(const std::string& deviceKey, const std::string& deviceKeyToRemove)
 {
     if (!isDeviceInList(deviceKey))
@@ -252,6 +292,82 @@ bool WolkMulti::obtainDevicesAsync(const std::string& deviceKey, TimePoint times
     return m_registrationService->obtainDevicesAsync(deviceKey, timestampFrom, deviceType, externalId, callback);
 }
 
+std::future<std::unique_ptr<std::vector<RegisteredDeviceInformation>>> WolkMulti::obtainDevicesFuture(
+  const std::string& deviceKey, TimePoint timestampFrom, std::string deviceType, std::string externalId)
+{
+    if (!isDeviceInList(deviceKey))
+    {
+        LOG(WARN) << "Ignoring call of 'obtainDevicesFuture' - Device '" << deviceKey << "' has not been added.";
+        auto promise = std::promise<std::unique_ptr<std::vector<RegisteredDeviceInformation>>>{};
+        promise.set_value(nullptr);
+        return promise.get_future();
+    }
+    return m_registrationService->obtainDevicesFuture(deviceKey, timestampFrom, std::move(deviceType),
+                                                      std::move(externalId));
+}
+
+bool WolkMulti::obtainDevicesPaged(const std::string& deviceKey, TimePoint timestampFrom, std::size_t pageSize,
+                                   std::function<void(const RegisteredDevicesPage&)> callback, std::string deviceType,
+                                   std::string externalId)
+{
+    if (!isDeviceInList(deviceKey))
+    {
+        LOG(WARN) << "Ignoring call of 'obtainDevicesPaged' - Device '" << deviceKey << "' has not been added.";
+        return false;
+    }
+    return m_registrationService->obtainDevicesPaged(deviceKey, timestampFrom, std::move(deviceType),
+                                                     std::move(externalId), pageSize, std::move(callback));
+}
+
+bool WolkMulti::refreshDevicesCache(const std::string& deviceKey, const std::string& deviceType,
+                                    std::function<void(bool)> callback)
+{
+    if (!isDeviceInList(deviceKey))
+    {
+        LOG(WARN) << "Ignoring call of 'refreshDevicesCache' - Device '" << deviceKey << "' has not been added.";
+        return false;
+    }
+    return m_registrationService->refreshDevicesCache(deviceKey, deviceType, std::move(callback));
+}
+
+std::vector<RegisteredDeviceInformation> WolkMulti::obtainCachedDevices(const std::string& deviceType)
+{
+    if (m_registrationService == nullptr)
+    {
+        LOG(ERROR) << "Failed to 'obtainCachedDevices' -> No registration service was added.";
+        return {};
+    }
+    const auto cache = m_registrationService->getDevicesCache();
+    if (cache == nullptr)
+    {
+        LOG(WARN) << "Ignoring call of 'obtainCachedDevices' - The registration was built without a cache.";
+        return {};
+    }
+    return cache->findByType(deviceType);
+}
+
+void WolkMulti::pauseFirmwareRollout()
+{
+    if (m_firmwareUpdateService == nullptr)
+    {
+        LOG(WARN) << "Ignoring call of 'pauseFirmwareRollout' - Firmware update is not enabled.";
+        return;
+    }
+
+    addToCommandBuffer([=]() -> void { m_firmwareUpdateService->pauseRollout(); });
+}
+
+void WolkMulti::resumeFirmwareRollout()
+{
+    if (m_firmwareUpdateService == nullptr)
+    {
+        LOG(WARN) << "Ignoring call of 'resumeFirmwareRollout' - Firmware update is not enabled.";
+        return;
+    }
+
+    addToCommandBuffer([=]() -> void { m_firmwareUpdateService->resumeRollout(); });
+}
+
 std::uint64_t WolkMulti::peekErrorCount(const std::string& deviceKey)
 {
     if (!isDeviceInList(deviceKey))
@@ -348,13 +464,7 @@ void WolkMulti::reportFirmwareUpdateForDevice(const Device& device)
             m_firmwareUpdateService->loadState(device.getKey());
 
             // Publish everything from the queue
-            while (!m_firmwareUpdateService->getQueue().empty())
-            {
-                // Get the message
-                auto message = m_firmwareUpdateService->getQueue().front();
-                m_connectivityService->publish(message);
-                m_firmwareUpdateService->getQueue().pop();
-            }
+            m_firmwareUpdateService->publishQueuedMessages();
         }
         else if (m_firmwareUpdateService->isParameterListener())
         {
@@ -392,6 +502,10 @@ void WolkMulti::notifyConnected()
         reportFilesForDevice(device);
         reportFirmwareUpdateForDevice(device);
     }
+
+    // The rollout starts installing only once the state of every device is loaded
+    if (m_firmwareUpdateService != nullptr && m_firmwareUpdateService->isInstaller())
+        m_firmwareUpdateService->startRollout();
 }
 
 std::function<void(const std::vector<std::string>&, const std::vector<std::string>&)> WolkMulti::wrapRegisterCallback(
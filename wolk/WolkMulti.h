@@ -64,6 +64,27 @@ public:
     void registerFeed(const std::string& deviceKey, const Feed& feed);
     void registerFeeds(const std::string& deviceKey, const std::vector<Feed>& feeds);
 
+    /**
+     * This method registers the feed, and sets up the filter that drops redundant readings of it before they are
+     * stored.
+     *
+     * @param deviceKey The key of the device owning the feed.
+     * @param feed The feed.
+     * @param filter The configuration of the filter.
+     */
+    void registerFeed(const std::string& deviceKey, const Feed& feed, const ReadingFilterConfiguration& filter);
+
+    /**
+     * This method sets up the aggregation of a numeric feed, so samples can be added at full rate, and only the
+     * minimum/maximum/mean/last/count of every window are stored and published.
+     *
+     * @param deviceKey The key of the device owning the feed.
+     * @param reference The reference of the feed.
+     * @param aggregation The configuration of the aggregation.
+     */
+    void setFeedAggregation(const std::string& deviceKey, const std::string& reference,
+                            const AggregationConfiguration& aggregation);
+
     void removeFeed(const std::string& deviceKey, const std::string& reference);
     void removeFeeds(const std::string& deviceKey, const std::vector<std::string>& references);
 
@@ -78,6 +99,21 @@ public:
       const std::vector<DeviceRegistrationData>& devices,
       std::function<void(const std::vector<std::string>&, const std::vector<std::string>&)> callback);
 
+    /**
+     * This method registers a large number of devices, sent in batches bounded by the options. The callback is invoked
+     * once, with the results of all the batches, and the progress callback after every answered batch.
+     *
+     * @param devices The list of devices that should be registered.
+     * @param callback The callback that receives the devices that are registered, and the ones that are not.
+     * @param progress The callback that receives the count of devices answered so far, and the count of all devices.
+     * @param options The options for splitting the devices into batches.
+     * @return Whether the registration has started.
+     */
+    bool registerDevicesInBatches(
+      const std::vector<DeviceRegistrationData>& devices,
+      std::function<void(const std::vector<std::string>&, const std::vector<std::string>&)> callback,
+      std::function<void(std::size_t, std::size_t)> progress = {}, BulkRegistrationOptions options = {});
+
     bool removeDevice(const std::string& deviceKey, const std::string& deviceKeyToRemove);
 
     bool removeDevices(const std::string& deviceKey, const std::vector<std::string>& deviceKeysToRemove);
@@ -90,6 +126,69 @@ public:
                             std::string externalId = {},
                             std::function<void(const std::vector<RegisteredDeviceInformation>&)> callback = {});
 
+    /**
+     * This method requests a list of devices, and returns a future for it right away, so many queries can be waited on
+     * at the same time.
+     *
+     * @param deviceKey The key of the device querying the devices.
+     * @param timestampFrom The timestamp from which devices will be queried.
+     * @param deviceType The type of devices that are queried.
+     * @param externalId The external id of a device, if you have such a value to query a single device.
+     * @return The future for the list of devices. The list will be a {@code: nullptr} if the query could not be made.
+     */
+    std::future<std::unique_ptr<std::vector<RegisteredDeviceInformation>>> obtainDevicesFuture(
+      const std::string& deviceKey, TimePoint timestampFrom, std::string deviceType = {}, std::string externalId = {});
+
+    /**
+     * This method requests a list of devices, and delivers it page by page, with a bounded number of devices copied
+     * at a time.
+     *
+     * @param deviceKey The key of the device querying the devices.
+     * @param timestampFrom The timestamp from which devices will be queried. The cursor of the last page of a previous
+     * query obtains only the devices registered since.
+     * @param pageSize The most devices delivered in one page.
+     * @param callback The callback that will be invoked for every page. The page is valid only while it runs.
+     * @param deviceType The type of devices that are queried.
+     * @param externalId The external id of a device, if you have such a value to query a single device.
+     * @return Whether the request was successfully sent out.
+     */
+    bool obtainDevicesPaged(const std::string& deviceKey, TimePoint timestampFrom, std::size_t pageSize,
+                            std::function<void(const RegisteredDevicesPage&)> callback, std::string deviceType = {},
+                            std::string externalId = {});
+
+    /**
+     * This method refreshes the local cache of the devices of a device type, obtaining only the devices registered
+     * since its last refresh. This requires the registration to be built with a cache file.
+     *
+     * @param deviceKey The key of the device querying the devices.
+     * @param deviceType The type of devices that are refreshed. Empty to refresh the devices of all types.
+     * @param callback The callback that will be invoked once the cache is refreshed, with whether the devices were
+     * stored.
+     * @return Whether the request was successfully sent out.
+     */
+    bool refreshDevicesCache(const std::string& deviceKey, const std::string& deviceType = {},
+                             std::function<void(bool)> callback = {});
+
+    /**
+     * This method returns the devices of a device type from the local cache, without querying the platform.
+     *
+     * @param deviceType The type of devices. Empty for the devices refreshed without a type.
+     * @return The cached devices. Empty if there is no cache.
+     */
+    std::vector<RegisteredDeviceInformation> obtainCachedDevices(const std::string& deviceType = {});
+
+    /**
+     * This method pauses the staged firmware rollout, if one is set up. The installations that are running are not
+     * affected.
+     */
+    void pauseFirmwareRollout();
+
+    /**
+     * This method resumes the staged firmware rollout, after it was paused manually or because of failed
+     * installations.
+     */
+    void resumeFirmwareRollout();
+
     /**
      * This method allows the user to see the count of error messages a device currently has in the backlog, sent out
      * from the platform.
@@ -88,6 +88,19 @@ void WolkSingle::registerFeeds(const std::vector<Feed>& feeds)
     addToCommandBuffer([=] { m_dataService->registerFeeds(m_device.getKey(), feeds); });
 }
 
+void WolkSingle::registerFeed(const Feed& feed, const ReadingFilterConfiguration& filter)
+{
+    addToCommandBuffer([=] {
+        m_dataService->setFeedFilter(m_device.getKey(), feed.getReference(), filter);
+        m_dataService->registerFeed(m_device.getKey(), feed);
+    });
+}
+
+void WolkSingle::setFeedAggregation(const std::string& reference, const AggregationConfiguration& aggregation)
+{
+    addToCommandBuffer([=] { m_dataService->setFeedAggregation(m_device.getKey(), reference, aggregation); });
+}
+
 void WolkSingle::removeFeed(const std::string& reference)
 {
     addToCommandBuffer([=] { m_dataService->removeFeed(m_device.getKey(), reference); });
@@ -135,14 +148,9 @@ void WolkSingle::notifyConnected()
     {
         if (m_firmwareUpdateService->isInstaller())
         {
-            // Publish everything from the queue
-            while (!m_firmwareUpdateService->getQueue().empty())
-            {
-                // Get the message
-                auto message = m_firmwareUpdateService->getQueue().front();
-                m_connectivityService->publish(message);
-                m_firmwareUpdateService->getQueue().pop();
-            }
+            // Publish everything from the queue, and let the rollout start, the state was loaded while building
+            m_firmwareUpdateService->publishQueuedMessages();
+            m_firmwareUpdateService->startRollout();
         }
         else if (m_firmwareUpdateService->isParameterListener())
         {
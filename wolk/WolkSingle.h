@@ -130,6 +130,21 @@ public:
     void registerFeed(const Feed& feed);
     void registerFeeds(const std::vector<Feed>& feeds);
 
+    /**
+     * @brief Registers the feed, and sets up the filter that drops redundant readings of it before they are stored
+     * @param feed The feed
+     * @param filter The configuration of the filter
+     */
+    void registerFeed(const Feed& feed, const ReadingFilterConfiguration& filter);
+
+    /**
+     * @brief Sets up the aggregation of a numeric feed, so samples can be added at full rate, and only the
+     *        minimum/maximum/mean/last/count of every window are stored and published
+     * @param reference The reference of the feed
+     * @param aggregation The configuration of the aggregation
+     */
+    void setFeedAggregation(const std::string& reference, const AggregationConfiguration& aggregation);
+
     void removeFeed(const std::string& reference);
     void removeFeeds(const std::vector<std::string>& references);
 
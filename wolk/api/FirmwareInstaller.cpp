@@ -20,9 +20,21 @@ namespace wolkabout
 {
 namespace connect
 {
+void FirmwareInstaller::installFirmwareAsync(const std::string& deviceKey, const std::string& fileName,
+                                             InstallResponseCallback callback)
+{
+    callback(installFirmware(deviceKey, fileName));
+}
+
 bool FirmwareInstaller::wasFirmwareInstallSuccessful(const std::string& deviceKey, const std::string& oldVersion)
 {
     return oldVersion != getFirmwareVersion(deviceKey);
 }
+
+bool FirmwareInstaller::wasFileInstallSuccessful(const std::string& deviceKey, const std::string& oldVersion,
+                                                 const std::string& /* fileName */)
+{
+    return wasFirmwareInstallSuccessful(deviceKey, oldVersion);
+}
 }    // namespace connect
 }    // namespace wolkabout
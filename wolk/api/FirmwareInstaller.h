@@ -17,6 +17,7 @@
 #ifndef WOLKABOUTCONNECTOR_FIRMWAREINSTALLER_H
 #define WOLKABOUTCONNECTOR_FIRMWAREINSTALLER_H
 
+#include <functional>
 #include <string>
 
 namespace wolkabout
@@ -35,6 +36,9 @@ enum class InstallResponse
     INSTALLED,
 };
 
+// This is the callback with which an installer reports the response for an installation it started asynchronously
+using InstallResponseCallback = std::function<void(InstallResponse)>;
+
 /**
  * This is an interface for a class capable of installing firmware on command from the platform.
  */
@@ -48,15 +52,29 @@ public:
 
     /**
      * This is the method with which the service notifies the user implemented FirmwareInstaller that an
-     * installation command has been received.
+     * installation command has been received. It is invoked on a worker thread of the service, one installation at a
+     * time for each device, so installations of different devices can run at the same time.
      *
      * @param fileName The name of the file
      */
     virtual InstallResponse installFirmware(const std::string& deviceKey, const std::string& fileName) = 0;
 
+    /**
+     * This is the method the service uses to start an installation. An installer that does its work elsewhere can
+     * return right away, and call the callback once it knows the response, so it does not hold a worker thread of the
+     * service for the whole installation. The callback must be called exactly once, from any thread. By default, it
+     * calls `installFirmware` and reports what it returns.
+     *
+     * @param deviceKey The device for which the installation is supposed to happen.
+     * @param fileName The name/path for the file that is supposed to be installed.
+     * @param callback The callback that receives the response for the installation.
+     */
+    virtual void installFirmwareAsync(const std::string& deviceKey, const std::string& fileName,
+                                      InstallResponseCallback callback);
+
     /**
      * This is the method that is invoked when the platform wants to abort a currently ongoing firmware installation
-     * session.
+     * session. It can be invoked while `installFirmware` is still running for the device.
      */
     virtual void abortFirmwareInstall(const std::string& deviceKey) = 0;
 
@@ -68,6 +86,20 @@ public:
      */
     virtual bool wasFirmwareInstallSuccessful(const std::string& deviceKey, const std::string& oldVersion);
 
+    /**
+     * This is the method with which the service will ask the firmware installer, if the install of a specific file was
+     * successful. The service calls this instead of `wasFirmwareInstallSuccessful` when it knows which file was being
+     * installed, so an installer that installs different things for different files can check the right one. By
+     * default, it calls `wasFirmwareInstallSuccessful`.
+     *
+     * @param deviceKey The device for which the installation happened.
+     * @param oldVersion The firmware version the device had before the installation.
+     * @param fileName The name/path of the file that was installed.
+     * @return Whether the firmware install was successful.
+     */
+    virtual bool wasFileInstallSuccessful(const std::string& deviceKey, const std::string& oldVersion,
+                                          const std::string& fileName);
+
     /**
      * This is the method with which the service can ask for the current firmware version.
      *
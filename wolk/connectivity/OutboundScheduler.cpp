@@ -0,0 +1,280 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wolk/connectivity/OutboundScheduler.h"
+
+#include "core/utilities/Logger.h"
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+namespace wolkabout
+{
+namespace connect
+{
+OutboundScheduler::OutboundScheduler(ConnectivityService& connectivityService, MessageClassifier classifier,
+                                     std::uint64_t messagesPerSecond, std::uint64_t bytesPerSecond,
+                                     std::size_t queueCapacity)
+: m_connectivityService(connectivityService)
+, m_classifier(std::move(classifier))
+, m_messageBucket(messagesPerSecond)
+, m_byteBucket(bytesPerSecond)
+, m_priorities{{MessageType::FILE_BINARY_REQUEST, OutboundPriority::HIGH},
+               {MessageType::FILE_UPLOAD_STATUS, OutboundPriority::HIGH},
+               {MessageType::FILE_URL_DOWNLOAD_STATUS, OutboundPriority::HIGH},
+               {MessageType::FIRMWARE_UPDATE_STATUS, OutboundPriority::HIGH},
+               {MessageType::FEED_VALUES, OutboundPriority::LOW}}
+, m_queueCapacity(queueCapacity)
+, m_queueDepth(0)
+, m_peakQueueDepth(0)
+, m_publishedCount(0)
+, m_droppedCount(0)
+, m_running(false)
+, m_stopped(true)
+{
+}
+
+OutboundScheduler::~OutboundScheduler()
+{
+    stop();
+}
+
+void OutboundScheduler::start()
+{
+    LOG(TRACE) << METHOD_INFO;
+
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        if (m_running.exchange(true))
+            return;
+        m_stopped = false;
+    }
+    m_dispatcher = std::thread{&OutboundScheduler::run, this};
+}
+
+void OutboundScheduler::stop()
+{
+    LOG(TRACE) << METHOD_INFO;
+
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        m_running = false;
+        m_stopped = true;
+    }
+    m_condition.notify_all();
+    if (m_dispatcher.joinable())
+        m_dispatcher.join();
+
+    // Nobody is going to send the queued messages any more, so their publishers are told they were not sent
+    auto givenUp = std::vector<QueuedMessage>{};
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        for (auto& queue : m_queues)
+        {
+            std::move(queue.begin(), queue.end(), std::back_inserter(givenUp));
+            m_droppedCount += queue.size();
+            queue.clear();
+        }
+        m_queueDepth = 0;
+    }
+    for (const auto& queued : givenUp)
+        if (queued.callback)
+            queued.callback(false);
+}
+
+void OutboundScheduler::setPriority(MessageType type, OutboundPriority priority)
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_priorities[type] = priority;
+}
+
+OutboundPriority OutboundScheduler::getPriority(MessageType type)
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    const auto it = m_priorities.find(type);
+    return it != m_priorities.cend() ? it->second : OutboundPriority::NORMAL;
+}
+
+bool OutboundScheduler::connect()
+{
+    return m_connectivityService.connect();
+}
+
+void OutboundScheduler::disconnect()
+{
+    m_connectivityService.disconnect();
+}
+
+bool OutboundScheduler::reconnect()
+{
+    return m_connectivityService.reconnect();
+}
+
+bool OutboundScheduler::isConnected()
+{
+    return m_connectivityService.isConnected();
+}
+
+bool OutboundScheduler::publish(std::shared_ptr<Message> outboundMessage)
+{
+    return publish(std::move(outboundMessage), nullptr);
+}
+
+bool OutboundScheduler::publish(std::shared_ptr<Message> outboundMessage, PublishCallback callback)
+{
+    LOG(TRACE) << METHOD_INFO;
+    const auto errorPrefix = "Failed to schedule outbound message";
+
+    if (outboundMessage == nullptr)
+    {
+        LOG(ERROR) << errorPrefix << " -> The message is a 'nullptr'.";
+        return false;
+    }
+    // Keep the behaviour of the connectivity service, so the services know to keep the data for later
+    if (!m_connectivityService.isConnected())
+    {
+        LOG(DEBUG) << errorPrefix << " -> Not connected.";
+        return false;
+    }
+
+    const auto priority = getPriority(m_classifier ? m_classifier(*outboundMessage) : MessageType::UNKNOWN);
+    auto dropped = QueuedMessage{};
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        if (m_stopped)
+        {
+            LOG(DEBUG) << errorPrefix << " -> The scheduler is not running.";
+            return false;
+        }
+        if (m_queueDepth >= m_queueCapacity && !makeRoomFor(priority, dropped))
+        {
+            ++m_droppedCount;
+            LOG(WARN) << errorPrefix << " -> The outbound queues are full. Dropping message on channel '"
+                      << outboundMessage->getChannel() << "'.";
+            return false;
+        }
+        m_queues[static_cast<std::size_t>(priority)].emplace_back(
+          QueuedMessage{std::move(outboundMessage), std::move(callback)});
+        ++m_queueDepth;
+        if (m_queueDepth > m_peakQueueDepth)
+            m_peakQueueDepth = m_queueDepth;
+    }
+    m_condition.notify_one();
+
+    // The publisher of the message that made room is told so without the lock, since it might publish again
+    if (dropped.callback)
+        dropped.callback(false);
+    return true;
+}
+
+std::size_t OutboundScheduler::getQueueDepth()
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    return m_queueDepth;
+}
+
+std::size_t OutboundScheduler::getQueueDepth(OutboundPriority priority)
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    return m_queues[static_cast<std::size_t>(priority)].size();
+}
+
+std::size_t OutboundScheduler::getPeakQueueDepth() const
+{
+    return m_peakQueueDepth;
+}
+
+std::uint64_t OutboundScheduler::getPublishedCount() const
+{
+    return m_publishedCount;
+}
+
+std::uint64_t OutboundScheduler::getDroppedCount() const
+{
+    return m_droppedCount;
+}
+
+void OutboundScheduler::run()
+{
+    auto lock = std::unique_lock<std::mutex>{m_mutex};
+    while (m_running)
+    {
+        // Find the queue with the highest priority that has messages
+        const auto queueIt =
+          std::find_if(m_queues.begin(), m_queues.end(),
+                       [](const std::deque<QueuedMessage>& queue) { return !queue.empty(); });
+        if (queueIt == m_queues.end())
+        {
+            m_condition.wait(lock);
+            continue;
+        }
+
+        // Check whether the buckets allow the message to go out. If not, wait, but wake up for any new message since
+        // it might be of a higher priority.
+        const auto now = TokenBucket::Clock::now();
+        const auto size = static_cast<std::uint64_t>(queueIt->front().message->getContent().size());
+        const auto wait =
+          std::max(m_messageBucket.timeUntilAvailable(1, now), m_byteBucket.timeUntilAvailable(size, now));
+        if (wait.count() > 0)
+        {
+            m_condition.wait_for(lock, wait);
+            continue;
+        }
+        m_messageBucket.tryConsume(1, now);
+        m_byteBucket.tryConsume(size, now);
+
+        // Take the message out and publish it without holding the lock
+        auto queued = std::move(queueIt->front());
+        queueIt->pop_front();
+        --m_queueDepth;
+        lock.unlock();
+        const auto published = m_connectivityService.publish(queued.message);
+
+        // A message that failed is handed back to its publisher, which keeps the data for a later attempt, the same
+        // as without the scheduler
+        if (published)
+            ++m_publishedCount;
+        else
+            LOG(WARN) << "Failed to publish outbound message on channel '" << queued.message->getChannel() << "'.";
+        if (queued.callback)
+            queued.callback(published);
+        lock.lock();
+    }
+}
+
+bool OutboundScheduler::makeRoomFor(OutboundPriority priority, QueuedMessage& dropped)
+{
+    // Drop the newest message of the lowest priority class that is lower than the new message
+    for (auto index = m_queues.size(); index > static_cast<std::size_t>(priority) + 1; --index)
+    {
+        auto& queue = m_queues[index - 1];
+        if (queue.empty())
+            continue;
+
+        LOG(WARN) << "The outbound queues are full. Dropping message on channel '"
+                  << queue.back().message->getChannel() << "' to make room for a message of higher priority.";
+        dropped = std::move(queue.back());
+        queue.pop_back();
+        --m_queueDepth;
+        ++m_droppedCount;
+        return true;
+    }
+    return false;
+}
+}    // namespace connect
+}    // namespace wolkabout
@@ -0,0 +1,235 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WOLKABOUTCONNECTOR_OUTBOUNDSCHEDULER_H
+#define WOLKABOUTCONNECTOR_OUTBOUNDSCHEDULER_H
+
+#include "core/Types.h"
+#include "core/connectivity/ConnectivityService.h"
+#include "core/model/Message.h"
+#include "core/utilities/Service.h"
+#include "wolk/connectivity/TokenBucket.h"
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace wolkabout
+{
+namespace connect
+{
+// The priority classes an outbound message can be placed in. Lower value means the message goes out sooner.
+enum class OutboundPriority
+{
+    HIGH = 0,
+    NORMAL,
+    LOW
+};
+
+// The function that tells the type of an outbound message, so it can be placed in its priority class
+using MessageClassifier = std::function<MessageType(const Message&)>;
+
+// The function that is told whether a queued message was really sent out
+using PublishCallback = std::function<void(bool)>;
+
+/**
+ * This is the class that shapes the outbound traffic. It is placed in front of the actual `ConnectivityService`, and
+ * services that publish messages through it will have their messages queued by priority class, and sent out by a
+ * dispatcher thread respecting the message and byte rate limits.
+ *
+ * The priority class of a message is determined by its `MessageType`. By default, file transfer chunk requests and
+ * status messages are `HIGH`, feed values are `LOW`, and everything else is `NORMAL`.
+ *
+ * A call to `publish` returns as soon as the message is queued, so no publisher, and no thread handling inbound
+ * messages, waits on the rate limits. The services that remove data from the persistence once it is sent publish with a
+ * `PublishCallback`, which is told whether the message was really handed to the wrapped connectivity service.
+ */
+class OutboundScheduler : public ConnectivityService, public Service
+{
+public:
+    /**
+     * Default parameter constructor.
+     *
+     * @param connectivityService The connectivity service that will actually send the messages.
+     * @param classifier The function used to determine the type of outbound messages.
+     * @param messagesPerSecond The maximum count of messages sent out per second. Zero means unlimited.
+     * @param bytesPerSecond The maximum count of payload bytes sent out per second. Zero means unlimited.
+     * @param queueCapacity The maximum count of messages held in all queues together.
+     */
+    OutboundScheduler(ConnectivityService& connectivityService, MessageClassifier classifier,
+                      std::uint64_t messagesPerSecond, std::uint64_t bytesPerSecond, std::size_t queueCapacity = 1000);
+
+    /**
+     * Overridden destructor. Will stop the dispatcher thread.
+     */
+    ~OutboundScheduler() override;
+
+    /**
+     * This is the overridden method from the `utilities::Service` interface.
+     * This method will start the dispatcher thread.
+     */
+    void start() override;
+
+    /**
+     * This is the overridden method from the `utilities::Service` interface.
+     * This method will stop the dispatcher thread. Messages that are still queued are given up, and their callbacks
+     * are told they were not sent.
+     */
+    void stop() override;
+
+    /**
+     * This method is used to override the priority class of a message type.
+     *
+     * @param type The message type.
+     * @param priority The priority class the messages of this type will be placed in.
+     */
+    void setPriority(MessageType type, OutboundPriority priority);
+
+    /**
+     * This method is used to obtain the priority class of a message type.
+     *
+     * @param type The message type.
+     * @return The priority class of the message type.
+     */
+    OutboundPriority getPriority(MessageType type);
+
+    /**
+     * These are the overridden methods from the `ConnectivityService` interface.
+     * The connection management is delegated to the wrapped connectivity service.
+     */
+    bool connect() override;
+    void disconnect() override;
+    bool reconnect() override;
+    bool isConnected() override;
+
+    /**
+     * This is the overridden method from the `ConnectivityService` interface.
+     * This method will place the message in the queue of its priority class, for the dispatcher to send it out. If all
+     * the queues are full, the newest message of a lower priority class will be dropped to make room. If there is no
+     * such message, the new message is dropped.
+     *
+     * @param outboundMessage The message that should be sent out.
+     * @return Whether the message was queued. False if not connected, if the message was dropped, or if the scheduler
+     * is not running.
+     */
+    bool publish(std::shared_ptr<Message> outboundMessage) override;
+
+    /**
+     * This method is used to queue a message the same way, and be told later whether it was really sent out.
+     *
+     * @param outboundMessage The message that should be sent out.
+     * @param callback The callback called once the message is published by the wrapped connectivity service, fails to
+     * be published, or is given up. It is called only if the message was queued, and never with the mutex locked.
+     * @return Whether the message was queued.
+     */
+    bool publish(std::shared_ptr<Message> outboundMessage, PublishCallback callback);
+
+    /**
+     * This method is used to obtain the count of messages waiting in all queues.
+     *
+     * @return The count of queued messages.
+     */
+    std::size_t getQueueDepth();
+
+    /**
+     * This method is used to obtain the count of messages waiting in the queue of a priority class.
+     *
+     * @param priority The priority class.
+     * @return The count of queued messages.
+     */
+    std::size_t getQueueDepth(OutboundPriority priority);
+
+    /**
+     * This method is used to obtain the largest count of messages that were waiting in all queues at the same time.
+     *
+     * @return The peak queue depth.
+     */
+    std::size_t getPeakQueueDepth() const;
+
+    /**
+     * This method is used to obtain the count of messages that were passed onto the connectivity service.
+     *
+     * @return The count of published messages.
+     */
+    std::uint64_t getPublishedCount() const;
+
+    /**
+     * This method is used to obtain the count of messages that were dropped because the queues were full.
+     *
+     * @return The count of dropped messages.
+     */
+    std::uint64_t getDroppedCount() const;
+
+private:
+    /**
+     * This is the internal method that is executed by the dispatcher thread.
+     */
+    void run();
+
+    // This struct holds a queued message, and the callback of its publisher
+    struct QueuedMessage
+    {
+        std::shared_ptr<Message> message;
+        PublishCallback callback;
+    };
+
+    /**
+     * This is the internal method used to make room for a new message in a full queue.
+     * Expects that the mutex is already locked.
+     *
+     * @param priority The priority class of the new message.
+     * @param dropped The message that was dropped to make room. Its callback is called once the mutex is unlocked.
+     * @return Whether room has been made.
+     */
+    bool makeRoomFor(OutboundPriority priority, QueuedMessage& dropped);
+
+    // Here we store the wrapped connectivity service and the function used to classify messages
+    ConnectivityService& m_connectivityService;
+    MessageClassifier m_classifier;
+
+    // Here we store the rate limits
+    TokenBucket m_messageBucket;
+    TokenBucket m_byteBucket;
+
+    // Here is the place for the queues, one for every priority class
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::map<MessageType, OutboundPriority> m_priorities;
+    std::array<std::deque<QueuedMessage>, 3> m_queues;
+    std::size_t m_queueCapacity;
+    std::size_t m_queueDepth;
+
+    // Here is the place for the metrics
+    std::atomic<std::size_t> m_peakQueueDepth;
+    std::atomic<std::uint64_t> m_publishedCount;
+    std::atomic<std::uint64_t> m_droppedCount;
+
+    // Here is the place for the dispatcher thread
+    std::atomic_bool m_running;
+    bool m_stopped;
+    std::thread m_dispatcher;
+};
+}    // namespace connect
+}    // namespace wolkabout
+
+#endif    // WOLKABOUTCONNECTOR_OUTBOUNDSCHEDULER_H
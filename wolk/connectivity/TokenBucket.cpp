@@ -0,0 +1,86 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wolk/connectivity/TokenBucket.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace wolkabout
+{
+namespace connect
+{
+TokenBucket::TokenBucket(std::uint64_t rate, std::uint64_t capacity)
+: m_rate(rate)
+, m_capacity(capacity == 0 ? rate : capacity)
+, m_tokens(static_cast<double>(m_capacity))
+, m_lastRefill(Clock::now())
+{
+}
+
+bool TokenBucket::isUnlimited() const
+{
+    return m_rate == 0;
+}
+
+double TokenBucket::getAvailableTokens(Clock::time_point now)
+{
+    refill(now);
+    return m_tokens;
+}
+
+bool TokenBucket::tryConsume(std::uint64_t tokens, Clock::time_point now)
+{
+    if (isUnlimited())
+        return true;
+
+    refill(now);
+    const auto requested = clamp(tokens);
+    if (m_tokens < requested)
+        return false;
+    m_tokens -= requested;
+    return true;
+}
+
+std::chrono::microseconds TokenBucket::timeUntilAvailable(std::uint64_t tokens, Clock::time_point now)
+{
+    if (isUnlimited())
+        return std::chrono::microseconds{0};
+
+    refill(now);
+    const auto missing = clamp(tokens) - m_tokens;
+    if (missing <= 0)
+        return std::chrono::microseconds{0};
+    return std::chrono::microseconds{
+      static_cast<std::int64_t>(std::ceil(missing * 1000000.0 / static_cast<double>(m_rate)))};
+}
+
+void TokenBucket::refill(Clock::time_point now)
+{
+    if (now <= m_lastRefill)
+        return;
+
+    const auto elapsed = std::chrono::duration_cast<std::chrono::duration<double>>(now - m_lastRefill).count();
+    m_tokens = std::min(static_cast<double>(m_capacity), m_tokens + elapsed * static_cast<double>(m_rate));
+    m_lastRefill = now;
+}
+
+double TokenBucket::clamp(std::uint64_t tokens) const
+{
+    return static_cast<double>(std::min(tokens, m_capacity));
+}
+}    // namespace connect
+}    // namespace wolkabout
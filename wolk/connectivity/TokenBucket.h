@@ -0,0 +1,95 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WOLKABOUTCONNECTOR_TOKENBUCKET_H
+#define WOLKABOUTCONNECTOR_TOKENBUCKET_H
+
+#include <chrono>
+#include <cstdint>
+
+namespace wolkabout
+{
+namespace connect
+{
+/**
+ * This is a simple token bucket. Tokens are refilled continuously at a fixed rate, up to the capacity of the bucket.
+ * A bucket with the rate set to zero is considered unlimited, and will always allow consumption.
+ *
+ * The bucket is not thread safe on its own, it is expected to be guarded by the owner.
+ */
+class TokenBucket
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * Default parameter constructor. The bucket starts out full.
+     *
+     * @param rate The amount of tokens that are added to the bucket each second. Zero means unlimited.
+     * @param capacity The maximum amount of tokens the bucket can hold. If zero, it will be equal to the rate.
+     */
+    explicit TokenBucket(std::uint64_t rate = 0, std::uint64_t capacity = 0);
+
+    /**
+     * This method is used to check whether the bucket is limiting anything at all.
+     *
+     * @return Whether the bucket is unlimited.
+     */
+    bool isUnlimited() const;
+
+    /**
+     * This method is used to obtain the count of tokens currently available in the bucket.
+     *
+     * @param now The current time point.
+     * @return The count of tokens available.
+     */
+    double getAvailableTokens(Clock::time_point now = Clock::now());
+
+    /**
+     * This method is used to attempt to take tokens out of the bucket. Requests larger than the capacity of the bucket
+     * are treated as if they requested the entire capacity, so they can be fulfilled once the bucket is full.
+     *
+     * @param tokens The count of tokens that should be taken out.
+     * @param now The current time point.
+     * @return Whether the tokens were taken out of the bucket.
+     */
+    bool tryConsume(std::uint64_t tokens, Clock::time_point now = Clock::now());
+
+    /**
+     * This method is used to calculate how long a request for tokens would have to wait to be fulfilled.
+     *
+     * @param tokens The count of tokens that would be taken out.
+     * @param now The current time point.
+     * @return The time until the tokens are available. Zero if they are available right now.
+     */
+    std::chrono::microseconds timeUntilAvailable(std::uint64_t tokens, Clock::time_point now = Clock::now());
+
+private:
+    // Internal method used to add the tokens that were generated since the last refill
+    void refill(Clock::time_point now);
+
+    // Internal method used to clamp the request to the capacity of the bucket
+    double clamp(std::uint64_t tokens) const;
+
+    std::uint64_t m_rate;
+    std::uint64_t m_capacity;
+    double m_tokens;
+    Clock::time_point m_lastRefill;
+};
+}    // namespace connect
+}    // namespace wolkabout
+
+#endif    // WOLKABOUTCONNECTOR_TOKENBUCKET_H
@@ -0,0 +1,506 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wolk/persistence/MappedRingPersistence.h"
+
+#include "core/persistence/inmemory/InMemoryPersistence.h"
+#include "core/utilities/FileSystemUtils.h"
+#include "core/utilities/Logger.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace wolkabout
+{
+namespace connect
+{
+namespace
+{
+const char RING_MAGIC[8] = {'W', 'O', 'L', 'K', 'R', 'N', 'G', '3'};
+const std::string RING_EXTENSION = ".ring";
+const std::size_t HEADER_SIZE = 4096;
+const std::size_t NAMES_SIZE = HEADER_SIZE - sizeof(RING_MAGIC) - 3 * sizeof(std::uint64_t) - 2 * sizeof(std::uint32_t);
+// The longest fraction kept in a ring, values with more digits after the point stay texts
+const std::uint32_t MAXIMUM_DECIMALS = 17;
+// The count of decimals of a record is kept in the bits of its timestamp above this one
+const unsigned int DECIMALS_SHIFT = 56;
+const std::uint64_t TIMESTAMP_MASK = (std::uint64_t{1} << DECIMALS_SHIFT) - 1;
+
+// The header takes the first page of the file, and the records follow it
+struct RingHeader
+{
+    char magic[sizeof(RING_MAGIC)];
+    std::uint64_t capacity;
+    // The positions only grow, the record of a position is at the position modulo the capacity
+    std::uint64_t head;
+    std::uint64_t tail;
+    std::uint32_t keyLength;
+    std::uint32_t referenceLength;
+    char names[NAMES_SIZE];
+};
+
+struct RingRecord
+{
+    // The timestamp in the low bits, and the count of digits the value is written with after the point in the high ones
+    std::uint64_t stamp;
+    double value;
+};
+
+static_assert(sizeof(RingHeader) == HEADER_SIZE, "The ring header must take exactly one page.");
+
+// Writes the value with a fixed count of decimals. Gives back an empty text for values too long to write.
+std::string formatNumber(double value, std::uint32_t decimals)
+{
+    char buffer[64];
+    const auto length = std::snprintf(buffer, sizeof(buffer), "%.*f", static_cast<int>(decimals), value);
+    if (length < 0 || static_cast<std::size_t>(length) >= sizeof(buffer))
+        return {};
+    return buffer;
+}
+
+// A text is kept as a number only if writing the number back with the same count of decimals gives exactly the same
+// text, so the persistence never changes the payload. Texts like '+7', '1e3', 'nan' or '0x10' stay texts.
+bool parseNumber(const std::string& text, double& value, std::uint32_t& decimals)
+{
+    if (text.empty())
+        return false;
+    const auto point = text.find('.');
+    const auto count = point != std::string::npos ? text.size() - point - 1 : std::size_t{0};
+    if (count > MAXIMUM_DECIMALS)
+        return false;
+    char* end = nullptr;
+    value = std::strtod(text.c_str(), &end);
+    if (end != text.c_str() + text.size() || !std::isfinite(value))
+        return false;
+    decimals = static_cast<std::uint32_t>(count);
+    return formatNumber(value, decimals) == text;
+}
+}    // namespace
+
+/**
+ * This is a single ring file, mapped into memory. It is only used with its mutex locked.
+ */
+class MappedRingPersistence::Ring
+{
+public:
+    static std::shared_ptr<Ring> create(const std::string& path, const std::string& key, const std::string& reference,
+                                        std::uint64_t capacity)
+    {
+        if (key.size() + reference.size() > NAMES_SIZE)
+            return nullptr;
+        auto ring = map(path, O_RDWR | O_CREAT | O_TRUNC, HEADER_SIZE + capacity * sizeof(RingRecord));
+        if (ring == nullptr)
+            return nullptr;
+        auto& header = *ring->m_header;
+        std::memcpy(header.magic, RING_MAGIC, sizeof(RING_MAGIC));
+        header.capacity = capacity;
+        header.head = 0;
+        header.tail = 0;
+        header.keyLength = static_cast<std::uint32_t>(key.size());
+        header.referenceLength = static_cast<std::uint32_t>(reference.size());
+        std::memcpy(header.names, key.data(), key.size());
+        std::memcpy(header.names + key.size(), reference.data(), reference.size());
+        ring->m_key = key;
+        ring->m_reference = reference;
+        return ring;
+    }
+
+    static std::shared_ptr<Ring> open(const std::string& path)
+    {
+        struct stat status = {};
+        if (stat(path.c_str(), &status) != 0 || static_cast<std::size_t>(status.st_size) < HEADER_SIZE)
+            return nullptr;
+        auto ring = map(path, O_RDWR, static_cast<std::size_t>(status.st_size));
+        if (ring == nullptr)
+            return nullptr;
+
+        // A file that is not a whole ring is not trusted
+        const auto& header = *ring->m_header;
+        if (std::memcmp(header.magic, RING_MAGIC, sizeof(RING_MAGIC)) != 0 || header.capacity == 0 ||
+            ring->m_length != HEADER_SIZE + header.capacity * sizeof(RingRecord) || header.head > header.tail ||
+            header.tail - header.head > header.capacity ||
+            static_cast<std::size_t>(header.keyLength) + header.referenceLength > NAMES_SIZE)
+            return nullptr;
+        ring->m_key.assign(header.names, header.keyLength);
+        ring->m_reference.assign(header.names + header.keyLength, header.referenceLength);
+        return ring;
+    }
+
+    ~Ring()
+    {
+        munmap(m_mapping, m_length);
+        ::close(m_descriptor);
+    }
+
+    Ring(const Ring&) = delete;
+    Ring& operator=(const Ring&) = delete;
+
+    // Returns whether the oldest reading had to be overwritten
+    bool push(std::uint64_t timestamp, double value, std::uint32_t decimals)
+    {
+        auto& header = *m_header;
+        const auto overwritten = header.tail - header.head == header.capacity;
+        if (overwritten)
+            ++header.head;
+        m_records[header.tail % header.capacity] =
+          RingRecord{timestamp | static_cast<std::uint64_t>(decimals) << DECIMALS_SHIFT, value};
+        ++header.tail;
+        return overwritten;
+    }
+
+    std::vector<std::shared_ptr<Reading>> read(std::uint64_t count)
+    {
+        const auto& header = *m_header;
+        const auto end = header.head + std::min(count, header.tail - header.head);
+        auto readings = std::vector<std::shared_ptr<Reading>>{};
+        readings.reserve(static_cast<std::size_t>(end - header.head));
+        for (auto position = header.head; position < end; ++position)
+        {
+            const auto& record = m_records[position % header.capacity];
+            const auto decimals = static_cast<std::uint32_t>(record.stamp >> DECIMALS_SHIFT);
+            readings.emplace_back(std::make_shared<Reading>(m_reference, formatNumber(record.value, decimals),
+                                                            record.stamp & TIMESTAMP_MASK));
+        }
+
+        // The removal that follows takes out only these readings, even if new readings overwrite some of them meanwhile
+        m_readEnd = end;
+        m_readOutstanding = true;
+        return readings;
+    }
+
+    void remove(std::uint64_t count)
+    {
+        auto& header = *m_header;
+        auto end = header.head + std::min(count, header.tail - header.head);
+        if (m_readOutstanding)
+            end = std::min(end, m_readEnd);
+        if (end > header.head)
+            header.head = end;
+        m_readOutstanding = false;
+    }
+
+    std::uint64_t size() const { return m_header->tail - m_header->head; }
+
+    const std::string& getKey() const { return m_key; }
+
+    const std::string& getReference() const { return m_reference; }
+
+    const std::string& getPath() const { return m_path; }
+
+    std::mutex mutex;
+    // Set once the feed was moved into the fallback persistence, and the ring must not be used any more
+    bool retired = false;
+
+private:
+    Ring(std::string path, int descriptor, void* mapping, std::size_t length)
+    : m_path(std::move(path))
+    , m_descriptor(descriptor)
+    , m_mapping(mapping)
+    , m_length(length)
+    , m_header(static_cast<RingHeader*>(mapping))
+    , m_records(reinterpret_cast<RingRecord*>(static_cast<char*>(mapping) + HEADER_SIZE))
+    {
+    }
+
+    static std::shared_ptr<Ring> map(const std::string& path, int flags, std::size_t length)
+    {
+        const auto descriptor = ::open(path.c_str(), flags, 0644);
+        if (descriptor < 0)
+            return nullptr;
+        if ((flags & O_CREAT) != 0 && ftruncate(descriptor, static_cast<off_t>(length)) != 0)
+        {
+            ::close(descriptor);
+            return nullptr;
+        }
+        const auto mapping = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+        if (mapping == MAP_FAILED)
+        {
+            ::close(descriptor);
+            return nullptr;
+        }
+        // The records are written and read in order, so the kernel can read ahead
+        madvise(mapping, length, MADV_SEQUENTIAL);
+        return std::shared_ptr<Ring>{new Ring{path, descriptor, mapping, length}};
+    }
+
+    std::string m_path;
+    int m_descriptor;
+    void* m_mapping;
+    std::size_t m_length;
+    RingHeader* m_header;
+    RingRecord* m_records;
+    std::string m_key;
+    std::string m_reference;
+
+    // The position after the last reading given out by a read that was not followed by a removal yet
+    std::uint64_t m_readEnd = 0;
+    bool m_readOutstanding = false;
+};
+
+MappedRingPersistence::MappedRingPersistence(std::string directory, std::uint64_t recordsPerFeed,
+                                             std::unique_ptr<Persistence> fallback)
+: m_directory(std::move(directory))
+, m_recordsPerFeed(std::max(recordsPerFeed, std::uint64_t{1}))
+, m_fallback(fallback != nullptr ? std::move(fallback) : std::unique_ptr<Persistence>{new InMemoryPersistence})
+, m_nextRing(0)
+, m_overwrittenReadings(0)
+{
+    if (!FileSystemUtils::isDirectoryPresent(m_directory))
+        FileSystemUtils::createDirectory(m_directory);
+    loadRings();
+}
+
+bool MappedRingPersistence::putReading(const std::string& key, const Reading& reading)
+{
+    auto value = 0.0;
+    auto decimals = std::uint32_t{0};
+    // A timestamp that reaches into the bits of the decimals can not be kept in a ring
+    const auto numeric = !reading.isMulti() && (reading.getTimestamp() & ~TIMESTAMP_MASK) == 0 &&
+                         parseNumber(reading.getStringValue(), value, decimals);
+    while (true)
+    {
+        const auto ring = obtainRing(key, reading, numeric);
+        if (ring == nullptr)
+            return m_fallback->putReading(key, reading);
+
+        std::lock_guard<std::mutex> lock{ring->mutex};
+        if (ring->retired)
+            continue;
+        if (ring->push(reading.getTimestamp(), value, decimals))
+            ++m_overwrittenReadings;
+        return true;
+    }
+}
+
+std::vector<std::shared_ptr<Reading>> MappedRingPersistence::getReadings(const std::string& key,
+                                                                         std::uint_fast64_t count)
+{
+    const auto ring = findRing(key);
+    if (ring != nullptr)
+    {
+        std::lock_guard<std::mutex> lock{ring->mutex};
+        if (!ring->retired)
+            return ring->read(count);
+    }
+    return m_fallback->getReadings(key, count);
+}
+
+void MappedRingPersistence::removeReadings(const std::string& key, std::uint_fast64_t count)
+{
+    const auto ring = findRing(key);
+    if (ring != nullptr)
+    {
+        std::lock_guard<std::mutex> lock{ring->mutex};
+        if (!ring->retired)
+        {
+            ring->remove(count);
+            return;
+        }
+    }
+    m_fallback->removeReadings(key, count);
+}
+
+std::vector<std::string> MappedRingPersistence::getReadingsKeys()
+{
+    auto keys = m_fallback->getReadingsKeys();
+    std::lock_guard<std::mutex> lock{m_mutex};
+    for (const auto& ring : m_rings)
+    {
+        std::lock_guard<std::mutex> ringLock{ring.second->mutex};
+        if (ring.second->size() > 0)
+            keys.emplace_back(ring.first);
+    }
+    return keys;
+}
+
+bool MappedRingPersistence::putAttribute(const std::string& key, std::shared_ptr<Attribute> attribute)
+{
+    return m_fallback->putAttribute(key, std::move(attribute));
+}
+
+std::map<std::string, std::shared_ptr<Attribute>> MappedRingPersistence::getAttributes()
+{
+    return m_fallback->getAttributes();
+}
+
+std::shared_ptr<Attribute> MappedRingPersistence::getAttributeUnderKey(const std::string& key)
+{
+    return m_fallback->getAttributeUnderKey(key);
+}
+
+void MappedRingPersistence::removeAttributes()
+{
+    m_fallback->removeAttributes();
+}
+
+void MappedRingPersistence::removeAttributes(const std::string& key)
+{
+    m_fallback->removeAttributes(key);
+}
+
+std::vector<std::string> MappedRingPersistence::getAttributeKeys()
+{
+    return m_fallback->getAttributeKeys();
+}
+
+bool MappedRingPersistence::putParameter(const std::string& key, Parameter parameter)
+{
+    return m_fallback->putParameter(key, std::move(parameter));
+}
+
+std::map<std::string, Parameter> MappedRingPersistence::getParameters()
+{
+    return m_fallback->getParameters();
+}
+
+Parameter MappedRingPersistence::getParameterForKey(const std::string& key)
+{
+    return m_fallback->getParameterForKey(key);
+}
+
+void MappedRingPersistence::removeParameters()
+{
+    m_fallback->removeParameters();
+}
+
+void MappedRingPersistence::removeParameters(const std::string& key)
+{
+    m_fallback->removeParameters(key);
+}
+
+std::vector<std::string> MappedRingPersistence::getParameterKeys()
+{
+    return m_fallback->getParameterKeys();
+}
+
+bool MappedRingPersistence::isEmpty()
+{
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        for (const auto& ring : m_rings)
+        {
+            std::lock_guard<std::mutex> ringLock{ring.second->mutex};
+            if (ring.second->size() > 0)
+                return false;
+        }
+    }
+    return m_fallback->isEmpty();
+}
+
+std::uint64_t MappedRingPersistence::getOverwrittenReadingCount() const
+{
+    return m_overwrittenReadings;
+}
+
+void MappedRingPersistence::loadRings()
+{
+    LOG(TRACE) << METHOD_INFO;
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    for (const auto& file : FileSystemUtils::listFiles(m_directory))
+    {
+        if (file.size() <= RING_EXTENSION.size() ||
+            file.compare(file.size() - RING_EXTENSION.size(), RING_EXTENSION.size(), RING_EXTENSION) != 0)
+            continue;
+        const auto path = FileSystemUtils::composePath(file, m_directory);
+        auto sequence = std::uint64_t{0};
+        try
+        {
+            sequence = std::stoull(file.substr(0, file.size() - RING_EXTENSION.size()));
+        }
+        catch (const std::exception&)
+        {
+            continue;
+        }
+
+        const auto ring = Ring::open(path);
+        if (ring == nullptr || m_rings.find(ring->getKey()) != m_rings.cend())
+        {
+            LOG(WARN) << "Deleting the unusable reading ring '" << path << "'.";
+            FileSystemUtils::deleteFile(path);
+            continue;
+        }
+        m_rings.emplace(ring->getKey(), ring);
+        m_nextRing = std::max(m_nextRing, sequence + 1);
+    }
+}
+
+std::shared_ptr<MappedRingPersistence::Ring> MappedRingPersistence::obtainRing(const std::string& key,
+                                                                               const Reading& reading, bool numeric)
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    const auto it = m_rings.find(key);
+    if (it != m_rings.cend())
+    {
+        if (numeric && it->second->getReference() == reading.getReference())
+            return it->second;
+        retireRing(key);
+        return nullptr;
+    }
+    if (m_fallbackKeys.find(key) != m_fallbackKeys.cend())
+        return nullptr;
+    if (!numeric)
+    {
+        m_fallbackKeys.emplace(key);
+        return nullptr;
+    }
+
+    const auto path = FileSystemUtils::composePath(std::to_string(m_nextRing++) + RING_EXTENSION, m_directory);
+    const auto ring = Ring::create(path, key, reading.getReference(), m_recordsPerFeed);
+    if (ring == nullptr)
+    {
+        LOG(ERROR) << "Failed to make a reading ring for '" << key << "' -> Keeping its readings in the fallback.";
+        FileSystemUtils::deleteFile(path);
+        m_fallbackKeys.emplace(key);
+        return nullptr;
+    }
+    m_rings.emplace(key, ring);
+    return ring;
+}
+
+void MappedRingPersistence::retireRing(const std::string& key)
+{
+    LOG(TRACE) << METHOD_INFO;
+
+    // The readings are moved over before any new reading of the feed reaches the fallback, so their order is kept
+    const auto it = m_rings.find(key);
+    const auto ring = it->second;
+    {
+        std::lock_guard<std::mutex> lock{ring->mutex};
+        for (const auto& reading : ring->read(ring->size()))
+            m_fallback->putReading(key, *reading);
+        ring->retired = true;
+    }
+    FileSystemUtils::deleteFile(ring->getPath());
+    m_rings.erase(it);
+    m_fallbackKeys.emplace(key);
+}
+
+std::shared_ptr<MappedRingPersistence::Ring> MappedRingPersistence::findRing(const std::string& key) const
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    const auto it = m_rings.find(key);
+    return it != m_rings.cend() ? it->second : nullptr;
+}
+}    // namespace connect
+}    // namespace wolkabout
@@ -0,0 +1,138 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WOLKABOUTCONNECTOR_MAPPEDRINGPERSISTENCE_H
+#define WOLKABOUTCONNECTOR_MAPPEDRINGPERSISTENCE_H
+
+#include "core/persistence/Persistence.h"
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace wolkabout
+{
+namespace connect
+{
+/**
+ * This is a persistence that keeps the readings of numeric feeds in memory-mapped circular files, one per feed.
+ *
+ * A feed whose first reading holds a single number gets a ring file of fixed-size (timestamp, value) records, so
+ * storing a reading is a copy into the mapping, without allocating, and the readings of a batch are read back from
+ * consecutive records. The mapping is shared with the page cache, so the stored readings survive a crash of the
+ * process, and are picked up again when the persistence is made with the same directory. Once a ring is full, every new
+ * reading overwrites the oldest one. A removal that follows `getReadings` takes out only the readings it gave out, so
+ * readings overwritten in between do not make it remove newer ones that were never published.
+ *
+ * Every record keeps the count of decimals its value came with, packed into the high bits of its timestamp, and a
+ * value is only placed into a ring if writing the number back with those decimals gives exactly the text it came with.
+ * So '20.500000' comes back as '20.500000', '20.5' followed by '21' both come back as they were, and '+7' or '1e3' are
+ * never treated as numbers. A feed that later receives a reading that does not fit, a text, several values, or a
+ * different reference, is moved with its readings into the fallback persistence, which also holds all the other feeds,
+ * the attributes and the parameters.
+ */
+class MappedRingPersistence : public Persistence
+{
+public:
+    /**
+     * Default parameter constructor.
+     *
+     * @param directory The directory of the ring files.
+     * @param recordsPerFeed The count of readings a ring file holds.
+     * @param fallback The persistence for everything that is not kept in a ring. In-memory if not set.
+     */
+    explicit MappedRingPersistence(std::string directory, std::uint64_t recordsPerFeed = 65536,
+                                   std::unique_ptr<Persistence> fallback = nullptr);
+
+    bool putReading(const std::string& key, const Reading& reading) override;
+
+    std::vector<std::shared_ptr<Reading>> getReadings(const std::string& key, std::uint_fast64_t count) override;
+
+    void removeReadings(const std::string& key, std::uint_fast64_t count) override;
+
+    std::vector<std::string> getReadingsKeys() override;
+
+    bool putAttribute(const std::string& key, std::shared_ptr<Attribute> attribute) override;
+
+    std::map<std::string, std::shared_ptr<Attribute>> getAttributes() override;
+
+    std::shared_ptr<Attribute> getAttributeUnderKey(const std::string& key) override;
+
+    void removeAttributes() override;
+
+    void removeAttributes(const std::string& key) override;
+
+    std::vector<std::string> getAttributeKeys() override;
+
+    bool putParameter(const std::string& key, Parameter parameter) override;
+
+    std::map<std::string, Parameter> getParameters() override;
+
+    Parameter getParameterForKey(const std::string& key) override;
+
+    void removeParameters() override;
+
+    void removeParameters(const std::string& key) override;
+
+    std::vector<std::string> getParameterKeys() override;
+
+    bool isEmpty() override;
+
+    /**
+     * Getter for the count of readings that were overwritten by newer readings because their ring was full.
+     *
+     * @return The count of readings.
+     */
+    std::uint64_t getOverwrittenReadingCount() const;
+
+private:
+    class Ring;
+
+    // Internal method used to pick up the ring files left in the directory
+    void loadRings();
+
+    // Internal method used to find the ring of a feed, or make one if the reading fits. Returns nothing for the feeds
+    // kept in the fallback persistence.
+    std::shared_ptr<Ring> obtainRing(const std::string& key, const Reading& reading, bool numeric);
+
+    // Internal method used to move a feed with all its readings into the fallback persistence. Must be called with the
+    // mutex locked.
+    void retireRing(const std::string& key);
+
+    // Internal method used to find the ring of a feed, if it has one
+    std::shared_ptr<Ring> findRing(const std::string& key) const;
+
+    std::string m_directory;
+    std::uint64_t m_recordsPerFeed;
+    std::unique_ptr<Persistence> m_fallback;
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<std::string, std::shared_ptr<Ring>> m_rings;
+    std::unordered_set<std::string> m_fallbackKeys;
+    std::uint64_t m_nextRing;
+
+    std::atomic<std::uint64_t> m_overwrittenReadings;
+};
+}    // namespace connect
+}    // namespace wolkabout
+
+#endif    // WOLKABOUTCONNECTOR_MAPPEDRINGPERSISTENCE_H
@@ -0,0 +1,215 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wolk/persistence/ShardedPersistence.h"
+
+#include "core/persistence/inmemory/InMemoryPersistence.h"
+
+#include <algorithm>
+#include <queue>
+#include <thread>
+
+namespace wolkabout
+{
+namespace connect
+{
+namespace
+{
+const char DEVICE_KEY_DELIMITER = '+';
+
+std::size_t resolveShardCount(std::size_t shardCount)
+{
+    if (shardCount > 0)
+        return shardCount;
+    return std::max(std::size_t{1}, static_cast<std::size_t>(std::thread::hardware_concurrency()));
+}
+
+// Merges the keys of every shard into a single ordered list. The shards never share a key, so each shard is sorted on
+// its own, and the lists are merged by always taking the smallest head.
+std::vector<std::string> mergeKeys(std::vector<std::vector<std::string>> keysOfShards)
+{
+    using Cursor = std::pair<std::vector<std::string>::const_iterator, std::vector<std::string>::const_iterator>;
+    const auto greater = [](const Cursor& left, const Cursor& right) { return *left.first > *right.first; };
+    auto heads = std::priority_queue<Cursor, std::vector<Cursor>, decltype(greater)>{greater};
+
+    auto total = std::size_t{0};
+    for (auto& keys : keysOfShards)
+    {
+        std::sort(keys.begin(), keys.end());
+        total += keys.size();
+        if (!keys.empty())
+            heads.emplace(keys.cbegin(), keys.cend());
+    }
+
+    auto merged = std::vector<std::string>{};
+    merged.reserve(total);
+    while (!heads.empty())
+    {
+        auto head = heads.top();
+        heads.pop();
+        merged.emplace_back(*head.first);
+        if (++head.first != head.second)
+            heads.emplace(head);
+    }
+    return merged;
+}
+}    // namespace
+
+ShardedPersistence::ShardedPersistence(std::size_t shardCount)
+: ShardedPersistence(shardCount, [] { return std::unique_ptr<Persistence>{new InMemoryPersistence}; })
+{
+}
+
+ShardedPersistence::ShardedPersistence(std::size_t shardCount,
+                                       const std::function<std::unique_ptr<Persistence>()>& shardFactory)
+{
+    const auto count = resolveShardCount(shardCount);
+    m_shards.reserve(count);
+    for (auto i = std::size_t{0}; i < count; ++i)
+        m_shards.emplace_back(shardFactory());
+}
+
+bool ShardedPersistence::putReading(const std::string& key, const Reading& reading)
+{
+    return getShard(key).putReading(key, reading);
+}
+
+std::vector<std::shared_ptr<Reading>> ShardedPersistence::getReadings(const std::string& key, std::uint_fast64_t count)
+{
+    return getShard(key).getReadings(key, count);
+}
+
+void ShardedPersistence::removeReadings(const std::string& key, std::uint_fast64_t count)
+{
+    getShard(key).removeReadings(key, count);
+}
+
+std::vector<std::string> ShardedPersistence::getReadingsKeys()
+{
+    auto keysOfShards = std::vector<std::vector<std::string>>{};
+    keysOfShards.reserve(m_shards.size());
+    for (const auto& shard : m_shards)
+        keysOfShards.emplace_back(shard->getReadingsKeys());
+    return mergeKeys(std::move(keysOfShards));
+}
+
+bool ShardedPersistence::putAttribute(const std::string& key, std::shared_ptr<Attribute> attribute)
+{
+    return getShard(key).putAttribute(key, std::move(attribute));
+}
+
+std::map<std::string, std::shared_ptr<Attribute>> ShardedPersistence::getAttributes()
+{
+    auto attributes = std::map<std::string, std::shared_ptr<Attribute>>{};
+    for (const auto& shard : m_shards)
+    {
+        const auto attributesOfShard = shard->getAttributes();
+        attributes.insert(attributesOfShard.cbegin(), attributesOfShard.cend());
+    }
+    return attributes;
+}
+
+std::shared_ptr<Attribute> ShardedPersistence::getAttributeUnderKey(const std::string& key)
+{
+    return getShard(key).getAttributeUnderKey(key);
+}
+
+void ShardedPersistence::removeAttributes()
+{
+    for (const auto& shard : m_shards)
+        shard->removeAttributes();
+}
+
+void ShardedPersistence::removeAttributes(const std::string& key)
+{
+    getShard(key).removeAttributes(key);
+}
+
+std::vector<std::string> ShardedPersistence::getAttributeKeys()
+{
+    auto keysOfShards = std::vector<std::vector<std::string>>{};
+    keysOfShards.reserve(m_shards.size());
+    for (const auto& shard : m_shards)
+        keysOfShards.emplace_back(shard->getAttributeKeys());
+    return mergeKeys(std::move(keysOfShards));
+}
+
+bool ShardedPersistence::putParameter(const std::string& key, Parameter parameter)
+{
+    return getShard(key).putParameter(key, std::move(parameter));
+}
+
+std::map<std::string, Parameter> ShardedPersistence::getParameters()
+{
+    auto parameters = std::map<std::string, Parameter>{};
+    for (const auto& shard : m_shards)
+    {
+        const auto parametersOfShard = shard->getParameters();
+        parameters.insert(parametersOfShard.cbegin(), parametersOfShard.cend());
+    }
+    return parameters;
+}
+
+Parameter ShardedPersistence::getParameterForKey(const std::string& key)
+{
+    return getShard(key).getParameterForKey(key);
+}
+
+void ShardedPersistence::removeParameters()
+{
+    for (const auto& shard : m_shards)
+        shard->removeParameters();
+}
+
+void ShardedPersistence::removeParameters(const std::string& key)
+{
+    getShard(key).removeParameters(key);
+}
+
+std::vector<std::string> ShardedPersistence::getParameterKeys()
+{
+    auto keysOfShards = std::vector<std::vector<std::string>>{};
+    keysOfShards.reserve(m_shards.size());
+    for (const auto& shard : m_shards)
+        keysOfShards.emplace_back(shard->getParameterKeys());
+    return mergeKeys(std::move(keysOfShards));
+}
+
+bool ShardedPersistence::isEmpty()
+{
+    return std::all_of(m_shards.cbegin(), m_shards.cend(),
+                       [](const std::unique_ptr<Persistence>& shard) { return shard->isEmpty(); });
+}
+
+std::size_t ShardedPersistence::getShardCount() const
+{
+    return m_shards.size();
+}
+
+Persistence& ShardedPersistence::getShard(const std::string& key) const
+{
+    // Only the device key part is hashed, so a device key on its own lands in the same shard as its feeds. The hash is
+    // taken in place, so finding the shard does not allocate.
+    auto hash = std::uint64_t{14695981039346656037ull};
+    for (auto it = key.cbegin(); it != key.cend() && *it != DEVICE_KEY_DELIMITER; ++it)
+    {
+        hash ^= static_cast<unsigned char>(*it);
+        hash *= 1099511628211ull;
+    }
+    return *m_shards[static_cast<std::size_t>(hash % m_shards.size())];
+}
+}    // namespace connect
+}    // namespace wolkabout
@@ -0,0 +1,107 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WOLKABOUTCONNECTOR_SHARDEDPERSISTENCE_H
+#define WOLKABOUTCONNECTOR_SHARDEDPERSISTENCE_H
+
+#include "core/persistence/Persistence.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace wolkabout
+{
+namespace connect
+{
+/**
+ * This is a persistence that spreads the keys over a number of independent persistence instances, the shards.
+ *
+ * The data service composes the keys as '<device key>+<name>', and the shard is picked by the hash of the device key
+ * part, so all the readings, attributes and parameters of a device live in the same shard, and the threads working
+ * with different devices mostly lock different shards. The calls that span all the keys visit every shard, and the
+ * keys they return are merged in order.
+ */
+class ShardedPersistence : public Persistence
+{
+public:
+    /**
+     * Default parameter constructor. The shards are in-memory persistence instances.
+     *
+     * @param shardCount The count of shards. If zero, one shard per hardware thread is made.
+     */
+    explicit ShardedPersistence(std::size_t shardCount = 0);
+
+    /**
+     * Parameter constructor for shards of any persistence.
+     *
+     * @param shardCount The count of shards. If zero, one shard per hardware thread is made.
+     * @param shardFactory The function making a single shard.
+     */
+    ShardedPersistence(std::size_t shardCount, const std::function<std::unique_ptr<Persistence>()>& shardFactory);
+
+    bool putReading(const std::string& key, const Reading& reading) override;
+
+    std::vector<std::shared_ptr<Reading>> getReadings(const std::string& key, std::uint_fast64_t count) override;
+
+    void removeReadings(const std::string& key, std::uint_fast64_t count) override;
+
+    std::vector<std::string> getReadingsKeys() override;
+
+    bool putAttribute(const std::string& key, std::shared_ptr<Attribute> attribute) override;
+
+    std::map<std::string, std::shared_ptr<Attribute>> getAttributes() override;
+
+    std::shared_ptr<Attribute> getAttributeUnderKey(const std::string& key) override;
+
+    void removeAttributes() override;
+
+    void removeAttributes(const std::string& key) override;
+
+    std::vector<std::string> getAttributeKeys() override;
+
+    bool putParameter(const std::string& key, Parameter parameter) override;
+
+    std::map<std::string, Parameter> getParameters() override;
+
+    Parameter getParameterForKey(const std::string& key) override;
+
+    void removeParameters() override;
+
+    void removeParameters(const std::string& key) override;
+
+    std::vector<std::string> getParameterKeys() override;
+
+    bool isEmpty() override;
+
+    /**
+     * Getter for the count of shards.
+     *
+     * @return The count of shards.
+     */
+    std::size_t getShardCount() const;
+
+private:
+    // Internal method used to find the shard the key belongs to
+    Persistence& getShard(const std::string& key) const;
+
+    std::vector<std::unique_ptr<Persistence>> m_shards;
+};
+}    // namespace connect
+}    // namespace wolkabout
+
+#endif    // WOLKABOUTCONNECTOR_SHARDEDPERSISTENCE_H
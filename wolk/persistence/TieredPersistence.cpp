@@ -0,0 +1,710 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wolk/persistence/TieredPersistence.h"
+
+#include "core/utilities/FileSystemUtils.h"
+#include "core/utilities/Logger.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+namespace wolkabout
+{
+namespace connect
+{
+namespace
+{
+const std::string SEGMENT_MAGIC = "WRS1";
+const char RAW_SEGMENT = 'R';
+const char COMPRESSED_SEGMENT = 'Z';
+const std::string SEGMENT_EXTENSION = ".segment";
+const std::string TEMPORARY_EXTENSION = ".tmp";
+
+// The most readings of a single feed that are moved into one segment
+const std::size_t SPILL_BATCH_SIZE = 1024;
+
+// Once the budget is exceeded, readings are spilled until the memory use drops to this share of the budget, so the
+// segments are not written one reading at a time
+const std::uint64_t SPILL_WATERMARK_PERCENT = 75;
+
+// The most times a segment is halved by the downsampling policy before it is deleted
+const std::uint32_t MAXIMUM_DOWNSAMPLE_COUNT = 3;
+
+// The memory a reading takes, with the shared pointer and the strings it owns
+std::uint64_t estimateSize(const Reading& reading)
+{
+    auto size = static_cast<std::uint64_t>(sizeof(Reading) + 2 * sizeof(std::shared_ptr<Reading>)) +
+                reading.getReference().size();
+    for (const auto& value : reading.getStringValues())
+        size += sizeof(std::string) + value.size();
+    return size;
+}
+
+void appendVarint(std::string& output, std::uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        output += static_cast<char>((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    output += static_cast<char>(value);
+}
+
+bool readVarint(const std::string& input, std::size_t& position, std::uint64_t& value)
+{
+    value = 0;
+    for (auto shift = 0u; shift < 64 && position < input.size(); shift += 7)
+    {
+        const auto byte = static_cast<std::uint8_t>(input[position++]);
+        value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+            return true;
+    }
+    return false;
+}
+
+void appendString(std::string& output, const std::string& value)
+{
+    appendVarint(output, value.size());
+    output += value;
+}
+
+bool readString(const std::string& input, std::size_t& position, std::string& value)
+{
+    auto size = std::uint64_t{0};
+    if (!readVarint(input, position, size) || size > input.size() - position)
+        return false;
+    value = input.substr(position, static_cast<std::size_t>(size));
+    position += static_cast<std::size_t>(size);
+    return true;
+}
+
+// The readings of a segment belong to one feed, so the reference is only written when it changes, and the timestamps,
+// which are close to each other, are written as zigzag encoded differences.
+std::string encodeSegment(const std::string& key, const std::vector<std::shared_ptr<Reading>>& readings)
+{
+    auto body = std::string{};
+    appendString(body, key);
+    appendVarint(body, readings.size());
+    auto reference = std::string{};
+    auto timestamp = std::uint64_t{0};
+    for (const auto& reading : readings)
+    {
+        const auto values = reading->getStringValues();
+        const auto referenceChanged = reading->getReference() != reference;
+        appendVarint(body, (static_cast<std::uint64_t>(values.size()) << 1) | (referenceChanged ? 1 : 0));
+        if (referenceChanged)
+        {
+            reference = reading->getReference();
+            appendString(body, reference);
+        }
+        const auto difference = static_cast<std::int64_t>(reading->getTimestamp() - timestamp);
+        appendVarint(body,
+                     (static_cast<std::uint64_t>(difference) << 1) ^ static_cast<std::uint64_t>(difference >> 63));
+        timestamp = reading->getTimestamp();
+        for (const auto& value : values)
+            appendString(body, value);
+    }
+    return body;
+}
+
+bool decodeSegment(const std::string& body, std::string& key, std::vector<std::shared_ptr<Reading>>& readings)
+{
+    auto position = std::size_t{0};
+    auto count = std::uint64_t{0};
+    if (!readString(body, position, key) || !readVarint(body, position, count))
+        return false;
+
+    readings.clear();
+    auto reference = std::string{};
+    auto timestamp = std::uint64_t{0};
+    for (auto i = std::uint64_t{0}; i < count; ++i)
+    {
+        auto header = std::uint64_t{0};
+        auto difference = std::uint64_t{0};
+        if (!readVarint(body, position, header) || ((header & 1) != 0 && !readString(body, position, reference)) ||
+            !readVarint(body, position, difference))
+            return false;
+        timestamp += (difference >> 1) ^ (~(difference & 1) + 1);
+
+        auto values = std::vector<std::string>(static_cast<std::size_t>(header >> 1));
+        for (auto& value : values)
+        {
+            if (!readString(body, position, value))
+                return false;
+        }
+        if (values.size() == 1)
+            readings.emplace_back(std::make_shared<Reading>(reference, values.front(), timestamp));
+        else
+            readings.emplace_back(std::make_shared<Reading>(reference, values, timestamp));
+    }
+    return position == body.size();
+}
+}    // namespace
+
+TieredPersistence::TieredPersistence(TieredPersistenceConfiguration configuration)
+: m_configuration(std::move(configuration))
+, m_nextReading(0)
+, m_nextSegment(0)
+, m_cachedSequence(0)
+, m_spilling(false)
+, m_stopping(false)
+{
+    if (!FileSystemUtils::isDirectoryPresent(m_configuration.segmentDirectory))
+        FileSystemUtils::createDirectory(m_configuration.segmentDirectory);
+    loadSegments();
+    m_spillThread = std::thread{&TieredPersistence::runSpill, this};
+}
+
+TieredPersistence::~TieredPersistence()
+{
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        m_stopping = true;
+    }
+    m_spillCondition.notify_all();
+    if (m_spillThread.joinable())
+        m_spillThread.join();
+}
+
+bool TieredPersistence::putReading(const std::string& key, const Reading& reading)
+{
+    const auto size = estimateSize(reading);
+    auto stored = std::make_shared<Reading>(reading);
+
+    // The spill thread takes care of the readings over the budget, so this never waits for the disk
+    auto overBudget = false;
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        auto& feed = m_feeds[key];
+        feed.readings.emplace_back(m_nextReading++, std::move(stored));
+        ++feed.nextOrdinal;
+        feed.memoryBytes += size;
+        m_usage.memoryBytes += size;
+        ++m_usage.memoryReadings;
+        overBudget = m_usage.memoryBytes > m_configuration.memoryBudget;
+    }
+    if (overBudget)
+        m_spillCondition.notify_all();
+    return true;
+}
+
+std::vector<std::shared_ptr<Reading>> TieredPersistence::getReadings(const std::string& key, std::uint_fast64_t count)
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    auto readings = std::vector<std::shared_ptr<Reading>>{};
+    const auto it = m_feeds.find(key);
+    if (it == m_feeds.cend())
+        return readings;
+
+    // The segments hold the oldest readings, so they are read first. The ordinal after the last reading given out is
+    // remembered, so the removal that follows takes out only these readings.
+    auto& feed = it->second;
+    auto readEnd = std::uint64_t{0};
+    for (const auto& segment : feed.segments)
+    {
+        if (readings.size() >= count)
+            break;
+
+        // The batches are usually read from the same segment until it is removed, so it is decoded only once
+        if (m_cachedReadings.empty() || m_cachedSequence != segment.sequence)
+        {
+            auto segmentKey = std::string{};
+            auto segmentReadings = std::vector<std::shared_ptr<Reading>>{};
+            if (!readSegment(segment.path, segmentKey, segmentReadings))
+                continue;
+            m_cachedSequence = segment.sequence;
+            m_cachedReadings = std::move(segmentReadings);
+        }
+        for (auto i = static_cast<std::size_t>(segment.removedCount);
+             i < m_cachedReadings.size() && readings.size() < count; ++i)
+        {
+            readings.emplace_back(m_cachedReadings[i]);
+            readEnd = segment.firstOrdinal + i * segment.ordinalStride + 1;
+        }
+    }
+    const auto firstMemoryOrdinal = feed.nextOrdinal - feed.readings.size();
+    for (auto i = std::size_t{0}; i < feed.readings.size() && readings.size() < count; ++i)
+    {
+        readings.emplace_back(feed.readings[i].second);
+        readEnd = firstMemoryOrdinal + i + 1;
+    }
+    if (!readings.empty())
+    {
+        feed.readEnd = readEnd;
+        feed.readOutstanding = true;
+    }
+    return readings;
+}
+
+void TieredPersistence::removeReadings(const std::string& key, std::uint_fast64_t count)
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    const auto it = m_feeds.find(key);
+    if (it == m_feeds.end())
+        return;
+
+    // After a read, the readings newer than the ones it gave out are left alone
+    auto& feed = it->second;
+    const auto limit = feed.readOutstanding ? feed.readEnd : feed.nextOrdinal;
+    feed.readOutstanding = false;
+    auto remaining = static_cast<std::uint64_t>(count);
+    while (remaining > 0 && !feed.segments.empty())
+    {
+        auto& segment = feed.segments.front();
+        const auto front = segment.firstOrdinal + segment.removedCount * segment.ordinalStride;
+        if (front >= limit)
+            break;
+        const auto given = (limit - front + segment.ordinalStride - 1) / segment.ordinalStride;
+        const auto taken = std::min({remaining, given, segment.readingCount - segment.removedCount});
+        segment.removedCount += taken;
+        m_usage.diskReadings -= taken;
+        remaining -= taken;
+        if (segment.removedCount == segment.readingCount)
+        {
+            // The readings were already counted out, so only the bytes are left to be released
+            segment.readingCount = 0;
+            segment.removedCount = 0;
+            dropSegment(key, feed);
+        }
+    }
+    while (remaining > 0 && !feed.readings.empty() && feed.nextOrdinal - feed.readings.size() < limit)
+    {
+        const auto size = estimateSize(*feed.readings.front().second);
+        feed.memoryBytes -= size;
+        m_usage.memoryBytes -= size;
+        --m_usage.memoryReadings;
+        feed.readings.pop_front();
+        --remaining;
+    }
+    eraseIfEmpty(it);
+}
+
+std::vector<std::string> TieredPersistence::getReadingsKeys()
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    auto keys = std::vector<std::string>{};
+    keys.reserve(m_feeds.size());
+    for (const auto& feed : m_feeds)
+    {
+        if (!feed.second.readings.empty() || !feed.second.segments.empty())
+            keys.emplace_back(feed.first);
+    }
+    return keys;
+}
+
+bool TieredPersistence::putAttribute(const std::string& key, std::shared_ptr<Attribute> attribute)
+{
+    return m_metadata.putAttribute(key, std::move(attribute));
+}
+
+std::map<std::string, std::shared_ptr<Attribute>> TieredPersistence::getAttributes()
+{
+    return m_metadata.getAttributes();
+}
+
+std::shared_ptr<Attribute> TieredPersistence::getAttributeUnderKey(const std::string& key)
+{
+    return m_metadata.getAttributeUnderKey(key);
+}
+
+void TieredPersistence::removeAttributes()
+{
+    m_metadata.removeAttributes();
+}
+
+void TieredPersistence::removeAttributes(const std::string& key)
+{
+    m_metadata.removeAttributes(key);
+}
+
+std::vector<std::string> TieredPersistence::getAttributeKeys()
+{
+    return m_metadata.getAttributeKeys();
+}
+
+bool TieredPersistence::putParameter(const std::string& key, Parameter parameter)
+{
+    return m_metadata.putParameter(key, std::move(parameter));
+}
+
+std::map<std::string, Parameter> TieredPersistence::getParameters()
+{
+    return m_metadata.getParameters();
+}
+
+Parameter TieredPersistence::getParameterForKey(const std::string& key)
+{
+    return m_metadata.getParameterForKey(key);
+}
+
+void TieredPersistence::removeParameters()
+{
+    m_metadata.removeParameters();
+}
+
+void TieredPersistence::removeParameters(const std::string& key)
+{
+    m_metadata.removeParameters(key);
+}
+
+std::vector<std::string> TieredPersistence::getParameterKeys()
+{
+    return m_metadata.getParameterKeys();
+}
+
+bool TieredPersistence::isEmpty()
+{
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        for (const auto& feed : m_feeds)
+        {
+            if (!feed.second.readings.empty() || !feed.second.segments.empty())
+                return false;
+        }
+    }
+    return m_metadata.isEmpty();
+}
+
+TieredPersistenceUsage TieredPersistence::getUsage() const
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    return m_usage;
+}
+
+void TieredPersistence::flush()
+{
+    std::unique_lock<std::mutex> lock{m_mutex};
+    m_spillCondition.wait(lock, [&] {
+        return m_stopping || (!m_spilling && m_usage.memoryBytes <= m_configuration.memoryBudget);
+    });
+}
+
+void TieredPersistence::loadSegments()
+{
+    LOG(TRACE) << METHOD_INFO;
+
+    // The segments are picked up in the order they were written, which is the order of their readings within a feed
+    auto sequences = std::vector<std::uint64_t>{};
+    for (const auto& file : FileSystemUtils::listFiles(m_configuration.segmentDirectory))
+    {
+        const auto path = FileSystemUtils::composePath(file, m_configuration.segmentDirectory);
+        if (file.size() > SEGMENT_EXTENSION.size() &&
+            file.compare(file.size() - SEGMENT_EXTENSION.size(), SEGMENT_EXTENSION.size(), SEGMENT_EXTENSION) == 0)
+        {
+            try
+            {
+                sequences.emplace_back(std::stoull(file.substr(0, file.size() - SEGMENT_EXTENSION.size())));
+                continue;
+            }
+            catch (const std::exception&)
+            {
+            }
+        }
+        // Anything else in the directory is left over from a segment that was never finished
+        FileSystemUtils::deleteFile(path);
+    }
+    std::sort(sequences.begin(), sequences.end());
+
+    for (const auto sequence : sequences)
+    {
+        const auto path = FileSystemUtils::composePath(std::to_string(sequence) + SEGMENT_EXTENSION,
+                                                       m_configuration.segmentDirectory);
+        auto key = std::string{};
+        auto readings = std::vector<std::shared_ptr<Reading>>{};
+        if (!readSegment(path, key, readings))
+        {
+            LOG(WARN) << "Deleting the unreadable reading segment '" << path << "'.";
+            FileSystemUtils::deleteFile(path);
+            continue;
+        }
+        const auto bytes =
+          static_cast<std::uint64_t>(std::ifstream{path, std::ios::in | std::ios::binary | std::ios::ate}.tellg());
+        auto& feed = m_feeds[key];
+        feed.segments.push_back(Segment{sequence, path, bytes, readings.size(), 0, 0, feed.nextOrdinal, 1});
+        feed.nextOrdinal += readings.size();
+        feed.diskBytes += bytes;
+        m_usage.diskBytes += bytes;
+        m_usage.diskReadings += readings.size();
+        ++m_usage.segmentCount;
+        m_nextSegment = sequence + 1;
+    }
+    enforceDiskBudget();
+}
+
+void TieredPersistence::runSpill()
+{
+    LOG(TRACE) << METHOD_INFO;
+
+    std::unique_lock<std::mutex> lock{m_mutex};
+    while (true)
+    {
+        m_spillCondition.wait(lock,
+                              [&] { return m_stopping || m_usage.memoryBytes > m_configuration.memoryBudget; });
+        if (m_stopping)
+            return;
+        m_spilling = true;
+        spill(lock);
+        m_spilling = false;
+        m_spillCondition.notify_all();
+    }
+}
+
+void TieredPersistence::spill(std::unique_lock<std::mutex>& lock)
+{
+    LOG(TRACE) << METHOD_INFO;
+
+    const auto watermark = m_configuration.memoryBudget / 100 * SPILL_WATERMARK_PERCENT;
+    while (!m_stopping && m_usage.memoryBytes > watermark)
+    {
+        // The feed holding the oldest reading in memory gives up its oldest readings
+        auto oldest = m_feeds.end();
+        for (auto it = m_feeds.begin(); it != m_feeds.end(); ++it)
+        {
+            if (!it->second.readings.empty() &&
+                (oldest == m_feeds.end() || it->second.readings.front().first < oldest->second.readings.front().first))
+                oldest = it;
+        }
+        if (oldest == m_feeds.end())
+            return;
+
+        const auto key = oldest->first;
+        const auto& memoryReadings = oldest->second.readings;
+        const auto count = std::min(memoryReadings.size(), SPILL_BATCH_SIZE);
+        const auto firstReading = memoryReadings.front().first;
+        const auto lastReading = memoryReadings[count - 1].first;
+        const auto firstOrdinal = oldest->second.nextOrdinal - memoryReadings.size();
+        auto readings = std::vector<std::shared_ptr<Reading>>{};
+        readings.reserve(count);
+        for (auto i = std::size_t{0}; i < count; ++i)
+            readings.emplace_back(memoryReadings[i].second);
+
+        // The segment is written without the lock, and the readings stay in memory meanwhile, so they can still be
+        // read, removed, or added to
+        const auto sequence = m_nextSegment++;
+        const auto path =
+          FileSystemUtils::composePath(std::to_string(sequence) + SEGMENT_EXTENSION, m_configuration.segmentDirectory);
+        auto bytes = std::uint64_t{0};
+        lock.unlock();
+        const auto written = writeSegment(path, key, readings, bytes);
+        lock.lock();
+
+        // If some of the readings were removed in the meantime, the segment is not what is in memory any more
+        const auto it = m_feeds.find(key);
+        if (it == m_feeds.end() || it->second.readings.size() < count ||
+            it->second.readings.front().first != firstReading || it->second.readings[count - 1].first != lastReading)
+        {
+            if (written)
+                FileSystemUtils::deleteFile(path);
+            continue;
+        }
+
+        auto& feed = it->second;
+        auto size = std::uint64_t{0};
+        for (auto i = std::size_t{0}; i < count; ++i)
+            size += estimateSize(*feed.readings[i].second);
+        feed.readings.erase(feed.readings.begin(), feed.readings.begin() + static_cast<std::ptrdiff_t>(count));
+        feed.memoryBytes -= size;
+        m_usage.memoryBytes -= size;
+        m_usage.memoryReadings -= count;
+        if (!written)
+        {
+            LOG(ERROR) << "Failed to spill readings to the disk -> Dropping " << count << " readings of '" << key
+                       << "'.";
+            m_usage.droppedReadings += count;
+            eraseIfEmpty(it);
+            continue;
+        }
+        feed.segments.push_back(Segment{sequence, path, bytes, count, 0, 0, firstOrdinal, 1});
+        feed.diskBytes += bytes;
+        m_usage.diskBytes += bytes;
+        m_usage.diskReadings += count;
+        m_usage.spilledReadings += count;
+        ++m_usage.segmentCount;
+        enforceDiskBudget();
+    }
+}
+
+void TieredPersistence::enforceDiskBudget()
+{
+    while (m_usage.diskBytes > m_configuration.diskBudget)
+    {
+        // Every policy starts from the front segments of the feeds, since those hold the oldest readings
+        auto oldest = m_feeds.end();
+        auto largest = m_feeds.end();
+        auto downsampleable = m_feeds.end();
+        for (auto it = m_feeds.begin(); it != m_feeds.end(); ++it)
+        {
+            if (it->second.segments.empty())
+                continue;
+            const auto& front = it->second.segments.front();
+            if (oldest == m_feeds.end() || front.sequence < oldest->second.segments.front().sequence)
+                oldest = it;
+            if (largest == m_feeds.end() || it->second.diskBytes > largest->second.diskBytes)
+                largest = it;
+            if (front.readingCount - front.removedCount > 1 && front.downsampleCount < MAXIMUM_DOWNSAMPLE_COUNT &&
+                (downsampleable == m_feeds.end() ||
+                 front.sequence < downsampleable->second.segments.front().sequence))
+                downsampleable = it;
+        }
+        if (oldest == m_feeds.end())
+            return;
+
+        switch (m_configuration.dropPolicy)
+        {
+        case ReadingDropPolicy::OldestFirst:
+            dropSegment(oldest->first, oldest->second);
+            eraseIfEmpty(oldest);
+            break;
+        case ReadingDropPolicy::PerFeedQuota:
+            dropSegment(largest->first, largest->second);
+            eraseIfEmpty(largest);
+            break;
+        case ReadingDropPolicy::DownsampleOnPressure:
+            if (downsampleable != m_feeds.end() &&
+                downsample(downsampleable->second, downsampleable->second.segments.front()))
+                break;
+            dropSegment(oldest->first, oldest->second);
+            eraseIfEmpty(oldest);
+            break;
+        }
+    }
+}
+
+void TieredPersistence::dropSegment(const std::string& key, Feed& feed)
+{
+    const auto& segment = feed.segments.front();
+    const auto dropped = segment.readingCount - segment.removedCount;
+    if (dropped > 0)
+        LOG(WARN) << "Dropping " << dropped << " readings of '" << key << "' to fit the disk budget.";
+    FileSystemUtils::deleteFile(segment.path);
+    feed.diskBytes -= segment.bytes;
+    m_usage.diskBytes -= segment.bytes;
+    m_usage.diskReadings -= dropped;
+    m_usage.droppedReadings += dropped;
+    --m_usage.segmentCount;
+    if (segment.sequence == m_cachedSequence)
+        m_cachedReadings.clear();
+    feed.segments.pop_front();
+}
+
+bool TieredPersistence::downsample(Feed& feed, Segment& segment)
+{
+    auto key = std::string{};
+    auto readings = std::vector<std::shared_ptr<Reading>>{};
+    if (!readSegment(segment.path, key, readings))
+        return false;
+
+    auto kept = std::vector<std::shared_ptr<Reading>>{};
+    for (auto i = static_cast<std::size_t>(segment.removedCount); i < readings.size(); i += 2)
+        kept.emplace_back(readings[i]);
+    auto bytes = std::uint64_t{0};
+    if (segment.sequence == m_cachedSequence)
+        m_cachedReadings.clear();
+    if (!writeSegment(segment.path, key, kept, bytes))
+        return false;
+
+    const auto dropped = readings.size() - segment.removedCount - kept.size();
+    LOG(WARN) << "Downsampling " << dropped << " readings of '" << key << "' to fit the disk budget.";
+    feed.diskBytes = feed.diskBytes - segment.bytes + bytes;
+    m_usage.diskBytes = m_usage.diskBytes - segment.bytes + bytes;
+    m_usage.diskReadings -= dropped;
+    m_usage.droppedReadings += dropped;
+    segment.bytes = bytes;
+    segment.readingCount = kept.size();
+    segment.firstOrdinal += segment.removedCount * segment.ordinalStride;
+    segment.ordinalStride *= 2;
+    segment.removedCount = 0;
+    ++segment.downsampleCount;
+    return true;
+}
+
+bool TieredPersistence::writeSegment(const std::string& path, const std::string& key,
+                                     const std::vector<std::shared_ptr<Reading>>& readings, std::uint64_t& bytes) const
+{
+    auto content = SEGMENT_MAGIC;
+    const auto body = encodeSegment(key, readings);
+    auto compressed = std::string{};
+    if (m_configuration.compress && m_configuration.compress(body, compressed) && compressed.size() < body.size())
+        content += COMPRESSED_SEGMENT + compressed;
+    else
+        content += RAW_SEGMENT + body;
+
+    // The segment is written into a temporary file first, so a crash can not leave half of a segment behind
+    const auto temporaryPath = path + TEMPORARY_EXTENSION;
+    {
+        std::ofstream file{temporaryPath, std::ios::out | std::ios::trunc | std::ios::binary};
+        if (!file || !file.write(content.data(), static_cast<std::streamsize>(content.size())).flush())
+        {
+            FileSystemUtils::deleteFile(temporaryPath);
+            return false;
+        }
+    }
+    if (std::rename(temporaryPath.c_str(), path.c_str()) != 0)
+    {
+        FileSystemUtils::deleteFile(temporaryPath);
+        return false;
+    }
+    bytes = content.size();
+    return true;
+}
+
+bool TieredPersistence::readSegment(const std::string& path, std::string& key,
+                                    std::vector<std::shared_ptr<Reading>>& readings) const
+{
+    auto content = std::string{};
+    if (!FileSystemUtils::readFileContent(path, content) || content.size() <= SEGMENT_MAGIC.size() ||
+        content.compare(0, SEGMENT_MAGIC.size(), SEGMENT_MAGIC) != 0)
+    {
+        LOG(ERROR) << "Failed to read the reading segment '" << path << "'.";
+        return false;
+    }
+
+    const auto type = content[SEGMENT_MAGIC.size()];
+    auto body = content.substr(SEGMENT_MAGIC.size() + 1);
+    if (type == COMPRESSED_SEGMENT)
+    {
+        auto decompressed = std::string{};
+        if (!m_configuration.decompress || !m_configuration.decompress(body, decompressed))
+        {
+            LOG(ERROR) << "Failed to read the reading segment '" << path << "' -> Failed to decompress it.";
+            return false;
+        }
+        body = std::move(decompressed);
+    }
+    else if (type != RAW_SEGMENT)
+    {
+        LOG(ERROR) << "Failed to read the reading segment '" << path << "' -> Unknown segment type.";
+        return false;
+    }
+    if (!decodeSegment(body, key, readings))
+    {
+        LOG(ERROR) << "Failed to read the reading segment '" << path << "' -> The segment is malformed.";
+        return false;
+    }
+    return true;
+}
+
+void TieredPersistence::eraseIfEmpty(std::map<std::string, Feed>::iterator it)
+{
+    // A feed with a read outstanding is kept, so its next readings do not start over the ordinals the removal expects
+    if (it->second.readings.empty() && it->second.segments.empty() && !it->second.readOutstanding)
+        m_feeds.erase(it);
+}
+}    // namespace connect
+}    // namespace wolkabout
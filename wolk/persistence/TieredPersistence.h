@@ -0,0 +1,246 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WOLKABOUTCONNECTOR_TIEREDPERSISTENCE_H
+#define WOLKABOUTCONNECTOR_TIEREDPERSISTENCE_H
+
+#include "core/persistence/Persistence.h"
+#include "core/persistence/inmemory/InMemoryPersistence.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace wolkabout
+{
+namespace connect
+{
+/**
+ * This enumeration describes which readings are given up once the disk budget of the tiered persistence is exhausted.
+ */
+enum class ReadingDropPolicy
+{
+    // The oldest segment of all the feeds is deleted.
+    OldestFirst,
+    // Every feed gets an equal share of the disk budget, and the oldest segment of the feed using the most is deleted.
+    PerFeedQuota,
+    // Every second reading of the oldest segment is dropped, up to three times for a segment, before segments are
+    // deleted, so a long outage is kept at a lower resolution instead of being cut off.
+    DownsampleOnPressure
+};
+
+// The functions that compress and decompress a segment. They return whether they succeeded.
+using SegmentCodec = std::function<bool(const std::string& input, std::string& output)>;
+
+// This struct holds the configuration of the tiered persistence.
+struct TieredPersistenceConfiguration
+{
+    // The count of bytes the readings can take in memory. The readings are spilled in the background, so the budget can
+    // be exceeded for the time it takes to write a segment.
+    std::uint64_t memoryBudget = 16 * 1024 * 1024;
+    // The count of bytes the segments can take on the disk.
+    std::uint64_t diskBudget = 256 * 1024 * 1024;
+    // The directory the segments are spilled into.
+    std::string segmentDirectory = "./readings";
+    ReadingDropPolicy dropPolicy = ReadingDropPolicy::OldestFirst;
+    // Optional compression of the segments, for example by a PayloadCompressor. Either both or none must be set.
+    SegmentCodec compress;
+    SegmentCodec decompress;
+};
+
+// This struct holds the usage of the tiers of the persistence.
+struct TieredPersistenceUsage
+{
+    std::uint64_t memoryBytes = 0;
+    std::uint64_t memoryReadings = 0;
+    std::uint64_t diskBytes = 0;
+    std::uint64_t diskReadings = 0;
+    std::uint64_t segmentCount = 0;
+    // The count of readings that were ever moved from memory to the disk.
+    std::uint64_t spilledReadings = 0;
+    // The count of readings that were ever dropped, by the drop policy or because a segment could not be written.
+    std::uint64_t droppedReadings = 0;
+};
+
+/**
+ * This is a persistence that keeps the readings within a memory and a disk budget.
+ *
+ * The recent readings are kept in memory. Once they outgrow the memory budget, a background thread moves the oldest
+ * readings in batches of a single feed into segment files, which are compactly encoded, and optionally compressed. The
+ * readings stay in memory while their segment is written, so `putReading` never waits for the disk. Once the segments
+ * outgrow the disk budget, the drop policy decides what is given up. The readings of a feed are always returned oldest
+ * first, the segments before the memory. The segment read last is kept decoded, so reading it in batches decodes it
+ * only once.
+ *
+ * The segments are picked up again when the persistence is made with the same directory, so the readings survive a
+ * restart. Readings removed from the front of a segment are only counted until the whole segment is removed, so after
+ * a restart they can be returned once more. Attributes and parameters are small, and are kept in memory only.
+ *
+ * A removal that follows `getReadings` takes out only the readings it gave out, so readings dropped by the drop policy
+ * in between do not make it remove newer ones that were never published.
+ */
+class TieredPersistence : public Persistence
+{
+public:
+    /**
+     * Default parameter constructor.
+     *
+     * @param configuration The budgets, the directory and the drop policy.
+     */
+    explicit TieredPersistence(TieredPersistenceConfiguration configuration);
+
+    /**
+     * Default destructor. Stops the background spilling. The readings in memory are not spilled.
+     */
+    ~TieredPersistence() override;
+
+    bool putReading(const std::string& key, const Reading& reading) override;
+
+    std::vector<std::shared_ptr<Reading>> getReadings(const std::string& key, std::uint_fast64_t count) override;
+
+    void removeReadings(const std::string& key, std::uint_fast64_t count) override;
+
+    std::vector<std::string> getReadingsKeys() override;
+
+    bool putAttribute(const std::string& key, std::shared_ptr<Attribute> attribute) override;
+
+    std::map<std::string, std::shared_ptr<Attribute>> getAttributes() override;
+
+    std::shared_ptr<Attribute> getAttributeUnderKey(const std::string& key) override;
+
+    void removeAttributes() override;
+
+    void removeAttributes(const std::string& key) override;
+
+    std::vector<std::string> getAttributeKeys() override;
+
+    bool putParameter(const std::string& key, Parameter parameter) override;
+
+    std::map<std::string, Parameter> getParameters() override;
+
+    Parameter getParameterForKey(const std::string& key) override;
+
+    void removeParameters() override;
+
+    void removeParameters(const std::string& key) override;
+
+    std::vector<std::string> getParameterKeys() override;
+
+    bool isEmpty() override;
+
+    /**
+     * This method is used to obtain the usage of the tiers.
+     *
+     * @return The usage.
+     */
+    TieredPersistenceUsage getUsage() const;
+
+    /**
+     * This method is used to wait until the readings over the memory budget have been spilled to the disk.
+     */
+    void flush();
+
+private:
+    struct Segment
+    {
+        std::uint64_t sequence;
+        std::string path;
+        std::uint64_t bytes;
+        std::uint64_t readingCount;
+        // The count of readings removed from the front of the segment
+        std::uint64_t removedCount;
+        std::uint32_t downsampleCount;
+        // The reading at an index of the segment file is the reading of the feed with the ordinal firstOrdinal +
+        // index * ordinalStride, the stride doubles with every downsampling
+        std::uint64_t firstOrdinal;
+        std::uint64_t ordinalStride;
+    };
+
+    struct Feed
+    {
+        std::deque<Segment> segments;
+        // The readings in memory, with the order they were put in
+        std::deque<std::pair<std::uint64_t, std::shared_ptr<Reading>>> readings;
+        std::uint64_t memoryBytes = 0;
+        std::uint64_t diskBytes = 0;
+        // Every reading of the feed gets the next ordinal, the readings in memory have consecutive ones
+        std::uint64_t nextOrdinal = 0;
+        // The ordinal after the last reading given out by a read that was not followed by a removal yet
+        std::uint64_t readEnd = 0;
+        bool readOutstanding = false;
+    };
+
+    // Internal method used to pick up the segments left in the directory
+    void loadSegments();
+
+    // Internal method that runs on the spill thread, and spills the readings whenever they outgrow the memory budget
+    void runSpill();
+
+    // Internal method used to move the oldest readings into segments, until the memory use drops well under the budget.
+    // The lock is released while a segment is written.
+    void spill(std::unique_lock<std::mutex>& lock);
+
+    // Internal method used to apply the drop policy until the disk use fits the budget
+    void enforceDiskBudget();
+
+    // Internal method used to delete the front segment of a feed
+    void dropSegment(const std::string& key, Feed& feed);
+
+    // Internal method used to drop every second reading of a segment
+    bool downsample(Feed& feed, Segment& segment);
+
+    // Internal method used to write a segment file, returning its size
+    bool writeSegment(const std::string& path, const std::string& key,
+                      const std::vector<std::shared_ptr<Reading>>& readings, std::uint64_t& bytes) const;
+
+    // Internal method used to read a segment file
+    bool readSegment(const std::string& path, std::string& key, std::vector<std::shared_ptr<Reading>>& readings) const;
+
+    // Internal method used to remove the feed once it holds no readings, and no read of it is outstanding
+    void eraseIfEmpty(std::map<std::string, Feed>::iterator it);
+
+    TieredPersistenceConfiguration m_configuration;
+
+    mutable std::mutex m_mutex;
+    std::map<std::string, Feed> m_feeds;
+    std::uint64_t m_nextReading;
+    std::uint64_t m_nextSegment;
+    TieredPersistenceUsage m_usage;
+
+    // The decoded readings of the segment that was read last
+    std::uint64_t m_cachedSequence;
+    std::vector<std::shared_ptr<Reading>> m_cachedReadings;
+
+    InMemoryPersistence m_metadata;
+
+    // Wakes up the spill thread once the readings outgrow the memory budget, and the flushes once the spill is done
+    std::condition_variable m_spillCondition;
+    bool m_spilling;
+    bool m_stopping;
+    std::thread m_spillThread;
+};
+}    // namespace connect
+}    // namespace wolkabout
+
+#endif    // WOLKABOUTCONNECTOR_TIEREDPERSISTENCE_H
@@ -0,0 +1,258 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wolk/protocol/BinaryWolkaboutDataProtocol.h"
+
+#include "core/utilities/Logger.h"
+
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+namespace wolkabout
+{
+namespace connect
+{
+namespace
+{
+std::uint32_t makeDictionaryId(const std::vector<std::string>& feedReferences)
+{
+    // FNV-1a over all the references, each one terminated with a zero
+    auto hash = std::uint32_t{2166136261u};
+    for (const auto& reference : feedReferences)
+    {
+        for (const auto character : reference)
+            hash = (hash ^ static_cast<std::uint8_t>(character)) * 16777619u;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+bool isInteger(const std::string& value)
+{
+    const auto begin = std::size_t{value.front() == '-' ? 1u : 0u};
+    if (begin == value.size())
+        return false;
+    for (auto i = begin; i < value.size(); ++i)
+        if (value[i] < '0' || value[i] > '9')
+            return false;
+    return true;
+}
+
+// The shortest text that reads back as the same number
+std::string formatShortest(double number)
+{
+    char buffer[32];
+    for (auto precision = 1; precision <= 17; ++precision)
+    {
+        std::snprintf(buffer, sizeof(buffer), "%.*g", precision, number);
+        if (std::strtod(buffer, nullptr) == number)
+            break;
+    }
+    return buffer;
+}
+}    // namespace
+
+const std::uint64_t BinaryWolkaboutDataProtocol::FORMAT_VERSION;
+
+BinaryWolkaboutDataProtocol::BinaryWolkaboutDataProtocol(std::vector<std::string> feedReferences,
+                                                         std::set<std::string> textFeedReferences)
+: m_feedReferences(std::move(feedReferences))
+, m_textFeedReferences(std::move(textFeedReferences))
+, m_dictionaryId(makeDictionaryId(m_feedReferences))
+{
+    for (auto i = std::size_t{0}; i < m_feedReferences.size(); ++i)
+        m_feedIndexes.emplace(m_feedReferences[i], i);
+}
+
+std::unique_ptr<Message> BinaryWolkaboutDataProtocol::makeOutboundMessage(const std::string& deviceKey,
+                                                                          FeedValuesMessage feedValuesMessage)
+{
+    LOG(TRACE) << METHOD_INFO;
+
+    const auto channel = getChannel(deviceKey, BinaryPayloadKind::FEED_VALUES, [&] {
+        return WolkaboutDataProtocol::makeOutboundMessage(deviceKey, feedValuesMessage);
+    });
+    if (channel.empty())
+        return nullptr;
+
+    auto writer = CborWriter{};
+    writeHeader(writer, BinaryPayloadKind::FEED_VALUES);
+    const auto& readings = feedValuesMessage.getReadings();
+    writer.writeMapHeader(readings.size());
+    for (const auto& timestampReadings : readings)
+    {
+        writer.writeUnsigned(timestampReadings.first);
+        writer.writeArrayHeader(timestampReadings.second.size() * 2);
+        for (const auto& reading : timestampReadings.second)
+        {
+            const auto indexIt = m_feedIndexes.find(reading.getReference());
+            if (indexIt != m_feedIndexes.cend())
+                writer.writeUnsigned(indexIt->second);
+            else
+                writer.writeText(reading.getReference());
+
+            // The values of the text feeds stay text, however they read
+            const auto text = m_textFeedReferences.find(reading.getReference()) != m_textFeedReferences.cend();
+            const auto writeValue = [&](const std::string& value) {
+                if (text)
+                    writer.writeText(value);
+                else
+                    writeTypedValue(writer, value);
+            };
+            const auto values = reading.getStringValues();
+            if (values.size() > 1)
+            {
+                writer.writeArrayHeader(values.size());
+                for (const auto& value : values)
+                    writeValue(value);
+            }
+            else
+            {
+                writeValue(reading.getStringValue());
+            }
+        }
+    }
+    return std::unique_ptr<Message>{new Message{writer.release(), channel}};
+}
+
+std::unique_ptr<Message> BinaryWolkaboutDataProtocol::makeOutboundMessage(
+  const std::string& deviceKey, AttributeRegistrationMessage attributeRegistrationMessage)
+{
+    LOG(TRACE) << METHOD_INFO;
+
+    const auto channel = getChannel(deviceKey, BinaryPayloadKind::ATTRIBUTE_REGISTRATION, [&] {
+        return WolkaboutDataProtocol::makeOutboundMessage(deviceKey, attributeRegistrationMessage);
+    });
+    if (channel.empty())
+        return nullptr;
+
+    auto writer = CborWriter{};
+    writeHeader(writer, BinaryPayloadKind::ATTRIBUTE_REGISTRATION);
+    const auto& attributes = attributeRegistrationMessage.getAttributes();
+    writer.writeArrayHeader(attributes.size());
+    for (const auto& attribute : attributes)
+    {
+        writer.writeArrayHeader(3);
+        writer.writeText(attribute.getName());
+        writer.writeUnsigned(static_cast<std::uint64_t>(attribute.getDataType()));
+        writer.writeText(attribute.getValue());
+    }
+    return std::unique_ptr<Message>{new Message{writer.release(), channel}};
+}
+
+std::unique_ptr<Message> BinaryWolkaboutDataProtocol::makeOutboundMessage(
+  const std::string& deviceKey, ParametersUpdateMessage parametersUpdateMessage)
+{
+    LOG(TRACE) << METHOD_INFO;
+
+    const auto channel = getChannel(deviceKey, BinaryPayloadKind::PARAMETERS, [&] {
+        return WolkaboutDataProtocol::makeOutboundMessage(deviceKey, parametersUpdateMessage);
+    });
+    if (channel.empty())
+        return nullptr;
+
+    auto writer = CborWriter{};
+    writeHeader(writer, BinaryPayloadKind::PARAMETERS);
+    const auto& parameters = parametersUpdateMessage.getParameters();
+    writer.writeMapHeader(parameters.size());
+    for (const auto& parameter : parameters)
+    {
+        writer.writeText(toString(parameter.first));
+        writeTypedValue(writer, parameter.second);
+    }
+    return std::unique_ptr<Message>{new Message{writer.release(), channel}};
+}
+
+const std::vector<std::string>& BinaryWolkaboutDataProtocol::getFeedReferences() const
+{
+    return m_feedReferences;
+}
+
+std::uint32_t BinaryWolkaboutDataProtocol::getDictionaryId() const
+{
+    return m_dictionaryId;
+}
+
+void BinaryWolkaboutDataProtocol::writeTypedValue(CborWriter& writer, const std::string& value)
+{
+    if (value.empty())
+    {
+        writer.writeText(value);
+        return;
+    }
+    if (value == "true" || value == "false")
+    {
+        writer.writeBool(value == "true");
+        return;
+    }
+    // A value is only written as a number if the number formats back into exactly the same text, so values like "007",
+    // "+5", "1.50" or "1e5" keep their form
+    if (isInteger(value))
+    {
+        errno = 0;
+        const auto integer = std::strtoll(value.c_str(), nullptr, 10);
+        if (errno == 0 && std::to_string(integer) == value)
+        {
+            writer.writeSigned(integer);
+            return;
+        }
+    }
+    else if (value.find_first_not_of("0123456789.eE+-") == std::string::npos)
+    {
+        char* end = nullptr;
+        errno = 0;
+        const auto number = std::strtod(value.c_str(), &end);
+        if (errno == 0 && end == value.c_str() + value.size() && std::isfinite(number) &&
+            formatShortest(number) == value)
+        {
+            writer.writeDouble(number);
+            return;
+        }
+    }
+    writer.writeText(value);
+}
+
+std::string BinaryWolkaboutDataProtocol::getChannel(const std::string& deviceKey, BinaryPayloadKind kind,
+                                                    const std::function<std::unique_ptr<Message>()>& makeJsonMessage)
+{
+    std::lock_guard<std::mutex> lock{m_channelMutex};
+    const auto key = std::make_pair(deviceKey, kind);
+    const auto it = m_channels.find(key);
+    if (it != m_channels.cend())
+        return it->second;
+
+    const auto jsonMessage = makeJsonMessage();
+    if (jsonMessage == nullptr)
+    {
+        LOG(ERROR) << "Failed to determine the channel for the binary payload of device '" << deviceKey << "'.";
+        return {};
+    }
+    m_channels.emplace(key, jsonMessage->getChannel());
+    return jsonMessage->getChannel();
+}
+
+void BinaryWolkaboutDataProtocol::writeHeader(CborWriter& writer, BinaryPayloadKind kind) const
+{
+    writer.writeTag(CborWriter::SELF_DESCRIBE_TAG);
+    writer.writeArrayHeader(4);
+    writer.writeUnsigned(FORMAT_VERSION);
+    writer.writeUnsigned(m_dictionaryId);
+    writer.writeUnsigned(static_cast<std::uint64_t>(kind));
+}
+}    // namespace connect
+}    // namespace wolkabout
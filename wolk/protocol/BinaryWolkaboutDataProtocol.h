@@ -0,0 +1,138 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WOLKABOUTCONNECTOR_BINARYWOLKABOUTDATAPROTOCOL_H
+#define WOLKABOUTCONNECTOR_BINARYWOLKABOUTDATAPROTOCOL_H
+
+#include "core/protocol/wolkabout/WolkaboutDataProtocol.h"
+#include "wolk/protocol/CborWriter.h"
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace wolkabout
+{
+namespace connect
+{
+// The kinds of payloads the binary protocol produces.
+enum class BinaryPayloadKind
+{
+    FEED_VALUES = 0,
+    PARAMETERS,
+    ATTRIBUTE_REGISTRATION
+};
+
+/**
+ * This is the Wolkabout data protocol that encodes the outbound data messages in CBOR instead of JSON.
+ *
+ * Every payload is the self-describe tag (bytes 0xd9 0xd9 0xf7) followed by the array
+ * `[version, dictionaryId, kind, body]`, where the body is:
+ *  - `FeedValuesMessage`: map of timestamp to an array of alternating references and values. A reference is the index
+ *    of the feed in the dictionary, or the reference itself as text if it is not in the dictionary. A value is a bool,
+ *    integer, float or text depending on how it reads, or an array of those for multi-value readings. A value is only
+ *    written as a number if the number formats back into exactly the same text, and the values of the text feeds are
+ *    always written as text.
+ *  - `ParametersUpdateMessage`: map of parameter name to the value.
+ *  - `AttributeRegistrationMessage`: array of `[name, dataType, value]` arrays, where the data type is the numeric
+ *    value of the `DataType` enumeration.
+ *
+ * The channels are the same as the ones the JSON protocol uses, and everything else is inherited from it.
+ * This protocol can be passed to `WolkBuilder::withDataProtocol`.
+ */
+class BinaryWolkaboutDataProtocol : public WolkaboutDataProtocol
+{
+public:
+    // The version of the payload layout.
+    static const std::uint64_t FORMAT_VERSION = 1;
+
+    /**
+     * Default parameter constructor.
+     *
+     * @param feedReferences The dictionary of feed references. Its order must be the same on the receiving side.
+     * @param textFeedReferences The references of the feeds that hold text, whose values are never written as numbers.
+     */
+    explicit BinaryWolkaboutDataProtocol(std::vector<std::string> feedReferences = {},
+                                         std::set<std::string> textFeedReferences = {});
+
+    using WolkaboutDataProtocol::makeOutboundMessage;
+
+    std::unique_ptr<Message> makeOutboundMessage(const std::string& deviceKey,
+                                                 FeedValuesMessage feedValuesMessage) override;
+
+    std::unique_ptr<Message> makeOutboundMessage(const std::string& deviceKey,
+                                                 AttributeRegistrationMessage attributeRegistrationMessage) override;
+
+    std::unique_ptr<Message> makeOutboundMessage(const std::string& deviceKey,
+                                                 ParametersUpdateMessage parametersUpdateMessage) override;
+
+    /**
+     * Getter for the dictionary of feed references.
+     *
+     * @return The feed references.
+     */
+    const std::vector<std::string>& getFeedReferences() const;
+
+    /**
+     * Getter for the id of the dictionary, which is written in every payload so the receiving side can verify it uses
+     * the same dictionary.
+     *
+     * @return The dictionary id.
+     */
+    std::uint32_t getDictionaryId() const;
+
+    /**
+     * This method writes a reading value with the type it reads as.
+     *
+     * @param writer The writer into which the value is written.
+     * @param value The value as text.
+     */
+    static void writeTypedValue(CborWriter& writer, const std::string& value);
+
+private:
+    /**
+     * This is the internal method used to obtain the channel for a payload kind. The channel is taken from the JSON
+     * protocol the first time, and cached afterwards.
+     *
+     * @param deviceKey The key of the device sending the message.
+     * @param kind The kind of the payload.
+     * @param makeJsonMessage The method that makes the message using the JSON protocol.
+     * @return The channel. Empty if the JSON protocol failed to make the message.
+     */
+    std::string getChannel(const std::string& deviceKey, BinaryPayloadKind kind,
+                           const std::function<std::unique_ptr<Message>()>& makeJsonMessage);
+
+    // Internal method used to write the header of a payload
+    void writeHeader(CborWriter& writer, BinaryPayloadKind kind) const;
+
+    std::vector<std::string> m_feedReferences;
+    std::unordered_map<std::string, std::uint64_t> m_feedIndexes;
+    std::set<std::string> m_textFeedReferences;
+    std::uint32_t m_dictionaryId;
+
+    std::mutex m_channelMutex;
+    std::map<std::pair<std::string, BinaryPayloadKind>, std::string> m_channels;
+};
+}    // namespace connect
+}    // namespace wolkabout
+
+#endif    // WOLKABOUTCONNECTOR_BINARYWOLKABOUTDATAPROTOCOL_H
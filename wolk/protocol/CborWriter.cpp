@@ -0,0 +1,154 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wolk/protocol/CborWriter.h"
+
+#include <cstring>
+#include <functional>
+
+namespace wolkabout
+{
+namespace connect
+{
+namespace
+{
+const std::uint8_t MAJOR_UNSIGNED = 0;
+const std::uint8_t MAJOR_NEGATIVE = 1;
+const std::uint8_t MAJOR_TEXT = 3;
+const std::uint8_t MAJOR_ARRAY = 4;
+const std::uint8_t MAJOR_MAP = 5;
+const std::uint8_t MAJOR_TAG = 6;
+const std::uint8_t MAJOR_SIMPLE = 7;
+
+const std::uint8_t SIMPLE_FALSE = 20;
+const std::uint8_t SIMPLE_TRUE = 21;
+const std::uint8_t SIMPLE_NULL = 22;
+const std::uint8_t SIMPLE_FLOAT = 26;
+const std::uint8_t SIMPLE_DOUBLE = 27;
+}    // namespace
+
+const std::uint64_t CborWriter::SELF_DESCRIBE_TAG;
+
+void CborWriter::writeUnsigned(std::uint64_t value)
+{
+    writeHead(MAJOR_UNSIGNED, value);
+}
+
+void CborWriter::writeSigned(std::int64_t value)
+{
+    if (value >= 0)
+        writeHead(MAJOR_UNSIGNED, static_cast<std::uint64_t>(value));
+    else
+        writeHead(MAJOR_NEGATIVE, static_cast<std::uint64_t>(-(value + 1)));
+}
+
+void CborWriter::writeDouble(double value)
+{
+    const auto single = static_cast<float>(value);
+    if (std::equal_to<double>()(static_cast<double>(single), value))
+    {
+        auto bits = std::uint32_t{0};
+        std::memcpy(&bits, &single, sizeof(bits));
+        m_buffer.push_back(static_cast<char>(MAJOR_SIMPLE << 5 | SIMPLE_FLOAT));
+        writeBigEndian(bits, sizeof(bits));
+        return;
+    }
+
+    auto bits = std::uint64_t{0};
+    std::memcpy(&bits, &value, sizeof(bits));
+    m_buffer.push_back(static_cast<char>(MAJOR_SIMPLE << 5 | SIMPLE_DOUBLE));
+    writeBigEndian(bits, sizeof(bits));
+}
+
+void CborWriter::writeBool(bool value)
+{
+    m_buffer.push_back(static_cast<char>(MAJOR_SIMPLE << 5 | (value ? SIMPLE_TRUE : SIMPLE_FALSE)));
+}
+
+void CborWriter::writeNull()
+{
+    m_buffer.push_back(static_cast<char>(MAJOR_SIMPLE << 5 | SIMPLE_NULL));
+}
+
+void CborWriter::writeText(const std::string& value)
+{
+    writeHead(MAJOR_TEXT, value.size());
+    m_buffer.append(value);
+}
+
+void CborWriter::writeArrayHeader(std::uint64_t size)
+{
+    writeHead(MAJOR_ARRAY, size);
+}
+
+void CborWriter::writeMapHeader(std::uint64_t size)
+{
+    writeHead(MAJOR_MAP, size);
+}
+
+void CborWriter::writeTag(std::uint64_t tag)
+{
+    writeHead(MAJOR_TAG, tag);
+}
+
+const std::string& CborWriter::getBuffer() const
+{
+    return m_buffer;
+}
+
+std::string CborWriter::release()
+{
+    auto buffer = std::string{};
+    buffer.swap(m_buffer);
+    return buffer;
+}
+
+void CborWriter::writeHead(std::uint8_t majorType, std::uint64_t argument)
+{
+    const auto major = static_cast<std::uint8_t>(majorType << 5);
+    if (argument < 24)
+    {
+        m_buffer.push_back(static_cast<char>(major | argument));
+    }
+    else if (argument <= 0xFF)
+    {
+        m_buffer.push_back(static_cast<char>(major | 24));
+        writeBigEndian(argument, 1);
+    }
+    else if (argument <= 0xFFFF)
+    {
+        m_buffer.push_back(static_cast<char>(major | 25));
+        writeBigEndian(argument, 2);
+    }
+    else if (argument <= 0xFFFFFFFF)
+    {
+        m_buffer.push_back(static_cast<char>(major | 26));
+        writeBigEndian(argument, 4);
+    }
+    else
+    {
+        m_buffer.push_back(static_cast<char>(major | 27));
+        writeBigEndian(argument, 8);
+    }
+}
+
+void CborWriter::writeBigEndian(std::uint64_t value, std::size_t bytes)
+{
+    for (auto i = bytes; i > 0; --i)
+        m_buffer.push_back(static_cast<char>((value >> (8 * (i - 1))) & 0xFF));
+}
+}    // namespace connect
+}    // namespace wolkabout
@@ -0,0 +1,110 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WOLKABOUTCONNECTOR_CBORWRITER_H
+#define WOLKABOUTCONNECTOR_CBORWRITER_H
+
+#include <cstdint>
+#include <string>
+
+namespace wolkabout
+{
+namespace connect
+{
+/**
+ * This is a minimal CBOR (RFC 8949) encoder. Values are appended into a buffer in the order the methods are called.
+ * Only definite length arrays and maps are supported.
+ */
+class CborWriter
+{
+public:
+    // The tag that marks the data as CBOR. It results in the bytes 0xd9 0xd9 0xf7.
+    static const std::uint64_t SELF_DESCRIBE_TAG = 55799;
+
+    /**
+     * This method writes an unsigned integer.
+     */
+    void writeUnsigned(std::uint64_t value);
+
+    /**
+     * This method writes a signed integer, as unsigned if it is not negative.
+     */
+    void writeSigned(std::int64_t value);
+
+    /**
+     * This method writes a floating point value. A single precision float is written if no precision is lost.
+     *
+     * @param value The value that should be written.
+     */
+    void writeDouble(double value);
+
+    /**
+     * This method writes a boolean value.
+     */
+    void writeBool(bool value);
+
+    /**
+     * This method writes the null value.
+     */
+    void writeNull();
+
+    /**
+     * This method writes an UTF-8 text string.
+     */
+    void writeText(const std::string& value);
+
+    /**
+     * This method writes the header of an array. It must be followed by `size` items.
+     */
+    void writeArrayHeader(std::uint64_t size);
+
+    /**
+     * This method writes the header of a map. It must be followed by `size` key and value pairs.
+     */
+    void writeMapHeader(std::uint64_t size);
+
+    /**
+     * This method writes a tag. It must be followed by the tagged item.
+     */
+    void writeTag(std::uint64_t tag);
+
+    /**
+     * Getter for the encoded data.
+     *
+     * @return The buffer holding the encoded data.
+     */
+    const std::string& getBuffer() const;
+
+    /**
+     * This method is used to take the encoded data out of the writer.
+     *
+     * @return The encoded data. The writer will be empty afterwards.
+     */
+    std::string release();
+
+private:
+    // Internal method used to write the head of an item, the major type and the argument
+    void writeHead(std::uint8_t majorType, std::uint64_t argument);
+
+    // Internal method used to write an integer in network byte order
+    void writeBigEndian(std::uint64_t value, std::size_t bytes);
+
+    std::string m_buffer;
+};
+}    // namespace connect
+}    // namespace wolkabout
+
+#endif    // WOLKABOUTCONNECTOR_CBORWRITER_H
@@ -0,0 +1,144 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wolk/protocol/CompressedWolkaboutDataProtocol.h"
+
+#include "core/utilities/Logger.h"
+
+namespace wolkabout
+{
+namespace connect
+{
+namespace
+{
+const std::string PLATFORM_TO_DEVICE_DIRECTION = "p2d";
+const std::string COMPRESSION_CHANNEL = "payload_compression";
+const char CHANNEL_DELIMITER = '/';
+
+std::string makeCompressionChannel(const std::string& deviceKey)
+{
+    return PLATFORM_TO_DEVICE_DIRECTION + CHANNEL_DELIMITER + deviceKey + CHANNEL_DELIMITER + COMPRESSION_CHANNEL;
+}
+}    // namespace
+
+CompressedWolkaboutDataProtocol::CompressedWolkaboutDataProtocol(std::size_t threshold,
+                                                                 const std::vector<std::string>& feedReferences,
+                                                                 int level)
+: m_threshold(threshold)
+, m_compressor(PayloadCompressor::makeDictionary(feedReferences), level)
+, m_uncompressedBytes(0)
+, m_compressedBytes(0)
+{
+}
+
+std::vector<std::string> CompressedWolkaboutDataProtocol::getInboundChannelsForDevice(
+  const std::string& deviceKey) const
+{
+    auto channels = WolkaboutDataProtocol::getInboundChannelsForDevice(deviceKey);
+    channels.emplace_back(makeCompressionChannel(deviceKey));
+    return channels;
+}
+
+MessageType CompressedWolkaboutDataProtocol::getMessageType(const Message& message)
+{
+    // The confirmation is handled right here, it does not need to go any further
+    const auto deviceKey = getDeviceKey(message);
+    if (deviceKey.empty() || message.getChannel() != makeCompressionChannel(deviceKey))
+        return WolkaboutDataProtocol::getMessageType(message);
+    const auto accepted = message.getContent() == std::to_string(m_compressor.getDictionaryId());
+    LOG(INFO) << "The platform " << (accepted ? "accepted" : "refused") << " compressed payloads for device '"
+              << deviceKey << "'.";
+    setCompressionAccepted(deviceKey, accepted);
+    return MessageType::UNKNOWN;
+}
+
+std::unique_ptr<Message> CompressedWolkaboutDataProtocol::makeOutboundMessage(const std::string& deviceKey,
+                                                                              FeedValuesMessage feedValuesMessage)
+{
+    return compress(deviceKey, WolkaboutDataProtocol::makeOutboundMessage(deviceKey, std::move(feedValuesMessage)));
+}
+
+std::unique_ptr<Message> CompressedWolkaboutDataProtocol::makeOutboundMessage(
+  const std::string& deviceKey, AttributeRegistrationMessage attributeRegistrationMessage)
+{
+    return compress(deviceKey,
+                    WolkaboutDataProtocol::makeOutboundMessage(deviceKey, std::move(attributeRegistrationMessage)));
+}
+
+std::unique_ptr<Message> CompressedWolkaboutDataProtocol::makeOutboundMessage(
+  const std::string& deviceKey, ParametersUpdateMessage parametersUpdateMessage)
+{
+    return compress(deviceKey,
+                    WolkaboutDataProtocol::makeOutboundMessage(deviceKey, std::move(parametersUpdateMessage)));
+}
+
+const PayloadCompressor& CompressedWolkaboutDataProtocol::getCompressor() const
+{
+    return m_compressor;
+}
+
+void CompressedWolkaboutDataProtocol::setCompressionAccepted(const std::string& deviceKey, bool accepted)
+{
+    std::lock_guard<std::mutex> lock{m_acceptedDevicesMutex};
+    if (accepted)
+        m_acceptedDevices.emplace(deviceKey);
+    else
+        m_acceptedDevices.erase(deviceKey);
+}
+
+bool CompressedWolkaboutDataProtocol::isCompressionAccepted(const std::string& deviceKey) const
+{
+    std::lock_guard<std::mutex> lock{m_acceptedDevicesMutex};
+    return m_acceptedDevices.find(deviceKey) != m_acceptedDevices.cend();
+}
+
+std::uint64_t CompressedWolkaboutDataProtocol::getUncompressedBytes() const
+{
+    return m_uncompressedBytes;
+}
+
+std::uint64_t CompressedWolkaboutDataProtocol::getCompressedBytes() const
+{
+    return m_compressedBytes;
+}
+
+std::unique_ptr<Message> CompressedWolkaboutDataProtocol::compress(const std::string& deviceKey,
+                                                                   std::unique_ptr<Message> message)
+{
+    if (message == nullptr)
+        return nullptr;
+
+    // Until the platform confirms it can inflate the payloads, they are sent as they are
+    const auto& content = message->getContent();
+    m_uncompressedBytes += content.size();
+    if (content.size() < m_threshold || !isCompressionAccepted(deviceKey))
+    {
+        m_compressedBytes += content.size();
+        return message;
+    }
+
+    auto compressed = std::string{};
+    if (!m_compressor.compress(content, compressed) || compressed.size() >= content.size())
+    {
+        LOG(DEBUG) << "Sending the payload on channel '" << message->getChannel() << "' uncompressed.";
+        m_compressedBytes += content.size();
+        return message;
+    }
+    m_compressedBytes += compressed.size();
+    return std::unique_ptr<Message>{new Message{std::move(compressed), message->getChannel()}};
+}
+}    // namespace connect
+}    // namespace wolkabout
@@ -0,0 +1,136 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WOLKABOUTCONNECTOR_COMPRESSEDWOLKABOUTDATAPROTOCOL_H
+#define WOLKABOUTCONNECTOR_COMPRESSEDWOLKABOUTDATAPROTOCOL_H
+
+#include "core/protocol/wolkabout/WolkaboutDataProtocol.h"
+#include "wolk/protocol/PayloadCompressor.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace wolkabout
+{
+namespace connect
+{
+/**
+ * This is the Wolkabout data protocol that compresses large outbound payloads.
+ *
+ * The `FeedValuesMessage`, `AttributeRegistrationMessage` and `ParametersUpdateMessage` payloads that are at least as
+ * large as the threshold get deflated with a dictionary built from the feed references. The payload is only replaced if
+ * compression actually makes it smaller. The channels are left as they are, and the receiving side can tell the
+ * compressed payloads apart by their zlib header, which also carries the id of the dictionary.
+ *
+ * The payloads of a device are sent uncompressed until the platform confirms it can inflate them. The platform does
+ * that by sending the id of the dictionary it holds on the `p2d/<device_key>/payload_compression` channel, and any
+ * other content turns compression off again. The application can also confirm it directly, if it knows it otherwise.
+ *
+ * This protocol can be passed to `WolkBuilder::withDataProtocol`.
+ */
+class CompressedWolkaboutDataProtocol : public WolkaboutDataProtocol
+{
+public:
+    /**
+     * Default parameter constructor.
+     *
+     * @param threshold The minimum size of a payload (in bytes) that will be compressed.
+     * @param feedReferences The feed references that will be placed in the compression dictionary.
+     * @param level The compression level, from 1 (fastest) to 9 (smallest).
+     */
+    explicit CompressedWolkaboutDataProtocol(std::size_t threshold = 256,
+                                             const std::vector<std::string>& feedReferences = {}, int level = 6);
+
+    std::vector<std::string> getInboundChannelsForDevice(const std::string& deviceKey) const override;
+
+    MessageType getMessageType(const Message& message) override;
+
+    using WolkaboutDataProtocol::makeOutboundMessage;
+
+    std::unique_ptr<Message> makeOutboundMessage(const std::string& deviceKey,
+                                                 FeedValuesMessage feedValuesMessage) override;
+
+    std::unique_ptr<Message> makeOutboundMessage(const std::string& deviceKey,
+                                                 AttributeRegistrationMessage attributeRegistrationMessage) override;
+
+    std::unique_ptr<Message> makeOutboundMessage(const std::string& deviceKey,
+                                                 ParametersUpdateMessage parametersUpdateMessage) override;
+
+    /**
+     * Getter for the compressor, which the receiving side can use to decompress payloads.
+     *
+     * @return The compressor.
+     */
+    const PayloadCompressor& getCompressor() const;
+
+    /**
+     * This method is used to set whether the platform can inflate the payloads of a device.
+     *
+     * @param deviceKey The key of the device.
+     * @param accepted Whether the payloads of the device can be sent compressed.
+     */
+    void setCompressionAccepted(const std::string& deviceKey, bool accepted);
+
+    /**
+     * This method is used to check whether the payloads of a device are sent compressed.
+     *
+     * @param deviceKey The key of the device.
+     * @return Whether the platform confirmed it can inflate them.
+     */
+    bool isCompressionAccepted(const std::string& deviceKey) const;
+
+    /**
+     * Getter for the count of payload bytes before compression, for all messages that went through this protocol.
+     *
+     * @return The count of bytes.
+     */
+    std::uint64_t getUncompressedBytes() const;
+
+    /**
+     * Getter for the count of payload bytes after compression, for all messages that went through this protocol.
+     *
+     * @return The count of bytes.
+     */
+    std::uint64_t getCompressedBytes() const;
+
+private:
+    /**
+     * This is the internal method that replaces the payload of a message if it is worth compressing.
+     *
+     * @param deviceKey The key of the device the message is for.
+     * @param message The message made by the regular data protocol.
+     * @return The message with a compressed payload, or the same message.
+     */
+    std::unique_ptr<Message> compress(const std::string& deviceKey, std::unique_ptr<Message> message);
+
+    std::size_t m_threshold;
+    PayloadCompressor m_compressor;
+
+    mutable std::mutex m_acceptedDevicesMutex;
+    std::set<std::string> m_acceptedDevices;
+
+    std::atomic<std::uint64_t> m_uncompressedBytes;
+    std::atomic<std::uint64_t> m_compressedBytes;
+};
+}    // namespace connect
+}    // namespace wolkabout
+
+#endif    // WOLKABOUTCONNECTOR_COMPRESSEDWOLKABOUTDATAPROTOCOL_H
@@ -0,0 +1,172 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wolk/protocol/PayloadCompressor.h"
+
+#include "core/utilities/Logger.h"
+
+#define ZLIB_CONST
+#include <zlib.h>
+
+namespace wolkabout
+{
+namespace connect
+{
+namespace
+{
+// The JSON fragments that appear in most of the payloads, regardless of the feeds
+const char* const BASE_DICTIONARY = "\"dataType\":\"STRING\"\"dataType\":\"NUMERIC\"\"dataType\":\"BOOLEAN\""
+                                    "\"name\":\"value\":\"true\"\"false\"[{\"},{\"}]\"timestamp\":";
+
+// The size of the chunks the output buffers grow by
+const std::size_t CHUNK_SIZE = 4096;
+
+const Bytef* toBytes(const std::string& value)
+{
+    return reinterpret_cast<const Bytef*>(value.data());
+}
+}    // namespace
+
+PayloadCompressor::PayloadCompressor(std::string dictionary, int level)
+: m_dictionary(std::move(dictionary)), m_dictionaryId(0), m_level(level)
+{
+    if (!m_dictionary.empty())
+        m_dictionaryId = static_cast<std::uint32_t>(
+          adler32(adler32(0L, Z_NULL, 0), toBytes(m_dictionary), static_cast<uInt>(m_dictionary.size())));
+}
+
+std::string PayloadCompressor::makeDictionary(const std::vector<std::string>& feedReferences)
+{
+    auto dictionary = std::string{BASE_DICTIONARY};
+    for (const auto& reference : feedReferences)
+        dictionary += "{\"" + reference + "\":";
+    return dictionary;
+}
+
+bool PayloadCompressor::isCompressed(const std::string& payload)
+{
+    if (payload.size() < 2)
+        return false;
+
+    // The compression method needs to be deflate, and the header needs to be a multiple of 31
+    const auto cmf = static_cast<unsigned char>(payload[0]);
+    const auto flg = static_cast<unsigned char>(payload[1]);
+    return (cmf & 0x0F) == Z_DEFLATED && (cmf * 256 + flg) % 31 == 0;
+}
+
+const std::string& PayloadCompressor::getDictionary() const
+{
+    return m_dictionary;
+}
+
+std::uint32_t PayloadCompressor::getDictionaryId() const
+{
+    return m_dictionaryId;
+}
+
+bool PayloadCompressor::compress(const std::string& input, std::string& output) const
+{
+    LOG(TRACE) << METHOD_INFO;
+    const auto errorPrefix = "Failed to compress payload";
+
+    auto stream = z_stream{};
+    if (deflateInit(&stream, m_level) != Z_OK)
+    {
+        LOG(ERROR) << errorPrefix << " -> Failed to initialize the deflate stream.";
+        return false;
+    }
+    if (!m_dictionary.empty() &&
+        deflateSetDictionary(&stream, toBytes(m_dictionary), static_cast<uInt>(m_dictionary.size())) != Z_OK)
+    {
+        LOG(ERROR) << errorPrefix << " -> Failed to set the dictionary.";
+        deflateEnd(&stream);
+        return false;
+    }
+
+    // The bound is the worst case, so deflate can finish in a single call
+    output.resize(deflateBound(&stream, static_cast<uLong>(input.size())));
+    stream.next_in = toBytes(input);
+    stream.avail_in = static_cast<uInt>(input.size());
+    stream.next_out = reinterpret_cast<Bytef*>(&output[0]);
+    stream.avail_out = static_cast<uInt>(output.size());
+    const auto result = deflate(&stream, Z_FINISH);
+    output.resize(stream.total_out);
+    deflateEnd(&stream);
+
+    if (result != Z_STREAM_END)
+    {
+        LOG(ERROR) << errorPrefix << " -> Deflate did not finish the stream.";
+        return false;
+    }
+    return true;
+}
+
+bool PayloadCompressor::decompress(const std::string& input, std::string& output) const
+{
+    LOG(TRACE) << METHOD_INFO;
+    const auto errorPrefix = "Failed to decompress payload";
+
+    auto stream = z_stream{};
+    if (inflateInit(&stream) != Z_OK)
+    {
+        LOG(ERROR) << errorPrefix << " -> Failed to initialize the inflate stream.";
+        return false;
+    }
+    stream.next_in = toBytes(input);
+    stream.avail_in = static_cast<uInt>(input.size());
+
+    output.clear();
+    auto result = Z_OK;
+    while (result != Z_STREAM_END)
+    {
+        const auto written = output.size();
+        output.resize(written + CHUNK_SIZE);
+        stream.next_out = reinterpret_cast<Bytef*>(&output[written]);
+        stream.avail_out = static_cast<uInt>(CHUNK_SIZE);
+        result = inflate(&stream, Z_NO_FLUSH);
+
+        // The header announces the dictionary it needs
+        if (result == Z_NEED_DICT)
+        {
+            if (m_dictionary.empty() || stream.adler != m_dictionaryId ||
+                inflateSetDictionary(&stream, toBytes(m_dictionary), static_cast<uInt>(m_dictionary.size())) != Z_OK)
+            {
+                LOG(ERROR) << errorPrefix << " -> The payload requires an unknown dictionary.";
+                inflateEnd(&stream);
+                return false;
+            }
+            result = inflate(&stream, Z_NO_FLUSH);
+        }
+        output.resize(stream.total_out);
+
+        if (result != Z_OK && result != Z_STREAM_END)
+        {
+            LOG(ERROR) << errorPrefix << " -> The payload is not a valid zlib stream.";
+            inflateEnd(&stream);
+            return false;
+        }
+        if (result == Z_OK && stream.avail_in == 0 && stream.avail_out != 0)
+        {
+            LOG(ERROR) << errorPrefix << " -> The payload is truncated.";
+            inflateEnd(&stream);
+            return false;
+        }
+    }
+    inflateEnd(&stream);
+    return true;
+}
+}    // namespace connect
+}    // namespace wolkabout
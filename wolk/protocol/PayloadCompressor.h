@@ -0,0 +1,105 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WOLKABOUTCONNECTOR_PAYLOADCOMPRESSOR_H
+#define WOLKABOUTCONNECTOR_PAYLOADCOMPRESSOR_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace wolkabout
+{
+namespace connect
+{
+/**
+ * This class compresses and decompresses payloads using the zlib format (deflate), optionally with a preset dictionary.
+ *
+ * When a dictionary is used, its id (Adler-32 checksum) is written into the zlib header, so the receiving side knows
+ * which dictionary it needs to inflate the payload.
+ */
+class PayloadCompressor
+{
+public:
+    /**
+     * Default parameter constructor.
+     *
+     * @param dictionary The preset dictionary. Empty means no dictionary is used.
+     * @param level The compression level, from 1 (fastest) to 9 (smallest).
+     */
+    explicit PayloadCompressor(std::string dictionary = {}, int level = 6);
+
+    /**
+     * This method is used to create a dictionary suited for the JSON payloads of the Wolkabout data protocol.
+     * The feed references are placed at the end of the dictionary, since deflate can reach those with shorter
+     * distances.
+     *
+     * @param feedReferences The feed references that commonly appear in the payloads.
+     * @return The dictionary.
+     */
+    static std::string makeDictionary(const std::vector<std::string>& feedReferences);
+
+    /**
+     * This method is used to check whether a payload looks like it starts with a zlib header.
+     * JSON payloads always start with a printable character that can not form a valid zlib header.
+     *
+     * @param payload The payload that is checked.
+     * @return Whether the payload is compressed.
+     */
+    static bool isCompressed(const std::string& payload);
+
+    /**
+     * Getter for the dictionary.
+     *
+     * @return The dictionary.
+     */
+    const std::string& getDictionary() const;
+
+    /**
+     * Getter for the dictionary id that is written into the header of compressed payloads.
+     *
+     * @return The dictionary id. Zero if no dictionary is used.
+     */
+    std::uint32_t getDictionaryId() const;
+
+    /**
+     * This method is used to compress a payload.
+     *
+     * @param input The payload that should be compressed.
+     * @param output The string where the compressed payload will be written.
+     * @return Whether the payload was compressed successfully.
+     */
+    bool compress(const std::string& input, std::string& output) const;
+
+    /**
+     * This method is used to decompress a payload.
+     *
+     * @param input The payload that should be decompressed.
+     * @param output The string where the decompressed payload will be written.
+     * @return Whether the payload was decompressed successfully. Will fail if the payload requires a different
+     * dictionary.
+     */
+    bool decompress(const std::string& input, std::string& output) const;
+
+private:
+    std::string m_dictionary;
+    std::uint32_t m_dictionaryId;
+    int m_level;
+};
+}    // namespace connect
+}    // namespace wolkabout
+
+#endif    // WOLKABOUTCONNECTOR_PAYLOADCOMPRESSOR_H
@@ -25,6 +25,7 @@
 #include "core/persistence/Persistence.h"
 #include "core/protocol/DataProtocol.h"
 #include "core/utilities/Logger.h"
+#include "wolk/connectivity/OutboundScheduler.h"
 
 #include <algorithm>
 #include <cassert>
@@ -34,6 +35,9 @@ namespace
 {
 const std::uint16_t RETRY_COUNT = 3;
 const std::chrono::milliseconds RETRY_TIMEOUT{5000};
+const std::chrono::seconds PARAMETER_SUBSCRIPTION_TIMEOUT{60};
+// A details request is given up once it is out of retries, so its callback lives only a bit longer
+const std::chrono::milliseconds DETAILS_SYNCHRONIZATION_TIMEOUT = RETRY_TIMEOUT * (RETRY_COUNT + 1);
 }    // namespace
 
 namespace wolkabout
@@ -50,34 +54,86 @@ DataService::DataService(DataProtocol& protocol, Persistence& persistence, Conne
 , m_persistence{persistence}
 , m_connectivityService{connectivityService}
 , m_outboundRetryMessageHandler{outboundRetryMessageHandler}
+, m_outboundScheduler{nullptr}
 , m_feedUpdateHandler{std::move(feedUpdateHandler)}
 , m_parameterSyncHandler{std::move(parameterSyncHandler)}
 , m_detailsSyncHandler{std::move(detailsSyncHandler)}
-, m_iterator(0)
+, m_ingestOverflowPolicy{IngestOverflowPolicy::Block}
+, m_ingestSleeping{false}
+, m_ingestBlocked{0}
+, m_droppedReadings{0}
 {
 }
 
+DataService::~DataService()
+{
+    stopIngestQueue();
+}
+
+void DataService::startIngestQueue(std::size_t capacity, IngestOverflowPolicy overflowPolicy)
+{
+    LOG(TRACE) << METHOD_INFO;
+
+    if (m_ingestQueue != nullptr)
+    {
+        LOG(WARN) << "Ignoring call of 'startIngestQueue' - The ingest queue is already started.";
+        return;
+    }
+    m_ingestQueue = std::unique_ptr<ReadingIngestQueue>{new ReadingIngestQueue{capacity}};
+    m_ingestOverflowPolicy = overflowPolicy;
+    m_ingestThread = std::thread{&DataService::runIngestQueue, this};
+}
+
+void DataService::stopIngestQueue()
+{
+    if (m_ingestQueue == nullptr)
+        return;
+
+    // The queue is closed to the threads adding readings first, so the thread of the queue leaves once it has stored
+    // every reading that made it in, and the threads waiting for room store their readings themselves
+    m_ingestQueue->close();
+    {
+        std::lock_guard<std::mutex> lock{m_ingestWakeupMutex};
+        m_ingestSleeping = false;
+        m_ingestWakeup.notify_one();
+        m_ingestSpace.notify_all();
+    }
+    if (m_ingestThread.joinable())
+        m_ingestThread.join();
+    flushIngestQueue();
+}
+
+void DataService::setOutboundScheduler(OutboundScheduler* outboundScheduler)
+{
+    m_outboundScheduler = outboundScheduler;
+}
+
+std::uint64_t DataService::getDroppedReadingCount() const
+{
+    return m_droppedReadings;
+}
+
 void DataService::addReading(const std::string& deviceKey, const std::string& reference, const std::string& value,
                              std::uint64_t rtc)
 {
-    m_persistence.putReading(makePersistenceKey(deviceKey, reference), Reading{reference, value, rtc});
+    ingestReading(deviceKey, Reading{reference, value, rtc});
 }
 
 void DataService::addReading(const std::string& deviceKey, const std::string& reference,
                              const std::vector<std::string>& value, std::uint64_t rtc)
 {
-    m_persistence.putReading(makePersistenceKey(deviceKey, reference), Reading{reference, value, rtc});
+    ingestReading(deviceKey, Reading{reference, value, rtc});
 }
 
 void DataService::addReading(const std::string& deviceKey, const Reading& reading)
 {
-    m_persistence.putReading(makePersistenceKey(deviceKey, reading.getReference()), reading);
+    ingestReading(deviceKey, reading);
 }
 
 void DataService::addReadings(const std::string& deviceKey, const std::vector<Reading>& readings)
 {
     for (const auto& reading : readings)
-        m_persistence.putReading(makePersistenceKey(deviceKey, reading.getReference()), reading);
+        ingestReading(deviceKey, reading);
 }
 
 void DataService::addAttribute(const std::string& deviceKey, const Attribute& attribute)
@@ -115,6 +171,22 @@ void DataService::removeFeed(const std::string& deviceKey, std::string reference
 void DataService::removeFeeds(const std::string& deviceKey, std::vector<std::string> feeds)
 {
     LOG(TRACE) << METHOD_INFO;
+    {
+        std::lock_guard<std::mutex> lock{m_filterMutex};
+        for (const auto& reference : feeds)
+            m_filters.erase(makePersistenceKey(deviceKey, reference));
+    }
+    {
+        std::lock_guard<std::mutex> lock{m_aggregationMutex};
+        const auto it = m_aggregators.find(deviceKey);
+        if (it != m_aggregators.end())
+        {
+            for (const auto& reference : feeds)
+                it->second.erase(reference);
+            if (it->second.empty())
+                m_aggregators.erase(it);
+        }
+    }
     auto message =
       std::shared_ptr<Message>(m_protocol.makeOutboundMessage(deviceKey, FeedRemovalMessage(std::move(feeds))));
     if (message == nullptr)
@@ -123,6 +195,57 @@ void DataService::removeFeeds(const std::string& deviceKey, std::vector<std::str
         LOG(ERROR) << "Failed to remove feeds -> Failed to publish the outgoing 'FeedRemovalMessage'.";
 }
 
+void DataService::setFeedFilter(const std::string& deviceKey, const std::string& reference,
+                                const ReadingFilterConfiguration& filter)
+{
+    LOG(TRACE) << METHOD_INFO;
+    const auto key = makePersistenceKey(deviceKey, reference);
+    std::lock_guard<std::mutex> lock{m_filterMutex};
+    m_filters.erase(key);
+    if (filter.isEnabled())
+        m_filters.emplace(key, ReadingFilter{filter});
+}
+
+void DataService::setFeedAggregation(const std::string& deviceKey, const std::string& reference,
+                                     const AggregationConfiguration& aggregation)
+{
+    LOG(TRACE) << METHOD_INFO;
+    std::lock_guard<std::mutex> lock{m_aggregationMutex};
+    auto& aggregators = m_aggregators[deviceKey];
+    aggregators.erase(reference);
+    if (aggregation.isEnabled())
+        aggregators.emplace(reference, FeedAggregator{reference, aggregation});
+    if (aggregators.empty())
+        m_aggregators.erase(deviceKey);
+}
+
+void DataService::flushAggregations()
+{
+    const auto now = currentTimestamp();
+    auto readings = std::vector<std::pair<std::string, Reading>>{};
+    {
+        std::lock_guard<std::mutex> lock{m_aggregationMutex};
+        for (auto& deviceAggregators : m_aggregators)
+        {
+            for (auto& aggregator : deviceAggregators.second)
+            {
+                auto output = std::vector<Reading>{};
+                if (!aggregator.second.flush(now, output))
+                    continue;
+                for (auto& reading : output)
+                    readings.emplace_back(deviceAggregators.first, std::move(reading));
+            }
+        }
+    }
+
+    for (const auto& deviceReading : readings)
+    {
+        const auto key = makePersistenceKey(deviceReading.first, deviceReading.second.getReference());
+        if (filterReading(key, deviceReading.second))
+            m_persistence.putReading(key, deviceReading.second);
+    }
+}
+
 void DataService::pullFeedValues(const std::string& deviceKey)
 {
     LOG(TRACE) << METHOD_INFO;
@@ -164,10 +287,7 @@ bool DataService::synchronizeParameters(const std::string& deviceKey, const std:
         return false;
     }
     if (callback)
-    {
-        std::lock_guard<std::mutex> lockGuard{m_subscriptionMutex};
-        m_parameterSubscriptions.emplace(m_iterator++, ParameterSubscription{parameters, std::move(callback)});
-    }
+        addSubscription(deviceKey, parameters, std::move(callback), PARAMETER_SUBSCRIPTION_TIMEOUT);
     return true;
 }
 
@@ -195,15 +315,14 @@ bool DataService::detailsSynchronizationAsync(
        },
        RETRY_COUNT, RETRY_TIMEOUT});
     if (callback)
-    {
-        std::lock_guard<std::mutex> lock{m_detailsMutex};
-        m_detailsCallbacks.push(std::move(callback));
-    }
+        addDetailsCallback(deviceKey, std::move(callback), DETAILS_SYNCHRONIZATION_TIMEOUT);
     return true;
 }
 
 void DataService::publishReadings()
 {
+    flushIngestQueue();
+    flushAggregations();
     for (const auto& key : m_persistence.getReadingsKeys())
     {
         publishReadingsForPersistenceKey(key);
@@ -212,6 +331,8 @@ void DataService::publishReadings()
 
 void DataService::publishReadings(const std::string& deviceKey)
 {
+    flushIngestQueue();
+    flushAggregations();
     publishReadingsForPersistenceKey(deviceKey);
 }
 
@@ -242,9 +363,9 @@ void DataService::publishAttributes()
     {
         // Make a lambda that will delete all these attributes from persistence
         const auto& deviceKey = deviceAttributes.first;
-        auto deleteAllAttributes = [&]() {
+        auto deleteAllAttributes = [this, deviceAttributes]() {
             for (const auto& attribute : deviceAttributes.second)
-                m_persistence.removeAttributes(makePersistenceKey(deviceKey, attribute.getName()));
+                m_persistence.removeAttributes(makePersistenceKey(deviceAttributes.first, attribute.getName()));
         };
 
         // Form the message
@@ -256,8 +377,10 @@ void DataService::publishAttributes()
             deleteAllAttributes();
             return;
         }
-        if (m_connectivityService.publish(outboundMessage))
-            deleteAllAttributes();
+        publishPersisted(outboundMessage, [deleteAllAttributes](bool published) {
+            if (published)
+                deleteAllAttributes();
+        });
     }
 }
 
@@ -280,7 +403,7 @@ void DataService::publishAttributes(const std::string& deviceKey)
         return;
 
     // Make a lambda that will delete all these attributes from persistence
-    auto deleteAllAttributes = [&]() {
+    auto deleteAllAttributes = [this, deviceKey, attributes]() {
         for (const auto& attribute : attributes)
             m_persistence.removeAttributes(makePersistenceKey(deviceKey, attribute.getName()));
     };
@@ -294,8 +417,10 @@ void DataService::publishAttributes(const std::string& deviceKey)
         deleteAllAttributes();
         return;
     }
-    if (m_connectivityService.publish(outboundMessage))
-        deleteAllAttributes();
+    publishPersisted(outboundMessage, [deleteAllAttributes](bool published) {
+        if (published)
+            deleteAllAttributes();
+    });
 }
 
 void DataService::publishParameters()
@@ -325,9 +450,9 @@ void DataService::publishParameters()
     {
         // Make a lambda that will delete all these parameters from persistence
         const auto& deviceKey = deviceParameters.first;
-        auto deleteAllParameters = [&]() {
+        auto deleteAllParameters = [this, deviceParameters]() {
             for (const auto& parameter : deviceParameters.second)
-                m_persistence.removeParameters(makePersistenceKey(deviceKey, toString(parameter.first)));
+                m_persistence.removeParameters(makePersistenceKey(deviceParameters.first, toString(parameter.first)));
         };
 
         // Form the message
@@ -339,8 +464,10 @@ void DataService::publishParameters()
             deleteAllParameters();
             return;
         }
-        if (m_connectivityService.publish(outboundMessage))
-            deleteAllParameters();
+        publishPersisted(outboundMessage, [deleteAllParameters](bool published) {
+            if (published)
+                deleteAllParameters();
+        });
     }
 }
 
@@ -363,7 +490,7 @@ void DataService::publishParameters(const std::string& deviceKey)
         return;
 
     // Make a lambda that will delete all these parameters from persistence
-    auto deleteAllParameters = [&]() {
+    auto deleteAllParameters = [this, deviceKey, parameters]() {
         for (const auto& parameter : parameters)
             m_persistence.removeParameters(makePersistenceKey(deviceKey, toString(parameter.first)));
     };
@@ -377,8 +504,10 @@ void DataService::publishParameters(const std::string& deviceKey)
         deleteAllParameters();
         return;
     }
-    if (m_connectivityService.publish(outboundMessage))
-        deleteAllParameters();
+    publishPersisted(outboundMessage, [deleteAllParameters](bool published) {
+        if (published)
+            deleteAllParameters();
+    });
 }
 
 const Protocol& DataService::getProtocol()
@@ -417,7 +546,7 @@ void DataService::messageReceived(std::shared_ptr<Message> message)
         auto parameterMessage = m_protocol.parseParameters(message);
         if (parameterMessage == nullptr)
             LOG(WARN) << "Unable to parse message: " << message->getChannel();
-        else if (checkIfSubscriptionIsWaiting(*parameterMessage))    // It's important to first check this
+        else if (checkIfSubscriptionIsWaiting(deviceKey, *parameterMessage))    // It's important to first check this
             return;
         else if (m_parameterSyncHandler)
             m_parameterSyncHandler(deviceKey, parameterMessage->getParameters());
@@ -429,7 +558,7 @@ void DataService::messageReceived(std::shared_ptr<Message> message)
         auto detailsSynchronization = m_protocol.parseDetails(message);
         if (detailsSynchronization == nullptr)
             LOG(WARN) << "Unable to parse message: " << message->getChannel();
-        else if (checkIfCallbackIsWaiting(*detailsSynchronization))
+        else if (checkIfCallbackIsWaiting(deviceKey, *detailsSynchronization))
             return;
         else if (m_detailsSyncHandler)
             m_detailsSyncHandler(deviceKey, detailsSynchronization->getFeeds(),
@@ -461,81 +590,165 @@ std::pair<std::string, std::string> DataService::parsePersistenceKey(const std::
     return {deviceKey, reference};
 }
 
-bool DataService::checkIfSubscriptionIsWaiting(const ParametersUpdateMessage& parameterMessage)
+std::string DataService::makeSubscriptionKey(const std::string& deviceKey, std::vector<ParameterName> parameters)
 {
-    LOG(TRACE) << METHOD_INFO;
+    // The order in which the parameters were requested or received does not matter
+    std::sort(parameters.begin(), parameters.end());
+    auto key = deviceKey + PERSISTENCE_KEY_DELIMITER;
+    for (const auto& parameter : parameters)
+        key += std::to_string(static_cast<int>(parameter)) + ",";
+    return key;
+}
 
-    // Check if there's a subscription waiting for those parameters
+void DataService::addSubscription(const std::string& deviceKey, const std::vector<ParameterName>& parameters,
+                                  std::function<void(std::vector<Parameter>)> callback,
+                                  std::chrono::steady_clock::duration timeout)
+{
+    const auto key = makeSubscriptionKey(deviceKey, parameters);
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+
+    std::lock_guard<std::mutex> lockGuard{m_subscriptionMutex};
+    removeExpiredSubscriptions();
+    m_parameterSubscriptions[key].emplace_back(ParameterSubscription{std::move(callback), deadline});
+    m_subscriptionDeadlines.emplace_back(deadline, key);
+}
+
+void DataService::removeExpiredSubscriptions()
+{
+    // Every deadline belongs to the oldest subscription under its key, unless that one has already been answered
+    const auto now = std::chrono::steady_clock::now();
+    while (!m_subscriptionDeadlines.empty() && m_subscriptionDeadlines.front().first <= now)
     {
-        std::lock_guard<std::mutex> lockGuard{m_subscriptionMutex};
-        for (const auto& subscription : m_parameterSubscriptions)
+        const auto it = m_parameterSubscriptions.find(m_subscriptionDeadlines.front().second);
+        if (it != m_parameterSubscriptions.end() && it->second.front().deadline <= now)
         {
-            // Check if the list of parameters is the same length, and then content
-            const auto& parameters = subscription.second.parameters;
-            const auto& values = parameterMessage.getParameters();
-            if (parameterMessage.getParameters().size() != parameters.size())
-            {
-                continue;
-            }
-            auto allNamesMatching = std::all_of(parameters.cbegin(), parameters.cend(), [&](const ParameterName& name) {
-                return std::find_if(values.begin(), values.end(), [&](const Parameter& parameter) {
-                           return parameter.first == name;
-                       }) != values.cend();
-            });
-            if (!allNamesMatching)
-            {
-                continue;
-            }
+            LOG(WARN) << "Parameter subscription '" << it->first << "' has expired without a response.";
+            it->second.pop_front();
+            if (it->second.empty())
+                m_parameterSubscriptions.erase(it);
+        }
+        m_subscriptionDeadlines.pop_front();
+    }
+}
 
-            // Then we found the ones for the subscription!
-            const auto callback = std::move(subscription.second.callback);
+bool DataService::checkIfSubscriptionIsWaiting(const std::string& deviceKey,
+                                               const ParametersUpdateMessage& parameterMessage)
+{
+    LOG(TRACE) << METHOD_INFO;
 
-            // And we can clear the subscription
-            m_parameterSubscriptions.erase(subscription.first);
+    // Find the oldest subscription waiting for exactly these parameters of the device
+    const auto& values = parameterMessage.getParameters();
+    auto names = std::vector<ParameterName>{};
+    names.reserve(values.size());
+    for (const auto& value : values)
+        names.emplace_back(value.first);
+    const auto key = makeSubscriptionKey(deviceKey, names);
 
-            // Invoke the subscription
-            if (callback)
-            {
-                m_commandBuffer.pushCommand(
-                  std::make_shared<std::function<void()>>([callback, values]() { callback(values); }));
-                return true;
-            }
+    auto callback = std::function<void(std::vector<Parameter>)>{};
+    {
+        std::lock_guard<std::mutex> lockGuard{m_subscriptionMutex};
+        removeExpiredSubscriptions();
+        const auto it = m_parameterSubscriptions.find(key);
+        if (it == m_parameterSubscriptions.end())
             return false;
+
+        // Then we found the one for the subscription, and we can clear it
+        callback = std::move(it->second.front().callback);
+        it->second.pop_front();
+        if (it->second.empty())
+            m_parameterSubscriptions.erase(it);
+    }
+
+    // Invoke the subscription
+    m_commandBuffer.pushCommand(std::make_shared<std::function<void()>>([callback, values]() { callback(values); }));
+    return true;
+}
+
+void DataService::addDetailsCallback(const std::string& deviceKey,
+                                     std::function<void(std::vector<std::string>, std::vector<std::string>)> callback,
+                                     std::chrono::steady_clock::duration timeout)
+{
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+
+    std::lock_guard<std::mutex> lock{m_detailsMutex};
+    removeExpiredDetailsCallbacks();
+    m_detailsCallbacks[deviceKey].emplace_back(DetailsSubscription{std::move(callback), deadline});
+    m_detailsDeadlines.emplace_back(deadline, deviceKey);
+}
+
+void DataService::removeExpiredDetailsCallbacks()
+{
+    const auto now = std::chrono::steady_clock::now();
+    while (!m_detailsDeadlines.empty() && m_detailsDeadlines.front().first <= now)
+    {
+        const auto it = m_detailsCallbacks.find(m_detailsDeadlines.front().second);
+        if (it != m_detailsCallbacks.end() && it->second.front().deadline <= now)
+        {
+            LOG(WARN) << "Details synchronization for device '" << it->first << "' has expired without a response.";
+            it->second.pop_front();
+            if (it->second.empty())
+                m_detailsCallbacks.erase(it);
         }
+        m_detailsDeadlines.pop_front();
     }
-    return false;
 }
 
-bool DataService::checkIfCallbackIsWaiting(const DetailsSynchronizationResponseMessage& synchronizationResponseMessage)
+bool DataService::checkIfCallbackIsWaiting(const std::string& deviceKey,
+                                           const DetailsSynchronizationResponseMessage& synchronizationResponseMessage)
 {
     LOG(TRACE) << METHOD_INFO;
 
+    // Find the oldest callback waiting for the details of the device
+    auto callback = std::function<void(std::vector<std::string>, std::vector<std::string>)>{};
     {
         std::lock_guard<std::mutex> lock{m_detailsMutex};
-        if (!m_detailsCallbacks.empty())
-        {
-            const auto callback = m_detailsCallbacks.front();
-            m_commandBuffer.pushCommand(
-              std::make_shared<std::function<void()>>([callback, synchronizationResponseMessage] {
-                  callback(synchronizationResponseMessage.getFeeds(), synchronizationResponseMessage.getAttributes());
-              }));
-            m_detailsCallbacks.pop();
-            return true;
-        }
+        removeExpiredDetailsCallbacks();
+        const auto it = m_detailsCallbacks.find(deviceKey);
+        if (it == m_detailsCallbacks.end())
+            return false;
+        callback = std::move(it->second.front().callback);
+        it->second.pop_front();
+        if (it->second.empty())
+            m_detailsCallbacks.erase(it);
     }
-    return false;
+
+    m_commandBuffer.pushCommand(std::make_shared<std::function<void()>>([callback, synchronizationResponseMessage] {
+        callback(synchronizationResponseMessage.getFeeds(), synchronizationResponseMessage.getAttributes());
+    }));
+    return true;
 }
 
 void DataService::publishReadingsForPersistenceKey(const std::string& persistenceKey)
 {
     LOG(TRACE) << METHOD_INFO;
 
+    // A key whose batch is still on its way is already being published
+    {
+        std::lock_guard<std::mutex> lock{m_readingsInFlightMutex};
+        if (!m_readingsInFlight.emplace(persistenceKey).second)
+            return;
+    }
+    publishReadingsBatch(persistenceKey);
+}
+
+void DataService::publishReadingsBatch(const std::string& persistenceKey)
+{
+    LOG(TRACE) << METHOD_INFO;
+
+    auto finish = [&] {
+        std::lock_guard<std::mutex> lock{m_readingsInFlightMutex};
+        m_readingsInFlight.erase(persistenceKey);
+    };
+
     // Read all information from persistence
     auto readings = std::vector<Reading>{};
     for (const auto& readingFromPersistence : m_persistence.getReadings(persistenceKey, PUBLISH_BATCH_ITEMS_COUNT))
         readings.emplace_back(*readingFromPersistence);
     if (readings.empty())
+    {
+        finish();
         return;
+    }
     auto deviceKey = std::string{};
     auto reference = std::string{};
     std::tie(deviceKey, reference) = parsePersistenceKey(persistenceKey);
@@ -544,22 +757,242 @@ void DataService::publishReadingsForPersistenceKey(const std::string& persistenc
     if (deviceKey.empty())
     {
         LOG(ERROR) << "Unable to create message from readings: The device key is empty.";
+        finish();
         return;
     }
     // Create the message
+    const auto count = static_cast<std::uint_fast64_t>(readings.size());
     const auto outboundMessage =
       std::shared_ptr<Message>{m_protocol.makeOutboundMessage(deviceKey, FeedValuesMessage{readings})};
     if (!outboundMessage)
     {
         LOG(ERROR) << "Unable to create message from readings: " << persistenceKey;
-        m_persistence.removeReadings(persistenceKey, PUBLISH_BATCH_ITEMS_COUNT);
+        m_persistence.removeReadings(persistenceKey, count);
+        finish();
+        return;
+    }
+
+    // Only the readings that were sent are removed, the ones added in the meantime wait for the next batch
+    publishPersisted(outboundMessage, [this, persistenceKey, count](bool published) {
+        if (!published)
+        {
+            std::lock_guard<std::mutex> lock{m_readingsInFlightMutex};
+            m_readingsInFlight.erase(persistenceKey);
+            return;
+        }
+        m_persistence.removeReadings(persistenceKey, count);
+        publishReadingsBatch(persistenceKey);
+    });
+}
+
+void DataService::publishPersisted(const std::shared_ptr<Message>& message, const std::function<void(bool)>& callback)
+{
+    // Through the scheduler, the data is removed only once the message is really out, not once it is queued
+    if (m_outboundScheduler != nullptr)
+    {
+        if (!m_outboundScheduler->publish(message, callback))
+            callback(false);
+        return;
+    }
+    callback(m_connectivityService.publish(message));
+}
+
+void DataService::ingestReading(const std::string& deviceKey, const Reading& reading)
+{
+    // Without a queue, the reading is stored right away
+    if (m_ingestQueue == nullptr)
+    {
+        handleReading(deviceKey, reading);
+        return;
+    }
+    if (queueReading(deviceKey, reading))
+        return;
+
+    // The readings still in the queue are stored first, so the readings of a feed keep their order
+    std::lock_guard<std::mutex> lock{m_ingestMutex};
+    storeQueuedReadings();
+    handleReading(deviceKey, reading);
+}
+
+bool DataService::queueReading(const std::string& deviceKey, const Reading& reading)
+{
+    if (m_ingestQueue->tryPush(deviceKey, reading))
+    {
+        wakeIngestThread();
+        return true;
+    }
+    if (m_ingestQueue->isClosed())
+        return false;
+
+    switch (m_ingestOverflowPolicy)
+    {
+    case IngestOverflowPolicy::Reject:
+        ++m_droppedReadings;
+        LOG(TRACE) << "Dropping reading for '" << deviceKey << "' -> The ingest queue is full.";
+        return true;
+    case IngestOverflowPolicy::Block:
+    {
+        // The producer waits until a batch is taken out of the queue, or the queue is closed
+        auto pushed = false;
+        {
+            std::unique_lock<std::mutex> lock{m_ingestWakeupMutex};
+            ++m_ingestBlocked;
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            m_ingestSpace.wait(lock, [&] {
+                pushed = m_ingestQueue->tryPush(deviceKey, reading);
+                return pushed || m_ingestQueue->isClosed();
+            });
+            --m_ingestBlocked;
+        }
+        if (pushed)
+            wakeIngestThread();
+        return pushed;
+    }
+    case IngestOverflowPolicy::Synchronous:
+    default:
+        return false;
+    }
+}
+
+void DataService::wakeIngestThread()
+{
+    // The claim of the slot and this load are both sequentially consistent, so either the thread sees the reading
+    // before it goes to sleep, or it is seen sleeping here
+    if (!m_ingestSleeping)
+        return;
+    std::lock_guard<std::mutex> lock{m_ingestWakeupMutex};
+    m_ingestSleeping = false;
+    m_ingestWakeup.notify_one();
+}
+
+void DataService::releaseBlockedProducers()
+{
+    // The fence orders the freeing of the slots before the load, the same way the producers order their count before
+    // they try again
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_ingestBlocked == 0)
+        return;
+    std::lock_guard<std::mutex> lock{m_ingestWakeupMutex};
+    m_ingestSpace.notify_all();
+}
+
+void DataService::flushIngestQueue()
+{
+    if (m_ingestQueue == nullptr)
+        return;
+    std::lock_guard<std::mutex> lock{m_ingestMutex};
+    storeQueuedReadings();
+}
+
+void DataService::storeQueuedReadings()
+{
+    auto batch = std::vector<IngestedReading>{};
+    while (m_ingestQueue->drain(batch, INGEST_BATCH_ITEMS_COUNT) > 0)
+    {
+        releaseBlockedProducers();
+        for (const auto& ingested : batch)
+            handleReading(ingested.deviceKey, ingested.reading);
+        batch.clear();
+    }
+}
+
+void DataService::runIngestQueue()
+{
+    auto batch = std::vector<IngestedReading>{};
+    batch.reserve(INGEST_BATCH_ITEMS_COUNT);
+    while (true)
+    {
+        // The batch is stored with the mutex locked, so the readings stored by other threads can not overtake it
+        auto drained = std::size_t{0};
+        {
+            std::lock_guard<std::mutex> lock{m_ingestMutex};
+            batch.clear();
+            drained = m_ingestQueue->drain(batch, INGEST_BATCH_ITEMS_COUNT);
+            if (drained > 0)
+                releaseBlockedProducers();
+            for (const auto& ingested : batch)
+                handleReading(ingested.deviceKey, ingested.reading);
+        }
+        if (drained > 0)
+            continue;
+
+        // The thread is marked as sleeping before it looks at the queue a last time, so a reading added meanwhile
+        // either is seen here, or its producer wakes the thread up. A slot that is claimed, but not yet written, is
+        // waited for.
+        std::unique_lock<std::mutex> lock{m_ingestWakeupMutex};
+        m_ingestSleeping = true;
+        if (!m_ingestQueue->isEmpty())
+        {
+            m_ingestSleeping = false;
+            lock.unlock();
+            std::this_thread::yield();
+            continue;
+        }
+        if (m_ingestQueue->isClosed())
+            return;
+        m_ingestWakeup.wait(lock, [&] { return !m_ingestSleeping; });
+    }
+}
+
+void DataService::handleReading(const std::string& deviceKey, const Reading& reading)
+{
+    // Samples of aggregated feeds are only stored once their window is closed, so the persistence key is only made for
+    // the readings that are stored
+    auto aggregated = std::vector<Reading>{};
+    if (aggregateReading(deviceKey, reading, aggregated))
+    {
+        for (const auto& aggregatedReading : aggregated)
+        {
+            const auto aggregatedKey = makePersistenceKey(deviceKey, aggregatedReading.getReference());
+            if (filterReading(aggregatedKey, aggregatedReading))
+                m_persistence.putReading(aggregatedKey, aggregatedReading);
+        }
         return;
     }
-    if (m_connectivityService.publish(outboundMessage))
+
+    const auto key = makePersistenceKey(deviceKey, reading.getReference());
+    if (filterReading(key, reading))
+        m_persistence.putReading(key, reading);
+}
+
+bool DataService::aggregateReading(const std::string& deviceKey, const Reading& reading, std::vector<Reading>& output)
+{
+    std::lock_guard<std::mutex> lock{m_aggregationMutex};
+    const auto deviceIt = m_aggregators.find(deviceKey);
+    if (deviceIt == m_aggregators.end())
+        return false;
+    const auto it = deviceIt->second.find(reading.getReference());
+    if (it == deviceIt->second.end())
+        return false;
+
+    auto value = double{0};
+    if (!FeedAggregator::parseSample(reading, value))
     {
-        m_persistence.removeReadings(persistenceKey, PUBLISH_BATCH_ITEMS_COUNT);
-        publishReadingsForPersistenceKey(persistenceKey);
+        LOG(WARN) << "Storing reading for '" << makePersistenceKey(deviceKey, reading.getReference())
+                  << "' without aggregation -> It is not a single numeric value.";
+        return false;
     }
+    it->second.addSample(value, reading.getTimestamp() != 0 ? reading.getTimestamp() : currentTimestamp(), output);
+    return true;
+}
+
+bool DataService::filterReading(const std::string& persistenceKey, const Reading& reading)
+{
+    std::lock_guard<std::mutex> lock{m_filterMutex};
+    const auto it = m_filters.find(persistenceKey);
+    if (it == m_filters.cend())
+        return true;
+
+    if (it->second.accept(reading, currentTimestamp()))
+        return true;
+    LOG(TRACE) << "Dropping reading for '" << persistenceKey << "' -> It was filtered out.";
+    return false;
+}
+
+std::uint64_t DataService::currentTimestamp()
+{
+    const auto now = std::chrono::system_clock::now().time_since_epoch();
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(now).count());
 }
 }    // namespace connect
 }    // namespace wolkabout
@@ -23,11 +23,22 @@
 #include "core/model/Feed.h"
 #include "core/model/Reading.h"
 #include "core/utilities/CommandBuffer.h"
+#include "wolk/service/data/FeedAggregator.h"
+#include "wolk/service/data/ReadingFilter.h"
+#include "wolk/service/data/ReadingIngestQueue.h"
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <functional>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <set>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 namespace wolkabout
@@ -42,6 +53,8 @@ class OutboundRetryMessageHandler;
 
 namespace connect
 {
+class OutboundScheduler;
+
 using FeedUpdateSetHandler = std::function<void(std::string, std::map<std::uint64_t, std::vector<Reading>>)>;
 using ParameterSyncHandler = std::function<void(std::string, std::vector<Parameter>)>;
 using DetailsSyncHandler = std::function<void(std::string, std::vector<std::string>, std::vector<std::string>)>;
@@ -53,6 +66,41 @@ public:
                 OutboundRetryMessageHandler& outboundRetryMessageHandler, FeedUpdateSetHandler feedUpdateHandler,
                 ParameterSyncHandler parameterSyncHandler, DetailsSyncHandler detailsSyncHandler);
 
+    ~DataService() override;
+
+    /**
+     * This method is used to place a queue in front of the persistence, so the threads adding readings do not wait for
+     * each other, or for the persistence. The readings are added into a lock-free queue, and a thread of the service
+     * takes them out in batches and stores them. The thread sleeps while the queue is empty, and is woken up by the
+     * first reading added afterwards. Must be called before readings are added.
+     *
+     * @param capacity The count of readings the queue can hold.
+     * @param overflowPolicy What happens to a reading that is added while the queue is full.
+     */
+    void startIngestQueue(std::size_t capacity, IngestOverflowPolicy overflowPolicy);
+
+    /**
+     * This method is used to stop the thread of the ingest queue, once it has stored all the readings in the queue.
+     * The queue is closed to new readings first, and the readings that are added afterwards are stored right away.
+     */
+    void stopIngestQueue();
+
+    /**
+     * This method is used to tell the service that its messages go through an outbound scheduler. The readings,
+     * attributes and parameters are then removed from the persistence only once the scheduler reports that their
+     * message was sent, instead of once it is queued. The scheduler must be stopped before the service is destroyed.
+     *
+     * @param outboundScheduler The scheduler the connectivity service of the service is.
+     */
+    void setOutboundScheduler(OutboundScheduler* outboundScheduler);
+
+    /**
+     * Getter for the count of readings that were dropped because the ingest queue was full.
+     *
+     * @return The count of dropped readings.
+     */
+    std::uint64_t getDroppedReadingCount() const;
+
     virtual void addReading(const std::string& deviceKey, const std::string& reference, const std::string& value,
                             std::uint64_t rtc);
     virtual void addReading(const std::string& deviceKey, const std::string& reference,
@@ -70,11 +118,60 @@ public:
     virtual void removeFeed(const std::string& deviceKey, std::string reference);
     virtual void removeFeeds(const std::string& deviceKey, std::vector<std::string> feeds);
 
+    /**
+     * This method is used to set up the filter for readings of a feed. Readings the filter drops are never stored in
+     * the persistence, and are never published. Passing a configuration with no criteria enabled removes the filter.
+     *
+     * @param deviceKey The key of the device owning the feed.
+     * @param reference The reference of the feed.
+     * @param filter The configuration of the filter.
+     */
+    virtual void setFeedFilter(const std::string& deviceKey, const std::string& reference,
+                               const ReadingFilterConfiguration& filter);
+
+    /**
+     * This method is used to set up the aggregation of a numeric feed. Instead of storing every sample, the service
+     * stores the minimum, maximum, mean, last value and count of every window as readings of the derived feeds (see
+     * `FeedAggregator`). Windows whose time has passed are closed when the next sample arrives, or when the readings
+     * are published. Passing a configuration with no window removes the aggregation, and drops the current window.
+     *
+     * @param deviceKey The key of the device owning the feed.
+     * @param reference The reference of the feed.
+     * @param aggregation The configuration of the aggregation.
+     */
+    virtual void setFeedAggregation(const std::string& deviceKey, const std::string& reference,
+                                    const AggregationConfiguration& aggregation);
+
+    /**
+     * This method is used to close all the aggregation windows whose time has passed, and store their readings.
+     */
+    virtual void flushAggregations();
+
     virtual void pullFeedValues(const std::string& deviceKey);
     virtual void pullParameters(const std::string& deviceKey);
+    /**
+     * This method is used to request the values of parameters from the platform. The callback is invoked with the
+     * values once the platform responds with exactly those parameters for the device. If the platform does not
+     * respond within the subscription timeout, the callback is dropped and never invoked.
+     *
+     * @param deviceKey The key of the device whose parameters are requested.
+     * @param parameters The names of the requested parameters.
+     * @param callback The callback that receives the values.
+     * @return Whether the request has been sent out.
+     */
     virtual bool synchronizeParameters(const std::string& deviceKey, const std::vector<ParameterName>& parameters,
                                        std::function<void(std::vector<Parameter>)> callback);
 
+    /**
+     * This method is used to request the list of feeds and attributes of a device from the platform. The callback is
+     * invoked with the response for that device. Concurrent requests for the same device are answered in the order
+     * they were made. If the platform does not respond within the retries of the request, the callback is dropped and
+     * never invoked.
+     *
+     * @param deviceKey The key of the device whose details are requested.
+     * @param callback The callback that receives the feeds and attributes.
+     * @return Whether the request has been sent out.
+     */
     virtual bool detailsSynchronizationAsync(
       const std::string& deviceKey, std::function<void(std::vector<std::string>, std::vector<std::string>)> callback);
 
@@ -96,16 +193,69 @@ private:
 
     static std::pair<std::string, std::string> parsePersistenceKey(const std::string& key);
 
-    bool checkIfSubscriptionIsWaiting(const ParametersUpdateMessage& parameterMessage);
+    static std::string makeSubscriptionKey(const std::string& deviceKey, std::vector<ParameterName> parameters);
 
-    bool checkIfCallbackIsWaiting(const DetailsSynchronizationResponseMessage& synchronizationResponseMessage);
+    void addSubscription(const std::string& deviceKey, const std::vector<ParameterName>& parameters,
+                         std::function<void(std::vector<Parameter>)> callback,
+                         std::chrono::steady_clock::duration timeout);
+
+    void removeExpiredSubscriptions();
+
+    bool checkIfSubscriptionIsWaiting(const std::string& deviceKey, const ParametersUpdateMessage& parameterMessage);
+
+    void addDetailsCallback(const std::string& deviceKey,
+                            std::function<void(std::vector<std::string>, std::vector<std::string>)> callback,
+                            std::chrono::steady_clock::duration timeout);
+
+    void removeExpiredDetailsCallbacks();
+
+    bool checkIfCallbackIsWaiting(const std::string& deviceKey,
+                                  const DetailsSynchronizationResponseMessage& synchronizationResponseMessage);
 
     void publishReadingsForPersistenceKey(const std::string& persistenceKey);
 
+    // Expects the key to be marked as in flight, and unmarks it once there is nothing left to send
+    void publishReadingsBatch(const std::string& persistenceKey);
+
+    // Publishes a message of persisted data, and tells the callback whether it was sent, once that is known
+    void publishPersisted(const std::shared_ptr<Message>& message, const std::function<void(bool)>& callback);
+
+    void ingestReading(const std::string& deviceKey, const Reading& reading);
+
+    // Returns whether the reading was taken care of by the queue, and does not need to be stored by the caller
+    bool queueReading(const std::string& deviceKey, const Reading& reading);
+
+    // Wakes up the thread of the queue, if it is sleeping
+    void wakeIngestThread();
+
+    // Wakes up the producers waiting for room in the queue, if there are any
+    void releaseBlockedProducers();
+
+    void flushIngestQueue();
+
+    // Expects the ingest mutex to be locked
+    void storeQueuedReadings();
+
+    void runIngestQueue();
+
+    void handleReading(const std::string& deviceKey, const Reading& reading);
+
+    bool aggregateReading(const std::string& deviceKey, const Reading& reading, std::vector<Reading>& output);
+
+    bool filterReading(const std::string& persistenceKey, const Reading& reading);
+
+    static std::uint64_t currentTimestamp();
+
     DataProtocol& m_protocol;
     Persistence& m_persistence;
     ConnectivityService& m_connectivityService;
     OutboundRetryMessageHandler& m_outboundRetryMessageHandler;
+    OutboundScheduler* m_outboundScheduler;
+
+    // The keys whose batch of readings is waiting to be sent. The next batch of a key is read only once the previous
+    // one is sent and removed, so a batch is never sent twice, or removed in place of readings that were not sent.
+    std::mutex m_readingsInFlightMutex;
+    std::set<std::string> m_readingsInFlight;
 
     FeedUpdateSetHandler m_feedUpdateHandler;
     ParameterSyncHandler m_parameterSyncHandler;
@@ -114,18 +264,51 @@ private:
     CommandBuffer m_commandBuffer;
     struct ParameterSubscription
     {
-        std::vector<ParameterName> parameters;
         std::function<void(std::vector<Parameter>)> callback;
+        std::chrono::steady_clock::time_point deadline;
     };
-    std::uint64_t m_iterator;
+    // The subscriptions are indexed by the device key and the sorted parameter names, oldest first. The deadlines are
+    // kept in the order the subscriptions were made, which is also the order in which they expire.
     std::mutex m_subscriptionMutex;
-    std::map<std::uint64_t, ParameterSubscription> m_parameterSubscriptions;
+    std::unordered_map<std::string, std::deque<ParameterSubscription>> m_parameterSubscriptions;
+    std::deque<std::pair<std::chrono::steady_clock::time_point, std::string>> m_subscriptionDeadlines;
+
+    std::mutex m_filterMutex;
+    std::map<std::string, ReadingFilter> m_filters;
 
+    // The aggregators are indexed by the device key, and then the reference, so a sample is matched without making
+    // its persistence key
+    std::mutex m_aggregationMutex;
+    std::map<std::string, std::map<std::string, FeedAggregator>> m_aggregators;
+
+    struct DetailsSubscription
+    {
+        std::function<void(std::vector<std::string>, std::vector<std::string>)> callback;
+        std::chrono::steady_clock::time_point deadline;
+    };
+    // The details callbacks are indexed by the device key, oldest first, with their deadlines kept the same way as the
+    // ones of the parameter subscriptions.
     std::mutex m_detailsMutex;
-    std::queue<std::function<void(std::vector<std::string>, std::vector<std::string>)>> m_detailsCallbacks;
+    std::unordered_map<std::string, std::deque<DetailsSubscription>> m_detailsCallbacks;
+    std::deque<std::pair<std::chrono::steady_clock::time_point, std::string>> m_detailsDeadlines;
+
+    // The optional queue of readings in front of the persistence, and the thread that stores them. Whoever takes the
+    // readings out of the queue holds the mutex. The thread sleeps on the wakeup while the queue is empty, and the
+    // producers that wait for room in a full queue sleep on the space.
+    std::unique_ptr<ReadingIngestQueue> m_ingestQueue;
+    IngestOverflowPolicy m_ingestOverflowPolicy;
+    std::mutex m_ingestMutex;
+    std::mutex m_ingestWakeupMutex;
+    std::condition_variable m_ingestWakeup;
+    std::condition_variable m_ingestSpace;
+    std::atomic_bool m_ingestSleeping;
+    std::atomic<std::size_t> m_ingestBlocked;
+    std::atomic<std::uint64_t> m_droppedReadings;
+    std::thread m_ingestThread;
 
     static const std::string PERSISTENCE_KEY_DELIMITER;
     static const constexpr unsigned int PUBLISH_BATCH_ITEMS_COUNT = 50;
+    static const constexpr std::size_t INGEST_BATCH_ITEMS_COUNT = 256;
 };
 }    // namespace connect
 }    // namespace wolkabout
@@ -0,0 +1,139 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wolk/service/data/FeedAggregator.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <sstream>
+
+namespace wolkabout
+{
+namespace connect
+{
+namespace
+{
+std::string toString(double value)
+{
+    auto stream = std::ostringstream{};
+    stream.precision(std::numeric_limits<double>::digits10);
+    stream << value;
+    return stream.str();
+}
+}    // namespace
+
+const std::string FeedAggregator::MINIMUM_SUFFIX = "_min";
+const std::string FeedAggregator::MAXIMUM_SUFFIX = "_max";
+const std::string FeedAggregator::MEAN_SUFFIX = "_mean";
+const std::string FeedAggregator::LAST_SUFFIX = "_last";
+const std::string FeedAggregator::COUNT_SUFFIX = "_count";
+
+bool AggregationConfiguration::isEnabled() const
+{
+    return window.count() > 0 && (minimum || maximum || mean || last || count);
+}
+
+FeedAggregator::FeedAggregator(std::string reference, AggregationConfiguration configuration)
+: m_reference(std::move(reference))
+, m_configuration(configuration)
+, m_windowLength(static_cast<std::uint64_t>(configuration.window.count() > 0 ? configuration.window.count() : 1))
+, m_windowStart(0)
+, m_count(0)
+, m_minimum(0)
+, m_maximum(0)
+, m_sum(0)
+, m_last(0)
+, m_lastTimestamp(0)
+{
+}
+
+bool FeedAggregator::parseSample(const Reading& reading, double& value)
+{
+    // The single value is read on its own, without copying the values of the reading
+    if (reading.isMulti())
+        return false;
+    const auto& text = reading.getStringValue();
+    if (text.empty())
+        return false;
+    char* end = nullptr;
+    value = std::strtod(text.c_str(), &end);
+    return end == text.c_str() + text.size() && std::isfinite(value);
+}
+
+bool FeedAggregator::addSample(double value, std::uint64_t timestamp, std::vector<Reading>& output)
+{
+    const auto windowStart = timestamp - timestamp % m_windowLength;
+    auto closed = false;
+    if (m_count > 0 && windowStart > m_windowStart)
+    {
+        closeWindow(output);
+        closed = true;
+    }
+
+    // A sample that is late for its window is counted in the current one
+    if (m_count == 0)
+    {
+        m_windowStart = windowStart;
+        m_minimum = value;
+        m_maximum = value;
+        m_sum = 0;
+    }
+    m_minimum = value < m_minimum ? value : m_minimum;
+    m_maximum = value > m_maximum ? value : m_maximum;
+    m_sum += value;
+    m_last = value;
+    m_lastTimestamp = timestamp > m_lastTimestamp ? timestamp : m_lastTimestamp;
+    ++m_count;
+    return closed;
+}
+
+bool FeedAggregator::flush(std::uint64_t now, std::vector<Reading>& output)
+{
+    if (m_count == 0 || now < m_windowStart + m_windowLength)
+        return false;
+    closeWindow(output);
+    return true;
+}
+
+const AggregationConfiguration& FeedAggregator::getConfiguration() const
+{
+    return m_configuration;
+}
+
+std::uint64_t FeedAggregator::getSampleCount() const
+{
+    return m_count;
+}
+
+void FeedAggregator::closeWindow(std::vector<Reading>& output)
+{
+    if (m_configuration.minimum)
+        output.emplace_back(m_reference + MINIMUM_SUFFIX, toString(m_minimum), m_lastTimestamp);
+    if (m_configuration.maximum)
+        output.emplace_back(m_reference + MAXIMUM_SUFFIX, toString(m_maximum), m_lastTimestamp);
+    if (m_configuration.mean)
+        output.emplace_back(m_reference + MEAN_SUFFIX, toString(m_sum / static_cast<double>(m_count)),
+                            m_lastTimestamp);
+    if (m_configuration.last)
+        output.emplace_back(m_reference + LAST_SUFFIX, toString(m_last), m_lastTimestamp);
+    if (m_configuration.count)
+        output.emplace_back(m_reference + COUNT_SUFFIX, std::to_string(m_count), m_lastTimestamp);
+    m_count = 0;
+    m_lastTimestamp = 0;
+}
+}    // namespace connect
+}    // namespace wolkabout
@@ -0,0 +1,140 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WOLKABOUTCONNECTOR_FEEDAGGREGATOR_H
+#define WOLKABOUTCONNECTOR_FEEDAGGREGATOR_H
+
+#include "core/model/Reading.h"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace wolkabout
+{
+namespace connect
+{
+/**
+ * This is the configuration of the aggregation of a feed. Every window produces a reading for each of the enabled
+ * outputs, with the reference of the feed followed by the suffix of the output (for example `T_mean`). Those feeds
+ * need to be registered on the platform like any other feed.
+ */
+struct AggregationConfiguration
+{
+    // The length of the window. Windows are aligned to multiples of it, so windows of different feeds line up.
+    std::chrono::milliseconds window{0};
+
+    // The outputs that are produced for every window.
+    bool minimum = true;
+    bool maximum = true;
+    bool mean = true;
+    bool last = true;
+    bool count = true;
+
+    /**
+     * This method is used to check whether the configuration describes any aggregation.
+     *
+     * @return Whether the window and at least one output is set.
+     */
+    bool isEnabled() const;
+};
+
+/**
+ * This is the aggregator for the samples of a single numeric feed. It keeps only the running minimum, maximum, sum,
+ * last value and count of the current window, so adding a sample never allocates, no matter the sample rate.
+ */
+class FeedAggregator
+{
+public:
+    static const std::string MINIMUM_SUFFIX;
+    static const std::string MAXIMUM_SUFFIX;
+    static const std::string MEAN_SUFFIX;
+    static const std::string LAST_SUFFIX;
+    static const std::string COUNT_SUFFIX;
+
+    /**
+     * Default parameter constructor.
+     *
+     * @param reference The reference of the feed that is aggregated.
+     * @param configuration The configuration of the aggregation.
+     */
+    FeedAggregator(std::string reference, AggregationConfiguration configuration);
+
+    /**
+     * This method is used to read the sample value out of a reading. Only single value numeric readings can be
+     * aggregated.
+     *
+     * @param reading The reading.
+     * @param value The value of the sample.
+     * @return Whether the reading holds a sample.
+     */
+    static bool parseSample(const Reading& reading, double& value);
+
+    /**
+     * This method adds a sample to the current window. If the sample belongs to a later window, the current window is
+     * closed first and its readings are added to the output.
+     *
+     * @param value The value of the sample.
+     * @param timestamp The time of the sample in milliseconds.
+     * @param output The vector into which the readings of a closed window are added.
+     * @return Whether a window was closed.
+     */
+    bool addSample(double value, std::uint64_t timestamp, std::vector<Reading>& output);
+
+    /**
+     * This method closes the current window if its time has passed.
+     *
+     * @param now The current time in milliseconds.
+     * @param output The vector into which the readings of the closed window are added.
+     * @return Whether a window was closed.
+     */
+    bool flush(std::uint64_t now, std::vector<Reading>& output);
+
+    /**
+     * Getter for the configuration of the aggregation.
+     *
+     * @return The configuration.
+     */
+    const AggregationConfiguration& getConfiguration() const;
+
+    /**
+     * Getter for the count of samples in the current window.
+     *
+     * @return The count of samples.
+     */
+    std::uint64_t getSampleCount() const;
+
+private:
+    // Internal method used to produce the readings of the current window and reset it
+    void closeWindow(std::vector<Reading>& output);
+
+    std::string m_reference;
+    AggregationConfiguration m_configuration;
+    std::uint64_t m_windowLength;
+
+    std::uint64_t m_windowStart;
+    std::uint64_t m_count;
+    double m_minimum;
+    double m_maximum;
+    double m_sum;
+    double m_last;
+    std::uint64_t m_lastTimestamp;
+};
+}    // namespace connect
+}    // namespace wolkabout
+
+#endif    // WOLKABOUTCONNECTOR_FEEDAGGREGATOR_H
@@ -0,0 +1,124 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wolk/service/data/ReadingFilter.h"
+
+#include <cmath>
+#include <cstdlib>
+
+namespace wolkabout
+{
+namespace connect
+{
+namespace
+{
+bool parseNumber(const std::string& value, double& number)
+{
+    if (value.empty())
+        return false;
+    char* end = nullptr;
+    number = std::strtod(value.c_str(), &end);
+    return end == value.c_str() + value.size() && std::isfinite(number);
+}
+}    // namespace
+
+bool ReadingFilterConfiguration::isEnabled() const
+{
+    return absoluteDeadband > 0 || percentDeadband > 0 || publishOnChange || minimumInterval.count() > 0;
+}
+
+ReadingFilter::ReadingFilter(ReadingFilterConfiguration configuration)
+: m_configuration(configuration), m_hasLastReading(false), m_lastTimestamp(0), m_droppedCount(0)
+{
+}
+
+bool ReadingFilter::accept(const Reading& reading, std::uint64_t timestamp)
+{
+    if (reading.getTimestamp() != 0)
+        timestamp = reading.getTimestamp();
+    auto values = reading.getStringValues();
+
+    // The first reading, and the readings that arrive out of order, are always kept, but only the newer ones are
+    // remembered
+    if (!m_hasLastReading || timestamp < m_lastTimestamp)
+    {
+        if (!m_hasLastReading)
+        {
+            m_hasLastReading = true;
+            m_lastValues = std::move(values);
+            m_lastTimestamp = timestamp;
+        }
+        return true;
+    }
+
+    const auto elapsed = timestamp - m_lastTimestamp;
+    const auto minimumInterval = static_cast<std::uint64_t>(m_configuration.minimumInterval.count());
+    const auto maximumSilence = static_cast<std::uint64_t>(m_configuration.maximumSilence.count());
+    auto keep = elapsed >= minimumInterval;
+    if (keep && !(maximumSilence > 0 && elapsed >= maximumSilence))
+        keep = hasChanged(values);
+
+    if (!keep)
+    {
+        ++m_droppedCount;
+        return false;
+    }
+    m_lastValues = std::move(values);
+    m_lastTimestamp = timestamp;
+    return true;
+}
+
+const ReadingFilterConfiguration& ReadingFilter::getConfiguration() const
+{
+    return m_configuration;
+}
+
+std::uint64_t ReadingFilter::getDroppedCount() const
+{
+    return m_droppedCount;
+}
+
+bool ReadingFilter::hasChanged(const std::vector<std::string>& values) const
+{
+    const auto hasDeadband = m_configuration.absoluteDeadband > 0 || m_configuration.percentDeadband > 0;
+    if (!hasDeadband && !m_configuration.publishOnChange)
+        return true;
+    if (values.size() != m_lastValues.size())
+        return true;
+
+    for (auto i = std::size_t{0}; i < values.size(); ++i)
+    {
+        auto current = double{0};
+        auto last = double{0};
+        if (!hasDeadband || !parseNumber(values[i], current) || !parseNumber(m_lastValues[i], last))
+        {
+            if (values[i] != m_lastValues[i])
+                return true;
+            continue;
+        }
+
+        // The value has changed if it is out of any of the configured bands
+        const auto difference = std::fabs(current - last);
+        if (m_configuration.absoluteDeadband > 0 && difference > m_configuration.absoluteDeadband)
+            return true;
+        if (m_configuration.percentDeadband > 0 &&
+            difference > std::fabs(last) * m_configuration.percentDeadband / 100.0)
+            return true;
+    }
+    return false;
+}
+}    // namespace connect
+}    // namespace wolkabout
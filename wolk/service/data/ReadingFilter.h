@@ -0,0 +1,117 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WOLKABOUTCONNECTOR_READINGFILTER_H
+#define WOLKABOUTCONNECTOR_READINGFILTER_H
+
+#include "core/model/Reading.h"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace wolkabout
+{
+namespace connect
+{
+/**
+ * This is the configuration of a filter that decides which readings of a feed are worth storing and publishing.
+ * Every criteria that is left at its default value is disabled, so a default constructed configuration lets every
+ * reading through.
+ */
+struct ReadingFilterConfiguration
+{
+    // A numeric reading is dropped if no value moved more than this from the last kept reading.
+    double absoluteDeadband = 0;
+
+    // A numeric reading is dropped if no value moved more than this percentage of the last kept reading.
+    double percentDeadband = 0;
+
+    // A reading is dropped if its values are exactly the same as the ones of the last kept reading.
+    bool publishOnChange = false;
+
+    // A reading is dropped if it came sooner than this after the last kept reading.
+    std::chrono::milliseconds minimumInterval{0};
+
+    // A reading is always kept if this much time has passed since the last kept reading, even if it was not changed.
+    std::chrono::milliseconds maximumSilence{0};
+
+    /**
+     * This method is used to check whether any of the criteria is enabled.
+     *
+     * @return Whether the filter would drop any readings.
+     */
+    bool isEnabled() const;
+};
+
+/**
+ * This is the filter for readings of a single feed. It remembers the last reading it kept, and compares every new
+ * reading against it (not against the last reading it has seen, so slow drifts are not hidden by the deadband).
+ *
+ * Values that can not be read as numbers are not affected by the deadband, and are compared as text if the filter
+ * has any value criteria. The maximum silence is only checked when a reading arrives, so it makes sure a reading is
+ * kept every now and then as long as the device keeps sampling the feed.
+ */
+class ReadingFilter
+{
+public:
+    /**
+     * Default parameter constructor.
+     *
+     * @param configuration The configuration of the filter.
+     */
+    explicit ReadingFilter(ReadingFilterConfiguration configuration = {});
+
+    /**
+     * This method checks whether the reading should be kept, and if so, remembers it as the last kept reading.
+     *
+     * @param reading The new reading.
+     * @param timestamp The time of the reading in milliseconds. If the reading has its own timestamp, this is ignored.
+     * @return Whether the reading should be kept.
+     */
+    bool accept(const Reading& reading, std::uint64_t timestamp);
+
+    /**
+     * Getter for the configuration of the filter.
+     *
+     * @return The configuration.
+     */
+    const ReadingFilterConfiguration& getConfiguration() const;
+
+    /**
+     * Getter for the count of readings the filter has dropped.
+     *
+     * @return The count of dropped readings.
+     */
+    std::uint64_t getDroppedCount() const;
+
+private:
+    // Internal method used to check whether the values have changed enough to be worth keeping
+    bool hasChanged(const std::vector<std::string>& values) const;
+
+    ReadingFilterConfiguration m_configuration;
+
+    bool m_hasLastReading;
+    std::vector<std::string> m_lastValues;
+    std::uint64_t m_lastTimestamp;
+
+    std::uint64_t m_droppedCount;
+};
+}    // namespace connect
+}    // namespace wolkabout
+
+#endif    // WOLKABOUTCONNECTOR_READINGFILTER_H
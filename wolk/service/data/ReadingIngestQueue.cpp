@@ -0,0 +1,122 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wolk/service/data/ReadingIngestQueue.h"
+
+#include <new>
+
+namespace wolkabout
+{
+namespace connect
+{
+ReadingIngestQueue::ReadingIngestQueue(std::size_t capacity)
+: m_mask(0), m_enqueuePadding{}, m_enqueuePosition{0}, m_dequeuePadding{}, m_dequeuePosition(0), m_endPadding{}
+{
+    auto size = std::size_t{2};
+    while (size < capacity)
+        size <<= 1;
+    m_mask = size - 1;
+
+    // Every slot starts out free for the first lap
+    m_slots = std::unique_ptr<Slot[]>{new Slot[size]};
+    for (auto i = std::size_t{0}; i < size; ++i)
+        m_slots[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+ReadingIngestQueue::~ReadingIngestQueue()
+{
+    auto remaining = std::vector<IngestedReading>{};
+    drain(remaining, capacity());
+}
+
+bool ReadingIngestQueue::tryPush(const std::string& deviceKey, const Reading& reading)
+{
+    auto position = m_enqueuePosition.load(std::memory_order_relaxed);
+    while (true)
+    {
+        if ((position & CLOSED_BIT) != 0)
+            return false;
+
+        auto& slot = m_slots[position & m_mask];
+        const auto sequence = slot.sequence.load(std::memory_order_acquire);
+        const auto difference = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(position);
+        if (difference == 0)
+        {
+            // The slot is free for this lap, and it is ours if no other producer claimed it, and the queue was not
+            // closed, in the meantime. The claim is sequentially consistent, so a consumer about to sleep sees it.
+            if (m_enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_seq_cst,
+                                                        std::memory_order_relaxed))
+            {
+                new (&slot.storage) IngestedReading{deviceKey, reading};
+                slot.sequence.store(position + 1, std::memory_order_release);
+                return true;
+            }
+        }
+        else if (difference < 0)
+        {
+            // The slot still holds the reading of the previous lap, so the queue is full
+            return false;
+        }
+        else
+        {
+            position = m_enqueuePosition.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+std::size_t ReadingIngestQueue::drain(std::vector<IngestedReading>& output, std::size_t maximum)
+{
+    auto taken = std::size_t{0};
+    auto position = m_dequeuePosition.load(std::memory_order_relaxed);
+    while (taken < maximum)
+    {
+        auto& slot = m_slots[position & m_mask];
+        if (slot.sequence.load(std::memory_order_acquire) != position + 1)
+            break;
+
+        // Take the reading, and free the slot for the next lap of the producers
+        auto& reading = *reinterpret_cast<IngestedReading*>(&slot.storage);
+        output.emplace_back(std::move(reading));
+        reading.~IngestedReading();
+        slot.sequence.store(position + m_mask + 1, std::memory_order_release);
+        ++position;
+        ++taken;
+    }
+    m_dequeuePosition.store(position, std::memory_order_relaxed);
+    return taken;
+}
+
+void ReadingIngestQueue::close()
+{
+    m_enqueuePosition.fetch_or(CLOSED_BIT);
+}
+
+bool ReadingIngestQueue::isClosed() const
+{
+    return (m_enqueuePosition.load() & CLOSED_BIT) != 0;
+}
+
+bool ReadingIngestQueue::isEmpty() const
+{
+    return m_dequeuePosition.load(std::memory_order_relaxed) == (m_enqueuePosition.load() & ~CLOSED_BIT);
+}
+
+std::size_t ReadingIngestQueue::capacity() const
+{
+    return m_mask + 1;
+}
+}    // namespace connect
+}    // namespace wolkabout
@@ -0,0 +1,153 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WOLKABOUTCONNECTOR_READINGINGESTQUEUE_H
+#define WOLKABOUTCONNECTOR_READINGINGESTQUEUE_H
+
+#include "core/model/Reading.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace wolkabout
+{
+namespace connect
+{
+/**
+ * This enumeration describes what happens to a reading that is added while the ingest queue is full.
+ */
+enum class IngestOverflowPolicy
+{
+    // The reading is dropped, and counted.
+    Reject,
+    // The thread adding the reading waits until there is room for it.
+    Block,
+    // The thread adding the reading stores the readings waiting in the queue, and then its own, so the order is kept.
+    Synchronous
+};
+
+// This struct holds a reading waiting in the ingest queue, together with the device it belongs to.
+struct IngestedReading
+{
+    std::string deviceKey;
+    Reading reading;
+};
+
+/**
+ * This is a bounded lock-free queue of readings, which many threads can add to, and a single thread takes from.
+ *
+ * Every slot of the ring carries a sequence number that tells whether it is free for the lap of the producer, or holds
+ * a reading for the lap of the consumer. A producer claims a slot with a single compare-and-swap of the enqueue
+ * position, which only has to be retried if another producer claimed the same slot first, and publishes the reading
+ * with a store of the sequence. The consumer never writes the enqueue position, so it does not contend with the
+ * producers at all. The queue is closed by setting the highest bit of the enqueue position, which makes every later
+ * claim fail, so no reading can be added after the consumer has taken the last one.
+ */
+class ReadingIngestQueue
+{
+public:
+    /**
+     * Default parameter constructor.
+     *
+     * @param capacity The count of readings the queue can hold. Rounded up to a power of two, and at least 2.
+     */
+    explicit ReadingIngestQueue(std::size_t capacity);
+
+    /**
+     * Overridden destructor. Destroys the readings that were never taken.
+     */
+    ~ReadingIngestQueue();
+
+    ReadingIngestQueue(const ReadingIngestQueue&) = delete;
+    ReadingIngestQueue& operator=(const ReadingIngestQueue&) = delete;
+
+    /**
+     * This method is used to add a reading into the queue. It can be called from any thread.
+     *
+     * @param deviceKey The key of the device the reading belongs to.
+     * @param reading The reading.
+     * @return Whether the reading was added. False if the queue is full, or closed.
+     */
+    bool tryPush(const std::string& deviceKey, const Reading& reading);
+
+    /**
+     * This method is used to close the queue, so every reading added afterwards is refused. It can be called from any
+     * thread.
+     */
+    void close();
+
+    /**
+     * This method is used to check whether the queue has been closed.
+     *
+     * @return Whether the queue is closed.
+     */
+    bool isClosed() const;
+
+    /**
+     * This method is used to check whether every reading added so far has been taken, including the ones a producer is
+     * still writing into their slot. It must only be called from the thread that takes the readings.
+     *
+     * @return Whether the queue is empty.
+     */
+    bool isEmpty() const;
+
+    /**
+     * This method is used to take readings from the queue, in the order they were added. It must only be called from
+     * one thread at a time.
+     *
+     * @param output The vector the readings are appended to.
+     * @param maximum The most readings that are taken.
+     * @return The count of readings that were taken.
+     */
+    std::size_t drain(std::vector<IngestedReading>& output, std::size_t maximum);
+
+    /**
+     * Getter for the count of readings the queue can hold.
+     *
+     * @return The capacity of the queue.
+     */
+    std::size_t capacity() const;
+
+private:
+    struct Slot
+    {
+        std::atomic<std::size_t> sequence;
+        typename std::aligned_storage<sizeof(IngestedReading), alignof(IngestedReading)>::type storage;
+    };
+
+    // The positions are kept on their own cache lines, so the producers and the consumer do not invalidate each other
+    static const constexpr std::size_t CACHE_LINE_SIZE = 64;
+
+    // The bit of the enqueue position that tells the queue is closed
+    static const constexpr std::size_t CLOSED_BIT = ~(~std::size_t{0} >> 1);
+
+    std::size_t m_mask;
+    std::unique_ptr<Slot[]> m_slots;
+
+    char m_enqueuePadding[CACHE_LINE_SIZE];
+    std::atomic<std::size_t> m_enqueuePosition;
+    char m_dequeuePadding[CACHE_LINE_SIZE];
+    std::atomic<std::size_t> m_dequeuePosition;
+    char m_endPadding[CACHE_LINE_SIZE];
+};
+}    // namespace connect
+}    // namespace wolkabout
+
+#endif    // WOLKABOUTCONNECTOR_READINGINGESTQUEUE_H
@@ -0,0 +1,227 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wolk/service/file_management/FileBlobStore.h"
+
+#include "core/utilities/FileSystemUtils.h"
+#include "core/utilities/Logger.h"
+#include "wolk/utilities/Sha256.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+namespace wolkabout
+{
+namespace connect
+{
+namespace
+{
+const std::string ALIAS_EXTENSION = ".alias";
+const std::string TEMPORARY_EXTENSION = ".tmp";
+
+// Blobs, and the links to them, can only be read, so a device file can not be changed in place under every device
+const mode_t BLOB_MODE = S_IRUSR | S_IRGRP | S_IROTH;
+
+const std::size_t COPY_CHUNK_SIZE = 64 * 1024;
+
+bool endsWith(const std::string& value, const std::string& suffix)
+{
+    return value.size() > suffix.size() && value.compare(value.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+}    // namespace
+
+FileBlobStore::FileBlobStore(std::string folder) : m_folder(std::move(folder)) {}
+
+bool FileBlobStore::store(const ByteArray& content, const std::string& alias, std::string& hash)
+{
+    LOG(TRACE) << METHOD_INFO;
+    const auto errorPrefix = "Failed to store the file blob";
+
+    auto sha256 = Sha256{};
+    sha256.update(content.data(), content.size());
+    const auto contentHash = Sha256::toHex(sha256.digest());
+
+    // An already stored blob is checked here, once, so the blobs that are handed out are the content of their hash
+    const auto blobPath = getBlobPath(contentHash);
+    auto blobDigest = Sha256::Digest{};
+    const auto intact = FileSystemUtils::isFilePresent(blobPath) && Sha256::hashFile(blobPath, blobDigest) &&
+                        Sha256::toHex(blobDigest) == contentHash;
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    if (!FileSystemUtils::isDirectoryPresent(m_folder) && !FileSystemUtils::createDirectory(m_folder))
+    {
+        LOG(ERROR) << errorPrefix << " -> Failed to create the folder '" << m_folder << "'.";
+        return false;
+    }
+
+    // The blob is written under a temporary name, so a blob under its final name is always complete. A blob that does
+    // not match its hash is replaced, the files already linked to it keep their own content.
+    if (!intact)
+    {
+        if (FileSystemUtils::isFilePresent(blobPath))
+            LOG(WARN) << "The content of the blob '" << contentHash << "' does not match its hash. Replacing it.";
+        const auto temporaryPath = blobPath + TEMPORARY_EXTENSION;
+        if (!FileSystemUtils::createBinaryFileWithContent(temporaryPath, content) ||
+            ::chmod(temporaryPath.c_str(), BLOB_MODE) != 0 || std::rename(temporaryPath.c_str(), blobPath.c_str()) != 0)
+        {
+            LOG(ERROR) << errorPrefix << " -> Failed to write the blob '" << contentHash << "'.";
+            FileSystemUtils::deleteFile(temporaryPath);
+            return false;
+        }
+    }
+
+    // The alias is only a lookup shortcut, so failing to record it does not fail the store
+    if (isHash(alias) && !FileSystemUtils::createFileWithContent(getAliasPath(alias), contentHash))
+        LOG(WARN) << "Failed to record the alias '" << alias << "' of the blob '" << contentHash << "'.";
+
+    hash = contentHash;
+    return true;
+}
+
+std::string FileBlobStore::findByAlias(const std::string& alias) const
+{
+    if (!isHash(alias))
+        return {};
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    auto hash = std::string{};
+    if (!FileSystemUtils::readFileContent(getAliasPath(alias), hash) || !isHash(hash) ||
+        !FileSystemUtils::isFilePresent(getBlobPath(hash)))
+        return {};
+    return hash;
+}
+
+std::uint64_t FileBlobStore::getSize(const std::string& hash) const
+{
+    if (!isHash(hash))
+        return 0;
+
+    struct stat status = {};
+    if (stat(getBlobPath(hash).c_str(), &status) != 0)
+        return 0;
+    return static_cast<std::uint64_t>(status.st_size);
+}
+
+bool FileBlobStore::place(const std::string& hash, const std::string& targetPath) const
+{
+    LOG(TRACE) << METHOD_INFO;
+
+    if (!isHash(hash))
+        return false;
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    const auto blobPath = getBlobPath(hash);
+    if (!FileSystemUtils::isFilePresent(blobPath))
+        return false;
+    if (FileSystemUtils::isFilePresent(targetPath))
+        FileSystemUtils::deleteFile(targetPath);
+    if (::link(blobPath.c_str(), targetPath.c_str()) == 0)
+        return true;
+
+    // Some file systems can not link, and then the blob is copied
+    LOG(DEBUG) << "Failed to link the blob '" << hash << "' to '" << targetPath << "'. Copying it instead.";
+    if (copy(blobPath, targetPath))
+        return true;
+    LOG(ERROR) << "Failed to place the file blob -> Failed to copy the blob '" << hash << "' to '" << targetPath
+               << "'.";
+    FileSystemUtils::deleteFile(targetPath);
+    return false;
+}
+
+std::size_t FileBlobStore::collectGarbage()
+{
+    LOG(TRACE) << METHOD_INFO;
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    if (!FileSystemUtils::isDirectoryPresent(m_folder))
+        return 0;
+
+    // A blob with a single link is only held by the store
+    auto removed = std::size_t{0};
+    const auto files = FileSystemUtils::listFiles(m_folder);
+    for (const auto& file : files)
+    {
+        const auto path = FileSystemUtils::composePath(file, m_folder);
+        struct stat status = {};
+        if ((isHash(file) && stat(path.c_str(), &status) == 0 && status.st_nlink <= 1) ||
+            endsWith(file, TEMPORARY_EXTENSION))
+        {
+            if (FileSystemUtils::deleteFile(path) && isHash(file))
+                ++removed;
+        }
+    }
+
+    // And the aliases of the removed blobs go with them
+    for (const auto& file : files)
+    {
+        if (!endsWith(file, ALIAS_EXTENSION))
+            continue;
+        const auto path = FileSystemUtils::composePath(file, m_folder);
+        auto hash = std::string{};
+        if (!FileSystemUtils::readFileContent(path, hash) || !isHash(hash) ||
+            !FileSystemUtils::isFilePresent(getBlobPath(hash)))
+            FileSystemUtils::deleteFile(path);
+    }
+
+    if (removed > 0)
+        LOG(DEBUG) << "Removed " << removed << " file blob(s) that are not used anymore.";
+    return removed;
+}
+
+std::string FileBlobStore::getBlobPath(const std::string& hash) const
+{
+    return FileSystemUtils::composePath(hash, m_folder);
+}
+
+std::string FileBlobStore::getAliasPath(const std::string& alias) const
+{
+    return FileSystemUtils::composePath(alias + ALIAS_EXTENSION, m_folder);
+}
+
+bool FileBlobStore::copy(const std::string& sourcePath, const std::string& targetPath)
+{
+    // The copy is made a piece at a time, so a large blob is never held in memory
+    auto source = std::ifstream{sourcePath, std::ios::binary};
+    auto target = std::ofstream{targetPath, std::ios::binary | std::ios::trunc};
+    if (!source || !target)
+        return false;
+
+    auto buffer = std::vector<char>(COPY_CHUNK_SIZE);
+    while (source)
+    {
+        source.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        if (source.gcount() > 0 && !target.write(buffer.data(), source.gcount()))
+            return false;
+    }
+    target.close();
+    return source.eof() && target && ::chmod(targetPath.c_str(), BLOB_MODE) == 0;
+}
+
+bool FileBlobStore::isHash(const std::string& value)
+{
+    // Only hex hashes are accepted, so a value received from the platform can never point outside of the folder
+    return !value.empty() && value.size() <= 128 && std::all_of(value.cbegin(), value.cend(), [](char character) {
+        return std::isxdigit(static_cast<unsigned char>(character)) != 0;
+    });
+}
+}    // namespace connect
+}    // namespace wolkabout
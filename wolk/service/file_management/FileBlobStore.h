@@ -0,0 +1,110 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WOLKABOUTCONNECTOR_FILEBLOBSTORE_H
+#define WOLKABOUTCONNECTOR_FILEBLOBSTORE_H
+
+#include "core/Types.h"
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+namespace wolkabout
+{
+namespace connect
+{
+/**
+ * This is the class that stores the content of files only once, no matter how many devices hold them.
+ *
+ * Every content is stored as a blob named after its SHA-256. A blob can also be found by an alias, which is the hash
+ * the platform announces the file with, so a file that is already stored does not need to be transferred again. The
+ * files in the device folders are hard links to the blobs, so a file held by many devices takes its space once. Blobs
+ * and their links are read-only, so a device file can only be replaced, never changed in place under every device. A
+ * blob that is not linked from anywhere anymore is removed when the garbage is collected.
+ */
+class FileBlobStore
+{
+public:
+    /**
+     * Default parameter constructor.
+     *
+     * @param folder The folder in which the blobs are stored.
+     */
+    explicit FileBlobStore(std::string folder);
+
+    /**
+     * This method is used to store the content as a blob, if it is not already stored. A stored blob whose content
+     * does not match its hash anymore is replaced.
+     *
+     * @param content The content of the file.
+     * @param alias The hash by which the platform refers to the content. It is not recorded if it is empty.
+     * @param hash The SHA-256 of the content, in hex, under which the blob is stored.
+     * @return Whether the blob is stored.
+     */
+    bool store(const ByteArray& content, const std::string& alias, std::string& hash);
+
+    /**
+     * This method is used to find a blob by the hash the platform refers to it with.
+     *
+     * @param alias The hash by which the platform refers to the content.
+     * @return The SHA-256 of the blob. Empty if there is no such blob.
+     */
+    std::string findByAlias(const std::string& alias) const;
+
+    /**
+     * This method is used to obtain the size of a blob.
+     *
+     * @param hash The SHA-256 of the blob.
+     * @return The size of the blob in bytes. Zero if there is no such blob.
+     */
+    std::uint64_t getSize(const std::string& hash) const;
+
+    /**
+     * This method is used to place a blob at a path, as a hard link, or as a read-only copy where the file system can
+     * not link. Anything that was at the path is replaced.
+     *
+     * @param hash The SHA-256 of the blob.
+     * @param targetPath The path at which the blob should be placed.
+     * @return Whether the blob is placed at the path.
+     */
+    bool place(const std::string& hash, const std::string& targetPath) const;
+
+    /**
+     * This method is used to remove all the blobs that are not linked from anywhere anymore, together with their
+     * aliases.
+     *
+     * @return The number of removed blobs.
+     */
+    std::size_t collectGarbage();
+
+private:
+    std::string getBlobPath(const std::string& hash) const;
+
+    std::string getAliasPath(const std::string& alias) const;
+
+    static bool copy(const std::string& sourcePath, const std::string& targetPath);
+
+    static bool isHash(const std::string& value);
+
+    std::string m_folder;
+
+    mutable std::mutex m_mutex;
+};
+}    // namespace connect
+}    // namespace wolkabout
+
+#endif    // WOLKABOUTCONNECTOR_FILEBLOBSTORE_H
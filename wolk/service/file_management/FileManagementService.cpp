@@ -28,6 +28,9 @@ namespace wolkabout
 {
 namespace connect
 {
+// The folder in the file location in which the content of the files is stored
+const std::string BLOB_FOLDER = ".blobs";
+
 FileManagementService::FileManagementService(ConnectivityService& connectivityService, DataService& dataService,
                                              FileManagementProtocol& protocol, std::string fileLocation,
                                              bool fileTransferEnabled, bool fileTransferUrlEnabled,
@@ -39,6 +42,7 @@ FileManagementService::FileManagementService(ConnectivityService& connectivitySe
 , m_fileTransferUrlEnabled(fileTransferUrlEnabled)
 , m_protocol(protocol)
 , m_fileLocation(std::move(fileLocation))
+, m_blobStore(FileSystemUtils::composePath(BLOB_FOLDER, m_fileLocation))
 , m_downloader(std::move(fileDownloader))
 , m_fileListener(std::move(fileListener))
 {
@@ -61,6 +65,9 @@ void FileManagementService::createFolder()
         FileSystemUtils::createDirectory(m_fileLocation);
         LOG(DEBUG) << "Created FileManagement directory '" << m_fileLocation << "'.";
     }
+
+    // Clean up the content that was left behind by files deleted while the service was not running
+    m_blobStore.collectGarbage();
 }
 
 void FileManagementService::reportPresentFiles(const std::string& deviceKey)
@@ -318,6 +325,10 @@ void FileManagementService::onFileUploadInit(const std::string& deviceKey, const
         return;
     }
 
+    // If the same content is already stored for some device, there is no need to transfer it
+    if (placeStoredFile(deviceKey, message))
+        return;
+
     // Create a session for this file
     m_sessions[deviceKey] = std::unique_ptr<FileTransferSession>{
       new FileTransferSession{deviceKey, message,
@@ -415,6 +426,7 @@ void FileManagementService::onFileDelete(const std::string& deviceKey, const Fil
             notifyListenerRemovedFile(deviceKey, file);
         }
     }
+    m_blobStore.collectGarbage();
 
     // And report the files back
     reportPresentFiles(deviceKey);
@@ -434,6 +446,7 @@ void FileManagementService::onFilePurge(const std::string& deviceKey, const File
             notifyListenerRemovedFile(deviceKey, file);
         }
     }
+    m_blobStore.collectGarbage();
 
     // And report the files back
     reportPresentFiles(deviceKey);
@@ -521,7 +534,7 @@ void FileManagementService::onFileSessionStatus(const std::string& deviceKey, Fi
         }
 
         // Place the file in the folder
-        if (!FileSystemUtils::createBinaryFileWithContent(relativePath, content))
+        if (!storeFile(content, relativePath))
         {
             LOG(ERROR) << "Failed to store the '" << fileName << "' locally.";
             reportStatus(deviceKey, FileTransferStatus::ERROR, FileTransferError::FILE_SYSTEM_ERROR);
@@ -602,6 +615,51 @@ void FileManagementService::reportUrlTransferProtocolDisabled(const std::string&
     m_connectivityService.publish(message);
 }
 
+bool FileManagementService::placeStoredFile(const std::string& deviceKey, const FileUploadInitiateMessage& message)
+{
+    LOG(TRACE) << METHOD_INFO;
+
+    // Check that the content is stored, and that it is what the platform announced
+    const auto hash = m_blobStore.findByAlias(message.getHash());
+    if (hash.empty() || m_blobStore.getSize(hash) != message.getSize())
+        return false;
+
+    // Link it into the folder of the device
+    const auto deviceFolder = FileSystemUtils::composePath(deviceKey, m_fileLocation);
+    if (!FileSystemUtils::isDirectoryPresent(deviceFolder))
+        FileSystemUtils::createDirectory(deviceFolder);
+    if (!m_blobStore.place(hash, FileSystemUtils::composePath(message.getName(), deviceFolder)))
+        return false;
+    LOG(INFO) << "File '" << message.getName() << "' for device '" << deviceKey
+              << "' is already stored locally. Skipping the transfer.";
+
+    // Report that the file is ready
+    auto status = FileUploadStatusMessage{message.getName(), FileTransferStatus::FILE_READY, FileTransferError::NONE};
+    auto statusMessage = std::shared_ptr<Message>(m_protocol.makeOutboundMessage(deviceKey, status));
+    if (statusMessage != nullptr)
+        m_connectivityService.publish(statusMessage);
+    else
+        LOG(ERROR) << "Failed to report that the file is ready -> Failed to make outbound status message.";
+    notifyListenerAddedFile(deviceKey, message.getName(), absolutePathOfFile(deviceKey, message.getName()));
+    return true;
+}
+
+bool FileManagementService::storeFile(const ByteArray& content, const std::string& path)
+{
+    LOG(TRACE) << METHOD_INFO;
+
+    // The content is aliased by the hash the platform announces the uploads with
+    auto hash = std::string{};
+    const auto alias = ByteUtils::toHexString(ByteUtils::hashMDA5(content));
+    if (m_blobStore.store(content, alias, hash) && m_blobStore.place(hash, path))
+        return true;
+
+    // A file that was there before might be a read-only link to a blob, so it is replaced instead of written over
+    if (FileSystemUtils::isFilePresent(path))
+        FileSystemUtils::deleteFile(path);
+    return FileSystemUtils::createBinaryFileWithContent(path, content);
+}
+
 std::string FileManagementService::absolutePathOfFile(const std::string& deviceKey, const std::string& file)
 {
     LOG(TRACE) << METHOD_INFO;
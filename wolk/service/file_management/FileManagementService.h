@@ -23,6 +23,7 @@
 #include "core/utilities/CommandBuffer.h"
 #include "wolk/api/FileListener.h"
 #include "wolk/service/data/DataService.h"
+#include "wolk/service/file_management/FileBlobStore.h"
 #include "wolk/service/file_management/FileDownloader.h"
 #include "wolk/service/file_management/FileTransferSession.h"
 
@@ -134,6 +135,26 @@ private:
      */
     void reportUrlTransferProtocolDisabled(const std::string& deviceKey, const std::string& url);
 
+    /**
+     * This is an internal method that will attempt to place a file the platform wants to upload from the content that
+     * is already stored for some device, so the file does not have to be transferred again.
+     *
+     * @param deviceKey The device for which the file is being uploaded.
+     * @param message The message with which the platform initiated the upload.
+     * @return Whether the file is placed, and reported as ready.
+     */
+    bool placeStoredFile(const std::string& deviceKey, const FileUploadInitiateMessage& message);
+
+    /**
+     * This is an internal method that will store the content of a file in the blob store, and link it into the device
+     * folder. If that fails, the content is written straight into the device folder.
+     *
+     * @param content The content of the file.
+     * @param path The path of the file in the device folder.
+     * @return Whether the file is stored.
+     */
+    bool storeFile(const ByteArray& content, const std::string& path);
+
     /**
      * This is an internal method meant to make a shortcut to obtaining the absolute path for a file by pre-including
      * the `m_fileLocation` variable.
@@ -178,6 +199,9 @@ private:
     // This is where the user parameters will be passed.
     std::string m_fileLocation;
 
+    // This is where the content of the files is stored once for all devices
+    FileBlobStore m_blobStore;
+
     // This is where we locally store information about files in memory
     std::map<std::string, DeviceFiles> m_files;
 
@@ -0,0 +1,243 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wolk/service/firmware_update/FirmwareDeltaPatcher.h"
+
+#include "core/utilities/FileSystemUtils.h"
+#include "core/utilities/Logger.h"
+#include "wolk/utilities/Sha256.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+namespace wolkabout
+{
+namespace connect
+{
+namespace
+{
+const std::string MAGIC = "WDLT";
+const std::uint8_t FORMAT_VERSION = 1;
+const std::string PARTIAL_SUFFIX = ".part";
+
+const std::uint8_t END_OPERATION = 0;
+const std::uint8_t COPY_OPERATION = 1;
+const std::uint8_t INSERT_OPERATION = 2;
+
+bool readBytes(std::istream& stream, std::uint8_t* bytes, std::size_t size)
+{
+    stream.read(reinterpret_cast<char*>(bytes), static_cast<std::streamsize>(size));
+    return static_cast<std::size_t>(stream.gcount()) == size;
+}
+
+bool readNumber(std::istream& stream, std::size_t size, std::uint64_t& value)
+{
+    auto bytes = std::vector<std::uint8_t>(size);
+    if (!readBytes(stream, bytes.data(), size))
+        return false;
+    value = 0;
+    for (const auto byte : bytes)
+        value = value << 8 | byte;
+    return true;
+}
+
+// Copies a count of bytes from one stream into the other through the buffer, and feeds them into the hash
+bool copyBytes(std::istream& input, std::ostream& output, std::uint64_t count, std::vector<char>& buffer,
+               Sha256& hash)
+{
+    while (count > 0)
+    {
+        const auto chunk = static_cast<std::size_t>(std::min<std::uint64_t>(count, buffer.size()));
+        input.read(buffer.data(), static_cast<std::streamsize>(chunk));
+        if (static_cast<std::size_t>(input.gcount()) != chunk)
+            return false;
+        output.write(buffer.data(), static_cast<std::streamsize>(chunk));
+        if (!output)
+            return false;
+        hash.update(reinterpret_cast<const std::uint8_t*>(buffer.data()), chunk);
+        count -= chunk;
+    }
+    return true;
+}
+
+std::string directoryOf(const std::string& filePath)
+{
+    const auto separator = filePath.find_last_of('/');
+    return separator == std::string::npos ? "./" : filePath.substr(0, separator + 1);
+}
+}    // namespace
+
+const std::string FirmwareDeltaPatcher::EXTENSION = ".wdelta";
+
+std::string toString(DeltaPatchResult result)
+{
+    switch (result)
+    {
+    case DeltaPatchResult::APPLIED:
+        return "APPLIED";
+    case DeltaPatchResult::INVALID_PATCH:
+        return "INVALID_PATCH";
+    case DeltaPatchResult::MISSING_BASE:
+        return "MISSING_BASE";
+    case DeltaPatchResult::BASE_MISMATCH:
+        return "BASE_MISMATCH";
+    case DeltaPatchResult::TARGET_MISMATCH:
+        return "TARGET_MISMATCH";
+    case DeltaPatchResult::IO_ERROR:
+        return "IO_ERROR";
+    }
+    return {};
+}
+
+FirmwareDeltaPatcher::FirmwareDeltaPatcher(std::size_t bufferSize) : m_bufferSize(std::max<std::size_t>(bufferSize, 1))
+{
+}
+
+bool FirmwareDeltaPatcher::isPatch(const std::string& filePath)
+{
+    if (filePath.size() <= EXTENSION.size() ||
+        filePath.compare(filePath.size() - EXTENSION.size(), EXTENSION.size(), EXTENSION) != 0)
+        return false;
+
+    std::ifstream patch{filePath, std::ios::in | std::ios::binary};
+    auto magic = std::string(MAGIC.size(), '\0');
+    return patch.read(&magic[0], static_cast<std::streamsize>(magic.size())) && magic == MAGIC;
+}
+
+DeltaPatchResult FirmwareDeltaPatcher::apply(const std::string& patchPath, std::string& outputPath) const
+{
+    LOG(TRACE) << METHOD_INFO;
+    const auto errorPrefix = "Failed to apply the firmware delta package";
+
+    std::ifstream patch{patchPath, std::ios::in | std::ios::binary};
+    if (!patch)
+    {
+        LOG(ERROR) << errorPrefix << " -> Failed to open '" << patchPath << "'.";
+        return DeltaPatchResult::IO_ERROR;
+    }
+
+    // Read the header
+    auto magic = std::string(MAGIC.size(), '\0');
+    auto version = std::uint8_t{0};
+    auto baseNameLength = std::uint64_t{0};
+    if (!patch.read(&magic[0], static_cast<std::streamsize>(magic.size())) || magic != MAGIC ||
+        !readBytes(patch, &version, 1) || version != FORMAT_VERSION || !readNumber(patch, 2, baseNameLength))
+    {
+        LOG(ERROR) << errorPrefix << " -> The header is invalid.";
+        return DeltaPatchResult::INVALID_PATCH;
+    }
+    auto baseName = std::string(static_cast<std::size_t>(baseNameLength), '\0');
+    auto baseDigest = Sha256::Digest{};
+    auto targetDigest = Sha256::Digest{};
+    auto targetSize = std::uint64_t{0};
+    if (baseName.empty() || !patch.read(&baseName[0], static_cast<std::streamsize>(baseName.size())) ||
+        baseName.find('/') != std::string::npos || baseName == "." || baseName == ".." ||
+        !readBytes(patch, baseDigest.data(), baseDigest.size()) ||
+        !readBytes(patch, targetDigest.data(), targetDigest.size()) || !readNumber(patch, 8, targetSize))
+    {
+        LOG(ERROR) << errorPrefix << " -> The header is invalid.";
+        return DeltaPatchResult::INVALID_PATCH;
+    }
+
+    // Check that the base is the one the package was made for
+    const auto directory = directoryOf(patchPath);
+    const auto basePath = FileSystemUtils::composePath(baseName, directory);
+    auto actualBaseDigest = Sha256::Digest{};
+    if (!FileSystemUtils::isFilePresent(basePath) || !Sha256::hashFile(basePath, actualBaseDigest))
+    {
+        LOG(ERROR) << errorPrefix << " -> The base image '" << baseName << "' is missing.";
+        return DeltaPatchResult::MISSING_BASE;
+    }
+    if (actualBaseDigest != baseDigest)
+    {
+        LOG(ERROR) << errorPrefix << " -> The base image '" << baseName << "' is not the one the package is made for.";
+        return DeltaPatchResult::BASE_MISMATCH;
+    }
+    std::ifstream base{basePath, std::ios::in | std::ios::binary | std::ios::ate};
+    const auto baseSize = static_cast<std::uint64_t>(base.tellg());
+
+    // Write the target into a partial file, that is renamed only once it is verified
+    const auto targetPath = patchPath.substr(0, patchPath.size() - EXTENSION.size());
+    const auto partialPath = targetPath + PARTIAL_SUFFIX;
+    auto result = DeltaPatchResult::APPLIED;
+    {
+        std::ofstream target{partialPath, std::ios::out | std::ios::trunc | std::ios::binary};
+        if (!target)
+        {
+            LOG(ERROR) << errorPrefix << " -> Failed to create '" << partialPath << "'.";
+            return DeltaPatchResult::IO_ERROR;
+        }
+
+        auto buffer = std::vector<char>(m_bufferSize);
+        auto hash = Sha256{};
+        auto written = std::uint64_t{0};
+        auto operation = std::uint8_t{0};
+        while (result == DeltaPatchResult::APPLIED)
+        {
+            auto offset = std::uint64_t{0};
+            auto length = std::uint64_t{0};
+            if (!readBytes(patch, &operation, 1))
+            {
+                result = DeltaPatchResult::INVALID_PATCH;
+            }
+            else if (operation == END_OPERATION)
+            {
+                break;
+            }
+            else if (operation == COPY_OPERATION)
+            {
+                if (!readNumber(patch, 8, offset) || !readNumber(patch, 8, length) || offset > baseSize ||
+                    length > baseSize - offset || length > targetSize - written)
+                    result = DeltaPatchResult::INVALID_PATCH;
+                else if (!base.seekg(static_cast<std::streamoff>(offset)) ||
+                         !copyBytes(base, target, length, buffer, hash))
+                    result = DeltaPatchResult::IO_ERROR;
+            }
+            else if (operation == INSERT_OPERATION)
+            {
+                if (!readNumber(patch, 8, length) || length > targetSize - written ||
+                    !copyBytes(patch, target, length, buffer, hash))
+                    result = DeltaPatchResult::INVALID_PATCH;
+            }
+            else
+            {
+                result = DeltaPatchResult::INVALID_PATCH;
+            }
+            written += length;
+        }
+
+        if (result == DeltaPatchResult::APPLIED && (written != targetSize || hash.digest() != targetDigest))
+            result = DeltaPatchResult::TARGET_MISMATCH;
+        if (result == DeltaPatchResult::APPLIED && !target.flush())
+            result = DeltaPatchResult::IO_ERROR;
+    }
+
+    if (result != DeltaPatchResult::APPLIED || std::rename(partialPath.c_str(), targetPath.c_str()) != 0)
+    {
+        if (result == DeltaPatchResult::APPLIED)
+            result = DeltaPatchResult::IO_ERROR;
+        LOG(ERROR) << errorPrefix << " -> " << toString(result) << ".";
+        FileSystemUtils::deleteFile(partialPath);
+        return result;
+    }
+    LOG(INFO) << "Applied firmware delta package '" << patchPath << "' onto '" << baseName << "'.";
+    outputPath = targetPath;
+    return result;
+}
+}    // namespace connect
+}    // namespace wolkabout
@@ -0,0 +1,95 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WOLKABOUTCONNECTOR_FIRMWAREDELTAPATCHER_H
+#define WOLKABOUTCONNECTOR_FIRMWAREDELTAPATCHER_H
+
+#include <cstdint>
+#include <string>
+
+namespace wolkabout
+{
+namespace connect
+{
+/**
+ * This is the outcome of applying a delta package.
+ */
+enum class DeltaPatchResult
+{
+    APPLIED,
+    INVALID_PATCH,
+    MISSING_BASE,
+    BASE_MISMATCH,
+    TARGET_MISMATCH,
+    IO_ERROR
+};
+
+std::string toString(DeltaPatchResult result);
+
+/**
+ * This is the class that rebuilds a firmware image out of a delta package and a base image that is already on the
+ * device.
+ *
+ * A delta package is a file with the `.wdelta` extension, laid out as follows, with all numbers big endian:
+ *  - the magic `WDLT` and the format version `1`,
+ *  - the length of the name of the base image (2 bytes), and the name, relative to the folder of the package,
+ *  - the SHA-256 of the base image, the SHA-256 of the target image, and the size of the target image (8 bytes),
+ *  - the operations, each starting with a byte:
+ *    - `1`, followed by an offset and a length (8 bytes each), copies that range of the base image,
+ *    - `2`, followed by a length (8 bytes) and that many bytes, inserts the bytes,
+ *    - `0` ends the package.
+ *
+ * The package is applied as a stream through a fixed size buffer, so the memory used does not depend on the size of the
+ * images. The base image is verified before, and the target image after it is written, and the target image only
+ * takes its final name once it matches.
+ */
+class FirmwareDeltaPatcher
+{
+public:
+    static const std::string EXTENSION;
+
+    /**
+     * Default parameter constructor.
+     *
+     * @param bufferSize The size of the buffer through which the data is copied.
+     */
+    explicit FirmwareDeltaPatcher(std::size_t bufferSize = 64 * 1024);
+
+    /**
+     * This method is used to check whether a file is a delta package, by its extension and its magic.
+     *
+     * @param filePath The path of the file.
+     * @return Whether the file is a delta package.
+     */
+    static bool isPatch(const std::string& filePath);
+
+    /**
+     * This method is used to apply a delta package. The target image is written next to the package, under the name of
+     * the package without the extension.
+     *
+     * @param patchPath The path of the delta package.
+     * @param outputPath The path of the target image, if it was applied.
+     * @return The outcome.
+     */
+    DeltaPatchResult apply(const std::string& patchPath, std::string& outputPath) const;
+
+private:
+    std::size_t m_bufferSize;
+};
+}    // namespace connect
+}    // namespace wolkabout
+
+#endif    // WOLKABOUTCONNECTOR_FIRMWAREDELTAPATCHER_H
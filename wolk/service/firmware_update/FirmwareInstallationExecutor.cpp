@@ -0,0 +1,192 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wolk/service/firmware_update/FirmwareInstallationExecutor.h"
+
+#include "core/utilities/Logger.h"
+
+#include <algorithm>
+#include <exception>
+
+namespace wolkabout
+{
+namespace connect
+{
+namespace
+{
+// Set on a worker whose own job stopped the executor. The executor can be gone by the time the job returns, so the
+// worker ends without touching it.
+thread_local bool detachedWorker = false;
+}    // namespace
+
+FirmwareInstallationExecutor::FirmwareInstallationExecutor(std::size_t workerCount, std::size_t queueCapacity)
+: m_queueCapacity(queueCapacity), m_running(true), m_pendingCount(0)
+{
+    if (workerCount == 0)
+        workerCount = 1;
+    for (auto i = std::size_t{0}; i < workerCount; ++i)
+        m_workers.emplace_back(&FirmwareInstallationExecutor::run, this);
+}
+
+FirmwareInstallationExecutor::~FirmwareInstallationExecutor()
+{
+    stop();
+}
+
+bool FirmwareInstallationExecutor::submit(const std::string& deviceKey, std::function<void()> job)
+{
+    LOG(TRACE) << METHOD_INFO;
+    const auto errorPrefix = "Failed to submit firmware installation job";
+
+    if (!job)
+    {
+        LOG(ERROR) << errorPrefix << " -> The job is empty.";
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    if (!m_running)
+    {
+        LOG(ERROR) << errorPrefix << " -> The executor is stopped.";
+        return false;
+    }
+    if (m_pendingCount >= m_queueCapacity)
+    {
+        LOG(ERROR) << errorPrefix << " -> The queue is full.";
+        return false;
+    }
+
+    // A device becomes ready only if it is not already waiting or running, those get picked up again when the job
+    // that is running is done
+    auto& deviceJobs = m_jobs[deviceKey];
+    const auto wasIdle = deviceJobs.empty() && m_runningDevices.find(deviceKey) == m_runningDevices.cend();
+    deviceJobs.emplace_back(std::move(job));
+    ++m_pendingCount;
+    if (wasIdle)
+    {
+        m_readyDevices.emplace_back(deviceKey);
+        m_condition.notify_one();
+    }
+    return true;
+}
+
+std::size_t FirmwareInstallationExecutor::cancel(const std::string& deviceKey)
+{
+    LOG(TRACE) << METHOD_INFO;
+
+    // The jobs are destroyed once the lock is released, since they might hold on to anything
+    auto cancelled = std::deque<std::function<void()>>{};
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        const auto it = m_jobs.find(deviceKey);
+        if (it == m_jobs.end())
+            return 0;
+        cancelled = std::move(it->second);
+        m_jobs.erase(it);
+        m_pendingCount -= cancelled.size();
+        m_readyDevices.erase(std::remove(m_readyDevices.begin(), m_readyDevices.end(), deviceKey),
+                             m_readyDevices.end());
+    }
+    return cancelled.size();
+}
+
+bool FirmwareInstallationExecutor::isBusy(const std::string& deviceKey) const
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    return m_jobs.find(deviceKey) != m_jobs.cend() || m_runningDevices.find(deviceKey) != m_runningDevices.cend();
+}
+
+std::size_t FirmwareInstallationExecutor::getPendingCount() const
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    return m_pendingCount;
+}
+
+void FirmwareInstallationExecutor::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        if (!m_running)
+            return;
+        m_running = false;
+        if (m_pendingCount > 0)
+            LOG(WARN) << "Dropping " << m_pendingCount << " firmware installation job(s) -> The executor is stopped.";
+        m_jobs.clear();
+        m_readyDevices.clear();
+        m_pendingCount = 0;
+    }
+    m_condition.notify_all();
+
+    // A job could stop the executor, and its own thread can not be joined
+    for (auto& worker : m_workers)
+    {
+        if (!worker.joinable())
+            continue;
+        if (worker.get_id() == std::this_thread::get_id())
+        {
+            worker.detach();
+            detachedWorker = true;
+        }
+        else
+            worker.join();
+    }
+}
+
+void FirmwareInstallationExecutor::run()
+{
+    std::unique_lock<std::mutex> lock{m_mutex};
+    while (true)
+    {
+        m_condition.wait(lock, [&] { return !m_running || !m_readyDevices.empty(); });
+        if (!m_running)
+            return;
+
+        // Take the first job of the device that has waited the longest
+        const auto deviceKey = m_readyDevices.front();
+        m_readyDevices.pop_front();
+        auto& deviceJobs = m_jobs[deviceKey];
+        auto job = std::move(deviceJobs.front());
+        deviceJobs.pop_front();
+        if (deviceJobs.empty())
+            m_jobs.erase(deviceKey);
+        --m_pendingCount;
+        m_runningDevices.emplace(deviceKey);
+
+        lock.unlock();
+        try
+        {
+            job();
+        }
+        catch (const std::exception& exception)
+        {
+            LOG(ERROR) << "Firmware installation job for device '" << deviceKey
+                       << "' threw an exception -> '" << exception.what() << "'.";
+        }
+        if (detachedWorker)
+            return;
+        lock.lock();
+
+        // If more jobs came in for the device in the meantime, it is ready again
+        m_runningDevices.erase(deviceKey);
+        if (m_running && m_jobs.find(deviceKey) != m_jobs.cend())
+        {
+            m_readyDevices.emplace_back(deviceKey);
+            m_condition.notify_one();
+        }
+    }
+}
+}    // namespace connect
+}    // namespace wolkabout
@@ -0,0 +1,123 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WOLKABOUTCONNECTOR_FIRMWAREINSTALLATIONEXECUTOR_H
+#define WOLKABOUTCONNECTOR_FIRMWAREINSTALLATIONEXECUTOR_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace wolkabout
+{
+namespace connect
+{
+/**
+ * This is the executor that runs firmware installation jobs away from the thread that receives the messages.
+ *
+ * It has a fixed count of worker threads, and a bounded count of jobs waiting for them. Jobs of the same device are
+ * run one at a time in the order they were submitted, while jobs of different devices run in parallel, so one long
+ * installation does not hold up the others.
+ */
+class FirmwareInstallationExecutor
+{
+public:
+    /**
+     * Default parameter constructor. The worker threads are started right away.
+     *
+     * @param workerCount The count of worker threads. At least one is always started.
+     * @param queueCapacity The maximum count of jobs that can be waiting to run.
+     */
+    explicit FirmwareInstallationExecutor(std::size_t workerCount = 2, std::size_t queueCapacity = 100);
+
+    /**
+     * Default destructor. Stops the executor.
+     */
+    ~FirmwareInstallationExecutor();
+
+    FirmwareInstallationExecutor(const FirmwareInstallationExecutor&) = delete;
+    FirmwareInstallationExecutor& operator=(const FirmwareInstallationExecutor&) = delete;
+
+    /**
+     * This method is used to submit a job for a device.
+     *
+     * @param deviceKey The key of the device the job is for.
+     * @param job The job.
+     * @return Whether the job was accepted. It is not if the executor is stopped or the queue is full.
+     */
+    bool submit(const std::string& deviceKey, std::function<void()> job);
+
+    /**
+     * This method is used to drop the jobs of a device that are waiting to run. A job that is already running is not
+     * affected.
+     *
+     * @param deviceKey The key of the device.
+     * @return The count of dropped jobs.
+     */
+    std::size_t cancel(const std::string& deviceKey);
+
+    /**
+     * This method is used to check whether a device has a job that is running or waiting to run.
+     *
+     * @param deviceKey The key of the device.
+     * @return Whether the device has a job.
+     */
+    bool isBusy(const std::string& deviceKey) const;
+
+    /**
+     * This method is used to obtain the count of jobs that are waiting to run.
+     *
+     * @return The count of waiting jobs.
+     */
+    std::size_t getPendingCount() const;
+
+    /**
+     * This method is used to stop the executor. The jobs that are running are allowed to finish, and the jobs that are
+     * waiting are dropped. When a job stops the executor, or destroys it, its own worker is left to end on its own once
+     * the job returns, without touching the executor again.
+     */
+    void stop();
+
+private:
+    // The method the worker threads run
+    void run();
+
+    std::size_t m_queueCapacity;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_running;
+
+    // The waiting jobs of every device, the devices that have a job waiting and are not running one, and the devices
+    // that are running a job
+    std::map<std::string, std::deque<std::function<void()>>> m_jobs;
+    std::deque<std::string> m_readyDevices;
+    std::set<std::string> m_runningDevices;
+    std::size_t m_pendingCount;
+
+    std::vector<std::thread> m_workers;
+};
+}    // namespace connect
+}    // namespace wolkabout
+
+#endif    // WOLKABOUTCONNECTOR_FIRMWAREINSTALLATIONEXECUTOR_H
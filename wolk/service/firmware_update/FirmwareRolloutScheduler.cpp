@@ -0,0 +1,486 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wolk/service/firmware_update/FirmwareRolloutScheduler.h"
+
+#include "core/utilities/FileSystemUtils.h"
+#include "core/utilities/Logger.h"
+#include "wolk/service/firmware_update/FirmwareSessionJournal.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <sstream>
+#include <unistd.h>
+#include <utility>
+
+namespace wolkabout
+{
+namespace connect
+{
+namespace
+{
+const char SEPARATOR = '\t';
+const std::string PAUSED_LINE = "paused";
+const std::string COUNTS_LINE = "counts";
+const std::string QUEUED_LINE = "queued";
+const std::string RUNNING_LINE = "running";
+const std::string STARTED_LINE = "started";
+const std::string REQUEUED_LINE = "requeued";
+const std::string REMOVED_LINE = "removed";
+const std::string TEMPORARY_SUFFIX = ".tmp";
+
+// The state file is not compacted until it has at least this many lines
+const std::size_t COMPACTION_MINIMUM = 64;
+
+std::vector<std::string> splitLine(const std::string& line)
+{
+    auto parts = std::vector<std::string>{};
+    auto stream = std::istringstream{line};
+    auto part = std::string{};
+    while (std::getline(stream, part, SEPARATOR))
+        parts.emplace_back(part);
+    return parts;
+}
+
+std::string composeEntryLine(const std::string& type, const RolloutEntry& entry)
+{
+    // Device keys and file names are escaped the same way as in the session journal, so they can not break up the line
+    return type + SEPARATOR + (entry.canary ? "1" : "0") + SEPARATOR + FirmwareSessionJournal::escape(entry.deviceKey) +
+           SEPARATOR + FirmwareSessionJournal::escape(entry.file) + "\n";
+}
+
+std::string composeKeyLine(const std::string& type, const std::string& deviceKey)
+{
+    return type + SEPARATOR + FirmwareSessionJournal::escape(deviceKey) + "\n";
+}
+
+std::string composeStateLines(bool paused, std::uint64_t succeeded, std::uint64_t failed)
+{
+    return PAUSED_LINE + SEPARATOR + (paused ? "1" : "0") + "\n" + COUNTS_LINE + SEPARATOR + std::to_string(succeeded) +
+           SEPARATOR + std::to_string(failed) + "\n";
+}
+
+// Writes the content into the file and waits until it is on the disk
+bool writeAndSync(const std::string& path, const std::string& content, int flags)
+{
+    const auto descriptor = ::open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC | flags, 0644);
+    if (descriptor < 0)
+        return false;
+    auto written = std::size_t{0};
+    while (written < content.size())
+    {
+        const auto result = ::write(descriptor, content.data() + written, content.size() - written);
+        if (result < 0 && errno == EINTR)
+            continue;
+        if (result <= 0)
+            break;
+        written += static_cast<std::size_t>(result);
+    }
+    const auto synced = written == content.size() && ::fsync(descriptor) == 0;
+    return ::close(descriptor) == 0 && synced;
+}
+
+// Makes a file that was just renamed into the directory survive a crash
+void syncDirectoryOf(const std::string& path)
+{
+    const auto slash = path.find_last_of('/');
+    const auto directory = slash == std::string::npos ? std::string{"."} :
+                           slash == 0                 ? std::string{"/"} :
+                                                        path.substr(0, slash);
+    const auto descriptor = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (descriptor < 0)
+        return;
+    ::fsync(descriptor);
+    ::close(descriptor);
+}
+}    // namespace
+
+bool RolloutConfiguration::isEnabled() const
+{
+    return concurrencyLimit > 0;
+}
+
+FirmwareRolloutScheduler::FirmwareRolloutScheduler(RolloutConfiguration configuration, std::string stateFile)
+: m_configuration(std::move(configuration))
+, m_stateFile(std::move(stateFile))
+, m_paused(false)
+, m_succeeded(0)
+, m_failed(0)
+, m_recordCount(0)
+{
+}
+
+bool FirmwareRolloutScheduler::load()
+{
+    LOG(TRACE) << METHOD_INFO;
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    if (!FileSystemUtils::isFilePresent(m_stateFile))
+        return false;
+    auto content = std::string{};
+    if (!FileSystemUtils::readFileContent(m_stateFile, content))
+    {
+        LOG(ERROR) << "Failed to load the firmware rollout state -> Failed to read the state file.";
+        return false;
+    }
+
+    // Replay the lines, a snapshot of the state followed by the changes made since
+    auto start = std::size_t{0};
+    while (start < content.size())
+    {
+        const auto end = content.find('\n', start);
+        if (end == std::string::npos)
+        {
+            LOG(WARN) << "Ignoring the incomplete last line of the firmware rollout state file.";
+            break;
+        }
+        const auto line = content.substr(start, end - start);
+        start = end + 1;
+        if (applyLine(line))
+            ++m_recordCount;
+        else if (!line.empty())
+            LOG(WARN) << "Ignoring invalid line in the firmware rollout state file.";
+    }
+
+    // Continue with a file that holds just the current state
+    if (m_recordCount > 2 + m_queue.size() + m_running.size() || start < content.size())
+        compact();
+    LOG(INFO) << "Loaded firmware rollout state -> " << m_queue.size() << " waiting and " << m_running.size()
+              << " running installation(s)" << (m_paused ? ", paused." : ".");
+    return true;
+}
+
+bool FirmwareRolloutScheduler::enqueue(const std::string& deviceKey, const std::string& file)
+{
+    LOG(TRACE) << METHOD_INFO;
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    if (m_running.find(deviceKey) != m_running.cend() ||
+        std::any_of(m_queue.cbegin(), m_queue.cend(),
+                    [&](const RolloutEntry& entry) { return entry.deviceKey == deviceKey; }))
+        return false;
+
+    const auto entry = RolloutEntry{
+      deviceKey, file, m_configuration.canaryDevices.find(deviceKey) != m_configuration.canaryDevices.cend()};
+    insertWaiting(entry, false);
+    record(composeEntryLine(QUEUED_LINE, entry));
+    return true;
+}
+
+std::vector<RolloutEntry> FirmwareRolloutScheduler::takeReady()
+{
+    LOG(TRACE) << METHOD_INFO;
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    auto ready = std::vector<RolloutEntry>{};
+    auto lines = std::string{};
+    while (!m_paused && !m_queue.empty() && m_running.size() < m_configuration.concurrencyLimit)
+    {
+        // The canary devices are in the front of the queue, so once the front one is not a canary, no canaries are
+        // waiting, and the others can start once the running canaries are done
+        const auto& next = m_queue.front();
+        if (!next.canary && std::any_of(m_running.cbegin(), m_running.cend(),
+                                        [](const std::pair<const std::string, RolloutEntry>& running) {
+                                            return running.second.canary;
+                                        }))
+            break;
+        m_running.emplace(next.deviceKey, next);
+        lines += composeKeyLine(STARTED_LINE, next.deviceKey);
+        ready.emplace_back(next);
+        m_queue.pop_front();
+    }
+    if (!ready.empty())
+        record(lines);
+    return ready;
+}
+
+bool FirmwareRolloutScheduler::finish(const std::string& deviceKey, bool success)
+{
+    LOG(TRACE) << METHOD_INFO;
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    const auto it = m_running.find(deviceKey);
+    if (it == m_running.cend())
+        return false;
+    const auto canary = it->second.canary;
+    m_running.erase(it);
+    if (success)
+        ++m_succeeded;
+    else
+        ++m_failed;
+
+    // Check whether the rollout needs to be paused
+    const auto finished = m_succeeded + m_failed;
+    if (!success && canary)
+    {
+        LOG(WARN) << "Pausing firmware rollout -> The installation on canary device '" << deviceKey << "' failed.";
+        m_paused = true;
+    }
+    else if (!m_paused && finished >= m_configuration.errorRateSampleSize &&
+             static_cast<double>(m_failed) > m_configuration.maximumErrorRate * static_cast<double>(finished))
+    {
+        LOG(WARN) << "Pausing firmware rollout -> " << m_failed << " out of " << finished
+                  << " installation(s) failed.";
+        m_paused = true;
+    }
+
+    // Once everything is done, the next rollout starts from a clean slate
+    if (m_queue.empty() && m_running.empty() && !m_paused)
+    {
+        LOG(INFO) << "Firmware rollout is done -> " << m_succeeded << " installation(s) succeeded, " << m_failed
+                  << " failed.";
+        m_succeeded = 0;
+        m_failed = 0;
+    }
+    record(composeKeyLine(REMOVED_LINE, deviceKey) + composeStateLines(m_paused, m_succeeded, m_failed));
+    return true;
+}
+
+bool FirmwareRolloutScheduler::remove(const std::string& deviceKey)
+{
+    LOG(TRACE) << METHOD_INFO;
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    const auto it = std::find_if(m_queue.begin(), m_queue.end(),
+                                 [&](const RolloutEntry& entry) { return entry.deviceKey == deviceKey; });
+    if (it == m_queue.end())
+        return false;
+    m_queue.erase(it);
+    record(composeKeyLine(REMOVED_LINE, deviceKey));
+    return true;
+}
+
+bool FirmwareRolloutScheduler::release(const std::string& deviceKey)
+{
+    LOG(TRACE) << METHOD_INFO;
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    if (m_running.erase(deviceKey) == 0)
+        return false;
+    record(composeKeyLine(REMOVED_LINE, deviceKey));
+    return true;
+}
+
+bool FirmwareRolloutScheduler::requeue(const std::string& deviceKey)
+{
+    LOG(TRACE) << METHOD_INFO;
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    const auto it = m_running.find(deviceKey);
+    if (it == m_running.end())
+        return false;
+    insertWaiting(std::move(it->second), true);
+    m_running.erase(it);
+    record(composeKeyLine(REQUEUED_LINE, deviceKey));
+    return true;
+}
+
+bool FirmwareRolloutScheduler::contains(const std::string& deviceKey) const
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    return m_running.find(deviceKey) != m_running.cend() ||
+           std::any_of(m_queue.cbegin(), m_queue.cend(),
+                       [&](const RolloutEntry& entry) { return entry.deviceKey == deviceKey; });
+}
+
+bool FirmwareRolloutScheduler::isRunning(const std::string& deviceKey) const
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    return m_running.find(deviceKey) != m_running.cend();
+}
+
+void FirmwareRolloutScheduler::pause()
+{
+    LOG(TRACE) << METHOD_INFO;
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_paused = true;
+    record(composeStateLines(m_paused, m_succeeded, m_failed));
+}
+
+void FirmwareRolloutScheduler::resume()
+{
+    LOG(TRACE) << METHOD_INFO;
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_paused = false;
+    m_succeeded = 0;
+    m_failed = 0;
+    record(composeStateLines(m_paused, m_succeeded, m_failed));
+}
+
+bool FirmwareRolloutScheduler::isPaused() const
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    return m_paused;
+}
+
+std::size_t FirmwareRolloutScheduler::getQueuedCount() const
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    return m_queue.size();
+}
+
+std::size_t FirmwareRolloutScheduler::getRunningCount() const
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    return m_running.size();
+}
+
+const RolloutConfiguration& FirmwareRolloutScheduler::getConfiguration() const
+{
+    return m_configuration;
+}
+
+void FirmwareRolloutScheduler::insertWaiting(RolloutEntry entry, bool inFront)
+{
+    // The canary installations are in front of everyone else, so the only other place one can go is behind them
+    if (entry.canary && inFront)
+    {
+        m_queue.emplace_front(std::move(entry));
+        return;
+    }
+    if (!entry.canary && !inFront)
+    {
+        m_queue.emplace_back(std::move(entry));
+        return;
+    }
+    m_queue.insert(
+      std::find_if(m_queue.begin(), m_queue.end(), [](const RolloutEntry& waiting) { return !waiting.canary; }),
+      std::move(entry));
+}
+
+bool FirmwareRolloutScheduler::applyLine(const std::string& line)
+{
+    const auto parts = splitLine(line);
+    if (parts.size() == 2 && parts[0] == PAUSED_LINE)
+    {
+        m_paused = parts[1] == "1";
+    }
+    else if (parts.size() == 3 && parts[0] == COUNTS_LINE)
+    {
+        m_succeeded = std::strtoull(parts[1].c_str(), nullptr, 10);
+        m_failed = std::strtoull(parts[2].c_str(), nullptr, 10);
+    }
+    else if (parts.size() == 4 && (parts[0] == QUEUED_LINE || parts[0] == RUNNING_LINE))
+    {
+        auto entry = RolloutEntry{FirmwareSessionJournal::unescape(parts[2]),
+                                  FirmwareSessionJournal::unescape(parts[3]), parts[1] == "1"};
+        if (parts[0] == QUEUED_LINE)
+            insertWaiting(std::move(entry), false);
+        else
+            m_running[entry.deviceKey] = entry;
+    }
+    else if (parts.size() == 2 && parts[0] == STARTED_LINE)
+    {
+        const auto deviceKey = FirmwareSessionJournal::unescape(parts[1]);
+        const auto it = std::find_if(m_queue.begin(), m_queue.end(),
+                                     [&](const RolloutEntry& entry) { return entry.deviceKey == deviceKey; });
+        if (it != m_queue.end())
+        {
+            m_running[deviceKey] = *it;
+            m_queue.erase(it);
+        }
+    }
+    else if (parts.size() == 2 && parts[0] == REQUEUED_LINE)
+    {
+        const auto it = m_running.find(FirmwareSessionJournal::unescape(parts[1]));
+        if (it != m_running.end())
+        {
+            insertWaiting(std::move(it->second), true);
+            m_running.erase(it);
+        }
+    }
+    else if (parts.size() == 2 && parts[0] == REMOVED_LINE)
+    {
+        const auto deviceKey = FirmwareSessionJournal::unescape(parts[1]);
+        m_running.erase(deviceKey);
+        m_queue.erase(std::remove_if(m_queue.begin(), m_queue.end(),
+                                     [&](const RolloutEntry& entry) { return entry.deviceKey == deviceKey; }),
+                      m_queue.end());
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+void FirmwareRolloutScheduler::record(const std::string& lines)
+{
+    // An empty rollout does not need a file
+    if (m_queue.empty() && m_running.empty() && !m_paused)
+    {
+        if (FileSystemUtils::isFilePresent(m_stateFile))
+            FileSystemUtils::deleteFile(m_stateFile);
+        m_recordCount = 0;
+        return;
+    }
+
+    // A new file starts with the whole state, and a failed append might have left a part of a line behind
+    if (!FileSystemUtils::isFilePresent(m_stateFile))
+    {
+        compact();
+        return;
+    }
+    if (!writeAndSync(m_stateFile, lines, O_APPEND))
+    {
+        LOG(ERROR) << "Failed to save the firmware rollout state -> Failed to append to the state file.";
+        compact();
+        return;
+    }
+    m_recordCount += static_cast<std::size_t>(std::count(lines.cbegin(), lines.cend(), '\n'));
+
+    // Once the changes start to outnumber the installations, they are replaced with the state they lead to
+    if (m_recordCount >= COMPACTION_MINIMUM && m_recordCount > 2 * (2 + m_queue.size() + m_running.size()))
+        compact();
+}
+
+bool FirmwareRolloutScheduler::compact()
+{
+    LOG(TRACE) << METHOD_INFO;
+
+    auto content = composeStateLines(m_paused, m_succeeded, m_failed);
+    for (const auto& entry : m_running)
+        content += composeEntryLine(RUNNING_LINE, entry.second);
+    for (const auto& entry : m_queue)
+        content += composeEntryLine(QUEUED_LINE, entry);
+
+    // The state is written into a temporary file first, which then replaces the state file in a single step, so a
+    // crash in the middle leaves either the old or the new state behind
+    const auto errorPrefix = "Failed to save the firmware rollout state";
+    const auto temporaryFile = m_stateFile + TEMPORARY_SUFFIX;
+    if (!writeAndSync(temporaryFile, content, O_TRUNC))
+    {
+        LOG(ERROR) << errorPrefix << " -> Failed to write the temporary file.";
+        FileSystemUtils::deleteFile(temporaryFile);
+        return false;
+    }
+    if (std::rename(temporaryFile.c_str(), m_stateFile.c_str()) != 0)
+    {
+        LOG(ERROR) << errorPrefix << " -> Failed to replace the state file.";
+        FileSystemUtils::deleteFile(temporaryFile);
+        return false;
+    }
+    syncDirectoryOf(m_stateFile);
+    m_recordCount = 2 + m_queue.size() + m_running.size();
+    return true;
+}
+}    // namespace connect
+}    // namespace wolkabout
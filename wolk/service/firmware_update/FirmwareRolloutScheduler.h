@@ -0,0 +1,207 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WOLKABOUTCONNECTOR_FIRMWAREROLLOUTSCHEDULER_H
+#define WOLKABOUTCONNECTOR_FIRMWAREROLLOUTSCHEDULER_H
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace wolkabout
+{
+namespace connect
+{
+/**
+ * This is the configuration of a staged firmware rollout over the devices behind a gateway.
+ */
+struct RolloutConfiguration
+{
+    // The maximum count of installations that are running at the same time. Zero disables the rollout, and every
+    // installation is started as soon as it is received.
+    std::size_t concurrencyLimit = 0;
+
+    // The devices that are updated first. Other devices are not started until every canary device waiting or running
+    // has finished, and a failed canary pauses the rollout.
+    std::set<std::string> canaryDevices;
+
+    // The rollout pauses once at least `errorRateSampleSize` installations have finished, and the share of them that
+    // failed is larger than `maximumErrorRate`.
+    double maximumErrorRate = 0.2;
+    std::size_t errorRateSampleSize = 5;
+
+    /**
+     * This method is used to check whether the configuration describes a rollout.
+     *
+     * @return Whether the concurrency limit is set.
+     */
+    bool isEnabled() const;
+};
+
+/**
+ * This is a single installation of a rollout.
+ */
+struct RolloutEntry
+{
+    std::string deviceKey;
+    std::string file;
+    bool canary;
+};
+
+/**
+ * This is the scheduler that decides when the installations of a rollout are started.
+ *
+ * Installations are started in the order they were received, with the canary devices first, while there are less than
+ * the concurrency limit of them running. Every change is appended to a state file and synced to the disk, so a rollout
+ * continues after a restart where it left off. The file is rewritten with just the current state once the changes start
+ * to outnumber the installations in it.
+ */
+class FirmwareRolloutScheduler
+{
+public:
+    /**
+     * Default parameter constructor.
+     *
+     * @param configuration The configuration of the rollout.
+     * @param stateFile The path of the file where the state of the rollout is kept.
+     */
+    FirmwareRolloutScheduler(RolloutConfiguration configuration, std::string stateFile);
+
+    /**
+     * This method is used to load the state of the rollout from the state file.
+     *
+     * @return Whether a state was loaded.
+     */
+    bool load();
+
+    /**
+     * This method is used to add an installation to the rollout.
+     *
+     * @param deviceKey The key of the device.
+     * @param file The name of the firmware file.
+     * @return Whether the installation was added. It is not if the device already has one waiting or running.
+     */
+    bool enqueue(const std::string& deviceKey, const std::string& file);
+
+    /**
+     * This method is used to take the installations that can be started now. They are marked as running.
+     *
+     * @return The installations that should be started.
+     */
+    std::vector<RolloutEntry> takeReady();
+
+    /**
+     * This method is used to report the outcome of a running installation.
+     *
+     * @param deviceKey The key of the device.
+     * @param success Whether the installation was successful.
+     * @return Whether the device had a running installation.
+     */
+    bool finish(const std::string& deviceKey, bool success);
+
+    /**
+     * This method is used to remove an installation that is waiting to be started.
+     *
+     * @param deviceKey The key of the device.
+     * @return Whether the device had a waiting installation.
+     */
+    bool remove(const std::string& deviceKey);
+
+    /**
+     * This method is used to remove a running installation that was never started, without counting it as finished.
+     *
+     * @param deviceKey The key of the device.
+     * @return Whether the device had a running installation.
+     */
+    bool release(const std::string& deviceKey);
+
+    /**
+     * This method is used to put a running installation that was never started back in front of the waiting ones,
+     * without counting it as finished.
+     *
+     * @param deviceKey The key of the device.
+     * @return Whether the device had a running installation.
+     */
+    bool requeue(const std::string& deviceKey);
+
+    /**
+     * This method is used to check whether a device has an installation that is waiting or running.
+     *
+     * @param deviceKey The key of the device.
+     * @return Whether the device is part of the rollout.
+     */
+    bool contains(const std::string& deviceKey) const;
+
+    /**
+     * This method is used to check whether a device has an installation that is running.
+     *
+     * @param deviceKey The key of the device.
+     * @return Whether the installation is running.
+     */
+    bool isRunning(const std::string& deviceKey) const;
+
+    /**
+     * This method is used to pause the rollout. The running installations are not affected.
+     */
+    void pause();
+
+    /**
+     * This method is used to resume the rollout. The count of finished installations the error rate is calculated
+     * from starts from zero again.
+     */
+    void resume();
+
+    bool isPaused() const;
+
+    std::size_t getQueuedCount() const;
+
+    std::size_t getRunningCount() const;
+
+    const RolloutConfiguration& getConfiguration() const;
+
+private:
+    // Internal method used to put an installation into the queue, behind or in front of the others of its kind. The
+    // canary installations are always in front of the others. Must be called with the mutex locked.
+    void insertWaiting(RolloutEntry entry, bool inFront);
+
+    // Internal method used to apply a line of the state file. Must be called with the mutex locked.
+    bool applyLine(const std::string& line);
+
+    // Internal method used to append the lines of a change to the state file. Must be called with the mutex locked.
+    void record(const std::string& lines);
+
+    // Internal method used to replace the state file with just the current state. Must be called with the mutex locked.
+    bool compact();
+
+    RolloutConfiguration m_configuration;
+    std::string m_stateFile;
+
+    mutable std::mutex m_mutex;
+    std::deque<RolloutEntry> m_queue;
+    std::map<std::string, RolloutEntry> m_running;
+    bool m_paused;
+    std::uint64_t m_succeeded;
+    std::uint64_t m_failed;
+    std::size_t m_recordCount;
+};
+}    // namespace connect
+}    // namespace wolkabout
+
+#endif    // WOLKABOUTCONNECTOR_FIRMWAREROLLOUTSCHEDULER_H
@@ -0,0 +1,278 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wolk/service/firmware_update/FirmwareSessionJournal.h"
+
+#include "core/utilities/FileSystemUtils.h"
+#include "core/utilities/Logger.h"
+
+#include <cstdio>
+#include <fstream>
+#include <utility>
+
+namespace wolkabout
+{
+namespace connect
+{
+namespace
+{
+const char STORE_RECORD = '+';
+const char REMOVE_RECORD = '-';
+const char SEPARATOR = '\t';
+const std::string TEMPORARY_SUFFIX = ".tmp";
+
+// The journal is not compacted until it has at least this many records
+const std::size_t COMPACTION_MINIMUM = 64;
+
+// The file is only written when it is known, so the records stay the same as before for the sessions without it
+std::string composeStoreLine(const std::string& deviceKey, const std::pair<std::string, std::string>& session)
+{
+    auto line = std::string{STORE_RECORD} + SEPARATOR + FirmwareSessionJournal::escape(deviceKey) + SEPARATOR +
+                FirmwareSessionJournal::escape(session.first);
+    if (!session.second.empty())
+        line += SEPARATOR + FirmwareSessionJournal::escape(session.second);
+    return line + "\n";
+}
+}    // namespace
+
+FirmwareSessionJournal::FirmwareSessionJournal(std::string journalFile)
+: m_journalFile(std::move(journalFile)), m_recordCount(0)
+{
+}
+
+std::string FirmwareSessionJournal::escape(const std::string& value)
+{
+    auto escaped = std::string{};
+    escaped.reserve(value.size());
+    for (const auto character : value)
+    {
+        if (character == '\\')
+            escaped += "\\\\";
+        else if (character == SEPARATOR)
+            escaped += "\\t";
+        else if (character == '\n')
+            escaped += "\\n";
+        else
+            escaped += character;
+    }
+    return escaped;
+}
+
+std::string FirmwareSessionJournal::unescape(const std::string& value)
+{
+    auto unescaped = std::string{};
+    unescaped.reserve(value.size());
+    for (auto i = std::size_t{0}; i < value.size(); ++i)
+    {
+        if (value[i] != '\\' || i + 1 == value.size())
+        {
+            unescaped += value[i];
+            continue;
+        }
+        const auto next = value[++i];
+        unescaped += next == 't' ? SEPARATOR : next == 'n' ? '\n' : next;
+    }
+    return unescaped;
+}
+
+bool FirmwareSessionJournal::load()
+{
+    LOG(TRACE) << METHOD_INFO;
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_sessions.clear();
+    m_recordCount = 0;
+    if (!FileSystemUtils::isFilePresent(m_journalFile))
+        return true;
+    auto content = std::string{};
+    if (!FileSystemUtils::readFileContent(m_journalFile, content))
+    {
+        LOG(ERROR) << "Failed to load the firmware session journal -> Failed to read the journal file.";
+        return false;
+    }
+
+    // Replay the records, the last record of every device wins
+    auto start = std::size_t{0};
+    while (start < content.size())
+    {
+        const auto end = content.find('\n', start);
+        if (end == std::string::npos)
+        {
+            LOG(WARN) << "Ignoring the incomplete last record of the firmware session journal.";
+            break;
+        }
+        const auto line = content.substr(start, end - start);
+        start = end + 1;
+
+        const auto keyStart = line.find(SEPARATOR);
+        if (line.empty() || keyStart != 1)
+            continue;
+        const auto keyEnd = line.find(SEPARATOR, keyStart + 1);
+        if (line[0] == STORE_RECORD && keyEnd != std::string::npos)
+        {
+            // The records stored without a file end with the version
+            auto& session = m_sessions[unescape(line.substr(keyStart + 1, keyEnd - keyStart - 1))];
+            const auto versionEnd = line.find(SEPARATOR, keyEnd + 1);
+            if (versionEnd == std::string::npos)
+                session = {unescape(line.substr(keyEnd + 1)), std::string{}};
+            else
+                session = {unescape(line.substr(keyEnd + 1, versionEnd - keyEnd - 1)),
+                           unescape(line.substr(versionEnd + 1))};
+        }
+        else if (line[0] == REMOVE_RECORD)
+            m_sessions.erase(unescape(line.substr(keyStart + 1)));
+        else
+            continue;
+        ++m_recordCount;
+    }
+
+    // Start with a journal that holds just the live sessions
+    if (m_recordCount > m_sessions.size() || start < content.size())
+        compact();
+    return true;
+}
+
+std::size_t FirmwareSessionJournal::migrateLegacyFiles(const std::string& directory, const std::string& prefix)
+{
+    LOG(TRACE) << METHOD_INFO;
+
+    if (!FileSystemUtils::isDirectoryPresent(directory))
+        return 0;
+
+    auto migrated = std::size_t{0};
+    for (const auto& fileName : FileSystemUtils::listFiles(directory))
+    {
+        if (fileName.size() <= prefix.size() || fileName.compare(0, prefix.size(), prefix) != 0)
+            continue;
+        const auto deviceKey = fileName.substr(prefix.size());
+        const auto filePath = FileSystemUtils::composePath(fileName, directory);
+        auto version = std::string{};
+        if (!FileSystemUtils::readFileContent(filePath, version) || !store(deviceKey, version))
+        {
+            LOG(ERROR) << "Failed to migrate the firmware session of device '" << deviceKey << "'.";
+            continue;
+        }
+        FileSystemUtils::deleteFile(filePath);
+        ++migrated;
+    }
+    if (migrated > 0)
+        LOG(INFO) << "Migrated " << migrated << " firmware session file(s) into the session journal.";
+    return migrated;
+}
+
+bool FirmwareSessionJournal::store(const std::string& deviceKey, const std::string& version,
+                                   const std::string& file)
+{
+    LOG(TRACE) << METHOD_INFO;
+
+    // The session goes into the map first, so a compaction triggered by the append keeps it
+    std::lock_guard<std::mutex> lock{m_mutex};
+    const auto previous = m_sessions.find(deviceKey);
+    const auto hadSession = previous != m_sessions.cend();
+    const auto previousSession = hadSession ? previous->second : std::pair<std::string, std::string>{};
+    m_sessions[deviceKey] = {version, file};
+    if (append(composeStoreLine(deviceKey, m_sessions[deviceKey])))
+        return true;
+
+    if (hadSession)
+        m_sessions[deviceKey] = previousSession;
+    else
+        m_sessions.erase(deviceKey);
+    return false;
+}
+
+bool FirmwareSessionJournal::remove(const std::string& deviceKey)
+{
+    LOG(TRACE) << METHOD_INFO;
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    if (m_sessions.erase(deviceKey) == 0)
+        return false;
+    append(std::string{REMOVE_RECORD} + SEPARATOR + escape(deviceKey) + "\n");
+    return true;
+}
+
+bool FirmwareSessionJournal::find(const std::string& deviceKey, std::string& version) const
+{
+    auto file = std::string{};
+    return find(deviceKey, version, file);
+}
+
+bool FirmwareSessionJournal::find(const std::string& deviceKey, std::string& version, std::string& file) const
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    const auto it = m_sessions.find(deviceKey);
+    if (it == m_sessions.cend())
+        return false;
+    version = it->second.first;
+    file = it->second.second;
+    return true;
+}
+
+std::size_t FirmwareSessionJournal::size() const
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    return m_sessions.size();
+}
+
+bool FirmwareSessionJournal::append(const std::string& line)
+{
+    {
+        std::ofstream journal{m_journalFile, std::ios::out | std::ios::app | std::ios::binary};
+        if (!journal || !journal.write(line.data(), static_cast<std::streamsize>(line.size())).flush())
+        {
+            LOG(ERROR) << "Failed to write into the firmware session journal -> Failed to append to the journal file.";
+            return false;
+        }
+    }
+    ++m_recordCount;
+
+    // Once the stale records start to outnumber the live ones, they are dropped
+    if (m_recordCount >= COMPACTION_MINIMUM && m_recordCount > 2 * m_sessions.size())
+        compact();
+    return true;
+}
+
+bool FirmwareSessionJournal::compact()
+{
+    LOG(TRACE) << METHOD_INFO;
+    const auto errorPrefix = "Failed to compact the firmware session journal";
+
+    // The live sessions are written into a temporary file first, which then replaces the journal in a single step, so
+    // a crash in the middle leaves either the old or the new journal behind
+    const auto temporaryFile = m_journalFile + TEMPORARY_SUFFIX;
+    {
+        std::ofstream journal{temporaryFile, std::ios::out | std::ios::trunc | std::ios::binary};
+        for (const auto& session : m_sessions)
+            journal << composeStoreLine(session.first, session.second);
+        if (!journal.flush())
+        {
+            LOG(ERROR) << errorPrefix << " -> Failed to write the temporary file.";
+            FileSystemUtils::deleteFile(temporaryFile);
+            return false;
+        }
+    }
+    if (std::rename(temporaryFile.c_str(), m_journalFile.c_str()) != 0)
+    {
+        LOG(ERROR) << errorPrefix << " -> Failed to replace the journal file.";
+        FileSystemUtils::deleteFile(temporaryFile);
+        return false;
+    }
+    m_recordCount = m_sessions.size();
+    return true;
+}
+}    // namespace connect
+}    // namespace wolkabout
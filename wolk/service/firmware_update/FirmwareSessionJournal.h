@@ -0,0 +1,142 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WOLKABOUTCONNECTOR_FIRMWARESESSIONJOURNAL_H
+#define WOLKABOUTCONNECTOR_FIRMWARESESSIONJOURNAL_H
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+namespace wolkabout
+{
+namespace connect
+{
+/**
+ * This is the store of the firmware update sessions of all the devices, kept in a single journal file.
+ *
+ * Every change is appended to the journal as one line, and the journal is read only once, when it is loaded, so looking
+ * up the session of a device never touches the disk. A line that was cut short by a crash is ignored, and the journal
+ * is rewritten without the stale records into a temporary file that replaces it, once they start to outnumber the live
+ * ones.
+ */
+class FirmwareSessionJournal
+{
+public:
+    /**
+     * Default parameter constructor.
+     *
+     * @param journalFile The path of the journal file.
+     */
+    explicit FirmwareSessionJournal(std::string journalFile);
+
+    /**
+     * This method is used to load the sessions from the journal file.
+     *
+     * @return Whether the journal was loaded. A journal that does not exist yet counts as loaded.
+     */
+    bool load();
+
+    /**
+     * This method is used to move the sessions kept in the old per device session files into the journal. The old
+     * files are deleted once their session is in the journal.
+     *
+     * @param directory The directory holding the old session files.
+     * @param prefix The prefix of the name of an old session file, followed by the device key.
+     * @return The count of sessions that were moved.
+     */
+    std::size_t migrateLegacyFiles(const std::string& directory, const std::string& prefix);
+
+    /**
+     * This method is used to store the session of a device.
+     *
+     * @param deviceKey The key of the device.
+     * @param version The firmware version the device had when the session started.
+     * @param file The path of the file that is being installed. Empty if it is not known.
+     * @return Whether the session was written into the journal.
+     */
+    bool store(const std::string& deviceKey, const std::string& version, const std::string& file = "");
+
+    /**
+     * This method is used to remove the session of a device.
+     *
+     * @param deviceKey The key of the device.
+     * @return Whether the device had a session.
+     */
+    bool remove(const std::string& deviceKey);
+
+    /**
+     * This method is used to look up the session of a device.
+     *
+     * @param deviceKey The key of the device.
+     * @param version The firmware version the device had when the session started.
+     * @return Whether the device has a session.
+     */
+    bool find(const std::string& deviceKey, std::string& version) const;
+
+    /**
+     * This method is used to look up the session of a device, together with the file it is installing.
+     *
+     * @param deviceKey The key of the device.
+     * @param version The firmware version the device had when the session started.
+     * @param file The path of the file that is being installed. Empty for the sessions stored without it.
+     * @return Whether the device has a session.
+     */
+    bool find(const std::string& deviceKey, std::string& version, std::string& file) const;
+
+    /**
+     * Getter for the count of sessions.
+     *
+     * @return The count of sessions.
+     */
+    std::size_t size() const;
+
+    /**
+     * This method is used to escape a value, so it can not break up the tab separated lines of a state file.
+     *
+     * @param value The value.
+     * @return The value with backslashes, tabs and newlines escaped.
+     */
+    static std::string escape(const std::string& value);
+
+    /**
+     * This method is used to restore a value that was escaped.
+     *
+     * @param value The escaped value.
+     * @return The original value.
+     */
+    static std::string unescape(const std::string& value);
+
+private:
+    // Internal method used to append a line to the journal. Must be called with the mutex locked.
+    bool append(const std::string& line);
+
+    // Internal method used to rewrite the journal with only the live sessions. Must be called with the mutex locked.
+    bool compact();
+
+    std::string m_journalFile;
+
+    mutable std::mutex m_mutex;
+    // The version and the file of the session of every device
+    std::unordered_map<std::string, std::pair<std::string, std::string>> m_sessions;
+    std::size_t m_recordCount;
+};
+}    // namespace connect
+}    // namespace wolkabout
+
+#endif    // WOLKABOUTCONNECTOR_FIRMWARESESSIONJOURNAL_H
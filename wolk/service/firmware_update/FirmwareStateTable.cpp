@@ -0,0 +1,99 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wolk/service/firmware_update/FirmwareStateTable.h"
+
+#include <functional>
+
+namespace wolkabout
+{
+namespace connect
+{
+std::string toString(FirmwareInstallationState state)
+{
+    switch (state)
+    {
+    case FirmwareInstallationState::IDLE:
+        return "IDLE";
+    case FirmwareInstallationState::INSTALLING:
+        return "INSTALLING";
+    case FirmwareInstallationState::AWAITING_RESULT:
+        return "AWAITING_RESULT";
+    }
+    return {};
+}
+
+FirmwareInstallationState FirmwareStateTable::get(const std::string& deviceKey) const
+{
+    auto& shard = getShard(deviceKey);
+    std::lock_guard<std::mutex> lock{shard.mutex};
+    const auto it = shard.states.find(deviceKey);
+    return it != shard.states.cend() ? it->second : FirmwareInstallationState::IDLE;
+}
+
+void FirmwareStateTable::set(const std::string& deviceKey, FirmwareInstallationState state)
+{
+    auto& shard = getShard(deviceKey);
+    std::lock_guard<std::mutex> lock{shard.mutex};
+    if (state == FirmwareInstallationState::IDLE)
+        shard.states.erase(deviceKey);
+    else
+        shard.states[deviceKey] = state;
+}
+
+bool FirmwareStateTable::transition(const std::string& deviceKey, FirmwareInstallationState expected,
+                                    FirmwareInstallationState desired)
+{
+    auto& shard = getShard(deviceKey);
+    std::lock_guard<std::mutex> lock{shard.mutex};
+    const auto it = shard.states.find(deviceKey);
+    const auto current = it != shard.states.cend() ? it->second : FirmwareInstallationState::IDLE;
+    if (current != expected)
+        return false;
+
+    if (desired == FirmwareInstallationState::IDLE)
+    {
+        if (it != shard.states.cend())
+            shard.states.erase(it);
+    }
+    else if (it != shard.states.cend())
+    {
+        it->second = desired;
+    }
+    else
+    {
+        shard.states.emplace(deviceKey, desired);
+    }
+    return true;
+}
+
+std::size_t FirmwareStateTable::size() const
+{
+    auto count = std::size_t{0};
+    for (const auto& shard : m_shards)
+    {
+        std::lock_guard<std::mutex> lock{shard.mutex};
+        count += shard.states.size();
+    }
+    return count;
+}
+
+FirmwareStateTable::Shard& FirmwareStateTable::getShard(const std::string& deviceKey) const
+{
+    return m_shards[std::hash<std::string>{}(deviceKey) % SHARD_COUNT];
+}
+}    // namespace connect
+}    // namespace wolkabout
@@ -0,0 +1,107 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WOLKABOUTCONNECTOR_FIRMWARESTATETABLE_H
+#define WOLKABOUTCONNECTOR_FIRMWARESTATETABLE_H
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace wolkabout
+{
+namespace connect
+{
+/**
+ * This is the state of the firmware installation of a single device.
+ */
+enum class FirmwareInstallationState
+{
+    // There is no installation going on.
+    IDLE,
+    // The installer is installing the firmware.
+    INSTALLING,
+    // The installer has started an installation that finishes later, usually after a reboot, and the outcome is
+    // learned when the state is loaded.
+    AWAITING_RESULT
+};
+
+std::string toString(FirmwareInstallationState state);
+
+/**
+ * This is the table holding the firmware installation state of every device.
+ *
+ * The devices are spread over shards by the hash of their key, and every shard has its own lock, so the installations
+ * of different devices very rarely wait on each other, and the table can be used from any thread.
+ */
+class FirmwareStateTable
+{
+public:
+    /**
+     * This method is used to obtain the state of a device. Devices that were never set are idle.
+     *
+     * @param deviceKey The key of the device.
+     * @return The state of the device.
+     */
+    FirmwareInstallationState get(const std::string& deviceKey) const;
+
+    /**
+     * This method is used to set the state of a device. Setting a device to idle removes it from the table.
+     *
+     * @param deviceKey The key of the device.
+     * @param state The new state of the device.
+     */
+    void set(const std::string& deviceKey, FirmwareInstallationState state);
+
+    /**
+     * This method is used to change the state of a device, only if it is in the expected state. The check and the
+     * change are done as one step.
+     *
+     * @param deviceKey The key of the device.
+     * @param expected The state the device needs to be in.
+     * @param desired The new state of the device.
+     * @return Whether the state was changed.
+     */
+    bool transition(const std::string& deviceKey, FirmwareInstallationState expected,
+                    FirmwareInstallationState desired);
+
+    /**
+     * Getter for the count of devices that are not idle.
+     *
+     * @return The count of devices.
+     */
+    std::size_t size() const;
+
+private:
+    static const std::size_t SHARD_COUNT = 16;
+
+    struct Shard
+    {
+        mutable std::mutex mutex;
+        std::unordered_map<std::string, FirmwareInstallationState> states;
+    };
+
+    // Internal method used to find the shard the device belongs to
+    Shard& getShard(const std::string& deviceKey) const;
+
+    mutable std::array<Shard, SHARD_COUNT> m_shards;
+};
+}    // namespace connect
+}    // namespace wolkabout
+
+#endif    // WOLKABOUTCONNECTOR_FIRMWARESTATETABLE_H
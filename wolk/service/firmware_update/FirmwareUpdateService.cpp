@@ -19,6 +19,7 @@
 #include "core/utilities/FileSystemUtils.h"
 #include "core/utilities/Logger.h"
 
+#include <algorithm>
 #include <utility>
 
 namespace wolkabout
@@ -26,6 +27,10 @@ namespace wolkabout
 namespace connect
 {
 const std::string SESSION_FILE = ".fw-session";
+const std::string SESSION_JOURNAL_FILE = ".fw-sessions";
+const std::string ROLLOUT_FILE = ".fw-rollout";
+const std::size_t INSTALLATION_WORKER_COUNT = 2;
+const std::size_t INSTALLATION_QUEUE_CAPACITY = 1000;
 
 FirmwareUpdateService::FirmwareUpdateService(ConnectivityService& connectivityService, DataService& dataService,
                                              std::shared_ptr<FileManagementService> fileManagementService,
@@ -34,10 +39,16 @@ FirmwareUpdateService::FirmwareUpdateService(ConnectivityService& connectivitySe
 : m_connectivityService(connectivityService)
 , m_dataService(dataService)
 , m_fileManagementService(std::move(fileManagementService))
-, m_sessionFile(FileSystemUtils::composePath(SESSION_FILE, workingDirectory))
+, m_sessionJournal(FileSystemUtils::composePath(SESSION_JOURNAL_FILE, workingDirectory))
 , m_firmwareInstaller(std::move(firmwareInstaller))
 , m_protocol(protocol)
+, m_rolloutFile(FileSystemUtils::composePath(ROLLOUT_FILE, workingDirectory))
+, m_rolloutStarted(false)
+, m_executor(new FirmwareInstallationExecutor{INSTALLATION_WORKER_COUNT, INSTALLATION_QUEUE_CAPACITY})
 {
+    // The sessions used to be kept in a file per device
+    m_sessionJournal.load();
+    m_sessionJournal.migrateLegacyFiles(workingDirectory, SESSION_FILE + "_");
 }
 
 FirmwareUpdateService::FirmwareUpdateService(ConnectivityService& connectivityService, DataService& dataService,
@@ -47,10 +58,22 @@ FirmwareUpdateService::FirmwareUpdateService(ConnectivityService& connectivitySe
 : m_connectivityService(connectivityService)
 , m_dataService(dataService)
 , m_fileManagementService(std::move(fileManagementService))
-, m_sessionFile(FileSystemUtils::composePath(SESSION_FILE, workingDirectory))
+, m_sessionJournal(FileSystemUtils::composePath(SESSION_JOURNAL_FILE, workingDirectory))
 , m_firmwareParametersListener(std::move(firmwareParametersListener))
 , m_protocol(protocol)
+, m_rolloutFile(FileSystemUtils::composePath(ROLLOUT_FILE, workingDirectory))
+, m_rolloutStarted(false)
 {
+    // The sessions used to be kept in a file per device
+    m_sessionJournal.load();
+    m_sessionJournal.migrateLegacyFiles(workingDirectory, SESSION_FILE + "_");
+}
+
+FirmwareUpdateService::~FirmwareUpdateService()
+{
+    // The installations report back into the service, so they are stopped while everything they use is still here
+    m_executor.reset();
+    m_firmwareInstaller.reset();
 }
 
 bool FirmwareUpdateService::isInstaller() const
@@ -79,18 +102,95 @@ std::queue<std::shared_ptr<Message>>& FirmwareUpdateService::getQueue()
     return m_queue;
 }
 
+void FirmwareUpdateService::publishQueuedMessages()
+{
+    LOG(TRACE) << METHOD_INFO;
+
+    std::lock_guard<std::mutex> lock{m_queueMutex};
+    while (!m_queue.empty())
+    {
+        m_connectivityService.publish(m_queue.front());
+        m_queue.pop();
+    }
+}
+
+void FirmwareUpdateService::setRolloutConfiguration(const RolloutConfiguration& configuration)
+{
+    LOG(TRACE) << METHOD_INFO;
+
+    if (m_firmwareInstaller == nullptr)
+    {
+        LOG(WARN) << "Ignoring the rollout configuration -> The firmware installer is null.";
+        return;
+    }
+    if (!configuration.isEnabled())
+    {
+        m_rolloutScheduler.reset();
+        return;
+    }
+
+    // There need to be enough workers for the installations the rollout is allowed to run at once
+    m_executor.reset(new FirmwareInstallationExecutor{
+      std::max(INSTALLATION_WORKER_COUNT, configuration.concurrencyLimit), INSTALLATION_QUEUE_CAPACITY});
+    m_rolloutScheduler.reset(new FirmwareRolloutScheduler{configuration, m_rolloutFile});
+    m_rolloutScheduler->load();
+}
+
+void FirmwareUpdateService::startRollout()
+{
+    LOG(TRACE) << METHOD_INFO;
+
+    m_rolloutStarted = true;
+    startRolloutInstallations();
+}
+
+void FirmwareUpdateService::pauseRollout()
+{
+    LOG(TRACE) << METHOD_INFO;
+
+    if (m_rolloutScheduler != nullptr)
+        m_rolloutScheduler->pause();
+}
+
+void FirmwareUpdateService::resumeRollout()
+{
+    LOG(TRACE) << METHOD_INFO;
+
+    if (m_rolloutScheduler == nullptr)
+        return;
+    m_rolloutScheduler->resume();
+    startRolloutInstallations();
+}
+
 void FirmwareUpdateService::loadState(const std::string& deviceKey)
 {
     LOG(TRACE) << METHOD_INFO;
 
+    // An installation that is still waiting on the executor, or is being installed right now, is not finished yet, and
+    // will report its own outcome
+    if (m_executor != nullptr && m_executor->isBusy(deviceKey))
+        return;
+    const auto state = m_installationStates.get(deviceKey);
+    if (state == FirmwareInstallationState::INSTALLING)
+        return;
+
     // Check if there is a session going on, and that we have a firmware installer
-    const auto deviceSessionFile = m_sessionFile + "_" + deviceKey;
     auto content = std::string{};
-    if (!FileSystemUtils::readFileContent(deviceSessionFile, content))
+    auto file = std::string{};
+    if (!m_sessionJournal.find(deviceKey, content, file))
     {
-        LOG(WARN) << "Failed to read the content of the session file.";
-        deleteSessionFile(deviceKey);
-        queueStatusMessage(deviceKey, FirmwareUpdateStatus::ERROR, FirmwareUpdateError::UNKNOWN);
+        // Nothing to report for a device without a session. A rollout installation that is running without one was
+        // never started, so it waits for its turn again.
+        if (m_rolloutScheduler != nullptr && m_rolloutScheduler->requeue(deviceKey))
+            startRolloutInstallations();
+        return;
+    }
+
+    // A session is finalized only if the installer reported that it will finish later, or if the device is idle
+    // because the connector was restarted since. Claiming the device keeps a new installation from starting meanwhile.
+    if (!m_installationStates.transition(deviceKey, state, FirmwareInstallationState::INSTALLING))
+    {
+        LOG(DEBUG) << "Not loading the firmware update state -> The installation state of the device has changed.";
         return;
     }
 
@@ -101,16 +201,19 @@ void FirmwareUpdateService::loadState(const std::string& deviceKey)
         LOG(WARN) << "Detected a Firmware Update session but a firmware installer is missing now.";
         deleteSessionFile(deviceKey);
         queueStatusMessage(deviceKey, FirmwareUpdateStatus::ERROR, FirmwareUpdateError::UNKNOWN);
+        m_installationStates.set(deviceKey, FirmwareInstallationState::IDLE);
         return;
     }
 
-    // Ask the installer if the update went well
-    auto success = m_firmwareInstaller->wasFirmwareInstallSuccessful(deviceKey, content);
+    // Ask the installer if the update of the file went well
+    auto success = m_firmwareInstaller->wasFileInstallSuccessful(deviceKey, content, file);
     if (success)
         queueStatusMessage(deviceKey, FirmwareUpdateStatus::SUCCESS);
     else
         queueStatusMessage(deviceKey, FirmwareUpdateStatus::ERROR, FirmwareUpdateError::INSTALLATION_FAILED);
     deleteSessionFile(deviceKey);
+    m_installationStates.set(deviceKey, FirmwareInstallationState::IDLE);
+    finishRolloutInstallation(deviceKey, success);
 }
 
 void FirmwareUpdateService::obtainParametersAndAnnounce(const std::string& deviceKey)
@@ -174,10 +277,30 @@ void FirmwareUpdateService::messageReceived(std::shared_ptr<Message> message)
     {
     case MessageType::FIRMWARE_UPDATE_INSTALL:
     {
-        if (auto parsedMessage = m_protocol.parseFirmwareUpdateInstall(message))
-            onFirmwareInstall(target, *parsedMessage);
-        else
+        auto parsedMessage =
+          std::shared_ptr<FirmwareUpdateInstallMessage>{m_protocol.parseFirmwareUpdateInstall(message)};
+        if (parsedMessage == nullptr)
+        {
             LOG(ERROR) << "Failed to parse 'FirmwareUpdateInstall' message.";
+            return;
+        }
+
+        // The installation can take a long time, so it is run on the executor
+        if (m_executor->isBusy(target) || (m_rolloutScheduler != nullptr && m_rolloutScheduler->contains(target)))
+        {
+            LOG(WARN) << "Received 'FirmwareUpdateInstallMessage' but an installation is already queued or running.";
+            return;
+        }
+
+        // With a rollout, the installation waits for its turn
+        if (m_rolloutScheduler != nullptr)
+        {
+            if (m_rolloutScheduler->enqueue(target, parsedMessage->getFile()))
+                startRolloutInstallations();
+            return;
+        }
+        if (!m_executor->submit(target, [this, target, parsedMessage] { onFirmwareInstall(target, *parsedMessage); }))
+            sendStatusMessage(target, FirmwareUpdateStatus::ERROR, FirmwareUpdateError::UNKNOWN);
         return;
     }
     case MessageType::FIRMWARE_UPDATE_ABORT:
@@ -198,10 +321,13 @@ void FirmwareUpdateService::onFirmwareInstall(const std::string& deviceKey, cons
 {
     LOG(TRACE) << METHOD_INFO;
 
-    // Check if there's already an installation session ongoing
-    if (m_installation.find(deviceKey) != m_installation.cend() && m_installation[deviceKey])
+    // Check if there's already an installation session ongoing, and claim the device if there is not
+    if (!m_installationStates.transition(deviceKey, FirmwareInstallationState::IDLE,
+                                         FirmwareInstallationState::INSTALLING))
     {
-        LOG(WARN) << "Received 'FirmwareUpdateInstallMessage' but an installation is already ongoing.";
+        LOG(WARN) << "Received 'FirmwareUpdateInstallMessage' but an installation is already ongoing ("
+                  << toString(m_installationStates.get(deviceKey)) << ").";
+        finishRolloutInstallation(deviceKey, false);
         return;
     }
 
@@ -215,26 +341,62 @@ void FirmwareUpdateService::onFirmwareInstall(const std::string& deviceKey, cons
     }();
 
     // Trigger the installation
-    storeSessionFile(deviceKey, m_firmwareInstaller->getFirmwareVersion(deviceKey));
+    const auto version = m_firmwareInstaller->getFirmwareVersion(deviceKey);
+    storeSessionFile(deviceKey, version, messagePath);
     sendStatusMessage(deviceKey, FirmwareUpdateStatus::INSTALLING);
-    auto status = m_firmwareInstaller->installFirmware(deviceKey, messagePath);
+
+    // A delta package is first rebuilt into the full image, out of the image that is already on the device
+    auto imagePath = messagePath;
+    if (FirmwareDeltaPatcher::isPatch(messagePath))
+    {
+        const auto result = m_deltaPatcher.apply(messagePath, imagePath);
+        if (result != DeltaPatchResult::APPLIED)
+        {
+            sendStatusMessage(deviceKey, FirmwareUpdateStatus::ERROR,
+                              result == DeltaPatchResult::MISSING_BASE ? FirmwareUpdateError::UNKNOWN_FILE :
+                                                                         FirmwareUpdateError::INSTALLATION_FAILED);
+            deleteSessionFile(deviceKey);
+            m_installationStates.set(deviceKey, FirmwareInstallationState::IDLE);
+            finishRolloutInstallation(deviceKey, false);
+            return;
+        }
+
+        // The session is checked against the file that is really installed
+        storeSessionFile(deviceKey, version, imagePath);
+    }
+    // The installer reports the response when it knows it, which does not have to be before this returns
+    m_firmwareInstaller->installFirmwareAsync(deviceKey, imagePath, [this, deviceKey](InstallResponse status) {
+        onInstallResponse(deviceKey, status);
+    });
+}
+
+void FirmwareUpdateService::onInstallResponse(const std::string& deviceKey, InstallResponse status)
+{
+    LOG(TRACE) << METHOD_INFO;
+
     switch (status)
     {
     case InstallResponse::FAILED_TO_INSTALL:
         sendStatusMessage(deviceKey, FirmwareUpdateStatus::ERROR, FirmwareUpdateError::INSTALLATION_FAILED);
         deleteSessionFile(deviceKey);
+        m_installationStates.set(deviceKey, FirmwareInstallationState::IDLE);
+        finishRolloutInstallation(deviceKey, false);
         return;
     case InstallResponse::NO_FILE:
         sendStatusMessage(deviceKey, FirmwareUpdateStatus::ERROR, FirmwareUpdateError::UNKNOWN_FILE);
         deleteSessionFile(deviceKey);
+        m_installationStates.set(deviceKey, FirmwareInstallationState::IDLE);
+        finishRolloutInstallation(deviceKey, false);
         return;
     case InstallResponse::WILL_INSTALL:
-        m_installation[deviceKey] = true;
+        m_installationStates.set(deviceKey, FirmwareInstallationState::AWAITING_RESULT);
         sendStatusMessage(deviceKey, FirmwareUpdateStatus::INSTALLING);
         return;
     case InstallResponse::INSTALLED:
         sendStatusMessage(deviceKey, FirmwareUpdateStatus::SUCCESS);
         deleteSessionFile(deviceKey);
+        m_installationStates.set(deviceKey, FirmwareInstallationState::IDLE);
+        finishRolloutInstallation(deviceKey, true);
         break;
     }
 }
@@ -244,9 +406,25 @@ void FirmwareUpdateService::onFirmwareAbort(const std::string& deviceKey,
 {
     LOG(TRACE) << METHOD_INFO;
 
-    // Check if the session file is present
-    if (m_installation.find(deviceKey) != m_installation.cend() && m_installation[deviceKey] &&
-        m_firmwareInstaller != nullptr)
+    // An installation that is still waiting for its turn in the rollout is just taken out of it
+    if (m_rolloutScheduler != nullptr && m_rolloutScheduler->remove(deviceKey))
+    {
+        sendStatusMessage(deviceKey, FirmwareUpdateStatus::ABORTED);
+        return;
+    }
+
+    // And so is one that is still waiting for a worker, which also gives its place in the rollout to the next one
+    if (m_executor != nullptr && m_executor->cancel(deviceKey) > 0)
+    {
+        sendStatusMessage(deviceKey, FirmwareUpdateStatus::ABORTED);
+        if (m_rolloutScheduler != nullptr && m_rolloutScheduler->release(deviceKey))
+            startRolloutInstallations();
+        return;
+    }
+
+    // Check if an installation is ongoing
+    const auto ongoing = m_installationStates.get(deviceKey) != FirmwareInstallationState::IDLE;
+    if ((ongoing || (m_executor != nullptr && m_executor->isBusy(deviceKey))) && m_firmwareInstaller != nullptr)
         m_firmwareInstaller->abortFirmwareInstall(deviceKey);
 }
 
@@ -263,7 +441,13 @@ void FirmwareUpdateService::sendStatusMessage(const std::string& deviceKey, Firm
         LOG(ERROR) << "Failed to generate outbound FirmwareUpdateStatusMessage.";
         return;
     }
-    m_connectivityService.publish(message);
+
+    // If the message can not be sent now, it is sent when the connection is established again
+    if (!m_connectivityService.publish(message))
+    {
+        std::lock_guard<std::mutex> lock{m_queueMutex};
+        m_queue.push(message);
+    }
 }
 
 void FirmwareUpdateService::queueStatusMessage(const std::string& deviceKey, FirmwareUpdateStatus status,
@@ -279,17 +463,45 @@ void FirmwareUpdateService::queueStatusMessage(const std::string& deviceKey, Fir
         LOG(ERROR) << "Failed to generate outbound FirmwareUpdateStatusMessage.";
         return;
     }
+    std::lock_guard<std::mutex> lock{m_queueMutex};
     m_queue.push(message);
 }
 
-bool FirmwareUpdateService::storeSessionFile(const std::string& deviceKey, const std::string& version)
+void FirmwareUpdateService::startRolloutInstallations()
+{
+    LOG(TRACE) << METHOD_INFO;
+
+    // Until the states are loaded, the slots held by the installations from before a restart are not known to be free
+    if (m_rolloutScheduler == nullptr || !m_rolloutStarted)
+        return;
+    for (const auto& entry : m_rolloutScheduler->takeReady())
+    {
+        const auto deviceKey = entry.deviceKey;
+        const auto message = std::make_shared<FirmwareUpdateInstallMessage>(entry.file);
+        if (!m_executor->submit(deviceKey, [this, deviceKey, message] { onFirmwareInstall(deviceKey, *message); }))
+        {
+            sendStatusMessage(deviceKey, FirmwareUpdateStatus::ERROR, FirmwareUpdateError::UNKNOWN);
+            finishRolloutInstallation(deviceKey, false);
+        }
+    }
+}
+
+void FirmwareUpdateService::finishRolloutInstallation(const std::string& deviceKey, bool success)
+{
+    // Every finished installation makes room for the next ones
+    if (m_rolloutScheduler != nullptr && m_rolloutScheduler->finish(deviceKey, success))
+        startRolloutInstallations();
+}
+
+bool FirmwareUpdateService::storeSessionFile(const std::string& deviceKey, const std::string& version,
+                                             const std::string& file)
 {
-    return FileSystemUtils::createFileWithContent(m_sessionFile + "_" + deviceKey, version);
+    return m_sessionJournal.store(deviceKey, version, file);
 }
 
 void FirmwareUpdateService::deleteSessionFile(const std::string& deviceKey)
 {
-    FileSystemUtils::deleteFile(m_sessionFile + "_" + deviceKey);
+    m_sessionJournal.remove(deviceKey);
 }
 }    // namespace connect
 }    // namespace wolkabout
@@ -24,7 +24,15 @@
 #include "wolk/api/FirmwareParametersListener.h"
 #include "wolk/service/data/DataService.h"
 #include "wolk/service/file_management/FileManagementService.h"
-
+#include "wolk/service/firmware_update/FirmwareDeltaPatcher.h"
+#include "wolk/service/firmware_update/FirmwareInstallationExecutor.h"
+#include "wolk/service/firmware_update/FirmwareRolloutScheduler.h"
+#include "wolk/service/firmware_update/FirmwareSessionJournal.h"
+#include "wolk/service/firmware_update/FirmwareStateTable.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <queue>
 
 namespace wolkabout
@@ -44,6 +52,8 @@ public:
                           std::unique_ptr<FirmwareParametersListener> firmwareParametersListener,
                           FirmwareUpdateProtocol& protocol, const std::string& workingDirectory = "./");
 
+    ~FirmwareUpdateService() override;
+
     bool isInstaller() const;
 
     bool isParameterListener() const;
@@ -52,13 +62,52 @@ public:
 
     /**
      * This is the queue containing any messages the service might want to send.
+     * The installations run on the worker threads of the service, so prefer `publishQueuedMessages` which is thread
+     * safe.
      *
      * @return The reference to the queue of messages.
      */
     std::queue<std::shared_ptr<Message>>& getQueue();
 
+    /**
+     * This method is used to publish all the status messages the service has queued up while it was not able to send
+     * them.
+     */
+    virtual void publishQueuedMessages();
+
+    /**
+     * This method is used to set up a staged rollout of the installations. Instead of starting every installation as
+     * soon as it is received, only as many as the concurrency limit allows are running at once, canary devices go
+     * first, and the rollout pauses when too many of them fail. The state of the rollout is kept in the working
+     * directory, and a rollout that was interrupted by a restart continues.
+     * This needs to be called before the service receives any messages, and before `loadState`. No installation is
+     * started until `startRollout` is called.
+     *
+     * @param configuration The configuration of the rollout.
+     */
+    void setRolloutConfiguration(const RolloutConfiguration& configuration);
+
+    /**
+     * This method is used to let the rollout start installations. It should be called once the state of every device
+     * was loaded, so the installations that finished while the connector was down free their slots before new ones are
+     * started. Calling it again has no other effect than starting the installations that are ready.
+     */
+    virtual void startRollout();
+
+    /**
+     * This method is used to pause the rollout. The installations that are running are not affected.
+     */
+    virtual void pauseRollout();
+
+    /**
+     * This method is used to resume the rollout after it was paused, manually or because of failed installations.
+     */
+    virtual void resumeRollout();
+
     /**
      * This is a loadState method that should be invoked to understand what the state of firmware update is.
+     * The sessions of all the devices are loaded once, when the service is created, so this does not touch the disk
+     * for devices that have no session.
      *
      * @param deviceKey The device key for which the state should be loaded.
      */
@@ -76,6 +125,8 @@ public:
 private:
     void onFirmwareInstall(const std::string& deviceKey, const FirmwareUpdateInstallMessage& message);
 
+    void onInstallResponse(const std::string& deviceKey, InstallResponse status);
+
     void onFirmwareAbort(const std::string& deviceKey, const FirmwareUpdateAbortMessage& message);
 
     void sendStatusMessage(const std::string& deviceKey, FirmwareUpdateStatus status,
@@ -84,7 +135,11 @@ private:
     void queueStatusMessage(const std::string& deviceKey, FirmwareUpdateStatus status,
                             FirmwareUpdateError error = FirmwareUpdateError::NONE);
 
-    bool storeSessionFile(const std::string& deviceKey, const std::string& version);
+    void startRolloutInstallations();
+
+    void finishRolloutInstallation(const std::string& deviceKey, bool success);
+
+    bool storeSessionFile(const std::string& deviceKey, const std::string& version, const std::string& file = "");
 
     void deleteSessionFile(const std::string& deviceKey);
 
@@ -92,12 +147,18 @@ private:
     ConnectivityService& m_connectivityService;
     DataService& m_dataService;
     std::shared_ptr<FileManagementService> m_fileManagementService;
-    std::string m_sessionFile;
 
-    // Here we store the info if a session is ongoing
-    std::map<std::string, std::atomic_bool> m_installation;
+    // Here we store the sessions of all the devices
+    FirmwareSessionJournal m_sessionJournal;
+
+    // Here we store the state of the installation of every device
+    FirmwareStateTable m_installationStates;
+
+    // This is what rebuilds the images out of delta packages
+    FirmwareDeltaPatcher m_deltaPatcher;
 
     // Here we store messages that the service queues up to send when the connection is established
+    std::mutex m_queueMutex;
     std::queue<std::shared_ptr<Message>> m_queue;
 
     // There is one of two ways the firmware update service can be instantiated
@@ -106,6 +167,15 @@ private:
 
     // This is where the protocol will be passed while the service is created.
     FirmwareUpdateProtocol& m_protocol;
+
+    // This is where the rollout is scheduled, if it is set up
+    std::string m_rolloutFile;
+    std::unique_ptr<FirmwareRolloutScheduler> m_rolloutScheduler;
+    std::atomic_bool m_rolloutStarted;
+
+    // This is where the installations are run, so they don't block the inbound messages. It is declared last so it is
+    // stopped before anything the installations use is destroyed.
+    std::unique_ptr<FirmwareInstallationExecutor> m_executor;
 };
 }    // namespace connect
 }    // namespace wolkabout
@@ -0,0 +1,302 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wolk/service/firmware_update/debian/DebianInstallationPipeline.h"
+
+#include "core/utilities/Logger.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+namespace wolkabout
+{
+namespace connect
+{
+namespace
+{
+// A Debian package is an `ar` archive of the `debian-binary` file, with the version of the format, and then the
+// `control` and `data` tarballs. The members whose names start with an underscore may be put in between.
+const std::string ARCHIVE_MAGIC = "!<arch>\n";
+const std::string MEMBER_MAGIC = "`\n";
+const std::string VERSION_MEMBER = "debian-binary";
+const std::string VERSION_PREFIX = "2.";
+const std::string CONTROL_MEMBER = "control.tar";
+const std::string DATA_MEMBER = "data.tar";
+const std::size_t MEMBER_HEADER_SIZE = 60;
+const std::size_t MEMBER_NAME_SIZE = 16;
+const std::size_t MEMBER_SIZE_OFFSET = 48;
+const std::size_t MEMBER_SIZE_SIZE = 10;
+const std::size_t MEMBER_MAGIC_OFFSET = 58;
+const std::size_t MAXIMUM_VERSION_SIZE = 16;
+
+bool startsWith(const std::string& value, const std::string& prefix)
+{
+    return value.compare(0, prefix.size(), prefix) == 0;
+}
+
+// Reads the header of the next member, and returns its name without the padding, or an empty name if there is none
+std::string readMemberHeader(std::istream& file, std::uint64_t& size)
+{
+    auto header = std::string(MEMBER_HEADER_SIZE, '\0');
+    if (!file.read(&header[0], static_cast<std::streamsize>(header.size())) ||
+        header.compare(MEMBER_MAGIC_OFFSET, MEMBER_MAGIC.size(), MEMBER_MAGIC) != 0)
+        return {};
+    const auto sizeField = header.substr(MEMBER_SIZE_OFFSET, MEMBER_SIZE_SIZE);
+    if (sizeField.find_first_of("0123456789") != 0)
+        return {};
+    size = std::stoull(sizeField);
+    auto name = header.substr(0, MEMBER_NAME_SIZE);
+    name.erase(name.find_last_not_of(' ') + 1);
+    if (!name.empty() && name.back() == '/')
+        name.pop_back();
+    return name;
+}
+
+// Checks that the whole content of the last member is in the file
+bool isMemberComplete(std::istream& file, std::uint64_t size)
+{
+    const auto start = file.tellg();
+    if (start < 0 || !file.seekg(0, std::ios::end))
+        return false;
+    return static_cast<std::uint64_t>(file.tellg() - start) >= size;
+}
+
+// Skips over the content of a member, which is padded to an even size
+bool skipMember(std::istream& file, std::uint64_t size)
+{
+    return static_cast<bool>(file.seekg(static_cast<std::streamoff>(size + size % 2), std::ios::cur)) &&
+           file.peek() != std::char_traits<char>::eof();
+}
+}    // namespace
+
+DebianInstallationPipeline::DebianInstallationPipeline(PackageInstallFunction install, ServiceRestartFunction restart,
+                                                       std::size_t maximumBatchSize)
+: m_install(std::move(install))
+, m_restart(std::move(restart))
+, m_maximumBatchSize(std::max<std::size_t>(maximumBatchSize, 1))
+, m_running(false)
+{
+}
+
+DebianInstallationPipeline::~DebianInstallationPipeline()
+{
+    stop();
+}
+
+void DebianInstallationPipeline::start()
+{
+    LOG(TRACE) << METHOD_INFO;
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    if (m_running)
+        return;
+    m_running = true;
+    m_verificationThread = std::thread{&DebianInstallationPipeline::runVerification, this};
+    m_installationThread = std::thread{&DebianInstallationPipeline::runInstallation, this};
+}
+
+void DebianInstallationPipeline::stop()
+{
+    LOG(TRACE) << METHOD_INFO;
+
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        m_running = false;
+    }
+    m_condition.notify_all();
+    if (m_verificationThread.joinable())
+        m_verificationThread.join();
+    if (m_installationThread.joinable())
+        m_installationThread.join();
+
+    // Whatever did not get to be installed is failed, so nobody waits for it
+    auto leftover = std::deque<Package>{};
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        std::move(m_submitted.begin(), m_submitted.end(), std::back_inserter(leftover));
+        std::move(m_verified.begin(), m_verified.end(), std::back_inserter(leftover));
+        m_submitted.clear();
+        m_verified.clear();
+    }
+    for (auto& package : leftover)
+        package.callback(package.path, false, package.timings);
+}
+
+bool DebianInstallationPipeline::submit(const std::string& absolutePath, PackageInstallationCallback callback)
+{
+    LOG(TRACE) << METHOD_INFO;
+
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        if (!m_running)
+        {
+            LOG(ERROR) << "Failed to submit the package '" << absolutePath << "' -> The pipeline is not running.";
+            return false;
+        }
+        m_submitted.emplace_back(
+          Package{absolutePath, serviceNameOf(absolutePath), std::move(callback), Clock::now(), {}, false});
+    }
+    m_condition.notify_all();
+    return true;
+}
+
+bool DebianInstallationPipeline::verifyPackage(const std::string& absolutePath)
+{
+    std::ifstream file{absolutePath, std::ios::in | std::ios::binary};
+    auto magic = std::string(ARCHIVE_MAGIC.size(), '\0');
+    if (!file.read(&magic[0], static_cast<std::streamsize>(magic.size())) || magic != ARCHIVE_MAGIC)
+        return false;
+
+    // The version of the format comes first
+    auto size = std::uint64_t{0};
+    if (readMemberHeader(file, size) != VERSION_MEMBER || size > MAXIMUM_VERSION_SIZE)
+        return false;
+    auto version = std::string(static_cast<std::size_t>(size), '\0');
+    if (!file.read(&version[0], static_cast<std::streamsize>(version.size())) || !startsWith(version, VERSION_PREFIX) ||
+        version.back() != '\n')
+        return false;
+    if (size % 2 != 0)
+        file.ignore(1);
+
+    // And then the control tarball, followed by the data tarball
+    auto control = false;
+    while (true)
+    {
+        const auto name = readMemberHeader(file, size);
+        if (name.empty())
+            return false;
+        if (!control && startsWith(name, CONTROL_MEMBER))
+            control = true;
+        else if (control && startsWith(name, DATA_MEMBER))
+            return isMemberComplete(file, size);
+        else if (name.front() != '_')
+            return false;
+        if (!skipMember(file, size))
+            return false;
+    }
+}
+
+std::string DebianInstallationPipeline::serviceNameOf(const std::string& absolutePath)
+{
+    const auto fileName = absolutePath.substr(absolutePath.rfind('/') + 1);
+    return fileName.substr(0, fileName.find('_'));
+}
+
+void DebianInstallationPipeline::runVerification()
+{
+    while (true)
+    {
+        std::unique_lock<std::mutex> lock{m_mutex};
+        m_condition.wait(lock, [&] { return !m_running || !m_submitted.empty(); });
+        if (!m_running)
+            return;
+        auto package = std::move(m_submitted.front());
+        m_submitted.pop_front();
+        lock.unlock();
+
+        // Verify the package while the ones before it are being installed
+        package.timings.queued = finishStep(package);
+        const auto valid = verifyPackage(package.path);
+        package.timings.verification = finishStep(package);
+        if (!valid)
+        {
+            LOG(ERROR) << "Failed to verify the package '" << package.path << "' -> It is not a Debian package.";
+            package.callback(package.path, false, package.timings);
+            continue;
+        }
+
+        lock.lock();
+        m_verified.emplace_back(std::move(package));
+        lock.unlock();
+        m_condition.notify_all();
+    }
+}
+
+void DebianInstallationPipeline::runInstallation()
+{
+    while (true)
+    {
+        std::unique_lock<std::mutex> lock{m_mutex};
+        m_condition.wait(lock, [&] { return !m_running || !m_verified.empty(); });
+        if (!m_running)
+            return;
+
+        // Take everything that is verified by now as one batch
+        auto batch = std::deque<Package>{};
+        while (!m_verified.empty() && batch.size() < m_maximumBatchSize)
+        {
+            batch.emplace_back(std::move(m_verified.front()));
+            m_verified.pop_front();
+        }
+        lock.unlock();
+        installBatch(batch);
+    }
+}
+
+void DebianInstallationPipeline::installBatch(std::deque<Package>& batch)
+{
+    LOG(DEBUG) << "Installing a batch of " << batch.size() << " package(s).";
+
+    // Install the packages in the order they were submitted
+    auto services = std::vector<std::string>{};
+    for (auto& package : batch)
+    {
+        package.timings.staged = finishStep(package);
+        package.success = m_install(package.path);
+        package.timings.installation = finishStep(package);
+        if (package.success && std::find(services.cbegin(), services.cend(), package.service) == services.cend())
+            services.emplace_back(package.service);
+    }
+
+    // And restart every service only once, after its last package
+    for (const auto& service : services)
+    {
+        const auto restartStart = Clock::now();
+        const auto restarted = m_restart(service);
+        const auto restartEnd = Clock::now();
+        for (auto& package : batch)
+        {
+            if (package.service != service || !package.success)
+                continue;
+            package.success = restarted;
+            package.timings.restart = std::chrono::duration_cast<std::chrono::milliseconds>(restartEnd - restartStart);
+            package.lastStep = restartEnd;
+        }
+    }
+
+    for (const auto& package : batch)
+    {
+        LOG(INFO) << "Package '" << package.path << "' " << (package.success ? "installed" : "failed") << " -> queued "
+                  << package.timings.queued.count() << "ms, verification " << package.timings.verification.count()
+                  << "ms, staged " << package.timings.staged.count() << "ms, installation "
+                  << package.timings.installation.count() << "ms, restart " << package.timings.restart.count() << "ms.";
+        package.callback(package.path, package.success, package.timings);
+    }
+}
+
+std::chrono::milliseconds DebianInstallationPipeline::finishStep(Package& package)
+{
+    const auto now = Clock::now();
+    const auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(now - package.lastStep);
+    package.lastStep = now;
+    return duration;
+}
+}    // namespace connect
+}    // namespace wolkabout
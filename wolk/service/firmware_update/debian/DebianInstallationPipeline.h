@@ -0,0 +1,159 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WOLKABOUTCONNECTOR_DEBIANINSTALLATIONPIPELINE_H
+#define WOLKABOUTCONNECTOR_DEBIANINSTALLATIONPIPELINE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace wolkabout
+{
+namespace connect
+{
+/**
+ * This structure holds how long a package spent in every step of the pipeline.
+ */
+struct PackageInstallationTimings
+{
+    // Waiting for the verification, and the verification itself
+    std::chrono::milliseconds queued{0};
+    std::chrono::milliseconds verification{0};
+
+    // Waiting verified for the installation, and the installation itself
+    std::chrono::milliseconds staged{0};
+    std::chrono::milliseconds installation{0};
+
+    // The restart of the service, which is shared by all the packages of the service in a batch
+    std::chrono::milliseconds restart{0};
+};
+
+// This is the function that installs a package, and returns once it is installed, with whether it was successful
+using PackageInstallFunction = std::function<bool(const std::string&)>;
+
+// This is the function that restarts a service, with whether it was successful
+using ServiceRestartFunction = std::function<bool(const std::string&)>;
+
+// This is the callback that reports the outcome of a package
+using PackageInstallationCallback = std::function<void(const std::string&, bool, const PackageInstallationTimings&)>;
+
+/**
+ * This is the class that takes Debian packages from submission to a restarted service in steps that overlap.
+ *
+ * A package is first verified on one thread, while the packages verified before it are installed on another. Once the
+ * installing thread is free, it takes all the verified packages as a batch, installs them one after another, and then
+ * restarts every service that got a new package once, so the services of a batch are only restarted once no matter how
+ * many packages they received.
+ */
+class DebianInstallationPipeline
+{
+public:
+    /**
+     * Default parameter constructor.
+     *
+     * @param install The function that installs a package.
+     * @param restart The function that restarts a service.
+     * @param maximumBatchSize The largest number of packages installed before the services are restarted.
+     */
+    DebianInstallationPipeline(PackageInstallFunction install, ServiceRestartFunction restart,
+                               std::size_t maximumBatchSize = 8);
+
+    /**
+     * Default destructor. Stops the pipeline.
+     */
+    ~DebianInstallationPipeline();
+
+    /**
+     * This method is used to start the threads of the pipeline.
+     */
+    void start();
+
+    /**
+     * This method is used to stop the threads of the pipeline. All the packages that were not installed yet are
+     * reported as failed.
+     */
+    void stop();
+
+    /**
+     * This method is used to submit a package to the pipeline.
+     *
+     * @param absolutePath The absolute path to the package.
+     * @param callback The callback that will be called with the outcome of the package.
+     * @return Whether the package was submitted. If not, the callback will never be called.
+     */
+    bool submit(const std::string& absolutePath, PackageInstallationCallback callback);
+
+    /**
+     * This method is used to check that a file is laid out as a Debian package. The file has to be an `ar` archive
+     * with the `debian-binary` member announcing the version 2 of the format, followed by the `control` and the whole
+     * `data` member. The content of the tarballs is left for APT to check.
+     *
+     * @param absolutePath The path to the file.
+     * @return Whether the file is a Debian package.
+     */
+    static bool verifyPackage(const std::string& absolutePath);
+
+    /**
+     * This method is used to obtain the name of the service a package is for, which is the first part of its name.
+     *
+     * @param absolutePath The path to the package.
+     * @return The name of the service.
+     */
+    static std::string serviceNameOf(const std::string& absolutePath);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Package
+    {
+        std::string path;
+        std::string service;
+        PackageInstallationCallback callback;
+        Clock::time_point lastStep;
+        PackageInstallationTimings timings;
+        bool success;
+    };
+
+    void runVerification();
+
+    void runInstallation();
+
+    void installBatch(std::deque<Package>& batch);
+
+    static std::chrono::milliseconds finishStep(Package& package);
+
+    PackageInstallFunction m_install;
+    ServiceRestartFunction m_restart;
+    std::size_t m_maximumBatchSize;
+
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_running;
+    std::deque<Package> m_submitted;
+    std::deque<Package> m_verified;
+
+    std::thread m_verificationThread;
+    std::thread m_installationThread;
+};
+}    // namespace connect
+}    // namespace wolkabout
+
+#endif    // WOLKABOUTCONNECTOR_DEBIANINSTALLATIONPIPELINE_H
@@ -19,12 +19,18 @@
 #include "core/utilities/FileSystemUtils.h"
 #include "core/utilities/Logger.h"
 
+#include <future>
 #include <utility>
 
 namespace wolkabout
 {
 namespace connect
 {
+// The time a single package is given to be installed by APT
+const std::chrono::seconds PACKAGE_INSTALLATION_TIMEOUT{120};
+// The time a service is given to come back up after a restart, same as the systemd default start timeout
+const std::chrono::seconds SERVICE_RESTART_TIMEOUT{90};
+
 DebianPackageInstaller::DebianPackageInstaller(std::string serviceName,
                                                std::unique_ptr<APTPackageInstaller> aptPackageInstaller,
                                                std::unique_ptr<SystemdServiceInterface> systemdServiceInterface)
@@ -32,33 +38,39 @@ DebianPackageInstaller::DebianPackageInstaller(std::string serviceName,
 , m_aptPackageInstaller{std::move(aptPackageInstaller)}
 , m_systemdServiceInterface{std::move(systemdServiceInterface)}
 {
+    // The pipeline holds the modules themselves, as they stay the same when this object is moved
+    auto aptPackageInstallerPtr = m_aptPackageInstaller.get();
+    auto systemdServiceInterfacePtr = m_systemdServiceInterface.get();
+    m_pipeline = std::unique_ptr<DebianInstallationPipeline>{new DebianInstallationPipeline{
+      [aptPackageInstallerPtr](const std::string& absolutePath) {
+          auto promise = std::make_shared<std::promise<bool>>();
+          auto future = promise->get_future();
+          if (aptPackageInstallerPtr->installPackage(absolutePath, [promise](const std::string&,
+                                                                             InstallationResult result) {
+                  promise->set_value(result == InstallationResult::Installed);
+              }) != InstallationResult::Installing)
+              return false;
+          return future.wait_for(PACKAGE_INSTALLATION_TIMEOUT) == std::future_status::ready && future.get();
+      },
+      [systemdServiceInterfacePtr](const std::string& serviceName) {
+          const auto objectName = systemdServiceInterfacePtr->obtainObjectNameForService(serviceName);
+          if (objectName.empty())
+              return false;
+          return systemdServiceInterfacePtr->restartServiceAndWait(objectName, SERVICE_RESTART_TIMEOUT) ==
+                 ServiceRestartResult::Successful;
+      }}};
 }
 
 DebianPackageInstaller::DebianPackageInstaller(DebianPackageInstaller&& instance) noexcept
 : m_serviceName{instance.m_serviceName}
 , m_aptPackageInstaller{std::move(instance.m_aptPackageInstaller)}
 , m_systemdServiceInterface{std::move(instance.m_systemdServiceInterface)}
+, m_pipeline{std::move(instance.m_pipeline)}
 {
 }
 
 DebianPackageInstaller::~DebianPackageInstaller()
 {
-    std::lock_guard<std::mutex> lockGuard{m_mapMutex};
-    for (const auto& pair : m_deviceInstallationResult)
-    {
-        if (pair.second != InstallResponse::WILL_INSTALL)
-        {
-            const auto fileIt = m_devicesInstallingFiles.find(pair.first);
-            if (fileIt != m_devicesInstallingFiles.cend())
-            {
-                const auto conditionVariableIt = m_conditionVariables.find(fileIt->second);
-                if (conditionVariableIt != m_conditionVariables.cend())
-                {
-                    conditionVariableIt->second->notify_one();
-                }
-            }
-        }
-    }
     stop();
 }
 
@@ -66,100 +78,132 @@ void DebianPackageInstaller::start()
 {
     m_aptPackageInstaller->start();
     m_systemdServiceInterface->start();
+    m_pipeline->start();
 }
 
 void DebianPackageInstaller::stop()
 {
-    m_aptPackageInstaller->stop();
-    m_systemdServiceInterface->stop();
+    // The installations are reported before the pipeline is stopped, as it would report them as failed, while the
+    // packages that are already with APT might still get installed
+    auto pending = std::map<std::string, std::shared_ptr<InstallResponseCallback>>{};
+    {
+        std::lock_guard<std::mutex> lock{m_mapMutex};
+        std::swap(pending, m_pendingInstallations);
+    }
+    for (const auto& pair : pending)
+        (*pair.second)(InstallResponse::WILL_INSTALL);
+
+    // A moved-from instance has nothing left to stop
+    if (m_pipeline != nullptr)
+        m_pipeline->stop();
+    if (m_aptPackageInstaller != nullptr)
+        m_aptPackageInstaller->stop();
+    if (m_systemdServiceInterface != nullptr)
+        m_systemdServiceInterface->stop();
 }
 
 bool DebianPackageInstaller::update(const std::string& pathToDebianFile, UpdateCallback callback)
 {
     LOG(TRACE) << METHOD_INFO;
 
-    // Define the callback that will be used once the APT package has been installed
-    auto serviceName = pathToDebianFile.substr(pathToDebianFile.rfind('/') + 1);
-    serviceName = serviceName.substr(0, serviceName.find('_'));
-    const auto internalCallback = InstallationCallback{[=](const std::string&, InstallationResult result) {
-        if (result == InstallationResult::Installed)
-        {
-            callback(pathToDebianFile,
-                     m_systemdServiceInterface->restartService(serviceName) == ServiceRestartResult::Successful);
-            return;
-        }
-        callback(pathToDebianFile, false);
-    }};
-
-    // Attempt to install the package with APT
-    return m_aptPackageInstaller->installPackage(pathToDebianFile, internalCallback) == InstallationResult::Installing;
+    // The pipeline verifies the package, installs it with APT, and restarts the service
+    return m_pipeline->submit(pathToDebianFile,
+                              [callback](const std::string& path, bool success, const PackageInstallationTimings&) {
+                                  callback(path, success);
+                              });
 }
 
 InstallResponse DebianPackageInstaller::installFirmware(const std::string& deviceKey, const std::string& fileName)
 {
-    // We should do this synchronously. Prepare things to be set.
-    auto conditionVariable = std::make_shared<std::condition_variable>();
-    auto mutex = std::make_shared<std::mutex>();
-    {
-        std::lock_guard<std::mutex> lockGuard{m_mapMutex};
-        m_devicesInstallingFiles[deviceKey] = fileName;
-        m_deviceInstallationResult[deviceKey] = InstallResponse::WILL_INSTALL;
-        m_conditionVariables[fileName] = conditionVariable;
-    }
+    LOG(TRACE) << METHOD_INFO;
 
-    // Run the update
-    const auto mutexWeakPtr = std::weak_ptr<std::mutex>{mutex};
-    auto installing = update(FileSystemUtils::absolutePath(fileName), [this, deviceKey, fileName, mutexWeakPtr](
-                                                                        const std::string&, bool installation) {
-        if (auto mutexValue = mutexWeakPtr.lock())
-        {
-            std::lock_guard<std::mutex> lockGuard{*mutexValue};
-            std::lock_guard<std::mutex> lockGuardMap{m_mapMutex};
-            auto result = m_deviceInstallationResult.find(deviceKey);
-            if (result != m_deviceInstallationResult.cend())
-                result->second = installation ? InstallResponse::INSTALLED : InstallResponse::FAILED_TO_INSTALL;
-        }
-        const auto cvIt = m_conditionVariables.find(fileName);
-        if (cvIt != m_conditionVariables.cend())
-            cvIt->second->notify_one();
-    });
-
-    // Wait for the installation to be done
-    if (installing)
-    {
-        std::unique_lock<std::mutex> lock{*mutex};
-        conditionVariable->wait_for(lock, std::chrono::seconds{120});
-    }
-    else
-    {
-        m_deviceInstallationResult[deviceKey] = InstallResponse::FAILED_TO_INSTALL;
-    }
-    // Remove the values from the maps
+    // This does not need a timeout of its own, as every step of the pipeline is bounded. The timeout of the
+    // installation starts when the package gets to APT, not when it is submitted, so the time spent waiting behind
+    // other packages does not count against it.
+    auto promise = std::make_shared<std::promise<InstallResponse>>();
+    auto future = promise->get_future();
+    installFirmwareAsync(deviceKey, fileName, [promise](InstallResponse response) { promise->set_value(response); });
+    return future.get();
+}
+
+void DebianPackageInstaller::installFirmwareAsync(const std::string& deviceKey, const std::string& fileName,
+                                                  InstallResponseCallback callback)
+{
+    LOG(TRACE) << METHOD_INFO;
+
+    // Only the latest installation of a device is reported by the pipeline, an older one finishes after the restart
+    auto pending = std::make_shared<InstallResponseCallback>(std::move(callback));
+    auto replaced = std::shared_ptr<InstallResponseCallback>{};
     {
         std::lock_guard<std::mutex> lock{m_mapMutex};
-        m_devicesInstallingFiles.erase(deviceKey);
-        m_conditionVariables.erase(fileName);
-        return m_deviceInstallationResult[deviceKey];
+        auto& slot = m_pendingInstallations[deviceKey];
+        replaced = std::move(slot);
+        slot = pending;
     }
+    if (replaced != nullptr)
+        (*replaced)(InstallResponse::WILL_INSTALL);
+
+    // The callback is taken out of the map by whoever reports first, so it is called only once
+    const auto submitted = update(FileSystemUtils::absolutePath(fileName),
+                                  [this, deviceKey, pending](const std::string&, bool installation) {
+                                      if (takePendingInstallation(deviceKey, pending))
+                                          (*pending)(installation ? InstallResponse::INSTALLED :
+                                                                    InstallResponse::FAILED_TO_INSTALL);
+                                  });
+    if (!submitted && takePendingInstallation(deviceKey, pending))
+        (*pending)(InstallResponse::FAILED_TO_INSTALL);
 }
 
 void DebianPackageInstaller::abortFirmwareInstall(const std::string& deviceKey)
 {
-    // Check if there is a condition variable waiting for the device
-    std::lock_guard<std::mutex> lock{m_mapMutex};
-    const auto deviceIt = m_devicesInstallingFiles.find(deviceKey);
-    if (deviceIt != m_devicesInstallingFiles.cend())
+    LOG(TRACE) << METHOD_INFO;
+
+    // The package can not be taken back from APT, so its outcome is checked after the restart
+    auto pending = std::shared_ptr<InstallResponseCallback>{};
     {
-        const auto cvIt = m_conditionVariables.find(deviceIt->second);
-        if (cvIt != m_conditionVariables.cend())
-        {
-            cvIt->second->notify_one();
-        }
+        std::lock_guard<std::mutex> lock{m_mapMutex};
+        const auto it = m_pendingInstallations.find(deviceKey);
+        if (it == m_pendingInstallations.cend())
+            return;
+        pending = it->second;
+        m_pendingInstallations.erase(it);
     }
+    (*pending)(InstallResponse::WILL_INSTALL);
+}
+
+bool DebianPackageInstaller::wasFirmwareInstallSuccessful(const std::string& deviceKey, const std::string& oldVersion)
+{
+    return wasFileInstallSuccessful(deviceKey, oldVersion, "");
 }
 
-bool DebianPackageInstaller::wasFirmwareInstallSuccessful(const std::string&, const std::string&)
+bool DebianPackageInstaller::wasFileInstallSuccessful(const std::string&, const std::string&,
+                                                      const std::string& fileName)
 {
+    LOG(TRACE) << METHOD_INFO;
+
+    // The service to check is the one of the installed package, the same one the pipeline restarted. Without the file,
+    // only the managed service is known.
+    const auto serviceName = fileName.empty() ? m_serviceName : DebianInstallationPipeline::serviceNameOf(fileName);
+
+    // If the service is not managed by systemd, there is nothing that can tell that it has failed
+    const auto objectName = m_systemdServiceInterface->obtainObjectNameForService(serviceName);
+    if (objectName.empty())
+        return true;
+
+    // The state is kept up to date by the signals of the service, so this does not wait on systemd
+    const auto state = m_systemdServiceInterface->getServiceState(objectName);
+    LOG(DEBUG) << "Service '" << serviceName << "' is '" << toString(state) << "' after the installation.";
+    return state != UnitActiveState::Failed;
+}
+
+bool DebianPackageInstaller::takePendingInstallation(const std::string& deviceKey,
+                                                     const std::shared_ptr<InstallResponseCallback>& pending)
+{
+    std::lock_guard<std::mutex> lock{m_mapMutex};
+    const auto it = m_pendingInstallations.find(deviceKey);
+    if (it == m_pendingInstallations.cend() || it->second != pending)
+        return false;
+    m_pendingInstallations.erase(it);
     return true;
 }
 
@@ -19,9 +19,14 @@
 
 #include "core/utilities/Service.h"
 #include "wolk/api/FirmwareInstaller.h"
+#include "wolk/service/firmware_update/debian/DebianInstallationPipeline.h"
 #include "wolk/service/firmware_update/debian/apt/APTPackageInstaller.h"
 #include "wolk/service/firmware_update/debian/systemd/SystemdServiceInterface.h"
 
+#include <map>
+#include <memory>
+#include <mutex>
+
 namespace wolkabout
 {
 namespace connect
@@ -66,13 +71,16 @@ public:
 
     /**
      * The overridden method from the `wolkabout::Service` interface.
-     * Will stop the underlying services.
+     * Will stop the underlying services. The installations that were not reported yet are reported as ones that will
+     * finish later, so their outcome is checked once the connector is back.
      */
     void stop() override;
 
     /**
      * This is the method that is used to update the package and restart it.
-     * The service that will be restarted is the first part of the name of the debian file.
+     * The service that will be restarted is the first part of the name of the debian file. The package is verified
+     * while the packages submitted before it are installed, and the packages that are ready at the same time are
+     * installed as a batch that restarts each service only once.
      *
      * @param pathToDebianFile The path to the file that needs to be installed.
      * @param callback The callback which will be called once the package is successfully installed and the service
@@ -83,7 +91,7 @@ public:
 
     /**
      * This is the overridden method from the `wolkabout::connect::FirmwareInstaller` interface.
-     * This is the method that is invoked once an installation is triggered by the platform.
+     * This is the method that installs the file and waits for the outcome.
      *
      * @param deviceKey The device for which the installation is supposed to happen.
      * @param fileName The name/path for the file that is supposed to be installed.
@@ -93,7 +101,21 @@ public:
 
     /**
      * This is the overridden method from the `wolkabout::connect::FirmwareInstaller` interface.
-     * This is the method that is invoked once an abort is triggered by the platform.
+     * This is the method that is invoked once an installation is triggered by the platform. It only submits the file
+     * to the pipeline, so the packages of many devices can be verified and batched together, and the callback is
+     * called once the package is installed and the service restarted.
+     *
+     * @param deviceKey The device for which the installation is supposed to happen.
+     * @param fileName The name/path for the file that is supposed to be installed.
+     * @param callback The callback that receives the response for the installation of the file.
+     */
+    void installFirmwareAsync(const std::string& deviceKey, const std::string& fileName,
+                              InstallResponseCallback callback) override;
+
+    /**
+     * This is the overridden method from the `wolkabout::connect::FirmwareInstaller` interface.
+     * This is the method that is invoked once an abort is triggered by the platform. A package can not be taken back
+     * from APT, so the installation is reported as one that will finish later.
      *
      * @param deviceKey The device for which the abort is sent.
      */
@@ -109,6 +131,19 @@ public:
      */
     bool wasFirmwareInstallSuccessful(const std::string& deviceKey, const std::string& oldVersion) override;
 
+    /**
+     * This is the overridden method from the `wolkabout::connect::FirmwareInstaller` interface.
+     * This is the method that is used to check the firmware update status of a specific package. The service that is
+     * checked is the one the package is for, which is the first part of the name of the file.
+     *
+     * @param deviceKey The device for which the version is sent.
+     * @param oldVersion The old version of software that was installed.
+     * @param fileName The path of the package that was installed.
+     * @return Whether the install was successful.
+     */
+    bool wasFileInstallSuccessful(const std::string& deviceKey, const std::string& oldVersion,
+                                  const std::string& fileName) override;
+
     /**
      * This is the overridden method from the `wolkabout::connect::FirmwareInstaller` interface.
      * This is the method that can return the current firmware version.
@@ -119,6 +154,8 @@ public:
     std::string getFirmwareVersion(const std::string& deviceKey) override;
 
 protected:
+    bool takePendingInstallation(const std::string& deviceKey, const std::shared_ptr<InstallResponseCallback>& pending);
+
     // The logger tag
     const std::string TAG = "[DebianPackageInstallation] -> ";
 
@@ -129,15 +166,12 @@ protected:
     std::unique_ptr<APTPackageInstaller> m_aptPackageInstaller;
     std::unique_ptr<SystemdServiceInterface> m_systemdServiceInterface;
 
-    // Here we store the callbacks
-    std::unordered_map<std::string, UpdateCallback> m_callbacks;
+    // And the pipeline that takes the packages through them
+    std::unique_ptr<DebianInstallationPipeline> m_pipeline;
 
-    // And the command buffer where to execute the callbacks
-    CommandBuffer m_commandBuffer;
+    // Here we store the callbacks of the installations that are not reported yet
     std::mutex m_mapMutex;
-    std::map<std::string, std::string> m_devicesInstallingFiles;
-    std::map<std::string, InstallResponse> m_deviceInstallationResult;
-    std::map<std::string, std::shared_ptr<std::condition_variable>> m_conditionVariables;
+    std::map<std::string, std::shared_ptr<InstallResponseCallback>> m_pendingInstallations;
 };
 }    // namespace connect
 }    // namespace wolkabout
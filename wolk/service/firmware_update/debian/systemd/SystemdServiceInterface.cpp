@@ -27,6 +27,10 @@ const std::string SYSTEMD_MANAGER_OBJECT = "/org/freedesktop/systemd1";
 const std::string SYSTEMD_MANAGER_INTERFACE = "org.freedesktop.systemd1.Manager";
 const std::string SYSTEMD_UNIT_INTERFACE = "org.freedesktop.systemd1.Unit";
 const std::string SYSTEMD_LOAD_UNIT_METHOD = "LoadUnit";
+const std::string SYSTEMD_SUBSCRIBE_METHOD = "Subscribe";
+const std::string SYSTEMD_ACTIVE_STATE_PROPERTY = "ActiveState";
+const std::string PROPERTIES_INTERFACE = "org.freedesktop.DBus.Properties";
+const std::string PROPERTIES_CHANGED_SIGNAL = "PropertiesChanged";
 
 SystemdServiceInterface::~SystemdServiceInterface()
 {
@@ -44,15 +48,43 @@ void SystemdServiceInterface::start()
         LOG(ERROR) << TAG << "Failed to connect to DBUS/SYSTEM_BUS.";
         return;
     }
+
+    // systemd sends out the signals of the units only to the clients that have subscribed
+    try
+    {
+        const auto value = m_dbusConnection.callMethod(SYSTEMD_NAMESPACE, SYSTEMD_MANAGER_OBJECT,
+                                                       SYSTEMD_MANAGER_INTERFACE, SYSTEMD_SUBSCRIBE_METHOD, nullptr);
+        if (value != nullptr)
+            g_variant_unref(value);
+    }
+    catch (const std::exception& exception)
+    {
+        LOG(WARN) << TAG << "Failed to subscribe to systemd signals: '" << exception.what()
+                  << "'. The service states will be requested.";
+    }
+
+    // Start the main loop
+    m_thread = std::thread{&SystemdServiceInterface::runMainLoop, this};
 }
 
 void SystemdServiceInterface::stop()
 {
     LOG(TRACE) << METHOD_INFO;
 
+    // Forget the watched services
+    {
+        std::lock_guard<std::mutex> lockGuard{m_watchedServicesMutex};
+        for (const auto& service : m_watchedServices)
+            m_dbusConnection.unsubscribeFromSignal(service.second);
+        m_watchedServices.clear();
+    }
+
     // Disconnect
     std::lock_guard<std::mutex> lockGuard{m_connectionMutex};
     m_dbusConnection.disconnect();
+    m_dbusConnection.stopLoop();
+    if (m_thread.joinable())
+        m_thread.join();
 }
 
 ServiceRestartResult SystemdServiceInterface::restartService(const std::string& serviceObjectName)
@@ -106,5 +138,119 @@ std::string SystemdServiceInterface::obtainObjectNameForService(std::string serv
         return {};
     }
 }
+
+ServiceRestartResult SystemdServiceInterface::restartServiceAndWait(const std::string& serviceObjectName,
+                                                                    std::chrono::milliseconds timeout)
+{
+    LOG(TRACE) << METHOD_INFO;
+
+    // Only the states that arrive after the restart request say something about the restart
+    watchService(serviceObjectName);
+    const auto generation = m_serviceStates.getGeneration(serviceObjectName);
+    const auto result = restartService(serviceObjectName);
+    if (result != ServiceRestartResult::Successful)
+        return result;
+
+    // Wait for the signals to show the service going down and coming back up, and ask systemd only if none arrived
+    auto state = UnitActiveState::Unknown;
+    auto restarted = m_serviceStates.waitUntilRestarted(serviceObjectName, generation, timeout, state);
+    if (m_serviceStates.getGeneration(serviceObjectName) == generation)
+    {
+        state = requestServiceState(serviceObjectName);
+        m_serviceStates.update(serviceObjectName, state);
+        restarted = true;
+    }
+    if (!restarted || state != UnitActiveState::Active)
+    {
+        LOG(ERROR) << TAG << "Failed to restart the service '" << serviceObjectName << "' -> The service is '"
+                   << toString(state) << (restarted ? "'." : "' and has not gone through a restart in time.");
+        return ServiceRestartResult::FailedToStart;
+    }
+    return ServiceRestartResult::Successful;
+}
+
+bool SystemdServiceInterface::watchService(const std::string& serviceObjectName)
+{
+    LOG(TRACE) << METHOD_INFO;
+
+    std::lock_guard<std::mutex> lockGuard{m_watchedServicesMutex};
+    if (m_watchedServices.find(serviceObjectName) != m_watchedServices.cend())
+        return true;
+
+    // Subscribe first, so no change can happen between the request and the subscription
+    const auto subscription = m_dbusConnection.subscribeToSignal(
+      SYSTEMD_NAMESPACE, serviceObjectName, PROPERTIES_INTERFACE, PROPERTIES_CHANGED_SIGNAL,
+      [this](const std::string&, const std::string& objectPath, const std::string&, const std::string&,
+             GVariant* value) { handlePropertiesChanged(objectPath, value); });
+    if (subscription == 0)
+    {
+        LOG(ERROR) << TAG << "Failed to watch the service '" << serviceObjectName << "' -> Failed to subscribe to the '"
+                   << PROPERTIES_CHANGED_SIGNAL << "' signal.";
+        return false;
+    }
+    m_watchedServices.emplace(serviceObjectName, subscription);
+    if (m_serviceStates.getGeneration(serviceObjectName) == 0)
+        m_serviceStates.update(serviceObjectName, requestServiceState(serviceObjectName));
+    return true;
+}
+
+UnitActiveState SystemdServiceInterface::getServiceState(const std::string& serviceObjectName)
+{
+    LOG(TRACE) << METHOD_INFO;
+
+    if (!watchService(serviceObjectName))
+        return requestServiceState(serviceObjectName);
+    return m_serviceStates.get(serviceObjectName);
+}
+
+void SystemdServiceInterface::runMainLoop()
+{
+    LOG(TRACE) << METHOD_INFO;
+
+    m_dbusConnection.startLoop();
+}
+
+UnitActiveState SystemdServiceInterface::requestServiceState(const std::string& serviceObjectName)
+{
+    LOG(TRACE) << METHOD_INFO;
+
+    // The property is returned wrapped in a variant
+    const auto value = m_dbusConnection.getProperty(SYSTEMD_NAMESPACE, serviceObjectName, SYSTEMD_UNIT_INTERFACE,
+                                                    SYSTEMD_ACTIVE_STATE_PROPERTY);
+    if (value == nullptr)
+        return UnitActiveState::Unknown;
+    GVariant* property = nullptr;
+    g_variant_get(value, "(v)", &property);
+    const auto state = unitActiveStateFromString(g_variant_get_string(property, nullptr));
+    g_variant_unref(property);
+    g_variant_unref(value);
+    return state;
+}
+
+void SystemdServiceInterface::handlePropertiesChanged(const std::string& serviceObjectName, GVariant* value)
+{
+    LOG(TRACE) << METHOD_INFO;
+
+    // The signal carries the interface name, the changed properties, and the invalidated property names
+    const gchar* interfaceName = nullptr;
+    GVariantIter* changedProperties = nullptr;
+    GVariantIter* invalidatedProperties = nullptr;
+    g_variant_get(value, "(&sa{sv}as)", &interfaceName, &changedProperties, &invalidatedProperties);
+    if (SYSTEMD_UNIT_INTERFACE == interfaceName)
+    {
+        const gchar* propertyName = nullptr;
+        GVariant* property = nullptr;
+        while (g_variant_iter_loop(changedProperties, "{&sv}", &propertyName, &property))
+        {
+            if (SYSTEMD_ACTIVE_STATE_PROPERTY != propertyName)
+                continue;
+            const auto state = unitActiveStateFromString(g_variant_get_string(property, nullptr));
+            LOG(DEBUG) << TAG << "Service '" << serviceObjectName << "' is now '" << toString(state) << "'.";
+            m_serviceStates.update(serviceObjectName, state);
+        }
+    }
+    g_variant_iter_free(changedProperties);
+    g_variant_iter_free(invalidatedProperties);
+}
 }    // namespace connect
 }    // namespace wolkabout
@@ -19,8 +19,12 @@
 
 #include "core/utilities/Service.h"
 #include "wolk/service/firmware_update/debian/GenericDBusInterface.h"
+#include "wolk/service/firmware_update/debian/systemd/SystemdUnitStateTable.h"
 
+#include <chrono>
+#include <map>
 #include <string>
+#include <thread>
 
 namespace wolkabout
 {
@@ -33,6 +37,7 @@ enum class ServiceRestartResult
 {
     FailedToFindToDBus,
     FailedToFindService,
+    FailedToStart,
     Successful
 };
 
@@ -58,7 +63,7 @@ public:
 
     /**
      * Overridden method from the `wolkabout::Service` interface.
-     * This will establish the DBus connection.
+     * This will establish the DBus connection, and start receiving the signals of the watched services.
      */
     void start() override;
 
@@ -85,13 +90,71 @@ public:
      */
     virtual std::string obtainObjectNameForService(std::string serviceName);
 
+    /**
+     * This is the method that allows the user to restart a service, and wait for the service to come back up. The state
+     * of the service is pushed by its `PropertiesChanged` signals, and is only queried if no signal arrives in time.
+     * The service only counts as restarted once it has left the `active` state after the request, and come back to it.
+     *
+     * @param serviceObjectName The name of an service unit object.
+     * @param timeout The longest time the service is given to become active.
+     * @return Whether the service has been restarted. It is `FailedToStart` if the service has failed, or did not go
+     * down and become active again in time.
+     */
+    virtual ServiceRestartResult restartServiceAndWait(const std::string& serviceObjectName,
+                                                       std::chrono::milliseconds timeout);
+
+    /**
+     * This is the method that allows the user to watch the state of a service. Once watched, the state of the service
+     * is kept up to date by its `PropertiesChanged` signals.
+     *
+     * @param serviceObjectName The name of an service unit object.
+     * @return Whether the service is being watched.
+     */
+    virtual bool watchService(const std::string& serviceObjectName);
+
+    /**
+     * This is the method that allows the user to obtain the state of a service. The service will be watched, so only
+     * the first call for a service makes a request to systemd.
+     *
+     * @param serviceObjectName The name of an service unit object.
+     * @return The state of the service.
+     */
+    virtual UnitActiveState getServiceState(const std::string& serviceObjectName);
+
 protected:
+    /**
+     * This is an internal method that is used to run the main loop that receives the signals.
+     */
+    void runMainLoop();
+
+    /**
+     * This is an internal method that is used to request the state of a service from systemd.
+     *
+     * @param serviceObjectName The name of an service unit object.
+     * @return The state of the service. `Unknown` if the request has failed.
+     */
+    UnitActiveState requestServiceState(const std::string& serviceObjectName);
+
+    /**
+     * This is an internal method that is used to record the new state from a `PropertiesChanged` signal of a service.
+     *
+     * @param serviceObjectName The name of an service unit object.
+     * @param value The signal parameters.
+     */
+    void handlePropertiesChanged(const std::string& serviceObjectName, GVariant* value);
+
     // The logger tag
     const std::string TAG = "[SystemdServiceInterface] -> ";
 
     // Here we store the DBus connection
     std::mutex m_connectionMutex;
     GenericDBusInterface m_dbusConnection;
+    std::thread m_thread;
+
+    // Here we store the subscriptions of the watched services, and their last known state
+    std::mutex m_watchedServicesMutex;
+    std::map<std::string, std::uint32_t> m_watchedServices;
+    SystemdUnitStateTable m_serviceStates;
 };
 }    // namespace connect
 }    // namespace wolkabout
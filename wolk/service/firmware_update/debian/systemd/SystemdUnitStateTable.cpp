@@ -0,0 +1,119 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wolk/service/firmware_update/debian/systemd/SystemdUnitStateTable.h"
+
+namespace wolkabout
+{
+namespace connect
+{
+std::string toString(UnitActiveState state)
+{
+    switch (state)
+    {
+    case UnitActiveState::Active:
+        return "active";
+    case UnitActiveState::Reloading:
+        return "reloading";
+    case UnitActiveState::Inactive:
+        return "inactive";
+    case UnitActiveState::Failed:
+        return "failed";
+    case UnitActiveState::Activating:
+        return "activating";
+    case UnitActiveState::Deactivating:
+        return "deactivating";
+    default:
+        return "unknown";
+    }
+}
+
+UnitActiveState unitActiveStateFromString(const std::string& state)
+{
+    if (state == "active")
+        return UnitActiveState::Active;
+    else if (state == "reloading")
+        return UnitActiveState::Reloading;
+    else if (state == "inactive")
+        return UnitActiveState::Inactive;
+    else if (state == "failed")
+        return UnitActiveState::Failed;
+    else if (state == "activating")
+        return UnitActiveState::Activating;
+    else if (state == "deactivating")
+        return UnitActiveState::Deactivating;
+    return UnitActiveState::Unknown;
+}
+
+void SystemdUnitStateTable::update(const std::string& unit, UnitActiveState state)
+{
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        auto& unitState = m_units[unit];
+        unitState.state = state;
+        ++unitState.generation;
+        if (state != UnitActiveState::Active)
+            unitState.inactiveGeneration = unitState.generation;
+    }
+    m_condition.notify_all();
+}
+
+UnitActiveState SystemdUnitStateTable::get(const std::string& unit) const
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    const auto it = m_units.find(unit);
+    return it != m_units.cend() ? it->second.state : UnitActiveState::Unknown;
+}
+
+std::uint64_t SystemdUnitStateTable::getGeneration(const std::string& unit) const
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    const auto it = m_units.find(unit);
+    return it != m_units.cend() ? it->second.generation : 0;
+}
+
+UnitActiveState SystemdUnitStateTable::waitUntilSettled(const std::string& unit, std::uint64_t generation,
+                                                        std::chrono::milliseconds timeout)
+{
+    std::unique_lock<std::mutex> lock{m_mutex};
+    const auto settled = [&] {
+        const auto it = m_units.find(unit);
+        return it != m_units.cend() && it->second.generation > generation &&
+               (it->second.state == UnitActiveState::Active || it->second.state == UnitActiveState::Failed);
+    };
+    m_condition.wait_for(lock, timeout, settled);
+    const auto it = m_units.find(unit);
+    return it != m_units.cend() ? it->second.state : UnitActiveState::Unknown;
+}
+
+bool SystemdUnitStateTable::waitUntilRestarted(const std::string& unit, std::uint64_t generation,
+                                               std::chrono::milliseconds timeout, UnitActiveState& state)
+{
+    // An `Active` state only counts once the unit has left it, since that could still be the state from before
+    std::unique_lock<std::mutex> lock{m_mutex};
+    const auto restarted = [&] {
+        const auto it = m_units.find(unit);
+        return it != m_units.cend() && it->second.generation > generation &&
+               (it->second.state == UnitActiveState::Failed ||
+                (it->second.state == UnitActiveState::Active && it->second.inactiveGeneration > generation));
+    };
+    const auto result = m_condition.wait_for(lock, timeout, restarted);
+    const auto it = m_units.find(unit);
+    state = it != m_units.cend() ? it->second.state : UnitActiveState::Unknown;
+    return result;
+}
+}    // namespace connect
+}    // namespace wolkabout
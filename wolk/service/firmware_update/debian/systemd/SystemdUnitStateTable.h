@@ -0,0 +1,134 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WOLKABOUTCONNECTOR_SYSTEMDUNITSTATETABLE_H
+#define WOLKABOUTCONNECTOR_SYSTEMDUNITSTATETABLE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace wolkabout
+{
+namespace connect
+{
+/**
+ * This enumeration represents the `ActiveState` of a systemd unit.
+ */
+enum class UnitActiveState
+{
+    Unknown,
+    Active,
+    Reloading,
+    Inactive,
+    Failed,
+    Activating,
+    Deactivating
+};
+
+/**
+ * This is a utility method that is used to convert an UnitActiveState value into a string.
+ *
+ * @param state Enumeration value.
+ * @return String representation for the enumeration value, as systemd names it.
+ */
+std::string toString(UnitActiveState state);
+
+/**
+ * This is a utility method that is used to parse the `ActiveState` systemd reports.
+ *
+ * @param state The state as systemd names it.
+ * @return The enumeration value. `Unknown` if the state is not recognized.
+ */
+UnitActiveState unitActiveStateFromString(const std::string& state);
+
+/**
+ * This is the class that holds the last known state of the systemd units, as it is pushed by the signals of the units,
+ * and lets threads wait for a unit to settle.
+ */
+class SystemdUnitStateTable
+{
+public:
+    /**
+     * This method is used to record a new state of a unit.
+     *
+     * @param unit The object name of the unit.
+     * @param state The new state of the unit.
+     */
+    void update(const std::string& unit, UnitActiveState state);
+
+    /**
+     * This method is used to obtain the last known state of a unit.
+     *
+     * @param unit The object name of the unit.
+     * @return The last known state. `Unknown` if nothing is known about the unit.
+     */
+    UnitActiveState get(const std::string& unit) const;
+
+    /**
+     * This method is used to obtain the number of state changes recorded for a unit, which can later be passed to
+     * `waitUntilSettled` to ignore the states that were known before.
+     *
+     * @param unit The object name of the unit.
+     * @return The number of recorded state changes.
+     */
+    std::uint64_t getGeneration(const std::string& unit) const;
+
+    /**
+     * This method is used to wait for a unit to settle as either `Active` or `Failed`, with a state recorded after the
+     * generation.
+     *
+     * @param unit The object name of the unit.
+     * @param generation The generation after which the state must be recorded.
+     * @param timeout The longest time to wait.
+     * @return The state the unit settled in, or its last known state if it did not settle in time.
+     */
+    UnitActiveState waitUntilSettled(const std::string& unit, std::uint64_t generation,
+                                     std::chrono::milliseconds timeout);
+
+    /**
+     * This method is used to wait for a unit to go through a restart. The unit has restarted once it has been in any
+     * other state than `Active` after the generation, and then became `Active` again. It can also fail instead.
+     *
+     * @param unit The object name of the unit.
+     * @param generation The generation after which the restart must be recorded.
+     * @param timeout The longest time to wait.
+     * @param state The state the unit settled in, or its last known state if it did not settle in time.
+     * @return Whether the unit has restarted or failed.
+     */
+    bool waitUntilRestarted(const std::string& unit, std::uint64_t generation, std::chrono::milliseconds timeout,
+                            UnitActiveState& state);
+
+private:
+    struct UnitState
+    {
+        UnitActiveState state;
+        std::uint64_t generation;
+        // The last generation in which the unit was not active
+        std::uint64_t inactiveGeneration;
+    };
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::map<std::string, UnitState> m_units;
+};
+}    // namespace connect
+}    // namespace wolkabout
+
+#endif    // WOLKABOUTCONNECTOR_SYSTEMDUNITSTATETABLE_H
@@ -0,0 +1,337 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wolk/service/registration_service/RegisteredDevicesCache.h"
+
+#include "core/utilities/FileSystemUtils.h"
+#include "core/utilities/Logger.h"
+
+#include <cstdio>
+#include <fstream>
+#include <utility>
+
+namespace wolkabout
+{
+namespace connect
+{
+namespace
+{
+const char DEVICE_RECORD = 'D';
+const char CURSOR_RECORD = 'C';
+const char SEPARATOR = '\t';
+const std::string TEMPORARY_SUFFIX = ".tmp";
+
+// The journal is not compacted until it has at least this many records
+const std::size_t COMPACTION_MINIMUM = 64;
+
+// The values are escaped so they can not break up the lines of the journal
+std::string escape(const std::string& value)
+{
+    auto escaped = std::string{};
+    escaped.reserve(value.size());
+    for (const auto character : value)
+    {
+        if (character == '\\')
+            escaped += "\\\\";
+        else if (character == SEPARATOR)
+            escaped += "\\t";
+        else if (character == '\n')
+            escaped += "\\n";
+        else
+            escaped += character;
+    }
+    return escaped;
+}
+
+std::string unescape(const std::string& value)
+{
+    auto unescaped = std::string{};
+    unescaped.reserve(value.size());
+    for (auto i = std::size_t{0}; i < value.size(); ++i)
+    {
+        if (value[i] != '\\' || i + 1 == value.size())
+        {
+            unescaped += value[i];
+            continue;
+        }
+        const auto next = value[++i];
+        unescaped += next == 't' ? SEPARATOR : next == 'n' ? '\n' : next;
+    }
+    return unescaped;
+}
+
+// Splits a line into its fields, and unescapes them
+std::vector<std::string> splitLine(const std::string& line)
+{
+    auto fields = std::vector<std::string>{};
+    auto start = std::size_t{0};
+    while (true)
+    {
+        const auto end = line.find(SEPARATOR, start);
+        fields.emplace_back(unescape(line.substr(start, end == std::string::npos ? std::string::npos : end - start)));
+        if (end == std::string::npos)
+            return fields;
+        start = end + 1;
+    }
+}
+
+std::string composeDeviceLine(const std::string& deviceType, const RegisteredDeviceInformation& device)
+{
+    return std::string{DEVICE_RECORD} + SEPARATOR + escape(deviceType) + SEPARATOR + escape(device.deviceKey) +
+           SEPARATOR + escape(device.deviceId) + SEPARATOR + escape(device.externalId) + "\n";
+}
+
+std::string composeCursorLine(const std::string& deviceType, std::int64_t cursor)
+{
+    return std::string{CURSOR_RECORD} + SEPARATOR + escape(deviceType) + SEPARATOR + std::to_string(cursor) + "\n";
+}
+}    // namespace
+
+RegisteredDevicesCache::RegisteredDevicesCache(std::string cacheFile)
+: m_cacheFile(std::move(cacheFile)), m_recordCount(0)
+{
+}
+
+bool RegisteredDevicesCache::load()
+{
+    LOG(TRACE) << METHOD_INFO;
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_devices.clear();
+    m_keysByExternalId.clear();
+    m_keysByType.clear();
+    m_cursors.clear();
+    m_recordCount = 0;
+    if (!FileSystemUtils::isFilePresent(m_cacheFile))
+        return true;
+    auto content = std::string{};
+    if (!FileSystemUtils::readFileContent(m_cacheFile, content))
+    {
+        LOG(ERROR) << "Failed to load the registered devices cache -> Failed to read the cache file.";
+        return false;
+    }
+
+    // Replay the records, the last record of every device and cursor wins
+    auto start = std::size_t{0};
+    while (start < content.size())
+    {
+        const auto end = content.find('\n', start);
+        if (end == std::string::npos)
+        {
+            LOG(WARN) << "Ignoring the incomplete last record of the registered devices cache.";
+            break;
+        }
+        const auto line = content.substr(start, end - start);
+        start = end + 1;
+
+        if (line.size() < 2 || line[1] != SEPARATOR)
+            continue;
+        const auto fields = splitLine(line.substr(2));
+        if (line[0] == DEVICE_RECORD && fields.size() == 4)
+        {
+            index(fields[0], RegisteredDeviceInformation{fields[1], fields[2], fields[3]});
+        }
+        else if (line[0] == CURSOR_RECORD && fields.size() == 2)
+        {
+            try
+            {
+                m_cursors[fields[0]] = std::stoll(fields[1]);
+            }
+            catch (const std::exception&)
+            {
+                continue;
+            }
+        }
+        else
+        {
+            continue;
+        }
+        ++m_recordCount;
+    }
+
+    // Start with a journal that holds just the live records
+    auto liveCount = m_cursors.size();
+    for (const auto& type : m_keysByType)
+        liveCount += type.second.size();
+    if (m_recordCount > liveCount || start < content.size())
+        compact();
+    return true;
+}
+
+bool RegisteredDevicesCache::update(const std::string& deviceType,
+                                    const std::vector<RegisteredDeviceInformation>& devices,
+                                    std::chrono::system_clock::time_point cursor)
+{
+    LOG(TRACE) << METHOD_INFO;
+
+    // All the records of the update are appended at once, with the cursor last, so a crash in the middle can only lose
+    // the cursor, and the next refresh obtains the devices again
+    const auto cursorMs =
+      std::chrono::duration_cast<std::chrono::milliseconds>(cursor.time_since_epoch()).count();
+    auto lines = std::string{};
+    for (const auto& device : devices)
+        lines += composeDeviceLine(deviceType, device);
+    lines += composeCursorLine(deviceType, static_cast<std::int64_t>(cursorMs));
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    for (const auto& device : devices)
+        index(deviceType, device);
+    m_cursors[deviceType] = static_cast<std::int64_t>(cursorMs);
+    if (!append(lines))
+        return false;
+    m_recordCount += devices.size() + 1;
+
+    // Once the stale records start to outnumber the live ones, they are dropped
+    auto liveCount = m_cursors.size();
+    for (const auto& type : m_keysByType)
+        liveCount += type.second.size();
+    if (m_recordCount >= COMPACTION_MINIMUM && m_recordCount > 2 * liveCount)
+        compact();
+    return true;
+}
+
+bool RegisteredDevicesCache::clear()
+{
+    LOG(TRACE) << METHOD_INFO;
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_devices.clear();
+    m_keysByExternalId.clear();
+    m_keysByType.clear();
+    m_cursors.clear();
+    return compact();
+}
+
+bool RegisteredDevicesCache::findByKey(const std::string& deviceKey, RegisteredDeviceInformation& device) const
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    const auto it = m_devices.find(deviceKey);
+    if (it == m_devices.cend())
+        return false;
+    device = it->second;
+    return true;
+}
+
+bool RegisteredDevicesCache::findByExternalId(const std::string& externalId,
+                                              RegisteredDeviceInformation& device) const
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    const auto keyIt = m_keysByExternalId.find(externalId);
+    if (keyIt == m_keysByExternalId.cend())
+        return false;
+    const auto it = m_devices.find(keyIt->second);
+    if (it == m_devices.cend())
+        return false;
+    device = it->second;
+    return true;
+}
+
+std::vector<RegisteredDeviceInformation> RegisteredDevicesCache::findByType(const std::string& deviceType) const
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    auto devices = std::vector<RegisteredDeviceInformation>{};
+    const auto typeIt = m_keysByType.find(deviceType);
+    if (typeIt == m_keysByType.cend())
+        return devices;
+    devices.reserve(typeIt->second.size());
+    for (const auto& deviceKey : typeIt->second)
+    {
+        const auto it = m_devices.find(deviceKey);
+        if (it != m_devices.cend())
+            devices.emplace_back(it->second);
+    }
+    return devices;
+}
+
+std::chrono::system_clock::time_point RegisteredDevicesCache::getCursor(const std::string& deviceType) const
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    const auto it = m_cursors.find(deviceType);
+    if (it == m_cursors.cend())
+        return std::chrono::system_clock::time_point{};
+    return std::chrono::system_clock::time_point{std::chrono::milliseconds{it->second}};
+}
+
+std::size_t RegisteredDevicesCache::size() const
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    return m_devices.size();
+}
+
+void RegisteredDevicesCache::index(const std::string& deviceType, const RegisteredDeviceInformation& device)
+{
+    // A device that changed its external id must not be found by the old one
+    const auto previous = m_devices.find(device.deviceKey);
+    if (previous != m_devices.cend() && previous->second.externalId != device.externalId)
+    {
+        const auto keyIt = m_keysByExternalId.find(previous->second.externalId);
+        if (keyIt != m_keysByExternalId.cend() && keyIt->second == device.deviceKey)
+            m_keysByExternalId.erase(keyIt);
+    }
+    m_devices[device.deviceKey] = device;
+    if (!device.externalId.empty())
+        m_keysByExternalId[device.externalId] = device.deviceKey;
+    m_keysByType[deviceType].emplace(device.deviceKey);
+}
+
+bool RegisteredDevicesCache::append(const std::string& lines)
+{
+    std::ofstream journal{m_cacheFile, std::ios::out | std::ios::app | std::ios::binary};
+    if (!journal || !journal.write(lines.data(), static_cast<std::streamsize>(lines.size())).flush())
+    {
+        LOG(ERROR) << "Failed to write into the registered devices cache -> Failed to append to the cache file.";
+        return false;
+    }
+    return true;
+}
+
+bool RegisteredDevicesCache::compact()
+{
+    LOG(TRACE) << METHOD_INFO;
+    const auto errorPrefix = "Failed to compact the registered devices cache";
+
+    // The live records are written into a temporary file first, which then replaces the journal in a single step, so
+    // a crash in the middle leaves either the old or the new journal behind
+    const auto temporaryFile = m_cacheFile + TEMPORARY_SUFFIX;
+    auto recordCount = m_cursors.size();
+    {
+        std::ofstream journal{temporaryFile, std::ios::out | std::ios::trunc | std::ios::binary};
+        for (const auto& type : m_keysByType)
+        {
+            for (const auto& deviceKey : type.second)
+                journal << composeDeviceLine(type.first, m_devices[deviceKey]);
+            recordCount += type.second.size();
+        }
+        for (const auto& cursor : m_cursors)
+            journal << composeCursorLine(cursor.first, cursor.second);
+        if (!journal.flush())
+        {
+            LOG(ERROR) << errorPrefix << " -> Failed to write the temporary file.";
+            FileSystemUtils::deleteFile(temporaryFile);
+            return false;
+        }
+    }
+    if (std::rename(temporaryFile.c_str(), m_cacheFile.c_str()) != 0)
+    {
+        LOG(ERROR) << errorPrefix << " -> Failed to replace the cache file.";
+        FileSystemUtils::deleteFile(temporaryFile);
+        return false;
+    }
+    m_recordCount = recordCount;
+    return true;
+}
+}    // namespace connect
+}    // namespace wolkabout
@@ -0,0 +1,144 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WOLKABOUTCONNECTOR_REGISTEREDDEVICESCACHE_H
+#define WOLKABOUTCONNECTOR_REGISTEREDDEVICESCACHE_H
+
+#include "core/model/messages/RegisteredDevicesResponseMessage.h"
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace wolkabout
+{
+namespace connect
+{
+/**
+ * This is the local copy of the devices registered on the platform, indexed by the device key, the external id, and the
+ * device type they were queried with, kept in a single journal file.
+ *
+ * Every device type has its own cursor, the time of the last query that refreshed it, so the next query only needs to
+ * obtain the devices registered since. Every change is appended to the journal as one line, and the journal is read
+ * only once, when it is loaded, so the lookups never touch the disk. Once the stale records start to outnumber the live
+ * ones, the journal is rewritten into a temporary file that replaces it.
+ *
+ * The platform reports only the devices that were registered, so a device removed from the platform stays in the cache
+ * until the cache is cleared.
+ */
+class RegisteredDevicesCache
+{
+public:
+    /**
+     * Default parameter constructor.
+     *
+     * @param cacheFile The path of the journal file.
+     */
+    explicit RegisteredDevicesCache(std::string cacheFile);
+
+    /**
+     * This method is used to load the devices from the journal file.
+     *
+     * @return Whether the journal was loaded. A journal that does not exist yet counts as loaded.
+     */
+    bool load();
+
+    /**
+     * This method is used to merge in the devices obtained by a query, and move the cursor of the device type.
+     *
+     * @param deviceType The device type the devices were queried with. Empty if they were queried without one.
+     * @param devices The devices obtained by the query.
+     * @param cursor The time at which the query was sent out.
+     * @return Whether the changes were written into the journal.
+     */
+    bool update(const std::string& deviceType, const std::vector<RegisteredDeviceInformation>& devices,
+                std::chrono::system_clock::time_point cursor);
+
+    /**
+     * This method is used to remove all the devices and cursors.
+     *
+     * @return Whether the journal was emptied.
+     */
+    bool clear();
+
+    /**
+     * This method is used to look up a device by its key.
+     *
+     * @param deviceKey The key of the device.
+     * @param device The information about the device.
+     * @return Whether the device is in the cache.
+     */
+    bool findByKey(const std::string& deviceKey, RegisteredDeviceInformation& device) const;
+
+    /**
+     * This method is used to look up a device by its external id.
+     *
+     * @param externalId The external id of the device.
+     * @param device The information about the device.
+     * @return Whether the device is in the cache.
+     */
+    bool findByExternalId(const std::string& externalId, RegisteredDeviceInformation& device) const;
+
+    /**
+     * This method is used to look up the devices of a device type.
+     *
+     * @param deviceType The device type the devices were queried with.
+     * @return The devices, ordered by their key.
+     */
+    std::vector<RegisteredDeviceInformation> findByType(const std::string& deviceType) const;
+
+    /**
+     * This method is used to obtain the cursor of a device type.
+     *
+     * @param deviceType The device type.
+     * @return The time of the last query that refreshed the device type. The epoch if it was never refreshed.
+     */
+    std::chrono::system_clock::time_point getCursor(const std::string& deviceType) const;
+
+    /**
+     * Getter for the count of devices.
+     *
+     * @return The count of devices.
+     */
+    std::size_t size() const;
+
+private:
+    // Internal method used to place a device into all the indexes. Must be called with the mutex locked.
+    void index(const std::string& deviceType, const RegisteredDeviceInformation& device);
+
+    // Internal method used to append lines to the journal. Must be called with the mutex locked.
+    bool append(const std::string& lines);
+
+    // Internal method used to rewrite the journal with only the live records. Must be called with the mutex locked.
+    bool compact();
+
+    std::string m_cacheFile;
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<std::string, RegisteredDeviceInformation> m_devices;
+    std::unordered_map<std::string, std::string> m_keysByExternalId;
+    std::unordered_map<std::string, std::set<std::string>> m_keysByType;
+    std::unordered_map<std::string, std::int64_t> m_cursors;
+    std::size_t m_recordCount;
+};
+}    // namespace connect
+}    // namespace wolkabout
+
+#endif    // WOLKABOUTCONNECTOR_REGISTEREDDEVICESCACHE_H
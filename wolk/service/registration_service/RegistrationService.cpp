@@ -17,9 +17,22 @@
 #include "wolk/service/registration_service/RegistrationService.h"
 
 #include "core/utilities/Logger.h"
+#include "wolk/utilities/Sha256.h"
 
 #include <algorithm>
 
+namespace
+{
+// The time the platform is given to answer a device registration
+const std::chrono::milliseconds DEVICE_REGISTRATION_TIMEOUT{60000};
+// The period in which the registrations are checked for their deadline
+const std::chrono::milliseconds DEVICE_REGISTRATION_CHECK_PERIOD{1000};
+// The time the platform is given to answer a children synchronization, before the request is sent out again
+const std::chrono::milliseconds CHILDREN_REQUEST_TIMEOUT{60000};
+// The time a list of children is given out without asking the platform again
+const std::chrono::milliseconds CHILDREN_CACHE_TIME_TO_LIVE{10000};
+}    // namespace
+
 namespace wolkabout
 {
 namespace connect
@@ -68,8 +81,17 @@ std::size_t DeviceQueryDataHash::operator()(const DeviceQueryData& data) const
     return timestamp ^ (deviceType << 1) ^ (externalId << 2);
 }
 
-RegistrationService::RegistrationService(RegistrationProtocol& protocol, ConnectivityService& connectivityService)
-: m_exitCondition{false}, m_protocol(protocol), m_connectivityService(connectivityService)
+RegistrationService::RegistrationService(RegistrationProtocol& protocol, ConnectivityService& connectivityService,
+                                         std::shared_ptr<RegisteredDevicesCache> devicesCache)
+: m_exitCondition{false}
+, m_protocol(protocol)
+, m_connectivityService(connectivityService)
+, m_childrenCacheTimeToLive(CHILDREN_CACHE_TIME_TO_LIVE)
+, m_childrenRequestCount{0}
+, m_deviceRegistrationTimeout(DEVICE_REGISTRATION_TIMEOUT)
+, m_unmatchedRegistrationResponses{0}
+, m_expiredRegistrations{0}
+, m_devicesCache{std::move(devicesCache)}
 {
 }
 
@@ -78,13 +100,34 @@ RegistrationService::~RegistrationService()
     stop();
 }
 
-void RegistrationService::start() {}
+void RegistrationService::start()
+{
+    // The registrations expire even when no other registration or response comes along
+    m_deviceRegistrationTimer.run(DEVICE_REGISTRATION_CHECK_PERIOD, [this] {
+        std::lock_guard<std::mutex> lock{m_deviceRegistrationMutex};
+        removeExpiredRegistrations();
+    });
+}
 
 void RegistrationService::stop()
 {
     m_exitCondition = true;
-    m_childrenSyncDevicesCV.notify_all();
-    m_registeredDevicesCV.notify_all();
+    m_deviceRegistrationTimer.stop();
+
+    // Wake up everyone waiting for children or devices, as the responses will not be handled anymore
+    {
+        std::lock_guard<std::mutex> lock{m_childrenSyncDevicesMutex};
+        for (const auto& request : m_childrenRequests)
+            for (const auto& promise : request.second.promises)
+                promise->set_value(nullptr);
+        m_childrenRequests.clear();
+    }
+    std::lock_guard<std::mutex> lock{m_registeredDevicesMutex};
+    for (const auto& queries : m_deviceQueries)
+        for (const auto& pending : queries.second)
+            if (!pending->callback && !pending->pageCallback)
+                pending->promise.set_value(nullptr);
+    m_deviceQueries.clear();
 }
 
 bool RegistrationService::registerDevices(
@@ -110,7 +153,6 @@ bool RegistrationService::registerDevices(
         }
         deviceNames.emplace_back(device.key);
     }
-    std::sort_heap(deviceNames.begin(), deviceNames.end());
 
     // Make the message that will be sent out
     const auto message =
@@ -123,18 +165,51 @@ bool RegistrationService::registerDevices(
     }
 
     // Send the message out
-    if (!m_connectivityService.publish(message))
+    if (!sendRegistration(message, std::move(deviceNames), std::move(callback)))
     {
         const auto errorMessage = "Failed to send the outgoing message.";
         LOG(ERROR) << errorPrefix << " -> " << errorMessage;
         return false;
     }
+    invalidateChildren(deviceKey);
+    return true;
+}
 
-    // Emplace the callback in the map
+bool RegistrationService::registerDevicesInBatches(
+  const std::string& deviceKey, const std::vector<DeviceRegistrationData>& devices,
+  std::function<void(const std::vector<std::string>&, const std::vector<std::string>&)> callback,
+  std::function<void(std::size_t, std::size_t)> progress, BulkRegistrationOptions options)
+{
+    LOG(TRACE) << METHOD_INFO;
+    const auto errorPrefix = "Failed to register devices";
+
+    // Check that there's devices in the vector and that their names are not empty
+    if (devices.empty())
     {
-        std::lock_guard<std::mutex> lock{m_deviceRegistrationMutex};
-        m_deviceRegistrationCallbacks.emplace(deviceNames, std::move(callback));
+        LOG(ERROR) << errorPrefix << " -> The list of devices is empty.";
+        return false;
+    }
+    if (std::any_of(devices.cbegin(), devices.cend(),
+                    [](const DeviceRegistrationData& device) { return device.key.empty(); }))
+    {
+        LOG(ERROR) << errorPrefix << " -> One of the devices has an empty name.";
+        return false;
     }
+
+    // Set up the state shared by all the batches
+    auto registration = std::make_shared<BulkRegistration>();
+    registration->deviceKey = deviceKey;
+    registration->devices = devices;
+    registration->callback = std::move(callback);
+    registration->progress = std::move(progress);
+    registration->options = options;
+    registration->options.batchSize = std::max<std::size_t>(options.batchSize, 1);
+    registration->options.inFlightBatches = std::max<std::size_t>(options.inFlightBatches, 1);
+    registration->next = 0;
+    registration->inFlight = 0;
+    registration->answered = 0;
+    sendRegistrationBatches(registration);
+    invalidateChildren(deviceKey);
     return true;
 }
 
@@ -160,6 +235,7 @@ bool RegistrationService::removeDevices(const std::string& deviceKey, std::vecto
         LOG(ERROR) << errorPrefix << " -> " << errorMessage;
         return false;
     }
+    invalidateChildren(deviceKey);
     return true;
 }
 
@@ -169,67 +245,20 @@ std::shared_ptr<std::vector<std::string>> RegistrationService::obtainChildren(co
     LOG(TRACE) << METHOD_INFO;
     const auto errorPrefix = "Failed to obtain children";
 
-    // Parse the message
-    auto message =
-      std::shared_ptr<Message>{m_protocol.makeOutboundMessage(deviceKey, ChildrenSynchronizationRequestMessage{})};
-    if (message == nullptr)
-    {
-        LOG(ERROR) << errorPrefix << " -> Failed to generate outgoing `ChildrenSynchronizationRequestMessage`.";
+    // Join the request for the children of the device, and wait for it to be answered
+    auto promise = std::make_shared<std::promise<std::shared_ptr<std::vector<std::string>>>>();
+    auto future = promise->get_future();
+    if (!requestChildren(deviceKey, {}, std::move(promise)))
         return nullptr;
-    }
-
-    // Lock the mutex for the map, just so the response arrival can't be faster than us putting the query data into the
-    // map.
-    auto callbackIt = std::vector<std::function<void(std::vector<std::string>)>>::iterator{};
-    auto called = std::make_shared<std::atomic_bool>(false);
-    auto list = std::make_shared<std::vector<std::string>>();
+    if (future.wait_for(timeout) != std::future_status::ready)
     {
-        std::lock_guard<std::mutex> lock{m_childrenSyncDevicesMutex};
-        // Send out the message
-        if (!m_connectivityService.publish(message))
-        {
-            LOG(ERROR) << errorPrefix << " -> Failed to send the outgoing `ChildrenSynchronizationRequestMessage`.";
-            return nullptr;
-        }
-        auto weakCalled = std::weak_ptr<std::atomic_bool>{called};
-        auto weakList = std::weak_ptr<std::vector<std::string>>{list};
-        m_childrenSynchronizationCallbacks[deviceKey].emplace_back(
-          [this, weakCalled, weakList](const std::vector<std::string>& children) {
-              // Check the flag
-              auto calledFlag = weakCalled.lock();
-              if (calledFlag == nullptr)
-                  return;
-
-              // Check the list
-              auto childrenList = weakList.lock();
-              if (childrenList == nullptr)
-                  return;
-
-              // Emplace the values in the list and change the flag
-              for (const auto& child : children)
-                  childrenList->emplace_back(child);
-              *calledFlag = true;
-              m_childrenSyncDevicesCV.notify_one();
-          });
-        callbackIt = std::prev(m_childrenSynchronizationCallbacks[deviceKey].end());
-    }
-
-    // Wait for the condition variable to be invoked
-    {
-        auto uniqueLock = std::unique_lock<std::mutex>{m_registeredDevicesMutex};
-        m_childrenSyncDevicesCV.wait_for(uniqueLock, timeout, [&] { return *called || m_exitCondition; });
-    }
-    if (!*called)
-    {
-        // Remove the callback as it wasn't called
-        std::lock_guard<std::mutex> lockGuard{m_registeredDevicesMutex};
-        m_childrenSynchronizationCallbacks[deviceKey].erase(callbackIt);
+        LOG(ERROR) << errorPrefix << " -> Received no response message.";
         return nullptr;
     }
-    else
-    {
-        return list;
-    }
+    auto children = future.get();
+    if (children == nullptr)
+        LOG(ERROR) << errorPrefix << " -> The service was stopped before the response arrived.";
+    return children;
 }
 
 bool RegistrationService::obtainChildrenAsync(const std::string& deviceKey,
@@ -244,29 +273,98 @@ bool RegistrationService::obtainChildrenAsync(const std::string& deviceKey,
         LOG(ERROR) << errorPrefix << " -> The user did not set the callback.";
         return false;
     }
+    return requestChildren(deviceKey, std::move(callback), nullptr);
+}
 
-    // Parse the message
-    auto message =
-      std::shared_ptr<Message>{m_protocol.makeOutboundMessage(deviceKey, ChildrenSynchronizationRequestMessage{})};
-    if (message == nullptr)
-    {
-        LOG(ERROR) << errorPrefix << " -> Failed to generate outgoing `ChildrenSynchronizationRequestMessage`.";
-        return false;
-    }
-
-    // Lock the mutex for the map, just so the response arrival can't be faster than us putting the query data into the
-    // map.
+bool RegistrationService::requestChildren(
+  const std::string& deviceKey, std::function<void(std::vector<std::string>)> callback,
+  std::shared_ptr<std::promise<std::shared_ptr<std::vector<std::string>>>> promise)
+{
+    const auto errorPrefix = "Failed to obtain children";
+    const auto now = std::chrono::steady_clock::now();
+    const auto waitsWithCallback = static_cast<bool>(callback);
+    auto message = std::shared_ptr<Message>{};
+    auto sequence = std::uint64_t{0};
+    auto previousDeadline = std::chrono::steady_clock::time_point{};
+    auto waiterIndex = std::size_t{0};
     {
         std::lock_guard<std::mutex> lock{m_childrenSyncDevicesMutex};
-        // Send out the message
-        if (!m_connectivityService.publish(message))
+
+        // A list that is still fresh is given out right away
+        const auto cachedIt = m_childrenCache.find(deviceKey);
+        if (cachedIt != m_childrenCache.end())
         {
-            LOG(ERROR) << errorPrefix << " -> Failed to send the outgoing `ChildrenSynchronizationRequestMessage`.";
-            return false;
+            if (cachedIt->second.expires > now)
+            {
+                const auto children = cachedIt->second.children;
+                if (callback)
+                    m_commandBuffer.pushCommand(
+                      std::make_shared<std::function<void()>>([callback, children] { callback(children); }));
+                else
+                    promise->set_value(std::make_shared<std::vector<std::string>>(children));
+                return true;
+            }
+            m_childrenCache.erase(cachedIt);
         }
-        m_childrenSynchronizationCallbacks[deviceKey].emplace_back(callback);
-        return true;
+
+        // Only one request is sent out for a device at a time, and everyone asking in the meantime waits for its
+        // response. A request that was not answered in time is sent out again, with the waiters it already had. The
+        // request is registered before it is published, so the mutex is not held while the message is published.
+        const auto requestIt = m_childrenRequests.find(deviceKey);
+        if (requestIt == m_childrenRequests.end() || requestIt->second.deadline <= now)
+        {
+            message = std::shared_ptr<Message>{
+              m_protocol.makeOutboundMessage(deviceKey, ChildrenSynchronizationRequestMessage{})};
+            if (message == nullptr)
+            {
+                LOG(ERROR) << errorPrefix << " -> Failed to generate outgoing `ChildrenSynchronizationRequestMessage`.";
+                return false;
+            }
+            auto& request = m_childrenRequests[deviceKey];
+            previousDeadline = request.deadline;
+            request.deadline = now + CHILDREN_REQUEST_TIMEOUT;
+            request.sequence = sequence = ++m_childrenRequestCount;
+        }
+        auto& request = m_childrenRequests[deviceKey];
+        if (waitsWithCallback)
+        {
+            waiterIndex = request.callbacks.size();
+            request.callbacks.emplace_back(std::move(callback));
+        }
+        else
+        {
+            waiterIndex = request.promises.size();
+            request.promises.emplace_back(std::move(promise));
+        }
+        if (message == nullptr)
+            return true;
     }
+
+    if (m_connectivityService.publish(message))
+        return true;
+    LOG(ERROR) << errorPrefix << " -> Failed to send the outgoing `ChildrenSynchronizationRequestMessage`.";
+
+    // The waiter is taken out again, and the request is left expired, so the next one asking sends it out again. A
+    // request that was answered, or sent out again, in the meantime has already taken care of the waiter.
+    std::lock_guard<std::mutex> lock{m_childrenSyncDevicesMutex};
+    const auto requestIt = m_childrenRequests.find(deviceKey);
+    if (requestIt == m_childrenRequests.end() || requestIt->second.sequence != sequence)
+        return true;
+    auto& request = requestIt->second;
+    if (waitsWithCallback)
+        request.callbacks.erase(request.callbacks.begin() + static_cast<std::ptrdiff_t>(waiterIndex));
+    else
+        request.promises.erase(request.promises.begin() + static_cast<std::ptrdiff_t>(waiterIndex));
+    request.deadline = previousDeadline;
+    if (request.callbacks.empty() && request.promises.empty())
+        m_childrenRequests.erase(requestIt);
+    return false;
+}
+
+void RegistrationService::invalidateChildren(const std::string& deviceKey)
+{
+    std::lock_guard<std::mutex> lock{m_childrenSyncDevicesMutex};
+    m_childrenCache.erase(deviceKey);
 }
 
 std::unique_ptr<std::vector<RegisteredDeviceInformation>> RegistrationService::obtainDevices(
@@ -276,101 +374,173 @@ std::unique_ptr<std::vector<RegisteredDeviceInformation>> RegistrationService::o
     LOG(TRACE) << METHOD_INFO;
     const auto errorPrefix = "Failed to obtain devices";
 
-    // Parse the message
+    // Send out the query
     const auto query = DeviceQueryData{timestampFrom, deviceType, externalId};
-    auto request = RegisteredDevicesRequestMessage{
-      std::chrono::duration_cast<std::chrono::milliseconds>(timestampFrom.time_since_epoch()), deviceType, externalId};
-    auto message = std::shared_ptr<Message>{m_protocol.makeOutboundMessage(deviceKey, std::move(request))};
-    if (message == nullptr)
-    {
-        LOG(ERROR) << errorPrefix << " -> Failed to generate outgoing `RegisteredDevicesRequest` message.";
+    const auto pending = std::make_shared<PendingDeviceQuery>();
+    if (!sendDevicesQuery(deviceKey, query, pending))
         return nullptr;
-    }
 
-    // Lock the mutex for the map, just so the response arrival can't be faster than us putting the query data into the
-    // map.
+    // Wait for the response to be delivered to this query
+    auto future = pending->promise.get_future();
+    if (future.wait_for(timeout) != std::future_status::ready)
     {
+        // Take the query out, unless the response has arrived in the meantime
         std::lock_guard<std::mutex> lock{m_registeredDevicesMutex};
-        // Send out the message
-        if (!m_connectivityService.publish(message))
+        const auto it = m_deviceQueries.find(query);
+        if (it != m_deviceQueries.end())
         {
-            LOG(ERROR) << errorPrefix << " -> Failed to send the outgoing `RegisteredDevicesRequest` message.";
-            return nullptr;
+            const auto pendingIt = std::find(it->second.begin(), it->second.end(), pending);
+            if (pendingIt != it->second.end())
+            {
+                it->second.erase(pendingIt);
+                if (it->second.empty())
+                    m_deviceQueries.erase(it);
+                LOG(ERROR) << errorPrefix << " -> Received no response message.";
+                return nullptr;
+            }
         }
-        m_deviceRegistrationResponses.emplace(query, nullptr);
     }
+    auto data = future.get();
+    if (data == nullptr)
+        LOG(ERROR) << errorPrefix << " -> The service was stopped before the response arrived.";
+    return data;
+}
 
-    // Wait for the condition variable to be invoked
-    {
-        auto uniqueLock = std::unique_lock<std::mutex>{m_registeredDevicesMutex};
-        m_registeredDevicesCV.wait_for(uniqueLock, timeout);
-    }
+bool RegistrationService::obtainDevicesAsync(
+  const std::string& deviceKey, TimePoint timestampFrom, std::string deviceType, std::string externalId,
+  std::function<void(const std::vector<RegisteredDeviceInformation>&)> callback)
+{
+    LOG(TRACE) << METHOD_INFO;
+    const auto errorPrefix = "Failed to obtain devices";
 
-    // Check if there's a response in the map for us
-    auto response = std::unique_ptr<RegisteredDevicesResponseMessage>{};
+    // Check whether the callback is actually set.
+    if (!callback)
     {
-        std::lock_guard<std::mutex> lock{m_registeredDevicesMutex};
-        // Check if there's a value in the map
-        const auto it = m_deviceRegistrationResponses.find(query);
-        if (it != m_deviceRegistrationResponses.cend())
-        {
-            response = std::move(it->second);
-            m_deviceRegistrationResponses.erase(it);
-        }
+        LOG(ERROR) << errorPrefix << " -> The user did not set the callback.";
+        return false;
     }
-    if (response == nullptr)
+
+    // Send out the query
+    const auto query = DeviceQueryData{timestampFrom, deviceType, externalId};
+    const auto pending = std::make_shared<PendingDeviceQuery>();
+    pending->callback = std::move(callback);
+    return sendDevicesQuery(deviceKey, query, pending);
+}
+
+std::future<std::unique_ptr<std::vector<RegisteredDeviceInformation>>> RegistrationService::obtainDevicesFuture(
+  const std::string& deviceKey, TimePoint timestampFrom, std::string deviceType, std::string externalId)
+{
+    LOG(TRACE) << METHOD_INFO;
+
+    // Send out the query
+    const auto query = DeviceQueryData{timestampFrom, deviceType, externalId};
+    const auto pending = std::make_shared<PendingDeviceQuery>();
+    if (!sendDevicesQuery(deviceKey, query, pending))
     {
-        LOG(ERROR) << errorPrefix << " -> Received no response message.";
-        return nullptr;
+        auto promise = std::promise<std::unique_ptr<std::vector<RegisteredDeviceInformation>>>{};
+        promise.set_value(nullptr);
+        return promise.get_future();
     }
-
-    // If there's some data that has been returned, return it.
-    auto data = std::unique_ptr<std::vector<RegisteredDeviceInformation>>{new std::vector<RegisteredDeviceInformation>};
-    for (const auto& device : response->getMatchingDevices())
-        data->emplace_back(device);
-    return data;
+    return pending->promise.get_future();
 }
 
-bool RegistrationService::obtainDevicesAsync(
-  const std::string& deviceKey, TimePoint timestampFrom, std::string deviceType, std::string externalId,
-  std::function<void(const std::vector<RegisteredDeviceInformation>&)> callback)
+bool RegistrationService::obtainDevicesPaged(const std::string& deviceKey, TimePoint timestampFrom,
+                                             std::string deviceType, std::string externalId, std::size_t pageSize,
+                                             std::function<void(const RegisteredDevicesPage&)> callback)
 {
     LOG(TRACE) << METHOD_INFO;
     const auto errorPrefix = "Failed to obtain devices";
 
-    // Check whether the callback is actually set.
+    // Check whether the callback and the page size are actually set.
     if (!callback)
     {
         LOG(ERROR) << errorPrefix << " -> The user did not set the callback.";
         return false;
     }
+    if (pageSize == 0)
+    {
+        LOG(ERROR) << errorPrefix << " -> The page size can not be 0.";
+        return false;
+    }
+
+    // The cursor is taken before the query is sent out, so the devices registered while it is answered are not missed.
+    // It is the local time, so it is only as good as the sync of the local clock with the platform's.
+    const auto query = DeviceQueryData{timestampFrom, deviceType, externalId};
+    const auto pending = std::make_shared<PendingDeviceQuery>();
+    pending->pageCallback = std::move(callback);
+    pending->pageSize = pageSize;
+    pending->cursor = std::chrono::time_point_cast<std::chrono::milliseconds>(std::chrono::system_clock::now());
+    return sendDevicesQuery(deviceKey, query, pending);
+}
+
+bool RegistrationService::refreshDevicesCache(const std::string& deviceKey, const std::string& deviceType,
+                                              std::function<void(bool)> callback)
+{
+    LOG(TRACE) << METHOD_INFO;
 
-    // Create the message and the local query object
-    const auto request = RegisteredDevicesRequestMessage{
-      std::chrono::duration_cast<std::chrono::milliseconds>(timestampFrom.time_since_epoch()), deviceType, externalId};
-    const auto query = DeviceQueryData{timestampFrom, deviceType, externalId, callback};
+    if (m_devicesCache == nullptr)
+    {
+        LOG(ERROR) << "Failed to refresh the devices cache -> The service has no cache.";
+        return false;
+    }
+
+    // The new cursor is taken before the query is sent out, so the devices registered while it is answered are
+    // obtained again by the next refresh, instead of being missed
+    const auto cache = m_devicesCache;
+    const auto cursor = std::chrono::time_point_cast<std::chrono::milliseconds>(std::chrono::system_clock::now());
+    return obtainDevicesAsync(
+      deviceKey, cache->getCursor(deviceType), deviceType, {},
+      [cache, deviceType, cursor, callback](const std::vector<RegisteredDeviceInformation>& devices) {
+          const auto stored = cache->update(deviceType, devices, cursor);
+          if (callback)
+              callback(stored);
+      });
+}
+
+std::shared_ptr<RegisteredDevicesCache> RegistrationService::getDevicesCache() const
+{
+    return m_devicesCache;
+}
+
+bool RegistrationService::sendDevicesQuery(const std::string& deviceKey, const DeviceQueryData& query,
+                                           const std::shared_ptr<PendingDeviceQuery>& pending)
+{
+    LOG(TRACE) << METHOD_INFO;
+    const auto errorPrefix = "Failed to obtain devices";
 
     // Parse the message
-    auto message = std::shared_ptr<Message>{m_protocol.makeOutboundMessage(deviceKey, request)};
+    auto request = RegisteredDevicesRequestMessage{
+      std::chrono::duration_cast<std::chrono::milliseconds>(query.getTimestampFrom().time_since_epoch()),
+      query.getDeviceType(), query.getExternalId()};
+    auto message = std::shared_ptr<Message>{m_protocol.makeOutboundMessage(deviceKey, std::move(request))};
     if (message == nullptr)
     {
         LOG(ERROR) << errorPrefix << " -> Failed to generate outgoing `RegisteredDevicesRequest` message.";
         return false;
     }
 
-    // Lock the mutex for the map, just so the response arrival can't be faster than us putting the query data into the
-    // map.
+    // Put the query into the map before it is sent out, so the response can't arrive before it, but publish without
+    // the lock, so the responses for other queries don't wait behind the publish.
     {
         std::lock_guard<std::mutex> lock{m_registeredDevicesMutex};
-        // Send out the message
-        if (!m_connectivityService.publish(message))
-        {
-            LOG(ERROR) << errorPrefix << " -> Failed to send the outgoing `RegisteredDevicesRequest` message.";
-            return false;
-        }
-        m_deviceRegistrationResponses.emplace(query, nullptr);
+        m_deviceQueries[query].emplace_back(pending);
+    }
+    if (m_connectivityService.publish(message))
         return true;
+    LOG(ERROR) << errorPrefix << " -> Failed to send the outgoing `RegisteredDevicesRequest` message.";
+
+    // Take the query back out
+    std::lock_guard<std::mutex> lock{m_registeredDevicesMutex};
+    const auto it = m_deviceQueries.find(query);
+    if (it != m_deviceQueries.end())
+    {
+        const auto pendingIt = std::find(it->second.begin(), it->second.end(), pending);
+        if (pendingIt != it->second.end())
+            it->second.erase(pendingIt);
+        if (it->second.empty())
+            m_deviceQueries.erase(it);
     }
+    return false;
 }
 
 void RegistrationService::messageReceived(std::shared_ptr<Message> message)
@@ -421,6 +591,166 @@ const Protocol& RegistrationService::getProtocol()
     return m_protocol;
 }
 
+std::uint64_t RegistrationService::getUnmatchedRegistrationResponseCount() const
+{
+    return m_unmatchedRegistrationResponses;
+}
+
+std::uint64_t RegistrationService::getExpiredRegistrationCount() const
+{
+    return m_expiredRegistrations;
+}
+
+std::string RegistrationService::makeRegistrationDigest(std::vector<std::string> deviceNames)
+{
+    // The names are separated by a character that can not appear in a name, so the same characters split differently
+    // give a different digest
+    std::sort(deviceNames.begin(), deviceNames.end());
+    auto hash = Sha256{};
+    for (const auto& name : deviceNames)
+    {
+        hash.update(name);
+        hash.update(std::string(1, '\0'));
+    }
+    return Sha256::toHex(hash.digest());
+}
+
+bool RegistrationService::sendRegistration(
+  const std::shared_ptr<Message>& message, std::vector<std::string> deviceNames,
+  std::function<void(std::vector<std::string>, std::vector<std::string>)> callback)
+{
+    const auto digest = makeRegistrationDigest(deviceNames);
+    const auto deadline = std::chrono::steady_clock::now() + m_deviceRegistrationTimeout;
+
+    std::lock_guard<std::mutex> lock{m_deviceRegistrationMutex};
+    auto& registrations = m_deviceRegistrationCallbacks[digest];
+    registrations.emplace_back(PendingRegistration{std::move(deviceNames), std::move(callback), deadline});
+    if (!m_connectivityService.publish(message))
+    {
+        registrations.pop_back();
+        if (registrations.empty())
+            m_deviceRegistrationCallbacks.erase(digest);
+        return false;
+    }
+    m_deviceRegistrationDeadlines.emplace_back(deadline, digest);
+    return true;
+}
+
+void RegistrationService::removeExpiredRegistrations()
+{
+    // Every deadline belongs to the oldest registration under its digest, unless that one has already been answered
+    const auto now = std::chrono::steady_clock::now();
+    while (!m_deviceRegistrationDeadlines.empty() && m_deviceRegistrationDeadlines.front().first <= now)
+    {
+        const auto it = m_deviceRegistrationCallbacks.find(m_deviceRegistrationDeadlines.front().second);
+        if (it != m_deviceRegistrationCallbacks.end() && it->second.front().deadline <= now)
+        {
+            auto registration = std::move(it->second.front());
+            it->second.pop_front();
+            if (it->second.empty())
+                m_deviceRegistrationCallbacks.erase(it);
+            ++m_expiredRegistrations;
+            LOG(WARN) << "Registration of " << registration.deviceNames.size()
+                      << " device(s) has expired without a response.";
+            if (registration.callback)
+            {
+                const auto callback = std::move(registration.callback);
+                const auto failed = std::move(registration.deviceNames);
+                m_commandBuffer.pushCommand(
+                  std::make_shared<std::function<void()>>([callback, failed] { callback({}, failed); }));
+            }
+        }
+        m_deviceRegistrationDeadlines.pop_front();
+    }
+}
+
+void RegistrationService::sendRegistrationBatches(const std::shared_ptr<BulkRegistration>& registration)
+{
+    LOG(TRACE) << METHOD_INFO;
+    const auto errorPrefix = "Failed to register a batch of devices";
+
+    const auto& devices = registration->devices;
+    const auto& options = registration->options;
+    while (true)
+    {
+        // Take the next batch, if there are devices left and the window allows it
+        auto first = std::size_t{0};
+        auto count = std::size_t{0};
+        {
+            std::lock_guard<std::mutex> lock{registration->mutex};
+            if (registration->next >= devices.size() || registration->inFlight >= options.inFlightBatches)
+                return;
+            first = registration->next;
+            count = std::min(options.batchSize, devices.size() - first);
+        }
+
+        // Make the message, and split the batch until the payload fits
+        auto batch = std::vector<DeviceRegistrationData>{};
+        auto message = std::shared_ptr<Message>{};
+        while (true)
+        {
+            batch.assign(devices.cbegin() + static_cast<std::ptrdiff_t>(first),
+                         devices.cbegin() + static_cast<std::ptrdiff_t>(first + count));
+            message = std::shared_ptr<Message>{
+              m_protocol.makeOutboundMessage(registration->deviceKey, DeviceRegistrationMessage{batch})};
+            if (message == nullptr || message->getContent().size() <= options.maximumPayloadSize || count == 1)
+                break;
+            count = (count + 1) / 2;
+        }
+        auto deviceNames = std::vector<std::string>{};
+        for (const auto& device : batch)
+            deviceNames.emplace_back(device.key);
+        {
+            std::lock_guard<std::mutex> lock{registration->mutex};
+            registration->next = first + count;
+            ++registration->inFlight;
+        }
+
+        // Send the message out with the callback already in the map, so the response can not arrive before it
+        auto sent = false;
+        if (message == nullptr)
+            LOG(ERROR) << errorPrefix << " -> Failed to generate the outgoing message.";
+        else if (message->getContent().size() > options.maximumPayloadSize)
+            LOG(ERROR) << errorPrefix << " -> The device '" << batch.front().key << "' alone exceeds the payload size.";
+        else
+        {
+            sent = sendRegistration(message, deviceNames,
+                                    [this, registration, count](const std::vector<std::string>& success,
+                                                                const std::vector<std::string>& failed) {
+                                        handleRegistrationBatch(registration, count, success, failed);
+                                        sendRegistrationBatches(registration);
+                                    });
+            if (!sent)
+                LOG(ERROR) << errorPrefix << " -> Failed to send the outgoing message.";
+        }
+        if (!sent)
+            handleRegistrationBatch(registration, count, {}, deviceNames);
+    }
+}
+
+void RegistrationService::handleRegistrationBatch(const std::shared_ptr<BulkRegistration>& registration,
+                                                  std::size_t batchSize, const std::vector<std::string>& success,
+                                                  const std::vector<std::string>& failed)
+{
+    auto answered = std::size_t{0};
+    auto finished = false;
+    {
+        std::lock_guard<std::mutex> lock{registration->mutex};
+        std::copy(success.cbegin(), success.cend(), std::back_inserter(registration->success));
+        std::copy(failed.cbegin(), failed.cend(), std::back_inserter(registration->failed));
+        registration->answered += batchSize;
+        --registration->inFlight;
+        answered = registration->answered;
+        finished = answered == registration->devices.size();
+    }
+
+    LOG(DEBUG) << "Registration answered for " << answered << "/" << registration->devices.size() << " device(s).";
+    if (registration->progress)
+        registration->progress(answered, registration->devices.size());
+    if (finished && registration->callback)
+        registration->callback(registration->success, registration->failed);
+}
+
 void RegistrationService::handleChildrenSynchronizationResponse(
   const std::string& deviceKey, std::unique_ptr<ChildrenSynchronizationResponseMessage> responseMessage)
 {
@@ -428,20 +758,32 @@ void RegistrationService::handleChildrenSynchronizationResponse(
     if (responseMessage == nullptr)
         return;
 
-    // Look for any callbacks
-    std::lock_guard<std::mutex> lockGuard{m_childrenSyncDevicesMutex};
-    if (!m_childrenSynchronizationCallbacks[deviceKey].empty())
+    // Remember the list, and take everyone waiting for it
+    const auto& children = responseMessage->getChildren();
+    auto request = ChildrenRequest{};
     {
-        // Take the first callback from the queue
-        const auto callback = m_childrenSynchronizationCallbacks[deviceKey].front();
-        m_childrenSynchronizationCallbacks[deviceKey].erase(m_childrenSynchronizationCallbacks[deviceKey].begin());
-
-        // Make copy of the children devices
-        const auto children = responseMessage->getChildren();
+        std::lock_guard<std::mutex> lockGuard{m_childrenSyncDevicesMutex};
+        m_childrenCache[deviceKey] =
+          CachedChildren{children, std::chrono::steady_clock::now() + m_childrenCacheTimeToLive};
+        const auto it = m_childrenRequests.find(deviceKey);
+        if (it == m_childrenRequests.end())
+            return;
+        request = std::move(it->second);
+        m_childrenRequests.erase(it);
+    }
 
-        // And invoke the callback
-        m_commandBuffer.pushCommand(
-          std::make_shared<std::function<void()>>([callback, children] { callback(children); }));
+    // The synchronous ones are woken up right away, and the callbacks are invoked with a single shared list
+    for (const auto& promise : request.promises)
+        promise->set_value(std::make_shared<std::vector<std::string>>(children));
+    if (!request.callbacks.empty())
+    {
+        auto callbacks = std::make_shared<std::vector<std::function<void(std::vector<std::string>)>>>(
+          std::move(request.callbacks));
+        auto list = std::make_shared<std::vector<std::string>>(children);
+        m_commandBuffer.pushCommand(std::make_shared<std::function<void()>>([callbacks, list] {
+            for (const auto& callback : *callbacks)
+                callback(*list);
+        }));
     }
 }
 
@@ -452,25 +794,34 @@ void RegistrationService::handleDeviceRegistrationResponse(
     if (responseMessage == nullptr)
         return;
 
-    // Take out the device names and find a callback
+    // Take out the device names and find the registration
     auto deviceNames = std::vector<std::string>{};
     std::copy(responseMessage->getSuccess().cbegin(), responseMessage->getSuccess().cend(),
               std::back_inserter(deviceNames));
     std::copy(responseMessage->getFailed().cbegin(), responseMessage->getFailed().cend(),
               std::back_inserter(deviceNames));
-    std::sort(deviceNames.begin(), deviceNames.end());
+    const auto digest = makeRegistrationDigest(std::move(deviceNames));
 
     // Look for callbacks
     std::lock_guard<std::mutex> lock{m_deviceRegistrationMutex};
-    const auto it = m_deviceRegistrationCallbacks.find(deviceNames);
-    if (it == m_deviceRegistrationCallbacks.cend())
+    removeExpiredRegistrations();
+    const auto it = m_deviceRegistrationCallbacks.find(digest);
+    if (it == m_deviceRegistrationCallbacks.end())
+    {
+        ++m_unmatchedRegistrationResponses;
+        LOG(WARN) << "Received a device registration response that does not match any registration.";
+        return;
+    }
+    const auto callback = std::move(it->second.front().callback);
+    it->second.pop_front();
+    if (it->second.empty())
+        m_deviceRegistrationCallbacks.erase(it);
+    if (!callback)
         return;
-    const auto callback = std::move(it->second);
     const auto success = responseMessage->getSuccess();
     const auto failed = responseMessage->getFailed();
     m_commandBuffer.pushCommand(
       std::make_shared<std::function<void()>>([callback, success, failed] { callback(success, failed); }));
-    m_deviceRegistrationCallbacks.erase(it);
 }
 
 void RegistrationService::handleRegisteredDevicesResponse(
@@ -483,28 +834,58 @@ void RegistrationService::handleRegisteredDevicesResponse(
     // Make the query object from the message
     auto query = DeviceQueryData{TimePoint(responseMessage->getTimestampFrom()), responseMessage->getDeviceType(),
                                  responseMessage->getExternalId()};
-    // And now look whether there's such a query object in the map
+
+    // And now look whether there's such a query waiting, and take the oldest one
+    auto pending = std::shared_ptr<PendingDeviceQuery>{};
     {
         std::lock_guard<std::mutex> lock{m_registeredDevicesMutex};
-        const auto it = m_deviceRegistrationResponses.find(query);
-        if (it == m_deviceRegistrationResponses.cend())
+        const auto it = m_deviceQueries.find(query);
+        if (it == m_deviceQueries.end())
             return;
+        pending = it->second.front();
+        it->second.pop_front();
+        if (it->second.empty())
+            m_deviceQueries.erase(it);
+    }
 
-        // Check whether there exists a callback.
-        if (it->first.getCallback())
-        {    // Just invoke the callback
-            const auto callback = std::move(it->first.getCallback());
-            const auto devices = responseMessage->getMatchingDevices();
-            m_commandBuffer.pushCommand(
-              std::make_shared<std::function<void()>>([callback, devices]() { callback(devices); }));
-        }
-        else
-        {
-            // Place the value in the map
-            m_deviceRegistrationResponses[query] = std::move(responseMessage);
-        }
+    // Deliver the devices to the query. The callbacks read the devices from the message itself, so they are not
+    // copied for them.
+    auto response = std::shared_ptr<RegisteredDevicesResponseMessage>{std::move(responseMessage)};
+    if (pending->callback)
+    {
+        m_commandBuffer.pushCommand(std::make_shared<std::function<void()>>(
+          [pending, response]() { pending->callback(response->getMatchingDevices()); }));
     }
-    m_registeredDevicesCV.notify_one();
+    else if (pending->pageCallback)
+    {
+        m_commandBuffer.pushCommand(
+          std::make_shared<std::function<void()>>([pending, response]() { deliverDevicePages(*pending, *response); }));
+    }
+    else
+    {
+        pending->promise.set_value(std::unique_ptr<std::vector<RegisteredDeviceInformation>>{
+          new std::vector<RegisteredDeviceInformation>(response->getMatchingDevices())});
+    }
+}
+
+void RegistrationService::deliverDevicePages(const PendingDeviceQuery& pending,
+                                             const RegisteredDevicesResponseMessage& responseMessage)
+{
+    // The devices are already all parsed into the response, and every page is a range of them
+    const auto& devices = responseMessage.getMatchingDevices();
+    auto page = RegisteredDevicesPage{devices.cbegin(), devices.cbegin(), 0, false, pending.cursor};
+    auto begin = devices.cbegin();
+    do
+    {
+        const auto end = begin + static_cast<std::ptrdiff_t>(
+                                   std::min(pending.pageSize, static_cast<std::size_t>(devices.cend() - begin)));
+        page.devicesBegin = begin;
+        page.devicesEnd = end;
+        page.last = end == devices.cend();
+        pending.pageCallback(page);
+        ++page.index;
+        begin = end;
+    } while (begin != devices.cend());
 }
 }    // namespace connect
 }    // namespace wolkabout
@@ -25,8 +25,13 @@
 #include "core/protocol/RegistrationProtocol.h"
 #include "core/utilities/CommandBuffer.h"
 #include "core/utilities/Service.h"
+#include "core/utilities/Timer.h"
 #include "wolk/service/error/ErrorService.h"
+#include "wolk/service/registration_service/RegisteredDevicesCache.h"
 
+#include <chrono>
+#include <deque>
+#include <future>
 #include <unordered_map>
 
 namespace wolkabout
@@ -67,17 +72,44 @@ public:
     std::size_t operator()(const DeviceQueryData& data) const;
 };
 
-// Define a hash function for a vector of strings.
-struct StringVectorHash
+// This struct holds one page of the devices delivered by a paged query for devices. The page is a view into the devices
+// of the response, so it is only valid while the callback runs, and the devices that are kept have to be copied out.
+struct RegisteredDevicesPage
 {
-public:
-    std::size_t operator()(const std::vector<std::string>& data) const
-    {
-        auto hash = std::size_t{0};
-        for (const auto& entry : data)
-            hash ^= std::hash<std::string>()(entry);
-        return hash;
-    }
+    using Iterator = std::vector<RegisteredDeviceInformation>::const_iterator;
+
+    // The range of the devices in the page. There are at most as many devices as the page size of the query.
+    Iterator begin() const { return devicesBegin; }
+    Iterator end() const { return devicesEnd; }
+    std::size_t size() const { return static_cast<std::size_t>(devicesEnd - devicesBegin); }
+    bool empty() const { return devicesBegin == devicesEnd; }
+
+    Iterator devicesBegin;
+    Iterator devicesEnd;
+
+    // The position of the page in the response, starting from 0.
+    std::size_t index;
+
+    // Whether this is the last page of the response.
+    bool last;
+
+    // The timestamp at which the query was sent out. Used as `timestampFrom` of the next query, it obtains only the
+    // devices that were registered since. It is read from the clock of this side, not the platform's, so if this
+    // clock is ahead of the platform's, the devices registered in that difference are skipped by the next query.
+    TimePoint cursor;
+};
+
+// This struct is used to configure how a bulk registration is split into messages.
+struct BulkRegistrationOptions
+{
+    // The most devices that are sent in one message.
+    std::size_t batchSize = 500;
+
+    // The largest payload of one message, in bytes. A batch whose message is larger is split in halves until it fits.
+    std::size_t maximumPayloadSize = 128 * 1024;
+
+    // The most batches that are waiting for a response at the same time.
+    std::size_t inFlightBatches = 4;
 };
 
 /**
@@ -92,8 +124,11 @@ public:
      *
      * @param protocol The protocol this service will follow.
      * @param connectivityService The connectivity service used to send outgoing messages.
+     * @param devicesCache The local cache of the registered devices. Optional, the cache can not be refreshed without
+     * it.
      */
-    explicit RegistrationService(RegistrationProtocol& protocol, ConnectivityService& connectivityService);
+    explicit RegistrationService(RegistrationProtocol& protocol, ConnectivityService& connectivityService,
+                                 std::shared_ptr<RegisteredDevicesCache> devicesCache = nullptr);
 
     /**
      * Overridden constructor. Will stop all running condition variables.
@@ -124,6 +159,25 @@ public:
       const std::string& deviceKey, const std::vector<DeviceRegistrationData>& devices,
       std::function<void(const std::vector<std::string>&, const std::vector<std::string>&)> callback);
 
+    /**
+     * This method is used to register a large number of devices. The devices are sent in batches bounded by the
+     * options, with only a few batches waiting for a response at a time, and the results of all the batches are
+     * collected into one callback. A batch that could not be sent out is reported as failed.
+     *
+     * @param deviceKey The key of the device trying to register the devices.
+     * @param devices The list of devices that the user would like to register.
+     * @param callback The callback which will be invoked once all batches are answered, with devices that are
+     * registered, and ones that are not.
+     * @param progress The callback which will be invoked after every answered batch, with the count of devices that
+     * are answered so far, and the count of all devices.
+     * @param options The options for splitting the devices into batches.
+     * @return Whether the registration has started. It will not if the list of devices is empty or not valid.
+     */
+    virtual bool registerDevicesInBatches(
+      const std::string& deviceKey, const std::vector<DeviceRegistrationData>& devices,
+      std::function<void(const std::vector<std::string>&, const std::vector<std::string>&)> callback,
+      std::function<void(std::size_t, std::size_t)> progress = {}, BulkRegistrationOptions options = {});
+
     /**
      * This method is used to send a device deletion request.
      *
@@ -191,6 +245,79 @@ public:
                                     std::string externalId,
                                     std::function<void(const std::vector<RegisteredDeviceInformation>&)> callback);
 
+    /**
+     * This method is used to obtain a list of devices. This version returns a future right away, which receives the
+     * response once it arrives, so the caller can wait on many queries at the same time. The query waits until it is
+     * answered, or the service is stopped.
+     *
+     * @param deviceKey The key of the device trying to obtain the list of devices.
+     * @param timestampFrom The timestamp from which devices will be queried.
+     * @param deviceType The type of devices that are queried.
+     * @param externalId The external id of a device, if you have such a value to query a single device.
+     * @return The future for the list of devices. The list will be a {@code: nullptr} if the request could not be sent
+     * out, or the service was stopped before the response arrived.
+     */
+    virtual std::future<std::unique_ptr<std::vector<RegisteredDeviceInformation>>> obtainDevicesFuture(
+      const std::string& deviceKey, TimePoint timestampFrom, std::string deviceType, std::string externalId);
+
+    /**
+     * This method is used to obtain a list of devices, delivered page by page. The platform answers with a single
+     * message that is parsed as a whole, so paging does not bound the memory used by the response, and every page is
+     * a view into its devices, valid only while the callback runs. It only bounds how many devices the callback handles
+     * at once. The callback is invoked for every page, and at least once, with an empty last page, if the platform
+     * returned no devices.
+     *
+     * @param deviceKey The key of the device trying to obtain the list of devices.
+     * @param timestampFrom The timestamp from which devices will be queried. To synchronize incrementally, pass the
+     * cursor of the last page of the previous query. The cursor comes from the local clock, so a local clock that is
+     * ahead of the platform's makes the next query skip the devices registered in the difference.
+     * @param deviceType The type of devices that are queried.
+     * @param externalId The external id of a device, if you have such a value to query a single device.
+     * @param pageSize The most devices delivered in one page. Must not be 0.
+     * @param callback The callback that will be invoked for every page, in order.
+     * @return Whether the request was successfully sent out. If this is false, that means that the callback will never
+     * be called.
+     */
+    virtual bool obtainDevicesPaged(const std::string& deviceKey, TimePoint timestampFrom, std::string deviceType,
+                                    std::string externalId, std::size_t pageSize,
+                                    std::function<void(const RegisteredDevicesPage&)> callback);
+
+    /**
+     * This method is used to refresh the local cache of the devices of a device type. The query obtains only the
+     * devices that were registered since the last refresh of the device type, and they are merged into the cache.
+     *
+     * @param deviceKey The key of the device trying to obtain the list of devices.
+     * @param deviceType The type of devices that are refreshed. Empty to refresh the devices of all types.
+     * @param callback The callback that will be invoked once the cache is refreshed, with whether the devices were
+     * stored. Optional.
+     * @return Whether the request was successfully sent out. Will be false if the service has no cache.
+     */
+    virtual bool refreshDevicesCache(const std::string& deviceKey, const std::string& deviceType,
+                                     std::function<void(bool)> callback = {});
+
+    /**
+     * Getter for the local cache of the registered devices. The lookups on it never reach the platform.
+     *
+     * @return The cache. Will be a {@code: nullptr} if the service has no cache.
+     */
+    std::shared_ptr<RegisteredDevicesCache> getDevicesCache() const;
+
+    /**
+     * This method is used to obtain the count of device registration responses that did not answer any registration,
+     * either because it has already expired, or because it was never sent out by this service.
+     *
+     * @return The count of unmatched responses.
+     */
+    std::uint64_t getUnmatchedRegistrationResponseCount() const;
+
+    /**
+     * This method is used to obtain the count of device registrations that have expired without a response. The
+     * callbacks of those receive all the devices as not registered.
+     *
+     * @return The count of expired registrations.
+     */
+    std::uint64_t getExpiredRegistrationCount() const;
+
     /**
      * This method is overridden from the `MessageListener` interface.
      * This is the method that is invoked once a message has arrived for this listener.
@@ -208,6 +335,150 @@ public:
     const Protocol& getProtocol() override;
 
 private:
+    // This struct holds the state of one bulk registration, shared between all of its batches.
+    struct BulkRegistration
+    {
+        std::string deviceKey;
+        std::vector<DeviceRegistrationData> devices;
+        std::function<void(const std::vector<std::string>&, const std::vector<std::string>&)> callback;
+        std::function<void(std::size_t, std::size_t)> progress;
+        BulkRegistrationOptions options;
+
+        std::mutex mutex;
+        std::size_t next;
+        std::size_t inFlight;
+        std::size_t answered;
+        std::vector<std::string> success;
+        std::vector<std::string> failed;
+    };
+
+    // This struct holds a query for devices that is waiting for a response. The synchronous queries and the ones with a
+    // future receive the response through the promise, the asynchronous ones through the callback, and the paged ones
+    // through the page callback.
+    struct PendingDeviceQuery
+    {
+        std::promise<std::unique_ptr<std::vector<RegisteredDeviceInformation>>> promise;
+        std::function<void(const std::vector<RegisteredDeviceInformation>&)> callback;
+        std::function<void(const RegisteredDevicesPage&)> pageCallback;
+        std::size_t pageSize;
+        TimePoint cursor;
+    };
+
+    /**
+     * This is the internal method that is used to send out a query for devices, with the query already waiting for the
+     * response, so the response can not arrive before it.
+     *
+     * @param deviceKey The key of the device trying to obtain the list of devices.
+     * @param query The query data.
+     * @param pending The query that will wait for the response.
+     * @return Whether the request was successfully sent out.
+     */
+    bool sendDevicesQuery(const std::string& deviceKey, const DeviceQueryData& query,
+                          const std::shared_ptr<PendingDeviceQuery>& pending);
+
+    /**
+     * This is the internal method that is used to deliver the devices of a response page by page to a paged query.
+     *
+     * @param pending The paged query.
+     * @param responseMessage The response for the query.
+     */
+    static void deliverDevicePages(const PendingDeviceQuery& pending,
+                                   const RegisteredDevicesResponseMessage& responseMessage);
+
+    // This struct holds a registration that is waiting for a response.
+    struct PendingRegistration
+    {
+        std::vector<std::string> deviceNames;
+        std::function<void(std::vector<std::string>, std::vector<std::string>)> callback;
+        std::chrono::steady_clock::time_point deadline;
+    };
+
+    /**
+     * This is the internal method that is used to make the key of a registration. The key is a digest of the sorted
+     * device names, so it is the same in whatever order the devices are listed in the request or the response.
+     *
+     * @param deviceNames The names of the devices in the registration.
+     * @return The digest of the names, as a hex string.
+     */
+    static std::string makeRegistrationDigest(std::vector<std::string> deviceNames);
+
+    /**
+     * This is the internal method that is used to send out a registration message, with the registration already
+     * waiting for the response, so the response can not arrive before it.
+     *
+     * @param message The registration message.
+     * @param deviceNames The names of the devices in the registration.
+     * @param callback The callback for the response.
+     * @return Whether the message has been sent out. If it has not, the registration is not kept.
+     */
+    bool sendRegistration(const std::shared_ptr<Message>& message, std::vector<std::string> deviceNames,
+                          std::function<void(std::vector<std::string>, std::vector<std::string>)> callback);
+
+    /**
+     * This is the internal method that is used to drop the registrations whose deadline has passed, and report their
+     * devices as not registered. It is run periodically by the registration timer, and before a response is matched.
+     * The registration mutex must be held.
+     */
+    void removeExpiredRegistrations();
+
+    /**
+     * This is the internal method that is invoked to send the batches of a bulk registration, as long as there are
+     * devices left and the amount of batches waiting for a response allows it.
+     *
+     * @param registration The bulk registration.
+     */
+    void sendRegistrationBatches(const std::shared_ptr<BulkRegistration>& registration);
+
+    /**
+     * This is the internal method that is invoked to record the result of a batch of a bulk registration. Once all
+     * the batches are answered, the callback of the registration is invoked.
+     *
+     * @param registration The bulk registration.
+     * @param batchSize The count of devices in the batch.
+     * @param success The devices of the batch that are registered.
+     * @param failed The devices of the batch that are not registered.
+     */
+    static void handleRegistrationBatch(const std::shared_ptr<BulkRegistration>& registration, std::size_t batchSize,
+                                        const std::vector<std::string>& success,
+                                        const std::vector<std::string>& failed);
+
+    // This struct holds the one request for the children of a device that is sent out, and everyone waiting for it.
+    // The synchronous ones wait on the promises, and the asynchronous ones on the callbacks.
+    struct ChildrenRequest
+    {
+        std::vector<std::function<void(std::vector<std::string>)>> callbacks;
+        std::vector<std::shared_ptr<std::promise<std::shared_ptr<std::vector<std::string>>>>> promises;
+        std::chrono::steady_clock::time_point deadline;
+        // Tells the times the request was sent out apart, so a failed send only rolls back its own
+        std::uint64_t sequence;
+    };
+
+    // This struct holds the last list of children of a device, and until when it can be given out.
+    struct CachedChildren
+    {
+        std::vector<std::string> children;
+        std::chrono::steady_clock::time_point expires;
+    };
+
+    /**
+     * This is the internal method that is used to obtain the children of a device. A list that is still cached is
+     * delivered right away, a request that is already sent out is joined, and otherwise a new one is sent out.
+     *
+     * @param deviceKey The key of the device trying to obtain the list of children.
+     * @param callback The callback for the list. If it is not set, the list is delivered through the promise.
+     * @param promise The promise for the list.
+     * @return Whether the list will be delivered.
+     */
+    bool requestChildren(const std::string& deviceKey, std::function<void(std::vector<std::string>)> callback,
+                         std::shared_ptr<std::promise<std::shared_ptr<std::vector<std::string>>>> promise);
+
+    /**
+     * This is the internal method that is used to drop the cached children of a device, once its children change.
+     *
+     * @param deviceKey The key of the device.
+     */
+    void invalidateChildren(const std::string& deviceKey);
+
     /**
      * This is the internal method that is invoked to handle the received `ChildrenSynchronizationResponseMessage`.
      *
@@ -240,23 +511,32 @@ private:
     // We need to use the connectivity service to send out the messages.
     ConnectivityService& m_connectivityService;
 
-    // Make place for the children requests
+    // Make place for the children requests. There is at most one request per device, and the lists are cached for a
+    // while, so everyone asking at once is served by a single response.
     std::mutex m_childrenSyncDevicesMutex;
-    std::condition_variable m_childrenSyncDevicesCV;
-    std::unordered_map<std::string, std::vector<std::function<void(std::vector<std::string>)>>>
-      m_childrenSynchronizationCallbacks;
+    std::chrono::milliseconds m_childrenCacheTimeToLive;
+    std::uint64_t m_childrenRequestCount;
+    std::unordered_map<std::string, ChildrenRequest> m_childrenRequests;
+    std::unordered_map<std::string, CachedChildren> m_childrenCache;
 
-    // Make place for the device registration responses
+    // Make place for the device registration responses. The registrations are indexed by the digest of their device
+    // names, oldest first, and their deadlines are kept in the order they expire in.
     std::mutex m_deviceRegistrationMutex;
-    std::unordered_map<std::vector<std::string>,
-                       std::function<void(std::vector<std::string>, std::vector<std::string>)>, StringVectorHash>
-      m_deviceRegistrationCallbacks;
-
-    // Make place for the requests for devices
+    Timer m_deviceRegistrationTimer;
+    std::chrono::milliseconds m_deviceRegistrationTimeout;
+    std::unordered_map<std::string, std::deque<PendingRegistration>> m_deviceRegistrationCallbacks;
+    std::deque<std::pair<std::chrono::steady_clock::time_point, std::string>> m_deviceRegistrationDeadlines;
+    std::atomic<std::uint64_t> m_unmatchedRegistrationResponses;
+    std::atomic<std::uint64_t> m_expiredRegistrations;
+
+    // Make place for the requests for devices. Every query waits in its own slot, oldest first, so a response only
+    // wakes the query it answers.
     std::mutex m_registeredDevicesMutex;
-    std::condition_variable m_registeredDevicesCV;
-    std::unordered_map<DeviceQueryData, std::unique_ptr<RegisteredDevicesResponseMessage>, DeviceQueryDataHash>
-      m_deviceRegistrationResponses;
+    std::unordered_map<DeviceQueryData, std::deque<std::shared_ptr<PendingDeviceQuery>>, DeviceQueryDataHash>
+      m_deviceQueries;
+
+    // The local copy of the registered devices
+    std::shared_ptr<RegisteredDevicesCache> m_devicesCache;
 
     // Have a command buffer for calling some callbacks
     CommandBuffer m_commandBuffer;
@@ -0,0 +1,191 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wolk/utilities/Sha256.h"
+
+#include <algorithm>
+#include <fstream>
+#include <vector>
+
+namespace wolkabout
+{
+namespace connect
+{
+namespace
+{
+const std::array<std::uint32_t, 64> ROUND_CONSTANTS = {
+  {0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+   0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+   0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+   0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+   0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+   0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+   0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+   0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2}};
+
+const std::array<std::uint32_t, 8> INITIAL_STATE = {
+  {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19}};
+
+// The size of the pieces in which files are read
+const std::size_t FILE_CHUNK_SIZE = 64 * 1024;
+
+inline std::uint32_t rotateRight(std::uint32_t value, std::uint32_t count)
+{
+    return (value >> count) | (value << (32 - count));
+}
+}    // namespace
+
+Sha256::Sha256()
+{
+    reset();
+}
+
+void Sha256::update(const std::uint8_t* data, std::size_t size)
+{
+    m_length += size;
+
+    // Fill up the partial block first, then process whole blocks straight from the data
+    if (m_bufferSize > 0)
+    {
+        const auto taken = std::min(size, m_buffer.size() - m_bufferSize);
+        std::copy(data, data + taken, m_buffer.begin() + static_cast<std::ptrdiff_t>(m_bufferSize));
+        m_bufferSize += taken;
+        data += taken;
+        size -= taken;
+        if (m_bufferSize < m_buffer.size())
+            return;
+        transform(m_buffer.data());
+        m_bufferSize = 0;
+    }
+    while (size >= m_buffer.size())
+    {
+        transform(data);
+        data += m_buffer.size();
+        size -= m_buffer.size();
+    }
+    std::copy(data, data + size, m_buffer.begin());
+    m_bufferSize = size;
+}
+
+void Sha256::update(const std::string& data)
+{
+    update(reinterpret_cast<const std::uint8_t*>(data.data()), data.size());
+}
+
+Sha256::Digest Sha256::digest()
+{
+    // Pad with a single bit, zeros, and the length in bits
+    const auto bitLength = m_length * 8;
+    const auto one = std::uint8_t{0x80};
+    update(&one, 1);
+    const auto zero = std::uint8_t{0};
+    while (m_bufferSize != 56)
+        update(&zero, 1);
+    auto lengthBytes = std::array<std::uint8_t, 8>{};
+    for (auto i = std::size_t{0}; i < lengthBytes.size(); ++i)
+        lengthBytes[i] = static_cast<std::uint8_t>(bitLength >> (56 - 8 * i));
+    update(lengthBytes.data(), lengthBytes.size());
+
+    auto result = Digest{};
+    for (auto i = std::size_t{0}; i < m_state.size(); ++i)
+        for (auto j = std::size_t{0}; j < 4; ++j)
+            result[i * 4 + j] = static_cast<std::uint8_t>(m_state[i] >> (24 - 8 * j));
+    reset();
+    return result;
+}
+
+bool Sha256::hashFile(const std::string& filePath, Digest& digest)
+{
+    std::ifstream file{filePath, std::ios::in | std::ios::binary};
+    if (!file)
+        return false;
+
+    auto hash = Sha256{};
+    auto buffer = std::vector<char>(FILE_CHUNK_SIZE);
+    while (file)
+    {
+        file.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        hash.update(reinterpret_cast<const std::uint8_t*>(buffer.data()), static_cast<std::size_t>(file.gcount()));
+    }
+    if (file.bad())
+        return false;
+    digest = hash.digest();
+    return true;
+}
+
+std::string Sha256::toHex(const Digest& digest)
+{
+    static const char* const HEX_DIGITS = "0123456789abcdef";
+    auto hex = std::string{};
+    hex.reserve(digest.size() * 2);
+    for (const auto byte : digest)
+    {
+        hex += HEX_DIGITS[byte >> 4];
+        hex += HEX_DIGITS[byte & 0x0F];
+    }
+    return hex;
+}
+
+void Sha256::transform(const std::uint8_t* block)
+{
+    auto words = std::array<std::uint32_t, 64>{};
+    for (auto i = std::size_t{0}; i < 16; ++i)
+        words[i] = static_cast<std::uint32_t>(block[i * 4]) << 24 | static_cast<std::uint32_t>(block[i * 4 + 1]) << 16 |
+                   static_cast<std::uint32_t>(block[i * 4 + 2]) << 8 | static_cast<std::uint32_t>(block[i * 4 + 3]);
+    for (auto i = std::size_t{16}; i < words.size(); ++i)
+    {
+        const auto s0 = rotateRight(words[i - 15], 7) ^ rotateRight(words[i - 15], 18) ^ (words[i - 15] >> 3);
+        const auto s1 = rotateRight(words[i - 2], 17) ^ rotateRight(words[i - 2], 19) ^ (words[i - 2] >> 10);
+        words[i] = words[i - 16] + s0 + words[i - 7] + s1;
+    }
+
+    auto a = m_state[0], b = m_state[1], c = m_state[2], d = m_state[3];
+    auto e = m_state[4], f = m_state[5], g = m_state[6], h = m_state[7];
+    for (auto i = std::size_t{0}; i < words.size(); ++i)
+    {
+        const auto s1 = rotateRight(e, 6) ^ rotateRight(e, 11) ^ rotateRight(e, 25);
+        const auto choice = (e & f) ^ (~e & g);
+        const auto first = h + s1 + choice + ROUND_CONSTANTS[i] + words[i];
+        const auto s0 = rotateRight(a, 2) ^ rotateRight(a, 13) ^ rotateRight(a, 22);
+        const auto majority = (a & b) ^ (a & c) ^ (b & c);
+        const auto second = s0 + majority;
+        h = g;
+        g = f;
+        f = e;
+        e = d + first;
+        d = c;
+        c = b;
+        b = a;
+        a = first + second;
+    }
+    m_state[0] += a;
+    m_state[1] += b;
+    m_state[2] += c;
+    m_state[3] += d;
+    m_state[4] += e;
+    m_state[5] += f;
+    m_state[6] += g;
+    m_state[7] += h;
+}
+
+void Sha256::reset()
+{
+    m_state = INITIAL_STATE;
+    m_bufferSize = 0;
+    m_length = 0;
+}
+}    // namespace connect
+}    // namespace wolkabout
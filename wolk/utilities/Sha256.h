@@ -0,0 +1,87 @@
+/**
+ * Copyright 2022 Wolkabout Technology s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WOLKABOUTCONNECTOR_SHA256_H
+#define WOLKABOUTCONNECTOR_SHA256_H
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+namespace wolkabout
+{
+namespace connect
+{
+/**
+ * This is an incremental SHA-256 hash. Data can be fed in pieces of any size, so files can be hashed while they are
+ * streamed, without holding them in memory.
+ */
+class Sha256
+{
+public:
+    using Digest = std::array<std::uint8_t, 32>;
+
+    Sha256();
+
+    /**
+     * This method is used to feed data into the hash.
+     *
+     * @param data The pointer to the data.
+     * @param size The size of the data.
+     */
+    void update(const std::uint8_t* data, std::size_t size);
+
+    void update(const std::string& data);
+
+    /**
+     * This method is used to finish the hash. The object is reset afterwards, and can be used for new data.
+     *
+     * @return The digest of all the data fed in.
+     */
+    Digest digest();
+
+    /**
+     * This method is used to hash the content of a file, reading it a piece at a time.
+     *
+     * @param filePath The path of the file.
+     * @param digest The digest of the content.
+     * @return Whether the file could be read.
+     */
+    static bool hashFile(const std::string& filePath, Digest& digest);
+
+    /**
+     * This method is used to format a digest as a lowercase hex string.
+     *
+     * @param digest The digest.
+     * @return The hex string.
+     */
+    static std::string toHex(const Digest& digest);
+
+private:
+    // Internal method used to process one full block
+    void transform(const std::uint8_t* block);
+
+    void reset();
+
+    std::array<std::uint32_t, 8> m_state;
+    std::array<std::uint8_t, 64> m_buffer;
+    std::size_t m_bufferSize;
+    std::uint64_t m_length;
+};
+}    // namespace connect
+}    // namespace wolkabout
+
+#endif    // WOLKABOUTCONNECTOR_SHA256_H